@@ -28,6 +28,7 @@ extern "C" {
 #include "sas.h"
 #include "ralf_processor.h"
 #include "servercaps.h"
+#include "header_index.h"
 
 /// Class tracking state required for Rf ACR messages.  An instance of this
 /// class is created for each SIP transaction that requires accounting, and
@@ -376,28 +377,28 @@ private:
 
   void split_sdp(const std::string& sdp, std::vector<std::string>& lines);
 
-  void store_charging_addresses(pjsip_msg* msg);
+  void store_charging_addresses(HeaderIndex& hdrs);
 
-  void store_subscription_ids(pjsip_msg* msg);
+  void store_subscription_ids(HeaderIndex& hdrs);
 
   SubscriptionId uri_to_subscription_id(pjsip_uri* uri);
 
-  void store_calling_party_addresses(pjsip_msg* msg);
+  void store_calling_party_addresses(HeaderIndex& hdrs);
 
   void store_called_party_address(pjsip_msg* msg);
 
-  void store_called_asserted_ids(pjsip_msg* msg);
+  void store_called_asserted_ids(HeaderIndex& hdrs);
 
-  void store_associated_uris(pjsip_msg* msg);
+  void store_associated_uris(HeaderIndex& hdrs);
 
-  void store_charging_info(pjsip_msg* msg);
+  void store_charging_info(HeaderIndex& hdrs);
 
-  void store_media_description(pjsip_msg* msg,
+  void store_media_description(HeaderIndex& hdrs,
                                MediaDescription& description);
 
-  void store_media_components(pjsip_msg* msg, MediaComponents& components);
+  void store_media_components(HeaderIndex& hdrs, MediaComponents& components);
 
-  void store_message_bodies(pjsip_msg* msg);
+  void store_message_bodies(HeaderIndex& hdrs);
 
   void store_instance_id(pjsip_msg* msg);
 
@@ -0,0 +1,160 @@
+/**
+ * @file adaptive_pool.h Adaptive sizing and recycling of the PJSIP pools
+ * used for messages.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef ADAPTIVE_POOL_H__
+#define ADAPTIVE_POOL_H__
+
+extern "C" {
+#include <pjlib.h>
+}
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+/// Wraps the pool factory of a caching pool to manage the pools used for
+/// received and transmitted messages (rdata and tdata) more efficiently.
+///
+/// PJSIP creates these pools with fixed initial and increment sizes, so
+/// large messages (INVITEs with SDP, or with many Route or Path headers)
+/// repeatedly grow their pools block by block.  This tracks how much of each
+/// message pool is used when it is released, and creates new pools with an
+/// initial size that covers most recent messages.
+///
+/// Released message pools are also reset and kept on a short free-list for
+/// their class, so most pools are reused rather than being returned to and
+/// recreated from the caching pool.  The free-lists are shared by all
+/// threads, because message pools are usually created on one thread and
+/// released on another - rdata pools are cloned on the transport thread and
+/// freed on a worker thread.  Pools on the free-lists still count as in use
+/// in the caching pool's statistics.
+///
+/// Pools are identified as message pools by their names, which PJSIP sets
+/// to "rtd%p" and "tdta%p".  Other pools are passed straight through to the
+/// caching pool.
+class AdaptivePoolFactory
+{
+public:
+  /// Installs the adaptive pool handling on a caching pool.  Only one
+  /// instance may exist at a time.
+  ///
+  /// @param cp                - The caching pool to wrap.
+  /// @param recalc_interval   - The number of pools of a class that are
+  ///                            released between recalculations of that
+  ///                            class's initial size.
+  AdaptivePoolFactory(pj_caching_pool* cp, int recalc_interval = 4096);
+
+  /// Uninstalls the adaptive pool handling, returning all pools on the
+  /// free-lists to the caching pool.  All threads that release pools must
+  /// have stopped (or must only release pools after this returns).
+  ~AdaptivePoolFactory();
+
+  /// The classes of message pool.
+  enum PoolClass
+  {
+    RDATA,
+    TDATA,
+    NUM_POOL_CLASSES,
+    NOT_MESSAGE_POOL = NUM_POOL_CLASSES
+  };
+
+  /// The maximum number of pools of each class kept on the free-list.
+  static const size_t FREE_LIST_SIZE = 256;
+
+  /// The limit on the initial size of a message pool.  Larger messages
+  /// still grow their pools as normal.
+  static const size_t MAX_INITIAL_SIZE = 64 * 1024;
+
+  /// The percentage of recent messages that fit in a pool of the chosen
+  /// initial size.
+  static const int TARGET_PERCENTILE = 95;
+
+  struct Stats
+  {
+    size_t initial_size;
+    uint64_t created;
+    uint64_t reused;
+
+    /// The number of pools on the free-list.
+    size_t free;
+  };
+
+  Stats stats(PoolClass pool_class) const;
+
+  /// The name of a class of pool, as used in statistics.
+  static const char* class_name(PoolClass pool_class);
+
+  /// Works out the class of a pool from its name.
+  static PoolClass classify(const char* name);
+
+private:
+  /// Size of the buckets used to record the sizes of released pools.
+  static const size_t BUCKET_SIZE = 1024;
+  static const size_t NUM_BUCKETS = MAX_INITIAL_SIZE / BUCKET_SIZE;
+
+  /// State for each class of pool.
+  struct ClassState
+  {
+    std::atomic<size_t> initial_size;
+    std::atomic<uint64_t> created;
+    std::atomic<uint64_t> reused;
+    std::atomic<uint64_t> released;
+    std::atomic<uint64_t> buckets[NUM_BUCKETS];
+
+    /// Held while the initial size is recalculated.
+    std::mutex recalc_lock;
+
+    /// Released pools waiting to be reused, and the lock protecting them.
+    /// The lock is only held to push or pop a pool.
+    mutable std::mutex free_list_lock;
+    std::vector<pj_pool_t*> free_list;
+  };
+
+  /// The replacement pool factory functions.
+  static pj_pool_t* create_pool(pj_pool_factory* factory,
+                                const char* name,
+                                pj_size_t initial_size,
+                                pj_size_t increment_size,
+                                pj_pool_callback* callback);
+  static void release_pool(pj_pool_factory* factory, pj_pool_t* pool);
+
+  /// Records the amount of a pool that was used, and recalculates the
+  /// initial size for the class if it is time to.
+  void record_usage(PoolClass pool_class, size_t used_size);
+  void recalculate(ClassState& state);
+
+  /// Takes a pool from a class's free-list, or returns NULL if it is
+  /// empty.
+  static pj_pool_t* pop_free(ClassState& state);
+
+  /// Adds a pool to a class's free-list.  Returns false if it is full.
+  static bool push_free(ClassState& state, pj_pool_t* pool);
+
+  pj_caching_pool* _cp;
+  uint64_t _recalc_interval;
+
+  /// The caching pool's original factory functions.
+  pj_pool_t* (*_create_pool)(pj_pool_factory*,
+                             const char*,
+                             pj_size_t,
+                             pj_size_t,
+                             pj_pool_callback*);
+  void (*_release_pool)(pj_pool_factory*, pj_pool_t*);
+
+  ClassState _classes[NUM_POOL_CLASSES];
+
+  /// The installed instance.
+  static AdaptivePoolFactory* _instance;
+};
+
+#endif
@@ -11,13 +11,26 @@
 
 #include <map>
 #include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #include "pdlog.h"
 #include "alarm.h"
+#include "instrumented_mutex.h"
 
 #ifndef AS_COMMUNICATION_TRACKER_H_
 #define AS_COMMUNICATION_TRACKER_H_
 
+/// Tracks whether communication with each Application Server is working,
+/// raising an alarm and generating logs as ASs start and stop failing.
+///
+/// This is called on every AS transaction, so the common cases - a success,
+/// or another failure for an AS that is already known to be failing - don't
+/// take any locks.  The lock is only taken when an AS first fails, when a
+/// new AS URI is first seen by a thread, and when checking for ASs that have
+/// recovered, which is done periodically on a background thread.
 class AsCommunicationTracker
 {
 public:
@@ -51,19 +64,62 @@ public:
   ///                 "SIP 500 response received"
   virtual void on_failure(const std::string& as_uri, const std::string& reason);
 
+  /// Check if any application servers are healthy. If so, log them and
+  /// consider clearing the alarm.  This does nothing unless a check period
+  /// has passed since the last check.
+  ///
+  /// This is called regularly by the tracker's background thread, and is
+  /// public so that UTs can drive it.
+  void check_for_healthy_app_servers();
+
 private:
-  // A lock that protects all member variables of this class.
-  pthread_mutex_t _lock;
+  /// The state of one AS.  These are created the first time an AS URI is
+  /// seen, and live as long as the tracker.
+  struct AsState
+  {
+    AsState() : failed(false), failures(0) {}
+
+    // Whether the AS is currently treated as failed.
+    std::atomic<bool> failed;
+
+    // A count of how many times we have had a communication failure to the
+    // AS in the current time period.
+    std::atomic<int> failures;
+  };
+
+  /// Finds the state for an AS, creating it if this is the first time the
+  /// AS has been seen.  Each thread caches the states it has looked up, so
+  /// this only takes the lock the first time a thread sees an AS.
+  AsState* get_as_state(const std::string& as_uri);
+
+  /// Treats an AS as failed, if it isn't already.
+  void as_failed(AsState* as_state,
+                 const std::string& as_uri,
+                 const std::string& reason);
 
-  // A count of how many times we have had a communication failure to each AS
-  // in the last time period.
-  std::map<std::string, int> _as_failures;
+  /// The background thread that checks for healthy ASs.
+  void run_checks();
 
-  // The time (in ms since the epoch) at which we should check the _as_failures
+  // A lock that protects _as_states and _num_failed, and serialises changes
+  // to whether each AS is failed.
+  InstrumentedMutex _lock;
+
+  // The state of each AS that has been seen, keyed by URI.
+  std::map<std::string, AsState*> _as_states;
+
+  // The number of ASs currently treated as failed.
+  int _num_failed;
+
+  // A unique ID for this tracker, used to key the per-thread caches of AS
+  // states.
+  const uint64_t _id;
+  static std::atomic<uint64_t> _next_id;
+
+  // The time (in ms since the epoch) at which we should check the AS states
   // to determine if some ASs are now OK again.
   std::atomic<uint64_t> _next_check_time_ms;
 
-  // The length of time that must pass between checks of _as_failures.
+  // The length of time that must pass between checks of the AS states.
   const static uint64_t NEXT_CHECK_INTERVAL_MS = 5 * 60 * 1000;
 
   // The alarm to raise when communication to some Application Servers is
@@ -79,13 +135,15 @@ private:
   const PDLog2<const char*, const char*>* _as_failed_log;
   const PDLog1<const char*>* _as_ok_log;
 
-  /// Check if any application servers are healthy. If so, log them and
-  /// consider clearing the alarm.
-  void check_for_healthy_app_servers();
+  // The background thread that checks for healthy ASs, and what it waits on
+  // between checks.
+  bool _terminate;
+  std::mutex _check_lock;
+  std::condition_variable _check_cond;
+  std::thread _check_thread;
 
   /// @return The current monotonic time in ms. Note that this is not wall time!
   static uint64_t current_time_ms();
 };
 
 #endif
-
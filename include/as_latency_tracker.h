@@ -0,0 +1,139 @@
+/**
+ * @file as_latency_tracker.h Tracking of Application Server response times,
+ * for adaptive AS timeouts and circuit breaking.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef AS_LATENCY_TRACKER_H_
+#define AS_LATENCY_TRACKER_H_
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+
+/// Tracks how quickly each Application Server responds, and whether it is
+/// failing, so that the S-CSCF can
+///
+/// -  shorten the liveness timer for an AS that normally responds quickly,
+///    so a hung AS costs less call setup time before default handling kicks
+///    in
+/// -  stop sending requests to an AS that keeps failing (open its circuit
+///    breaker) for a while, so that calls bypass it immediately.
+///
+/// Like AsCommunicationTracker, this is called on every AS transaction, so
+/// the common paths don't take any locks.
+class AsLatencyTracker
+{
+public:
+  /// Constructor.
+  ///
+  /// @param timeout_factor     - The adaptive timeout for an AS is this
+  ///                             multiple of its 99th percentile response
+  ///                             time.  0 disables adaptive timeouts.
+  /// @param breaker_threshold  - The number of consecutive failures after
+  ///                             which an AS's circuit breaker opens.  0
+  ///                             disables circuit breaking.
+  /// @param breaker_open_ms    - How long a circuit breaker stays open
+  ///                             before a single trial request is let
+  ///                             through.
+  AsLatencyTracker(int timeout_factor,
+                   int breaker_threshold,
+                   int breaker_open_ms = DEFAULT_BREAKER_OPEN_MS);
+  virtual ~AsLatencyTracker();
+
+  static const int DEFAULT_BREAKER_OPEN_MS = 30000;
+
+  /// Adaptive timeouts are never shorter than this.
+  static const int MIN_ADAPTIVE_TIMEOUT_MS = 100;
+
+  /// The number of responses from an AS between recalculations of its
+  /// response time percentile.  No adaptive timeout is used for an AS until
+  /// this many responses have been seen.
+  static const int RECALC_INTERVAL = 100;
+
+  /// Records a response from an AS.
+  ///
+  /// @param as_uri      - The URI of the AS.
+  /// @param latency_ms  - How long the AS took to respond.
+  void on_success(const std::string& as_uri, uint64_t latency_ms);
+
+  /// Records that an AS failed (timed out or returned an error).
+  void on_failure(const std::string& as_uri);
+
+  /// Returns whether a request should be sent to an AS.  This is false while
+  /// the AS's circuit breaker is open.  Once it has been open for long
+  /// enough, a single trial request is allowed through; if that succeeds
+  /// the breaker closes.
+  bool allow_request(const std::string& as_uri);
+
+  /// Returns the liveness timeout to use for an AS.
+  ///
+  /// @param as_uri              - The URI of the AS.
+  /// @param configured_timeout  - The configured timeout, which the adaptive
+  ///                              timeout never exceeds.
+  int timeout_ms(const std::string& as_uri, int configured_timeout_ms);
+
+  /// @return The current monotonic time in ms.
+  static uint64_t current_time_ms();
+
+private:
+  /// Response times are recorded in buckets.  Below 8ms each bucket is 1ms
+  /// wide.  Above that, each doubling of the response time is split into 8
+  /// buckets, up to 64s.
+  static const int SUB_BUCKETS = 8;
+  static const int NUM_BUCKETS = SUB_BUCKETS + 13 * SUB_BUCKETS;
+
+  static int bucket_index(uint64_t latency_ms);
+  static uint64_t bucket_upper_bound_ms(int bucket);
+
+  /// The state of one AS.  These are created the first time an AS URI is
+  /// seen, and live as long as the tracker.
+  struct AsState
+  {
+    AsState();
+
+    // Response time histogram, and the number of responses since the last
+    // recalculation.
+    std::atomic<uint32_t> buckets[NUM_BUCKETS];
+    std::atomic<uint32_t> responses;
+
+    // The 99th percentile response time, or 0 if not known yet.
+    std::atomic<uint64_t> p99_ms;
+
+    // Held while recalculating p99_ms.
+    std::mutex recalc_lock;
+
+    // Circuit breaker state.  The breaker is open (or half open) when
+    // open_until_ms is non-zero.  When it's half open, trial_start_ms is the
+    // time the trial request was let through.
+    std::atomic<int> consecutive_failures;
+    std::atomic<uint64_t> open_until_ms;
+    std::atomic<uint64_t> trial_start_ms;
+  };
+
+  AsState* get_as_state(const std::string& as_uri);
+  void recalculate(AsState* as_state);
+
+  int _timeout_factor;
+  int _breaker_threshold;
+  int _breaker_open_ms;
+
+  // Protects _as_states.
+  std::mutex _lock;
+  std::map<std::string, AsState*> _as_states;
+
+  // A unique ID for this tracker, used to key the per-thread caches of AS
+  // states.
+  const uint64_t _id;
+  static std::atomic<uint64_t> _next_id;
+};
+
+#endif
@@ -19,12 +19,14 @@ extern "C" {
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 
 #include "log.h"
 #include "sessioncase.h"
 #include "ifchandler.h"
 #include "acr.h"
 #include "fifcservice.h"
+#include "instrumented_mutex.h"
 
 // Forward declarations.
 class UASTransaction;
@@ -387,6 +389,11 @@ public:
   AsChainTable();
   ~AsChainTable();
 
+  /// The global operator new doesn't honour the shards' alignment before
+  /// C++17, so tables are allocated with it explicitly.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
   /// Lookup the next step to follow when receiving the given
   // token. The 0th token thus indicates the 1st step, the 1st token
   // the 2nd step, and so on.
@@ -398,9 +405,31 @@ private:
   void register_(AsChain* as_chain, std::vector<std::string>& tokens);
   void unregister(std::vector<std::string>& tokens);
 
+  /// Tokens are made up of a single character identifying the shard they
+  /// are stored in, followed by random characters.
   static const int TOKEN_LENGTH = 10;
 
-  /// Map from ODI token to pair of (AsChain, index).
-  std::map<std::string, AsChainLink> _odi_token_map;
-  pthread_mutex_t _lock;
+  /// The token table is split into shards, each with its own lock, so that
+  /// AS chains being created, destroyed and looked up for different calls
+  /// rarely contend. All the tokens for one AsChain are in the same shard.
+  /// The number of shards must not exceed the number of characters in the
+  /// token alphabet (64).
+  static const int NUM_SHARDS = 64;
+
+  /// Each shard is aligned to its own cache lines so that the locks of
+  /// neighbouring shards don't falsely share.
+  struct alignas(64) Shard
+  {
+    Shard() : odi_token_map(), lock("AsChainTable") {}
+
+    /// Map from ODI token to pair of (AsChain, index).
+    std::unordered_map<std::string, AsChainLink> odi_token_map;
+    InstrumentedMutex lock;
+  };
+
+  /// Returns the shard a token is stored in, or NULL if the token is not
+  /// well-formed.
+  Shard* shard_for_token(const std::string& token);
+
+  Shard _shards[NUM_SHARDS];
 };
@@ -22,8 +22,11 @@
 
 #include <functional>
 #include "updater.h"
+#include "instrumented_mutex.h"
 #include "sas.h"
 
+class ConfigImage;
+
 class BgcfService
 {
 public:
@@ -33,12 +36,31 @@ public:
   /// Updates the bgcf routes
   void update_routes();
 
+  /// Compiles the BGCF configuration file into a binary image that
+  /// update_routes can load instead.  Used by sprout_config_compiler.
+  static bool compile_image(const std::string& configuration,
+                            const std::string& image_path);
+
   std::vector<std::string> get_route_from_domain(const std::string &domain,
                                                  SAS::TrailId trail) const;
   std::vector<std::string> get_route_from_number(const std::string &number,
                                                  SAS::TrailId trail) const;
 
 private:
+  /// Reads and validates the BGCF configuration file.  Returns false if the
+  /// file can't be used at all.
+  static bool read_configuration(
+                const std::string& configuration,
+                std::map<std::string, std::vector<std::string>>& domain_routes,
+                std::map<std::string, std::vector<std::string>>& number_routes);
+
+  /// Loads the routes from a precompiled image.
+  void load_image(const ConfigImage& image);
+
+  /// The first field of each record in an image, giving the type of route.
+  static const char* IMAGE_DOMAIN;
+  static const char* IMAGE_NUMBER;
+
   std::map<std::string, std::vector<std::string>> _domain_routes;
   std::map<std::string, std::vector<std::string>> _number_routes;
   std::string _configuration;
@@ -46,7 +68,7 @@ private:
 
   // Mark as mutable to flag that this can be modified without affecting the
   // external behaviour of the class, allowing for locking in 'const' methods.
-  mutable boost::shared_mutex _routes_rw_lock;
+  mutable InstrumentedSharedMutex _routes_rw_lock;
 };
 
 #endif
@@ -27,6 +27,7 @@
 #include "impistore.h"
 #include "analyticslogger.h"
 #include "fifcservice.h"
+#include "expiry_jitter.h"
 
 // Struct containing the possible values for non-REGISTER authentication. These
 // are a set of flags that indicate different conditions that may cause a
@@ -90,6 +91,7 @@ struct options
   std::string                          analytics_directory;
   int                                  reg_max_expires;
   int                                  sub_max_expires;
+  int                                  expiry_jitter_percent;
   std::string                          http_address;
   int                                  http_port;
   int                                  http_threads;
@@ -102,6 +104,10 @@ struct options
   bool                                 interactive;
   bool                                 daemon;
   bool                                 override_npdi;
+  bool                                 in_dialog_fast_path;
+  int                                  io_profile_sample_rate;
+  int                                  slow_transactions;
+  int                                  slow_transactions_window;
   int                                  max_tokens;
   float                                init_token_rate;
   float                                min_token_rate;
@@ -116,6 +122,8 @@ struct options
   int                                  dns_timeout;
   int                                  session_continued_timeout_ms;
   int                                  session_terminated_timeout_ms;
+  int                                  as_adaptive_timeout_factor;
+  int                                  as_circuit_breaker_threshold;
   std::set<std::string>                stateless_proxies;
   int                                  max_sproutlet_depth;
   std::string                          pbxes;
@@ -170,5 +178,7 @@ extern AnalyticsLogger* analytics_logger;
 extern ChronosConnection* chronos_connection;
 extern FIFCService* fifc_service;
 extern IFCConfiguration ifc_configuration;
+extern ExpiryJitter* reg_expiry_jitter;
+extern ExpiryJitter* sub_expiry_jitter;
 
 #endif
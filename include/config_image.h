@@ -0,0 +1,165 @@
+/**
+ * @file config_image.h Precompiled binary images of configuration files.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef CONFIG_IMAGE_H__
+#define CONFIG_IMAGE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "pj_string_view.h"
+
+/// A configuration file (such as enum.json or bgcf.json) compiled by
+/// sprout_config_compiler into a flat binary image that Sprout can mmap.
+///
+/// Loading an image avoids reading the source file into memory and building
+/// a JSON DOM from it, and the compiler has already validated the entries, so
+/// Sprout just walks the records.
+///
+/// An image is a header, followed by a table of records, a table of fields
+/// and a string table.  Each record is a run of fields, and each field is a
+/// string in the string table.  How the fields of a record are interpreted
+/// depends on the type of configuration.  Integers are in host byte order -
+/// images are built on the node that uses them.
+///
+/// The header records the size and modification time (to the nanosecond, so
+/// that an edit within the same second is noticed) of the source file the
+/// image was compiled from.  If the source file has changed since, the image
+/// is stale and is ignored, so that a configuration upload without a
+/// recompile never leaves Sprout using old configuration.
+class ConfigImage
+{
+public:
+  /// The type of configuration held in an image.
+  enum Type
+  {
+    ENUM = 1,
+    BGCF = 2
+  };
+
+  /// The current version of the image format.  Images with a different
+  /// version are ignored.
+  static const uint32_t FORMAT_VERSION = 2;
+
+  ConfigImage();
+  ~ConfigImage();
+
+  /// Returns the path of the image for a source configuration file.
+  static std::string image_path(const std::string& source_path);
+
+  /// The result of opening an image.
+  enum Status
+  {
+    OK,
+    NOT_FOUND,
+    STALE,
+    INVALID
+  };
+
+  /// Maps an image into memory.
+  ///
+  /// @returns            - OK if a valid, up to date image was mapped.
+  /// @param path         - The path of the image.
+  /// @param type         - The type of configuration the image should hold.
+  /// @param source_path  - The source file the image was compiled from.  The
+  ///                       image is rejected as stale if this has changed
+  ///                       since.  It need not exist.
+  Status open(const std::string& path,
+              Type type,
+              const std::string& source_path);
+
+  /// Unmaps the image (if one is mapped).
+  void close();
+
+  /// The number of records in the image.
+  size_t num_records() const { return _num_records; }
+
+  /// The number of fields in a record.
+  size_t num_fields(size_t record) const;
+
+  /// Returns a field of a record.  The view points into the mapped image, so
+  /// is only valid until the image is closed.
+  PJStringView field(size_t record, size_t field) const;
+
+  /// Structures making up the image.
+  struct Header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t type;
+    int64_t source_mtime;
+    int64_t source_mtime_nsec;
+    uint64_t source_size;
+    uint32_t num_records;
+    uint32_t num_fields;
+    uint64_t records_offset;
+    uint64_t fields_offset;
+    uint64_t strings_offset;
+    uint64_t strings_length;
+  };
+
+  struct Record
+  {
+    uint32_t first_field;
+    uint32_t num_fields;
+  };
+
+  struct Field
+  {
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  static const char MAGIC[8];
+
+private:
+  /// Checks that the tables described by the header lie within the image.
+  bool check_layout(const Header* header, size_t image_size);
+
+  void* _image;
+  size_t _image_size;
+
+  size_t _num_records;
+  const Record* _records;
+  const Field* _fields;
+  const char* _strings;
+};
+
+/// Builds a ConfigImage and writes it to disk.
+class ConfigImageWriter
+{
+public:
+  ConfigImageWriter(ConfigImage::Type type);
+
+  /// Adds a record to the image.
+  void add_record(const std::vector<std::string>& fields);
+
+  /// The number of records added so far.
+  size_t num_records() const { return _records.size(); }
+
+  /// Writes the image.  The image is written to a temporary file that is
+  /// renamed over the target, so a running Sprout never sees a partially
+  /// written image.
+  ///
+  /// @returns            - Whether the image was written successfully.
+  /// @param path         - The path to write the image to.
+  /// @param source_path  - The source file the image was compiled from.
+  bool write(const std::string& path, const std::string& source_path);
+
+private:
+  ConfigImage::Type _type;
+  std::vector<ConfigImage::Record> _records;
+  std::vector<ConfigImage::Field> _fields;
+  std::string _strings;
+};
+
+#endif
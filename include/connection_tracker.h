@@ -23,6 +23,8 @@ extern "C" {
 // Common STL includes.
 #include <map>
 
+#include "instrumented_mutex.h"
+
 /// Interface that the ConnectionTracker notifies when quiescing connections has
 /// completed.
 class ConnectionsQuiescedInterface
@@ -60,8 +62,9 @@ public:
 
 private:
   // This must be held when accessing _connection_listeners, to avoid contention
-  // between the transport thread and websocket threads.
-  pthread_mutex_t _lock;
+  // between the transport thread and websocket threads.  This lock has always
+  // been recursive.
+  InstrumentedMutex _lock;
 
   // A map of all the connections known to the connection manager, and their
   // state listeners.  This is a set of pjsip transports, but only includes
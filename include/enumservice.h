@@ -26,6 +26,9 @@
 #include "dnsresolver.h"
 #include "communicationmonitor.h"
 #include "updater.h"
+#include "instrumented_mutex.h"
+
+class ConfigImage;
 
 /// @class EnumService
 ///
@@ -85,6 +88,11 @@ public:
   // Updates the enum configuration
   void update_enum();
 
+  // Compiles the ENUM configuration file into a binary image that
+  // update_enum can load instead.  Used by sprout_config_compiler.
+  static bool compile_image(const std::string& configuration,
+                            const std::string& image_path);
+
   std::string lookup_uri_from_user(const std::string& user, SAS::TrailId trail) const;
 
 private:
@@ -102,9 +110,17 @@ private:
 
   // Mark as mutable to flag that this can be modified without affecting the
   // external behaviour of the class, allowing for locking in 'const' methods.
-  mutable boost::shared_mutex _number_prefixes_rw_lock;
+  mutable InstrumentedSharedMutex _number_prefixes_rw_lock;
 
   const NumberPrefix* prefix_match(const std::string& number) const;
+
+  // Reads and validates the ENUM configuration file.  Returns false if the
+  // file can't be used at all.
+  static bool read_configuration(const std::string& configuration,
+                                 std::vector<NumberPrefix>& number_prefixes);
+
+  // Loads the configuration from a precompiled image.
+  void load_image(const ConfigImage& image);
 };
 
 /// @class DNSEnumService
@@ -0,0 +1,107 @@
+/**
+ * @file expiry_jitter.h Desynchronisation of registration and subscription
+ * expiry times.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef EXPIRY_JITTER_H__
+#define EXPIRY_JITTER_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+/// Policy for granting randomised expiry times.
+///
+/// If lots of devices register at the same time (for example when an access
+/// network or P-CSCF recovers from an outage), granting them all the same
+/// expiry keeps them synchronised, so every refresh cycle arrives as a storm.
+/// This policy shortens each granted expiry by a random amount of up to a
+/// configured percentage, which spreads the refreshes across the interval.
+///
+/// The policy also keeps a histogram of when the expiries it has granted will
+/// fall due.  When picking an expiry it considers two random candidates and
+/// picks the one that falls in the emptier histogram bucket, so clusters of
+/// refreshes are broken up over successive refresh cycles.
+class ExpiryJitter
+{
+public:
+  /// Constructor.
+  ///
+  /// @param max_expires    - The largest expiry that will be granted (in
+  ///                         seconds).  This sets the range of the histogram.
+  /// @param jitter_percent - The largest proportion of an expiry that may be
+  ///                         removed, as a percentage.
+  ExpiryJitter(int max_expires, int jitter_percent);
+  ~ExpiryJitter();
+
+  /// Picks the expiry to grant, and records it in the histogram.
+  ///
+  /// @returns              - The expiry to grant (in seconds).  This is never
+  ///                         longer than the requested expiry.
+  /// @param expiry         - The expiry that would otherwise be granted (in
+  ///                         seconds).  Zero and short expiries are returned
+  ///                         unchanged.
+  /// @param now            - The current time.
+  /// @param old_expires    - The absolute expiry time this refresh replaces,
+  ///                         or 0 if this is a new registration or
+  ///                         subscription.
+  int grant(int expiry, int now, int old_expires = 0);
+
+  /// Picks the expiry to grant, as grant() does, but doesn't record it.  Use
+  /// this with record() when the expiry should only be counted once it has
+  /// been stored.
+  int choose(int expiry, int now);
+
+  /// Records an expiry picked by choose() in the histogram.
+  ///
+  /// @param expiry         - The expiry that was passed to choose().
+  /// @param granted        - The expiry that choose() returned.
+  /// @param now            - The time passed to choose().
+  /// @param old_expires    - As for grant().
+  void record(int expiry, int granted, int now, int old_expires = 0);
+
+  /// Gets the number of granted expiries due in each upcoming interval.
+  ///
+  /// @param now            - The current time.
+  /// @param density        - Filled in with one count per histogram bucket,
+  ///                         starting with the bucket containing now.
+  void get_density(int now, std::vector<uint32_t>& density);
+
+  /// The width of each histogram bucket (in seconds).
+  int bucket_width() const { return _bucket_width; }
+
+  /// The number of histogram buckets.  These cover the range from now until
+  /// the maximum expiry.
+  static const int NUM_BUCKETS = 60;
+
+  /// Expiries shorter than this (in seconds) are never shortened.
+  static const int MIN_JITTER_EXPIRY = 60;
+
+private:
+  struct Bucket
+  {
+    /// The absolute bucket number (time / bucket width) this count is for.
+    /// The ring of buckets is reused as time passes, so this detects stale
+    /// counts.
+    int64_t epoch;
+    uint32_t count;
+  };
+
+  /// Returns the current count for the bucket containing the given time.
+  /// Must be called with the lock held.
+  uint32_t count_at(int time);
+
+  const int _jitter_percent;
+  int _bucket_width;
+  Bucket _buckets[NUM_BUCKETS];
+  pthread_mutex_t _lock;
+};
+
+#endif
@@ -0,0 +1,121 @@
+/**
+ * @file fast_clock.h Low-overhead clock, based on the CPU timestamp counter.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef FAST_CLOCK_H_
+#define FAST_CLOCK_H_
+
+#include <time.h>
+#include <stdint.h>
+
+/// Clock for latency accounting and timestamps that is much cheaper to read
+/// than clock_gettime.
+///
+/// Once started, the clock reads the CPU's invariant timestamp counter
+/// (TSC) and scales it to nanoseconds.  A background thread periodically
+/// re-syncs it against CLOCK_MONOTONIC and CLOCK_REALTIME, slewing the scale
+/// so that the clock never goes backwards.
+///
+/// Until the clock is started, or if the CPU doesn't have an invariant TSC,
+/// reads fall back to the system clock functions.
+namespace FastClock
+{
+  /// Calibrates the clock and starts the re-sync thread.
+  void start(int sync_interval_ms = 1000);
+
+  /// Stops the re-sync thread, and reverts to the system clock.
+  void stop();
+
+  /// Whether reads are being served from the TSC.
+  bool using_tsc();
+
+  /// Monotonic time in nanoseconds, comparable to CLOCK_MONOTONIC.
+  uint64_t now_ns();
+
+  /// Monotonic time in milliseconds.
+  inline uint64_t now_ms()
+  {
+    return now_ns() / 1000000;
+  }
+
+  /// Wall clock time, comparable to CLOCK_REALTIME.  May drift from the
+  /// system clock by up to a few microseconds between re-syncs, and only
+  /// picks up changes to the system time at the next re-sync.
+  void realtime(struct timespec* ts);
+
+  /// Wall clock time in seconds, for callers that only need second
+  /// granularity (in place of time(NULL)).  Once the clock is started this
+  /// is a cached value that the re-sync thread updates every second, so it
+  /// may lag time(NULL) by a few milliseconds around each second boundary.
+  time_t coarse_time();
+};
+
+/// Stopwatch for timing latencies using the fast clock.  Unlike
+/// Utils::StopWatch, it can be paused and resumed without losing the time
+/// measured so far.
+class FastStopWatch
+{
+public:
+  FastStopWatch() : _start_ns(0), _elapsed_ns(0), _running(false) {}
+
+  /// Starts (or restarts) timing from zero.
+  inline void start()
+  {
+    _start_ns = FastClock::now_ns();
+    _elapsed_ns = 0;
+    _running = true;
+  }
+
+  /// Stops timing.  The time measured so far is kept.
+  inline void stop()
+  {
+    if (_running)
+    {
+      _elapsed_ns += FastClock::now_ns() - _start_ns;
+      _running = false;
+    }
+  }
+
+  /// Resumes timing after a stop.
+  inline void resume()
+  {
+    if (!_running)
+    {
+      _start_ns = FastClock::now_ns();
+      _running = true;
+    }
+  }
+
+  /// Reads the time measured so far.  Always succeeds - the return value is
+  /// for compatibility with Utils::StopWatch.
+  inline bool read(unsigned long& result_us) const
+  {
+    uint64_t elapsed_ns = _elapsed_ns;
+
+    if (_running)
+    {
+      elapsed_ns += FastClock::now_ns() - _start_ns;
+    }
+
+    result_us = elapsed_ns / 1000;
+    return true;
+  }
+
+  /// The time at which timing was last started or resumed, from
+  /// FastClock::now_ns.
+  inline uint64_t start_ns() const { return _start_ns; }
+
+private:
+  uint64_t _start_ns;
+  uint64_t _elapsed_ns;
+  bool _running;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file fast_random.h Lock-free per-thread random number generation.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef FAST_RANDOM_H__
+#define FAST_RANDOM_H__
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+/// Fast random numbers for generating identifiers (branch IDs, flow tokens,
+/// ODI tokens) and for randomised load spreading.
+///
+/// Each thread has its own xoshiro256** generator, seeded from the kernel's
+/// entropy pool the first time the thread uses it, so generating a number
+/// takes no locks and makes no system calls. This is NOT suitable for
+/// anything that needs to be cryptographically unpredictable, such as
+/// authentication nonces.
+namespace FastRandom
+{
+  /// Returns 64 uniformly distributed random bits.
+  uint64_t next();
+
+  /// Returns a uniformly distributed random number in the range [0, n). n
+  /// must be non-zero.
+  uint32_t uniform(uint32_t n);
+
+  /// Fills a buffer with random characters from the standard base64
+  /// alphabet (A-Z, a-z, 0-9, '+' and '/'). No terminator is written.
+  void fill_base64(char* buf, size_t len);
+
+  /// Fills a buffer with random characters from the URL and SIP token safe
+  /// base64 alphabet (A-Z, a-z, 0-9, '-' and '_'). No terminator is
+  /// written.
+  void fill_base64url(char* buf, size_t len);
+
+  /// Fills a buffer with random lower case hex digits. No terminator is
+  /// written.
+  void fill_hex(char* buf, size_t len);
+
+  /// Creates a random base64 token of the specified length. This is a
+  /// drop-in replacement for Utils::create_random_token.
+  void create_token(size_t length, std::string& token);
+}
+
+#endif
@@ -14,6 +14,7 @@
 #include "rapidxml/rapidxml.hpp"
 
 #include "updater.h"
+#include "instrumented_mutex.h"
 #include "ifc.h"
 #include "alarm.h"
 
@@ -44,7 +45,7 @@ private:
 
   // Mark as mutable to flag that this can be modified without affecting the
   // external behaviour of the calss, allowing for locking in 'const' methods.
-  mutable boost::shared_mutex _sets_rw_lock;
+  mutable InstrumentedSharedMutex _sets_rw_lock;
 
   // Helper functions to set/clear the alarm.
   void set_alarm();
@@ -29,6 +29,7 @@ extern "C" {
 #include "snmp_scalar.h"
 #include "stack.h"
 #include "quiescing_manager.h"
+#include "instrumented_mutex.h"
 
 class FlowTable;
 
@@ -210,7 +211,7 @@ private:
     pj_sockaddr _raddr;
   };
 
-  pthread_mutex_t _flow_map_lock;
+  InstrumentedMutex _flow_map_lock;
   std::map<FlowKey, Flow*> _tp2flow_map;        // map from transport addresses to flow
   std::map<std::string, Flow*> _tk2flow_map;    // map from token to flow
 
@@ -18,6 +18,13 @@
 #include "subscriber_manager.h"
 #include "sipresolver.h"
 #include "impistore.h"
+#include "adaptive_pool.h"
+#include "expiry_jitter.h"
+#include "threadpool.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include <mutex>
 
 /// Base AuthTimeoutTask class for tasks that implement authentication timeout
 /// callbacks from specific timer services.
@@ -143,13 +150,112 @@ public:
   void run();
 
 protected:
-  /// Write information about all bindings in an AoR to a JSON string
+  /// Write information about the bindings in an AoR to a JSON string
   ///
   /// @param bindings[in]   map of binding_id to Binding object in an AoR
+  /// @param after[in]      only include bindings with IDs after this one (or
+  ///                       all bindings if empty)
+  /// @param limit[in]      the maximum number of bindings to include (or 0
+  ///                       for no limit)
   ///
-  /// @return JSON string containing all bindings information
-  std::string serialize_data(const Bindings& bindings);
+  /// @return JSON string containing the bindings information
+  std::string serialize_data(const Bindings& bindings,
+                             const std::string& after = "",
+                             size_t limit = 0);
+  const Config* _cfg;
+};
+
+/// Task to retrieve the bindings for many IMPUs in one request. The IMPUs are
+/// looked up concurrently on a shared pool of threads, so the request doesn't
+/// hold up an HTTP thread.  The thread that completes the last lookup sends
+/// the response.
+class GetBulkBindingsTask : public HttpStackUtils::Task
+{
+public:
+  /// A lookup of the bindings for one of the IMPUs in a request.
+  struct Lookup
+  {
+    GetBulkBindingsTask* task;
+    size_t index;
+  };
+
+  /// The pool of threads that run lookups for all bulk requests.
+  class LookupPool : public ThreadPool<Lookup*>
+  {
+  public:
+    LookupPool(ExceptionHandler* exception_handler,
+               unsigned int num_threads);
+    virtual ~LookupPool() {}
+
+  private:
+    virtual void process_work(Lookup*& lookup);
+
+    /// Called if a lookup throws, so that the request still completes.
+    static void exception_callback(Lookup* lookup);
+  };
+
+  struct Config
+  {
+    Config(SubscriberManager* sm, LookupPool* pool = NULL) :
+      _sm(sm),
+      _pool(pool)
+    {}
+
+    SubscriberManager* _sm;
+
+    /// The pool to run lookups on.  If NULL, the lookups are run in turn on
+    /// the HTTP thread.
+    LookupPool* _pool;
+  };
+
+  GetBulkBindingsTask(HttpStack::Request& req, const Config* cfg, SAS::TrailId trail) :
+    HttpStackUtils::Task(req, trail), _cfg(cfg), _writer(_sb), _next_to_write(0)
+  {};
+
+  void run();
+
+  /// The maximum number of IMPUs that can be requested at once.
+  static const size_t MAX_IMPUS = 1000;
+
+  /// The number of threads in the lookup pool.
+  static const int NUM_LOOKUP_THREADS = 8;
+
+protected:
+  HTTPCode parse_request(const std::string& body);
+
+  /// Looks up the bindings for the IMPU at the given index.
+  void look_up(size_t index);
+
+  /// Records the result of a lookup and writes out every result that is now
+  /// next in request order.  Sends the response once all of them have been
+  /// written, and the task is deleted once the response is sent.
+  void lookup_complete(size_t index, HTTPCode rc);
+
+  /// Writes the result for the IMPU at the given index, and frees its
+  /// bindings.  Must be called with _write_lock held.
+  void write_result(size_t index);
+
+  void send_response();
+
   const Config* _cfg;
+
+  /// The IMPUs requested, without duplicates, and the result of looking up
+  /// each one.
+  std::vector<std::string> _impus;
+  std::vector<HTTPCode> _rcs;
+  std::vector<Bindings> _bindings;
+  std::vector<bool> _complete;
+
+  /// The response body.  Results are written to this in request order as
+  /// soon as they're available, so only the bindings for lookups that
+  /// finish out of order are held at once.
+  rapidjson::StringBuffer _sb;
+  rapidjson::Writer<rapidjson::StringBuffer> _writer;
+
+  /// The index of the next result to write, and the lock that protects it
+  /// and the response body.
+  size_t _next_to_write;
+  std::mutex _write_lock;
 };
 
 /// For retrieving subscriptions from store.
@@ -172,12 +278,132 @@ public:
   void run();
 
 protected:
-  /// Write information about all subscriptions in an AoR to a JSON string
+  /// Write information about the subscriptions in an AoR to a JSON string
   ///
   /// @param subscription[in]   map of to_tag and Subscription object in an AoR
+  /// @param after[in]          only include subscriptions with IDs after this
+  ///                           one (or all subscriptions if empty)
+  /// @param limit[in]          the maximum number of subscriptions to include
+  ///                           (or 0 for no limit)
   ///
-  /// @return JSON string containing all subscription information
-  std::string serialize_data(const Subscriptions& subscriptions);
+  /// @return JSON string containing the subscription information
+  std::string serialize_data(const Subscriptions& subscriptions,
+                             const std::string& after = "",
+                             size_t limit = 0);
+  const Config* _cfg;
+};
+
+/// Task to report how much memory Sprout's PJSIP pools and subsystems are
+/// using.
+class GetMemoryTask : public HttpStackUtils::Task
+{
+public:
+  struct Config
+  {
+    Config(pj_caching_pool* cp,
+           const AdaptivePoolFactory* adaptive_pools = NULL) :
+      _cp(cp),
+      _adaptive_pools(adaptive_pools)
+    {}
+
+    pj_caching_pool* _cp;
+    const AdaptivePoolFactory* _adaptive_pools;
+  };
+
+  GetMemoryTask(HttpStack::Request& req, const Config* cfg, SAS::TrailId trail) :
+    HttpStackUtils::Task(req, trail), _cfg(cfg)
+  {};
+
+  void run();
+
+protected:
+  const Config* _cfg;
+};
+
+/// Task to report (GET) or clear (DELETE) the blocking IO profile of Sprout's
+/// worker threads.
+class IoProfileTask : public HttpStackUtils::Task
+{
+public:
+  struct Config
+  {
+    Config() {}
+  };
+
+  IoProfileTask(HttpStack::Request& req, const Config* cfg, SAS::TrailId trail) :
+    HttpStackUtils::Task(req, trail), _cfg(cfg)
+  {};
+
+  void run();
+
+protected:
+  const Config* _cfg;
+};
+
+/// Task to report (GET) or clear (DELETE) the contention statistics of
+/// Sprout's instrumented locks.
+class LockStatsTask : public HttpStackUtils::Task
+{
+public:
+  struct Config
+  {
+    Config() {}
+  };
+
+  LockStatsTask(HttpStack::Request& req, const Config* cfg, SAS::TrailId trail) :
+    HttpStackUtils::Task(req, trail), _cfg(cfg)
+  {};
+
+  void run();
+
+protected:
+  const Config* _cfg;
+};
+
+/// Task to report (GET) or clear (DELETE) the slowest SIP messages that
+/// Sprout has processed recently.
+class SlowTransactionsTask : public HttpStackUtils::Task
+{
+public:
+  struct Config
+  {
+    Config() {}
+  };
+
+  SlowTransactionsTask(HttpStack::Request& req, const Config* cfg, SAS::TrailId trail) :
+    HttpStackUtils::Task(req, trail), _cfg(cfg)
+  {};
+
+  void run();
+
+protected:
+  const Config* _cfg;
+};
+
+/// Task to report (GET) when the registration and subscription expiries
+/// granted with jitter fall due.
+class ExpiryJitterTask : public HttpStackUtils::Task
+{
+public:
+  struct Config
+  {
+    Config(ExpiryJitter* reg_jitter, ExpiryJitter* sub_jitter) :
+      _reg_jitter(reg_jitter), _sub_jitter(sub_jitter)
+    {}
+
+    /// The registration and subscription jitter policies.  Either is NULL if
+    /// jitter isn't enabled.
+    ExpiryJitter* _reg_jitter;
+    ExpiryJitter* _sub_jitter;
+  };
+
+  ExpiryJitterTask(HttpStack::Request& req, const Config* cfg, SAS::TrailId trail) :
+    HttpStackUtils::Task(req, trail), _cfg(cfg)
+  {};
+
+  void run();
+
+protected:
   const Config* _cfg;
 };
 
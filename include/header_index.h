@@ -0,0 +1,112 @@
+/**
+ * @file header_index.h Index of the headers in a SIP message by name.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef HEADER_INDEX_H__
+#define HEADER_INDEX_H__
+
+extern "C" {
+#include <pjsip.h>
+}
+
+#include <vector>
+#include <stdint.h>
+
+/// Indexes the headers of a SIP message by name, so that code that looks up
+/// several headers in the same message (or walks all the headers with a
+/// given name) doesn't search the whole header list each time.
+///
+/// The lookup functions mirror pjsip_msg_find_hdr_by_name and
+/// pjsip_msg_find_hdr_by_names, and return headers in the order they appear
+/// in the message.  The index is built on the first lookup.
+///
+/// The index only stays accurate if any headers added to or removed from the
+/// message while it is in use are added or removed through the index.
+class HeaderIndex
+{
+public:
+  HeaderIndex(pjsip_msg* msg);
+
+  pjsip_msg* msg() const { return _msg; }
+
+  /// Finds the first header with the given name (case insensitive).
+  pjsip_hdr* find(const pj_str_t* name);
+
+  /// Finds the first header with either the given name or short name.
+  pjsip_hdr* find(const pj_str_t* name, const pj_str_t* sname);
+
+  /// Finds the next header after hdr that has the same name as hdr.
+  pjsip_hdr* find_next(const pjsip_hdr* hdr);
+
+  /// Finds the next header after hdr that has either the given name or short
+  /// name.
+  pjsip_hdr* find_next(const pjsip_hdr* hdr,
+                       const pj_str_t* name,
+                       const pj_str_t* sname);
+
+  /// Gets the first header with each distinct name (ignoring case) in the
+  /// message, in no particular order.  This lets callers that test header
+  /// names against a pattern test each name once.
+  void first_hdrs(std::vector<pjsip_hdr*>& hdrs);
+
+  /// Adds a header to the end of the message.
+  void add_hdr(pjsip_hdr* hdr);
+
+  /// Adds a header to the start of the message.
+  void insert_first_hdr(pjsip_hdr* hdr);
+
+  /// Removes a header from the message.
+  void remove_hdr(pjsip_hdr* hdr);
+
+private:
+  /// A header in the index.  Entries for headers with the same name are
+  /// linked in message order.
+  struct Entry
+  {
+    pjsip_hdr* hdr;
+    int64_t seq;
+    int next;
+    int prev;
+  };
+
+  /// An open addressed hash table slot, holding the first and last entries
+  /// for a header name.
+  struct Slot
+  {
+    const pj_str_t* name;
+    uint32_t hash;
+    int first;
+    int last;
+  };
+
+  static const int NONE = -1;
+
+  static uint32_t hash(const pj_str_t* name);
+
+  void build();
+  void index_hdr(pjsip_hdr* hdr, int64_t seq, bool at_end);
+  Slot* find_slot(const pj_str_t* name);
+  Slot* create_slot(const pj_str_t* name);
+  int find_entry(const pjsip_hdr* hdr);
+
+  pjsip_msg* _msg;
+  bool _built;
+
+  std::vector<Entry> _entries;
+  std::vector<Slot> _slots;
+  size_t _used_slots;
+
+  /// Sequence numbers give the order of headers in the message, across all
+  /// names.
+  int64_t _first_seq;
+  int64_t _last_seq;
+};
+
+#endif
@@ -27,6 +27,7 @@ extern "C" {
 #include "sas.h"
 #include "xml_utils.h"
 #include "snmp_counter_table.h"
+#include "header_index.h"
 
 typedef enum {SESSION_CONTINUED=0, SESSION_TERMINATED=1} DefaultHandling;
 
@@ -88,6 +89,15 @@ public:
                       pjsip_msg* msg,
                       SAS::TrailId trail) const;
 
+  /// As above, but looks up headers through an index of the message, so
+  /// that callers testing several iFCs against the same message can share
+  /// the index between them.
+  bool filter_matches(const SessionCase& session_case,
+                      const bool is_registered,
+                      const bool is_initial_registration,
+                      HeaderIndex& hdrs,
+                      SAS::TrailId trail) const;
+
   AsInvocation as_invocation() const;
 
 private:
@@ -97,7 +107,7 @@ class ifc_error : public std::exception {};
   static bool spt_matches(const SessionCase& session_case,
                           const bool is_registered,
                           const bool is_initial_registration,
-                          pjsip_msg *msg,
+                          HeaderIndex& hdrs,
                           rapidxml::xml_node<>* spt,
                           std::string ifc_str,
                           std::string server_name,
@@ -0,0 +1,144 @@
+/**
+ * @file instrumented_mutex.h Mutexes that record how much they contend.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef INSTRUMENTED_MUTEX_H_
+#define INSTRUMENTED_MUTEX_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <boost/thread/shared_mutex.hpp>
+
+/// Contention statistics for a lock site.
+struct LockStats
+{
+  LockStats() :
+    acquisitions(0),
+    contended(0),
+    wait_ns(0),
+    hold_ns(0),
+    max_hold_ns(0)
+  {}
+
+  /// Number of times the lock was taken.  For a reader/writer lock, this
+  /// only counts exclusive acquisitions.
+  uint64_t acquisitions;
+
+  /// Number of times that the lock was already held, so the caller had to
+  /// wait.  For a reader/writer lock, this includes readers that had to wait.
+  uint64_t contended;
+
+  /// Total time spent waiting for the lock.
+  uint64_t wait_ns;
+
+  /// Total and longest time the lock was held exclusively.
+  uint64_t hold_ns;
+  uint64_t max_hold_ns;
+
+  void merge(const LockStats& other);
+};
+
+/// Base class for the instrumented locks, which holds the statistics and
+/// registers the lock under its site name.  Every lock created with the same
+/// site name (for example, all the shards of a sharded table) is reported
+/// together.
+class InstrumentedLock
+{
+public:
+  /// Gets the statistics for every lock site, including locks that have
+  /// since been destroyed.
+  static void get_all_stats(std::map<std::string, LockStats>& stats);
+
+  /// Clears the statistics for every lock site.
+  static void reset_all_stats();
+
+protected:
+  InstrumentedLock(const char* site);
+  virtual ~InstrumentedLock();
+
+  /// Records an acquisition.  If the first attempt to take the lock failed,
+  /// wait_start_ns is when the caller started waiting.
+  void acquired(bool contended, uint64_t wait_start_ns);
+
+  /// Records a caller having waited for the lock, without counting the
+  /// acquisition.
+  void waited(uint64_t wait_start_ns);
+
+  /// Records the start and end of an exclusive hold.
+  void hold_starts();
+  void hold_ends();
+
+private:
+  LockStats stats() const;
+  void reset();
+
+  const char* _site;
+
+  // The statistics are updated with relaxed atomics, in the same cache line
+  // as the lock.  Only exclusive holders and waiters update them, as shared
+  // holders updating them would bounce the cache line between readers that
+  // otherwise don't contend.
+  std::atomic<uint64_t> _acquisitions;
+  std::atomic<uint64_t> _contended;
+  std::atomic<uint64_t> _wait_ns;
+  std::atomic<uint64_t> _hold_ns;
+  std::atomic<uint64_t> _max_hold_ns;
+
+  // Only accessed by the thread holding the lock exclusively.
+  uint64_t _hold_start_ns;
+};
+
+/// Mutex that records its contention.  Meets the Lockable requirements, so
+/// can be used with std::unique_lock and std::lock_guard.
+class InstrumentedMutex : public InstrumentedLock
+{
+public:
+  InstrumentedMutex(const char* site, bool recursive = false);
+  virtual ~InstrumentedMutex();
+
+  void lock();
+  bool try_lock();
+  void unlock();
+
+private:
+  pthread_mutex_t _mutex;
+
+  // For recursive mutexes, how many times the owning thread has taken the
+  // lock.  Only accessed by the owning thread.
+  int _depth;
+};
+
+/// Reader/writer lock that records its contention.  Meets the
+/// SharedLockable requirements, so can be used with boost::shared_lock and
+/// boost::lock_guard.  Only exclusive acquisitions are counted and only
+/// exclusive holds are timed, but readers that have to wait are recorded as
+/// contended.
+class InstrumentedSharedMutex : public InstrumentedLock
+{
+public:
+  InstrumentedSharedMutex(const char* site);
+  virtual ~InstrumentedSharedMutex();
+
+  void lock();
+  bool try_lock();
+  void unlock();
+
+  void lock_shared();
+  bool try_lock_shared();
+  void unlock_shared();
+
+private:
+  boost::shared_mutex _mutex;
+};
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * @file io_profiler.h Sampling profiler for blocking IO on worker threads.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef IO_PROFILER_H_
+#define IO_PROFILER_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+
+/// Profiler for the blocking IO that worker threads do inside
+/// CW_IO_STARTS / CW_IO_COMPLETES regions (DNS queries, HTTP requests to
+/// homestead, memcached operations and so on).
+///
+/// Each thread that installs the profiler's IO hook records the duration of
+/// a sample of its IO regions into a histogram, keyed by the call site (the
+/// reason passed to CW_IO_STARTS) and the sproutlet that was running when
+/// the IO started.  The per-thread histograms are merged when the profile is
+/// read.
+namespace IoProfiler
+{
+  /// Number of histogram buckets.  Bucket 0 counts durations under 2us,
+  /// bucket i counts durations in [2^i, 2^(i+1)) us, and the last bucket
+  /// counts everything longer.
+  static const int NUM_BUCKETS = 24;
+
+  /// The statistics for one call site and sproutlet.
+  struct SiteStats
+  {
+    SiteStats() : count(0), total_us(0), max_us(0), buckets() {}
+
+    uint64_t count;
+    uint64_t total_us;
+    uint64_t max_us;
+    uint64_t buckets[NUM_BUCKETS];
+
+    void add(uint64_t duration_us);
+    void merge(const SiteStats& other);
+  };
+
+  /// Call site and sproutlet name.
+  typedef std::pair<std::string, std::string> SiteKey;
+  typedef std::map<SiteKey, SiteStats> Profile;
+
+  /// Sets the profiler to record one in every sample_rate IO regions on each
+  /// thread.  Zero (the default) disables profiling.
+  void set_sample_rate(int sample_rate);
+  int sample_rate();
+
+  /// IO hook callbacks.  Install these on a thread with Utils::IOHook to
+  /// profile the IO it does.
+  void io_started(const std::string& reason);
+  void io_completed(const std::string& reason);
+
+  /// Merges the profiles from all threads.
+  void get_profile(Profile& profile);
+
+  /// Clears the profiles on all threads.
+  void reset();
+
+  /// The exclusive upper bound, in microseconds, of the given bucket.  The
+  /// last bucket has no upper bound, and returns 0.
+  uint64_t bucket_limit_us(int bucket);
+
+  /// Records the sproutlet that is running on this thread while in scope, so
+  /// that any IO the sproutlet does is attributed to it.
+  class SproutletScope
+  {
+  public:
+    SproutletScope(const std::string& sproutlet);
+    ~SproutletScope();
+
+  private:
+    const std::string* _prev_sproutlet;
+  };
+};
+
+#endif
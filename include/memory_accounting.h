@@ -0,0 +1,151 @@
+/**
+ * @file memory_accounting.h Accounting of the memory used by Sprout's
+ * subsystems.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef MEMORY_ACCOUNTING_H__
+#define MEMORY_ACCOUNTING_H__
+
+extern "C" {
+#include <pjlib.h>
+}
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+#include "snmp_scalar.h"
+
+/// Tracks the memory held by one of Sprout's subsystems (for example the
+/// ODI token table).  The subsystem reports each allocation and free, with
+/// an estimate of its size.  Updates are lock-free, so can be made on the
+/// call path.
+class MemoryAccount
+{
+public:
+  MemoryAccount(const char* name);
+
+  /// Records that memory has been allocated.
+  void allocated(size_t bytes);
+
+  /// Records that memory has been freed.
+  void freed(size_t bytes);
+
+  /// Records that the subsystem has replaced everything it held (for
+  /// example on reloading configuration), and now holds the given amount.
+  void replaced(size_t bytes);
+
+  struct Stats
+  {
+    int64_t bytes;
+    int64_t high_water_bytes;
+    uint64_t allocations;
+    uint64_t frees;
+  };
+
+  Stats stats() const;
+
+  const char* name() const { return _name; }
+
+private:
+  /// Raises the high-water mark, if bytes is above it.
+  void update_high_water(int64_t bytes);
+
+  const char* _name;
+  std::atomic<int64_t> _bytes;
+  std::atomic<int64_t> _high_water_bytes;
+  std::atomic<uint64_t> _allocations;
+  std::atomic<uint64_t> _frees;
+};
+
+namespace MemoryAccounting
+{
+  /// The accounts for each subsystem.
+  extern MemoryAccount odi_tokens;
+  extern MemoryAccount acr_queue;
+  extern MemoryAccount shared_ifcs;
+
+  /// All the subsystem accounts.
+  extern MemoryAccount* const ACCOUNTS[];
+  extern const size_t NUM_ACCOUNTS;
+
+  /// Summary of the memory held by a set of PJSIP pools.
+  struct PoolStats
+  {
+    uint64_t pools;
+    uint64_t used_bytes;
+    uint64_t capacity_bytes;
+  };
+
+  /// Summary of the memory held by a PJSIP caching pool factory.
+  struct PoolFactoryStats
+  {
+    /// The capacity of the pools currently in use.
+    uint64_t used_bytes;
+
+    /// The most that used_bytes has been.
+    uint64_t peak_used_bytes;
+
+    /// The number of pools currently in use.
+    uint64_t used_pools;
+
+    /// The capacity of released pools held for reuse.
+    uint64_t cached_bytes;
+  };
+
+  /// Reads the totals for a caching pool factory.  This doesn't take the
+  /// factory's lock, so is cheap but the figures may be slightly out of step
+  /// with each other.
+  void get_factory_stats(pj_caching_pool* cp, PoolFactoryStats& stats);
+
+  /// Walks every pool in use from a caching pool factory, and totals them up
+  /// by owner (see pool_owner).  This holds the factory's lock while it runs,
+  /// so shouldn't be called often.
+  void get_pool_stats_by_owner(pj_caching_pool* cp,
+                               std::map<std::string, PoolStats>& stats);
+
+  /// Works out which part of Sprout owns a pool, based on its name.  PJSIP
+  /// names its pools after their purpose, followed by the address of the
+  /// owning object (for example "tsx0x1234"), and Sprout does the same.
+  std::string pool_owner(const char* pool_name);
+
+  /// Periodically reports the memory accounting figures in SNMP scalars.
+  class Reporter
+  {
+  public:
+    Reporter(pj_caching_pool* cp, int interval_ms = 10000);
+    ~Reporter();
+
+  private:
+    void run();
+    void report();
+
+    pj_caching_pool* _cp;
+    int _interval_ms;
+
+    SNMP::U32Scalar _pool_kbytes;
+    SNMP::U32Scalar _pool_peak_kbytes;
+    SNMP::U32Scalar _pool_count;
+    SNMP::U32Scalar _odi_token_kbytes;
+    SNMP::U32Scalar _acr_queue_kbytes;
+    SNMP::U32Scalar _shared_ifc_kbytes;
+
+    bool _terminate;
+    std::mutex _lock;
+    std::condition_variable _cond;
+    std::thread _thread;
+  };
+}
+
+#endif
@@ -15,9 +15,18 @@
 #ifndef OPTIONS_H__
 #define OPTIONS_H__
 
+#include "snmp_counter_by_scope_table.h"
+
 extern pjsip_module mod_options;
+extern pjsip_module mod_options_fast_path;
 
-pj_status_t init_options();
+/// Registers the OPTIONS modules.  This must be called before the thread
+/// dispatcher is initialised, so that OPTIONS polls are answered before they
+/// are dispatched to worker threads.
+///
+/// @param fast_path_counter  - Counts OPTIONS polls answered on the
+///                             transport thread.  May be NULL.
+pj_status_t init_options(SNMP::CounterByScopeTable* fast_path_counter = NULL);
 
 void destroy_options();
 
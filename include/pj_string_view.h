@@ -0,0 +1,145 @@
+/**
+ * @file pj_string_view.h Non-owning view of a string held in PJSIP memory.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef PJ_STRING_VIEW_H__
+#define PJ_STRING_VIEW_H__
+
+extern "C" {
+#include <pjlib.h>
+}
+
+#include <string>
+#include <cstring>
+#include <strings.h>
+
+/// A read-only view of a string that is owned by something else - typically
+/// a pj_str_t in a PJSIP pool, or a buffer on the caller's stack. This lets
+/// code compare and inspect strings from SIP messages without copying them
+/// into a std::string first.
+///
+/// The view is only valid for as long as the underlying storage is.
+class PJStringView
+{
+public:
+  PJStringView() : _ptr(""), _len(0) {}
+
+  PJStringView(const char* ptr, size_t len) : _ptr(ptr), _len(len) {}
+
+  PJStringView(const char* cstr) : _ptr(cstr), _len(strlen(cstr)) {}
+
+  PJStringView(const std::string& str) : _ptr(str.data()), _len(str.length()) {}
+
+  /// A NULL pj_str_t is treated as an empty string, as in
+  /// PJUtils::pj_str_to_string.
+  PJStringView(const pj_str_t* pjstr) :
+    _ptr(((pjstr != NULL) && (pjstr->slen > 0)) ? pjstr->ptr : ""),
+    _len(((pjstr != NULL) && (pjstr->slen > 0)) ? pjstr->slen : 0)
+  {
+  }
+
+  const char* data() const { return _ptr; }
+  size_t size() const { return _len; }
+  size_t length() const { return _len; }
+  bool empty() const { return (_len == 0); }
+
+  const char* begin() const { return _ptr; }
+  const char* end() const { return _ptr + _len; }
+
+  char operator[](size_t pos) const { return _ptr[pos]; }
+
+  /// Returns a pj_str_t that refers to the same characters.
+  pj_str_t pj_str() const
+  {
+    pj_str_t str;
+    str.ptr = (char*)_ptr;
+    str.slen = _len;
+    return str;
+  }
+
+  /// Copies the view into an owned string.
+  std::string str() const { return std::string(_ptr, _len); }
+
+  int compare(const PJStringView& other) const
+  {
+    size_t len = (_len < other._len) ? _len : other._len;
+    int rc = (len > 0) ? memcmp(_ptr, other._ptr, len) : 0;
+    if (rc == 0)
+    {
+      rc = (_len < other._len) ? -1 : ((_len > other._len) ? 1 : 0);
+    }
+    return rc;
+  }
+
+  bool equals(const PJStringView& other) const
+  {
+    return ((_len == other._len) &&
+            ((_len == 0) || (memcmp(_ptr, other._ptr, _len) == 0)));
+  }
+
+  /// Case-insensitive (ASCII) comparison, as used for SIP tokens and host
+  /// names.
+  bool iequals(const PJStringView& other) const
+  {
+    return ((_len == other._len) &&
+            ((_len == 0) || (strncasecmp(_ptr, other._ptr, _len) == 0)));
+  }
+
+  bool starts_with(const PJStringView& prefix) const
+  {
+    return ((_len >= prefix._len) &&
+            ((prefix._len == 0) || (memcmp(_ptr, prefix._ptr, prefix._len) == 0)));
+  }
+
+  /// Returns the position of the first occurrence of c, or std::string::npos.
+  size_t find(char c, size_t pos = 0) const
+  {
+    if (pos >= _len)
+    {
+      return std::string::npos;
+    }
+    const void* found = memchr(_ptr + pos, c, _len - pos);
+    return (found != NULL) ? (const char*)found - _ptr : std::string::npos;
+  }
+
+  PJStringView substr(size_t pos, size_t count = std::string::npos) const
+  {
+    if (pos > _len)
+    {
+      pos = _len;
+    }
+    if (count > _len - pos)
+    {
+      count = _len - pos;
+    }
+    return PJStringView(_ptr + pos, count);
+  }
+
+private:
+  const char* _ptr;
+  size_t _len;
+};
+
+inline bool operator==(const PJStringView& lhs, const PJStringView& rhs)
+{
+  return lhs.equals(rhs);
+}
+
+inline bool operator!=(const PJStringView& lhs, const PJStringView& rhs)
+{
+  return !lhs.equals(rhs);
+}
+
+inline bool operator<(const PJStringView& lhs, const PJStringView& rhs)
+{
+  return (lhs.compare(rhs) < 0);
+}
+
+#endif
@@ -29,6 +29,7 @@ extern "C" {
 #include "rphservice.h"
 #include "uri_classifier.h"
 #include "acr.h"
+#include "pj_string_view.h"
 
 namespace PJUtils {
 
@@ -59,6 +60,13 @@ std::string unescape_string_for_uri(const std::string& uri_s,
 
 std::string pj_str_to_string(const pj_str_t* pjstr);
 
+/// Returns a non-owning view of a pj_str_t. Use this in preference to
+/// pj_str_to_string when the string is only compared or inspected.
+inline PJStringView pj_str_view(const pj_str_t* pjstr)
+{
+  return PJStringView(pjstr);
+}
+
 std::string pj_str_to_unquoted_string(const pj_str_t* pjstr);
 
 std::string pj_status_to_string(const pj_status_t status);
@@ -70,9 +78,13 @@ std::string body_to_string(pjsip_msg_body* body);
 std::string extract_username(pjsip_authorization_hdr* auth_hdr, pjsip_uri* impu_uri);
 
 std::string public_id_from_uri(const pjsip_uri* uri);
+int public_id_from_uri(const pjsip_uri* uri, char* buf, size_t size);
+pj_str_t public_id_from_uri(const pjsip_uri* uri, pj_pool_t* pool);
 pj_bool_t valid_public_id_from_uri(const pjsip_uri* uri, std::string& impu);
 
 std::string default_private_id_from_uri(const pjsip_uri* uri);
+int default_private_id_from_uri(const pjsip_uri* uri, char* buf, size_t size);
+pj_str_t default_private_id_from_uri(const pjsip_uri* uri, pj_pool_t* pool);
 
 pj_str_t domain_from_uri(const std::string& uri_str, pj_pool_t* pool);
 
@@ -276,6 +288,7 @@ typedef std::map<pj_sockaddr, bool, bool(*)(const pj_sockaddr&, const pj_sockadd
 void create_random_token(size_t length, std::string& token);
 
 std::string get_header_value(pjsip_hdr*);
+PJStringView get_header_value(pjsip_hdr* header, char* buf, size_t size);
 
 void mark_icid(const SAS::TrailId trail, pjsip_msg* msg);
 
@@ -48,6 +48,9 @@ public:
   }
 
 private:
+  /// Estimates the memory used by a queued request.
+  static size_t request_size(const RalfRequest* rr);
+
   /// @class Pool
   /// The thread pool used by the ralf processor
   class Pool : public ThreadPool<RalfProcessor::RalfRequest*>
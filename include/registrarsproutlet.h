@@ -28,6 +28,7 @@
 #include "session_expires_helper.h"
 #include "as_communication_tracker.h"
 #include "compositesproutlet.h"
+#include "expiry_jitter.h"
 
 class RegistrarSproutletTsx;
 
@@ -61,7 +62,8 @@ public:
                      SubscriberManager* sm,
                      ACRFactory* rfacr_factory,
                      int cfg_max_expires,
-                     SNMP::RegistrationStatsTables* reg_stats_tbls);
+                     SNMP::RegistrationStatsTables* reg_stats_tbls,
+                     ExpiryJitter* expiry_jitter = NULL);
   ~RegistrarSproutlet();
 
   bool init();
@@ -87,6 +89,9 @@ private:
   // The maximum time a binding can exist for before needing re-registration.
   int _max_expires;
 
+  // Policy for randomising granted expiry times, or NULL if disabled.
+  ExpiryJitter* _expiry_jitter;
+
   // Pre-constructed Service Route header added to REGISTER responses.
   pjsip_routing_hdr* _service_route;
 
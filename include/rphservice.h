@@ -18,6 +18,7 @@
 #include <boost/algorithm/string.hpp>
 
 #include "updater.h"
+#include "instrumented_mutex.h"
 #include "sip_event_priority.h"
 #include "sas.h"
 #include "alarm.h"
@@ -67,7 +68,7 @@ private:
 
   // Mark as mutable to flag that this can be modified without affecting the
   // external behaviour of the class, allowing for locking in 'const' methods.
-  mutable boost::shared_mutex _sets_rw_lock;
+  mutable InstrumentedSharedMutex _sets_rw_lock;
 
   // Helper functions to set/clear the alarm.
   void set_alarm();
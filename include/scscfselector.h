@@ -18,6 +18,7 @@
 #include <functional>
 #include <boost/thread.hpp>
 #include "updater.h"
+#include "instrumented_mutex.h"
 #include "sas.h"
 
 class SCSCFSelector
@@ -48,7 +49,7 @@ private:
   std::string _configuration;
   std::vector<scscf> _scscfs;
   Updater<void, SCSCFSelector>* _updater;
-  boost::shared_mutex _scscfs_rw_lock;
+  InstrumentedSharedMutex _scscfs_rw_lock;
 };
 
 #endif
@@ -36,6 +36,7 @@ extern "C" {
 #include "snmp_counter_table.h"
 #include "session_expires_helper.h"
 #include "as_communication_tracker.h"
+#include "as_latency_tracker.h"
 #include "compositesproutlet.h"
 #include "subscriber_manager.h"
 #include "httpclient.h"
@@ -76,7 +77,8 @@ public:
                  int session_continued_timeout = DEFAULT_SESSION_CONTINUED_TIMEOUT,
                  int session_terminated_timeout = DEFAULT_SESSION_TERMINATED_TIMEOUT,
                  AsCommunicationTracker* sess_term_as_tracker = NULL,
-                 AsCommunicationTracker* sess_cont_as_tracker = NULL);
+                 AsCommunicationTracker* sess_cont_as_tracker = NULL,
+                 AsLatencyTracker* as_latency_tracker = NULL);
 
   /// SCSCFSproutlet destructor.
   ~SCSCFSproutlet();
@@ -95,6 +97,10 @@ public:
                         pj_pool_t* pool,
                         SAS::TrailId trail);
 
+  /// Sets whether in-dialog requests that need no S-CSCF processing are
+  /// forwarded without creating an S-CSCF transaction.
+  void set_in_dialog_fast_path(bool v) { _in_dialog_fast_path = v; }
+
   // Methods used to change the values of internal configuration during unit
   // test.
   void set_override_npdi(bool v) { _override_npdi = v; }
@@ -111,6 +117,10 @@ private:
   /// Returns the AS chain table for this system.
   AsChainTable* as_chain_table() const;
 
+  /// Returns true if an in-dialog request can be forwarded without any S-CSCF
+  /// processing.
+  bool is_uninteresting_in_dialog_request(pjsip_msg* req) const;
+
   /// Returns the service name of the entire S-CSCF.
   const std::string scscf_service_name() const;
 
@@ -177,8 +187,26 @@ private:
   ///
   /// @param uri               - The URI of the AS.
   /// @param default_handling  - The AS's default handling.
+  /// @param latency_ms        - How long the AS took to respond.
   void track_app_serv_comm_success(const std::string& uri,
-                                   DefaultHandling default_handling);
+                                   DefaultHandling default_handling,
+                                   uint64_t latency_ms);
+
+  /// Returns whether a request should be sent to an AS, or the AS should be
+  /// bypassed because it has been failing.  Only ASs with default handling
+  /// of SESSION_CONTINUED are ever bypassed.
+  ///
+  /// @param uri               - The URI of the AS.
+  /// @param default_handling  - The AS's default handling.
+  bool should_invoke_app_serv(const std::string& uri,
+                              DefaultHandling default_handling);
+
+  /// Returns the liveness timeout to use for an AS.
+  ///
+  /// @param uri               - The URI of the AS.
+  /// @param default_handling  - The AS's default handling.
+  int app_serv_timeout_ms(const std::string& uri,
+                          DefaultHandling default_handling);
 
   /// Record the time an INVITE took to reach ringing state.
   ///
@@ -242,6 +270,10 @@ private:
 
   bool _override_npdi;
 
+  /// Whether in-dialog requests that need no S-CSCF processing are forwarded
+  /// without creating an S-CSCF transaction.
+  bool _in_dialog_fast_path;
+
   /// Instance of the fallback iFC class, which contains any fallback iFCs that
   /// the S-CSCF should apply.
   FIFCService* _fifcservice;
@@ -273,6 +305,10 @@ private:
   // communications with ASs.
   AsCommunicationTracker* _sess_term_as_tracker;
   AsCommunicationTracker* _sess_cont_as_tracker;
+
+  // Tracker of AS response times and failures, used for adaptive AS timeouts
+  // and circuit breaking.  NULL if neither is enabled.
+  AsLatencyTracker* _as_latency_tracker;
 };
 
 
@@ -566,6 +602,10 @@ private:
   uint64_t _tsx_start_time_usec;
   bool _video_call;
 
+  /// The time (in monotonic ms) the request was sent to the current AS, for
+  /// tracking AS response times.
+  uint64_t _as_request_time_ms;
+
   static const int MAX_FORKING = 10;
 
   /// The private identity associated with the request. Empty unless the
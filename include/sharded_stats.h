@@ -0,0 +1,218 @@
+/**
+ * @file sharded_stats.h Statistics that are updated per thread and merged
+ * into the underlying SNMP tables in the background.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef SHARDED_STATS_H_
+#define SHARDED_STATS_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/// A statistic whose updates are held in per-thread shards until they are
+/// flushed to the SNMP table it wraps.
+class ShardedStatistic
+{
+public:
+  virtual ~ShardedStatistic() {}
+
+  /// Merges all the shards into the underlying table.
+  virtual void flush() = 0;
+
+  /// The number of shards in each statistic.  Threads are assigned shards
+  /// round robin, so a shard only has one writer if there are no more than
+  /// this many threads updating the statistic.
+  static const int NUM_SHARDS = 32;
+
+protected:
+  /// Returns the shard that the calling thread should update.
+  static int thread_shard();
+};
+
+/// Periodically flushes a set of sharded statistics, so that SNMP reads see
+/// updates soon after they happen.  All the writes to the underlying tables
+/// are made from this thread, so they don't contend with each other.
+class ShardedStatsFlusher
+{
+public:
+  ShardedStatsFlusher(int interval_ms = DEFAULT_INTERVAL_MS);
+  ~ShardedStatsFlusher();
+
+  /// Starts the background flushing thread.
+  void start();
+
+  void add(ShardedStatistic* stat);
+  void remove(ShardedStatistic* stat);
+
+  /// Flushes every statistic now.
+  void flush_all();
+
+  static const int DEFAULT_INTERVAL_MS = 100;
+
+private:
+  void run();
+
+  int _interval_ms;
+  std::mutex _stats_lock;
+  std::vector<ShardedStatistic*> _stats;
+
+  bool _terminate;
+  std::mutex _run_lock;
+  std::condition_variable _run_cond;
+  std::thread _thread;
+};
+
+/// Counter table (for example SNMP::CounterTable or
+/// SNMP::CounterByScopeTable) whose increments are counted per thread.
+/// Takes ownership of the wrapped table.
+template <class T>
+class ShardedCounter : public T, public ShardedStatistic
+{
+public:
+  ShardedCounter(T* table, ShardedStatsFlusher* flusher) :
+    _table(table),
+    _flusher(flusher)
+  {
+    for (int ii = 0; ii < NUM_SHARDS; ++ii)
+    {
+      _shards[ii].count = 0;
+    }
+
+    _flusher->add(this);
+  }
+
+  virtual ~ShardedCounter()
+  {
+    _flusher->remove(this);
+    flush();
+    delete _table; _table = NULL;
+  }
+
+  void increment()
+  {
+    _shards[thread_shard()].count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void flush()
+  {
+    for (int ii = 0; ii < NUM_SHARDS; ++ii)
+    {
+      uint64_t count = _shards[ii].count.exchange(0, std::memory_order_relaxed);
+
+      for (uint64_t jj = 0; jj < count; ++jj)
+      {
+        _table->increment();
+      }
+    }
+  }
+
+private:
+  /// Padded so that no two shards share a cache line.
+  struct Shard
+  {
+    std::atomic<uint64_t> count;
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+  };
+
+  T* _table;
+  ShardedStatsFlusher* _flusher;
+  Shard _shards[NUM_SHARDS];
+};
+
+/// Event accumulator table (for example SNMP::EventAccumulatorTable or
+/// SNMP::EventAccumulatorByScopeTable) whose samples are buffered per
+/// thread.  Takes ownership of the wrapped table.
+template <class T>
+class ShardedAccumulator : public T, public ShardedStatistic
+{
+public:
+  ShardedAccumulator(T* table, ShardedStatsFlusher* flusher) :
+    _table(table),
+    _flusher(flusher)
+  {
+    _flusher->add(this);
+  }
+
+  virtual ~ShardedAccumulator()
+  {
+    _flusher->remove(this);
+    flush();
+    delete _table; _table = NULL;
+  }
+
+  void accumulate(uint32_t sample)
+  {
+    Shard& shard = _shards[thread_shard()];
+    std::vector<uint32_t> full;
+
+    {
+      std::unique_lock<std::mutex> lock(shard.lock);
+      shard.samples.push_back(sample);
+
+      if (shard.samples.size() >= MAX_BUFFERED_SAMPLES)
+      {
+        // The flusher has fallen behind, so write these samples out now
+        // rather than let the buffer grow.
+        full.swap(shard.samples);
+      }
+    }
+
+    write(full);
+  }
+
+  void flush()
+  {
+    std::vector<uint32_t> samples;
+
+    for (int ii = 0; ii < NUM_SHARDS; ++ii)
+    {
+      {
+        std::unique_lock<std::mutex> lock(_shards[ii].lock);
+        samples.swap(_shards[ii].samples);
+      }
+
+      write(samples);
+      samples.clear();
+    }
+  }
+
+  static const size_t MAX_BUFFERED_SAMPLES = 4096;
+
+private:
+  void write(const std::vector<uint32_t>& samples)
+  {
+    for (uint32_t sample : samples)
+    {
+      _table->accumulate(sample);
+    }
+  }
+
+  /// Each sample takes the shard's lock and appends to its buffer, which
+  /// may allocate.  The lock is shared by the flusher and by every thread
+  /// assigned to the shard (when there are more than NUM_SHARDS threads),
+  /// so it is usually, but not always, uncontended.  Padded so that no two
+  /// shards share a cache line.
+  struct Shard
+  {
+    std::mutex lock;
+    std::vector<uint32_t> samples;
+    char padding[64];
+  };
+
+  T* _table;
+  ShardedStatsFlusher* _flusher;
+  Shard _shards[NUM_SHARDS];
+};
+
+#endif
@@ -19,6 +19,7 @@
 #include <functional>
 
 #include "updater.h"
+#include "instrumented_mutex.h"
 #include "sas.h"
 #include "ifc.h"
 #include "alarm.h"
@@ -55,7 +56,7 @@ private:
 
   // Mark as mutable to flag that this can be modified without affecting the
   // external behaviour of the class, allowing for locking in 'const' methods.
-  mutable boost::shared_mutex _sets_rw_lock;
+  mutable InstrumentedSharedMutex _sets_rw_lock;
 
   // Helper functions to set/clear the alarm.
   void set_alarm();
@@ -22,6 +22,7 @@ extern "C" {
 #include <random>
 
 #include "snmp_ip_count_table.h"
+#include "instrumented_mutex.h"
 
 class SIPConnectionPool
 {
@@ -88,7 +89,7 @@ private:
     int recycle_time;
   } tp_hash_slot;
 
-  pthread_mutex_t _tp_hash_lock;
+  InstrumentedMutex _tp_hash_lock;
   std::vector<tp_hash_slot> _tp_hash;
   std::map<pjsip_transport*, int> _tp_map;
 
@@ -0,0 +1,88 @@
+/**
+ * @file sip_scan.h Vectorised scanning of SIP message buffers.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef SIP_SCAN_H__
+#define SIP_SCAN_H__
+
+extern "C" {
+#include <pjsip.h>
+#include <pjlib.h>
+}
+
+#include <stddef.h>
+
+/// Scanning primitives used to frame SIP messages and split them into
+/// header lines. These find the same boundaries as the PJSIP byte-at-a-time
+/// scanner, but use SSE2 or AVX2 to examine 16 or 32 bytes at a time where
+/// the CPU supports it. The implementation is selected once at start of day
+/// based on the CPU features, and falls back to a portable scalar scanner.
+namespace SipScan
+{
+  enum struct Level
+  {
+    SCALAR,
+    SSE2,
+    AVX2
+  };
+
+  /// Returns the best implementation supported by this CPU.
+  Level detect_level();
+
+  /// Returns the implementation currently in use.
+  Level level();
+
+  /// Overrides the implementation in use. The level is capped to what the
+  /// CPU supports. This is intended for use by UT and for diagnosing
+  /// suspected scanner bugs in the field.
+  void set_level(Level level);
+
+  /// Returns a printable name for the implementation level.
+  const char* level_name(Level level);
+
+  /// Finds the first occurrence of the character c in the buffer.
+  ///
+  /// @returns A pointer to the character, or NULL if it is not present.
+  const char* find_char(const char* buf, size_t len, char c);
+
+  /// Finds the end of the first line in the buffer (the '\n' character).
+  ///
+  /// @returns A pointer to the '\n', or NULL if the line is incomplete.
+  inline const char* find_line_end(const char* buf, size_t len)
+  {
+    return find_char(buf, len, '\n');
+  }
+
+  /// Finds the blank line that terminates the headers of a SIP message (the
+  /// "\n\r\n" sequence that PJSIP looks for).
+  ///
+  /// @returns A pointer to the first '\n' of the sequence, or NULL if the
+  ///          headers are incomplete.
+  const char* find_end_of_headers(const char* buf, size_t len);
+
+  /// Frames a SIP message in a buffer. This is a drop-in replacement for
+  /// pjsip_find_msg and returns identical results.
+  ///
+  /// @param buf         - The buffer to scan.
+  /// @param size        - The number of bytes in the buffer.
+  /// @param is_datagram - Whether the buffer came from a datagram transport
+  ///                      (in which case the whole buffer is the message).
+  /// @param msg_size    - Set to the size of the framed message.
+  ///
+  /// @returns PJ_SUCCESS if a complete message was found, PJSIP_EPARTIALMSG
+  ///          if more data is needed, or PJSIP_EMISSINGHDR if the headers are
+  ///          complete but do not contain a valid Content-Length.
+  pj_status_t find_msg(const char* buf,
+                       pj_size_t size,
+                       pj_bool_t is_datagram,
+                       pj_size_t* msg_size);
+}
+
+#endif
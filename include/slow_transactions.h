@@ -0,0 +1,157 @@
+/**
+ * @file slow_transactions.h Records the slowest SIP messages processed by
+ * the worker threads, with a breakdown of where the time went.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef SLOW_TRANSACTIONS_H_
+#define SLOW_TRANSACTIONS_H_
+
+extern "C" {
+#include <pjsip.h>
+}
+
+#include <stdint.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sas.h"
+
+/// Keeps the slowest SIP messages that the worker threads have processed
+/// over a rolling window, for each SIP method, so that operators can see
+/// what the slow requests behind a latency spike actually were.
+///
+/// While a worker thread processes a message, the time is split into stages
+/// - the time on the queue, the time in each Sproutlet, the time blocked on
+/// each kind of IO, and the rest of Sprout's processing.  The stages are
+/// kept in a per-thread record that is reused from message to message.  When
+/// the message completes, its latency is compared against the fastest
+/// message that is currently kept for its method, and the record is only
+/// copied out if the message is slower.
+///
+/// The slowest messages are kept for each tenth of the window, and merged
+/// when they are read, so the window rolls forward a tenth at a time.
+namespace SlowTransactions
+{
+  /// Default number of messages to keep for each method, and the default
+  /// rolling window.
+  static const int DEFAULT_COUNT = 10;
+  static const int DEFAULT_WINDOW_S = 300;
+
+  /// A stage of processing, and the time spent in it.  Time spent in a
+  /// Sproutlet excludes any IO the Sproutlet blocked on, and any time spent
+  /// in Sproutlets it passed messages to.
+  struct Stage
+  {
+    enum Type
+    {
+      QUEUE,
+      SPROUT,
+      SPROUTLET,
+      IO
+    };
+
+    Type type;
+
+    /// The Sproutlet name, or the kind of IO (the reason passed to
+    /// CW_IO_STARTS).  Empty for the queue and Sprout stages.
+    std::string name;
+
+    uint64_t duration_us;
+
+    static const char* type_name(Type type);
+  };
+
+  /// A message that was slow to process.
+  struct Transaction
+  {
+    Transaction() :
+      latency_us(0),
+      timestamp(0),
+      trail(0),
+      request(true),
+      status_code(0)
+    {}
+
+    /// Time from the message being queued to it being processed, in
+    /// microseconds, including any time blocked on IO.
+    uint64_t latency_us;
+
+    /// When processing completed.
+    time_t timestamp;
+
+    SAS::TrailId trail;
+    std::string method;
+    bool request;
+    std::string call_id;
+
+    /// The served user, if the S-CSCF determined one.
+    std::string served_user;
+
+    /// The Sproutlets the message passed through, in order.
+    std::vector<std::string> sproutlets;
+
+    std::vector<Stage> stages;
+
+    /// The status code of the last response Sprout sent upstream while
+    /// processing the message, or zero if it didn't send one.
+    int status_code;
+  };
+
+  /// The slowest messages for each method, slowest first.
+  typedef std::map<std::string, std::vector<Transaction> > Report;
+
+  /// Sets how many messages to keep for each method, and for how long.  A
+  /// count of zero disables recording.
+  void configure(int count, int window_s);
+
+  /// Gets the slowest messages still in the window.
+  void get_slowest(Report& report);
+
+  /// Discards all the messages kept.
+  void reset();
+
+  /// Starts recording the processing of a message on this thread, given the
+  /// time it spent on the queue.
+  void start(uint64_t queue_us);
+
+  /// Completes the record of the message on this thread, and keeps it if it
+  /// is one of the slowest.  Must be called before the message is freed.
+  void finish(pjsip_rx_data* rdata, SAS::TrailId trail);
+
+  /// Whether a message is being recorded on this thread.  Callers can use
+  /// this to skip building arguments to the functions below.
+  bool recording();
+
+  /// Records the served user of the message being processed.
+  void set_served_user(const std::string& served_user);
+
+  /// Records a response being sent upstream.
+  void response_sent(int status_code);
+
+  /// IO hook callbacks.  Install these on a thread with Utils::IOHook to
+  /// record the IO it does.
+  void io_started(const std::string& reason);
+  void io_completed(const std::string& reason);
+
+  /// Records the time spent in a Sproutlet while in scope.
+  class SproutletStage
+  {
+  public:
+    SproutletStage(const std::string& sproutlet);
+    ~SproutletStage();
+
+  private:
+    bool _recording;
+  };
+};
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ * @file sprout_probes.h Static (USDT) tracepoints on Sprout's SIP hot path.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#ifndef SPROUT_PROBES_H_
+#define SPROUT_PROBES_H_
+
+extern "C" {
+#include <pjsip.h>
+}
+
+/// Sprout's tracepoints are systemtap-style USDT probes in the "sprout"
+/// provider, which can be attached to with bpftrace, perf or systemtap (see
+/// docs/Tracepoints.md for the list of probes and their arguments).
+///
+/// A probe site is a single nop until a tracer attaches.  Each probe also
+/// has a semaphore that the tracer increments when it attaches, and the
+/// probe's arguments are only evaluated when the semaphore is set, so
+/// arguments that need formatting cost nothing when the probe is disabled.
+///
+/// If the systemtap SDT header isn't available, the probes compile to
+/// nothing.
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define SPROUT_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef SPROUT_HAVE_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define SPROUT_PROBE_SEMAPHORE(NAME) sprout_##NAME##_semaphore
+
+/// Declares a probe's semaphore.  Every probe must be declared here, and
+/// defined in sprout_probes.cpp, or in the plugin that fires it if it is only
+/// fired from a plugin (as the probe's note must be able to locate the
+/// semaphore without relocations into another object).
+#define SPROUT_PROBE_DECLARE(NAME)                                             \
+  extern "C" volatile unsigned short SPROUT_PROBE_SEMAPHORE(NAME)
+
+#define SPROUT_PROBE_DEFINE(NAME)                                              \
+  extern "C" volatile unsigned short SPROUT_PROBE_SEMAPHORE(NAME)              \
+    __attribute__((section(".probes"))) = 0
+
+/// Whether a tracer is attached to the probe.
+#define SPROUT_PROBE_ENABLED(NAME)                                             \
+  __builtin_expect(SPROUT_PROBE_SEMAPHORE(NAME) != 0, 0)
+
+/// Fires a probe.  The arguments must be integers or pointers.
+#define SPROUT_PROBE(NAME, ...)                                                \
+  do                                                                           \
+  {                                                                            \
+    if (SPROUT_PROBE_ENABLED(NAME))                                            \
+    {                                                                          \
+      STAP_PROBEV(sprout, NAME, __VA_ARGS__);                                  \
+    }                                                                          \
+  } while (0)
+
+#else
+#define SPROUT_PROBE_DECLARE(NAME) struct sprout_probe_##NAME##_unused
+#define SPROUT_PROBE_DEFINE(NAME) struct sprout_probe_##NAME##_unused
+#define SPROUT_PROBE_ENABLED(NAME) (false)
+#define SPROUT_PROBE(NAME, ...) do {} while (0)
+#endif
+
+// Thread dispatcher.  Arguments are the trail, method and status code (zero
+// for a request), plus the time spent queued (in us) on dequeue.
+SPROUT_PROBE_DECLARE(dispatch_enqueue);
+SPROUT_PROBE_DECLARE(dispatch_dequeue);
+
+// Sproutlet callbacks.  Arguments are the trail, sproutlet name, callback
+// name and method (empty for a timer pop).
+SPROUT_PROBE_DECLARE(sproutlet_entry);
+SPROUT_PROBE_DECLARE(sproutlet_exit);
+
+// Requests to other components.  Arguments are the trail, HTTP method and
+// path (the AoR for S4, and the timer ID or callback path for Chronos), plus
+// the HTTP result code on finish.
+SPROUT_PROBE_DECLARE(hss_request_start);
+SPROUT_PROBE_DECLARE(hss_request_finish);
+SPROUT_PROBE_DECLARE(s4_request_start);
+SPROUT_PROBE_DECLARE(s4_request_finish);
+SPROUT_PROBE_DECLARE(chronos_request_start);
+SPROUT_PROBE_DECLARE(chronos_request_finish);
+SPROUT_PROBE_DECLARE(ralf_request_start);
+SPROUT_PROBE_DECLARE(ralf_request_finish);
+
+// PJSIP transactions being bound to and unbound from the BasicProxy.
+// Arguments are the trail, method, transaction and whether it is a UAC
+// transaction.
+SPROUT_PROBE_DECLARE(tsx_create);
+SPROUT_PROBE_DECLARE(tsx_destroy);
+
+/// Copies a SIP method into a null-terminated buffer so that it can be
+/// passed to a probe.  For a response, this is the method from the CSeq, and
+/// if there is no message the method is empty.
+class ProbeMethod
+{
+public:
+  ProbeMethod(const pjsip_method* method);
+  ProbeMethod(const pjsip_msg* msg);
+
+  const char* c_str() const { return _name; }
+
+private:
+  void set(const pj_str_t* name);
+
+  char _name[24];
+};
+
+/// The status code of a response, or zero for a request.
+inline int probe_status_code(const pjsip_msg* msg)
+{
+  return (msg->type == PJSIP_RESPONSE_MSG) ? msg->line.status.code : 0;
+}
+
+#endif
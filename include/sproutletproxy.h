@@ -25,6 +25,7 @@
 #include "sproutlet_options.h"
 
 class SproutletWrapper;
+class ProbeMethod;
 
 class SproutletProxy : public BasicProxy, SproutletHelper
 {
@@ -594,6 +595,8 @@ private:
   int compare_sip_sc(int sc1, int sc2);
   bool is_uri_local(const pjsip_uri*) const;
   void log_inter_sproutlet(pjsip_tx_data* tdata, bool downstream);
+  void probe_entry(const char* callback, const ProbeMethod& method);
+  void probe_exit(const char* callback, const ProbeMethod& method);
   ForkErrorState get_error_state() const;
 
   SproutletProxy* _proxy;
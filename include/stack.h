@@ -27,6 +27,7 @@ extern "C" {
 
 /* Pre-declariations */
 class LastValueCache;
+class AdaptivePoolFactory;
 
 /* Options */
 struct stack_data_struct
@@ -34,6 +35,7 @@ struct stack_data_struct
   SIPResolver*         sipresolver;
 
   pj_caching_pool      cp;
+  AdaptivePoolFactory *adaptive_pools;
   pj_pool_t           *pool;
   pjsip_endpoint      *endpt;
   pj_thread_t         *pjsip_transport_thread;
@@ -135,6 +135,22 @@ Bindings copy_active_bindings(const Bindings& bindings,
                               int now,
                               SAS::TrailId trail);
 
+/// Moves the active bindings out of a set of bindings, rather than copying
+/// them. This is used when the bindings come from an AoR that is about to be
+/// deleted, so there is no need to duplicate every binding (and its path
+/// headers and parameters) only to free the original a moment later.
+///
+/// @param bindings - The bindings to take from. The active bindings are
+///                   removed from this map and ownership passes to the
+///                   caller. Any expired bindings are left in place.
+/// @param now      - The current time.
+/// @param trail    - SAS trail to log expired bindings on.
+///
+/// @return The active bindings.
+Bindings take_active_bindings(Bindings& bindings,
+                              int now,
+                              SAS::TrailId trail);
+
 // Helper functions to copy subscriptions.
 Subscriptions copy_subscriptions(const Subscriptions& subscriptions);
 Subscriptions copy_active_subscriptions(const Subscriptions& subscriptions,
@@ -292,6 +292,22 @@ private:
   void handle_timer_pop_internal(const std::string& aor_id,
                                  SAS::TrailId trail);
 
+  /// Requests to S4, wrapped so that each fires the S4 request probes.
+  HTTPCode s4_get(const std::string& aor_id,
+                  AoR** aor,
+                  uint64_t& version,
+                  SAS::TrailId trail);
+  HTTPCode s4_put(const std::string& aor_id,
+                  AoR& aor,
+                  SAS::TrailId trail);
+  HTTPCode s4_patch(const std::string& aor_id,
+                    PatchObject& patch_object,
+                    AoR** aor,
+                    SAS::TrailId trail);
+  HTTPCode s4_delete(const std::string& aor_id,
+                     uint64_t version,
+                     SAS::TrailId trail);
+
   /// Helper function to get the default public ID from the HSS.
   HTTPCode get_cached_default_id(const std::string& public_id,
                                  std::string& aor_id,
@@ -21,6 +21,7 @@
 #include "subscriber_manager.h"
 #include "sproutlet.h"
 #include "compositesproutlet.h"
+#include "expiry_jitter.h"
 
 class SubscriptionSproutletTsx;
 
@@ -34,7 +35,8 @@ public:
                         const std::string& next_hop_service,
                         SubscriberManager* sm,
                         ACRFactory* acr_factory,
-                        int cfg_max_expires);
+                        int cfg_max_expires,
+                        ExpiryJitter* expiry_jitter = NULL);
   ~SubscriptionSproutlet();
 
   bool init();
@@ -60,6 +62,9 @@ private:
   /// The maximum time (in seconds) that a device can subscribe for.
   int _max_expires;
 
+  /// Policy for randomising granted expiry times, or NULL if disabled.
+  ExpiryJitter* _expiry_jitter;
+
   /// Default value for a subscription expiry. RFC3860 has this as 3761 seconds.
   static const int DEFAULT_SUBSCRIPTION_EXPIRES = 3761;
 
@@ -27,6 +27,7 @@ extern "C" {
 #include "snmp_counter_by_scope_table.h"
 #include "sip_event_priority.h"
 #include "eventq.h"
+#include "fast_clock.h"
 
 pj_status_t init_thread_dispatcher(int num_worker_threads_arg,
                                    SNMP::EventAccumulatorByScopeTable* latency_tbl_arg,
@@ -64,7 +65,7 @@ struct SipEvent
 
   // A stop watch for tracking latency and determining the length of time the
   // message has been on the queue
-  Utils::StopWatch stop_watch;
+  FastStopWatch stop_watch;
 
   // The event data itself
   SipEventData event_data;
@@ -83,19 +84,10 @@ struct SipEvent
     }
     else
     {
-      // At the same priority level, older SipEvents are 'larger'
-      unsigned long lhs_us = 0;
-      unsigned long rhs_us = 0;
-
-      if (!lhs.stop_watch.read(lhs_us) || !rhs.stop_watch.read(rhs_us))
-      {
-        // We're extremely unlikely to end up in this case, but we try to cope
-        // with it as well as possible
-        TRC_ERROR("Failed to read stopwatch.");
-        return false;
-      }
-
-      return lhs_us < rhs_us;
+      // At the same priority level, older SipEvents (those whose stop watches
+      // were started earlier) are 'larger'.  SipEvents on the queue are
+      // never paused, so this doesn't need to read the clock.
+      return lhs.stop_watch.start_ns() > rhs.stop_watch.start_ns();
     }
   }
 };
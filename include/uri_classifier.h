@@ -11,6 +11,8 @@
 #define URI_CLASSIFIER_H
 
 #include <string>
+#include <vector>
+#include <stdint.h>
 
 extern "C" {
 #include <pjsip.h>
@@ -44,9 +46,45 @@ namespace URIClassifier
 
   bool is_user_numeric(pj_str_t user);
 
+  /// Rebuilds the sets of home domains and local names used to classify
+  /// URIs. This must be called after home_domains or stack_data.name have
+  /// been changed, and before any URIs are classified.
+  void update_host_sets();
+
   extern bool enforce_user_phone;
   extern bool enforce_global;
   extern std::vector<pj_str_t*> home_domains;
+
+  /// Case-insensitive hash set of host names, used so that checking whether
+  /// a host is a home domain or a local name takes constant time however
+  /// many domains are configured. The set is built at configuration time
+  /// and is read-only while URIs are being classified.
+  class HostSet
+  {
+  public:
+    HostSet();
+
+    void insert(const pj_str_t* host);
+    bool contains(const pj_str_t* host) const;
+    void clear();
+
+  private:
+    struct Slot
+    {
+      Slot() : used(false), hash(0), host() {}
+
+      bool used;
+      uint32_t hash;
+      std::string host;
+    };
+
+    static uint32_t hash(const pj_str_t* host);
+    void insert_slot(Slot& slot);
+
+    size_t _mask;
+    size_t _size;
+    std::vector<Slot> _slots;
+  };
 };
 
 #endif
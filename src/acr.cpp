@@ -177,6 +177,10 @@ RalfACR::~RalfACR()
 
 void RalfACR::rx_request(pjsip_msg* req, pj_time_val timestamp)
 {
+  // Most of the information in the ACR comes from headers looked up by
+  // name, so index them.
+  HeaderIndex hdrs(req);
+
   if (timestamp.sec == -1)
   {
     // Timestamp is unspecified, so get the current time.
@@ -256,7 +260,7 @@ void RalfACR::rx_request(pjsip_msg* req, pj_time_val timestamp)
         (_method == "NOTIFY"))
     {
       pjsip_generic_string_hdr* event_hdr = (pjsip_generic_string_hdr*)
-                             pjsip_msg_find_hdr_by_name(req, &STR_EVENT, NULL);
+                             hdrs.find(&STR_EVENT);
       if (event_hdr != NULL)
       {
         _event = PJUtils::pj_str_to_string(&event_hdr->hvalue);
@@ -318,10 +322,7 @@ void RalfACR::rx_request(pjsip_msg* req, pj_time_val timestamp)
     if (req->line.req.method.id == PJSIP_INVITE_METHOD)
     {
       pjsip_session_expires_hdr* sess_expires = (pjsip_session_expires_hdr*)
-                               pjsip_msg_find_hdr_by_names(req,
-                                                           &STR_SESSION_EXPIRES,
-                                                           &STR_X,
-                                                           NULL);
+                               hdrs.find(&STR_SESSION_EXPIRES, &STR_X);
       if (sess_expires != NULL)
       {
         _interim_interval = sess_expires->expires;
@@ -340,7 +341,7 @@ void RalfACR::rx_request(pjsip_msg* req, pj_time_val timestamp)
     {
       // For originating requests take the subscription identifiers from
       // P-Asserted-Identity headers in the original request.
-      store_subscription_ids(req);
+      store_subscription_ids(hdrs);
     }
 
     if ((_method == "REGISTER") &&
@@ -359,7 +360,7 @@ void RalfACR::rx_request(pjsip_msg* req, pj_time_val timestamp)
     }
 
     // Store the calling party addresses (from P-Asserted-Identity headers).
-    store_calling_party_addresses(req);
+    store_calling_party_addresses(hdrs);
 
     // Store the RequestURI in case it is needed for a Requested-Party-Address
     // AVP or as a Media-Originator-Party AVP.
@@ -367,17 +368,17 @@ void RalfACR::rx_request(pjsip_msg* req, pj_time_val timestamp)
                PJUtils::uri_to_string(PJSIP_URI_IN_REQ_URI, req->line.req.uri);
 
     // Store IOIs and ICID from P-Charging-Vector header if present.
-    store_charging_info(req);
+    store_charging_info(hdrs);
 
     // In the originating case we always take SDP and other message bodies
     // from the original request.
     if (_node_role == NODE_ROLE_ORIGINATING)
     {
       // Store media description if present.
-      store_media_description(req, _media);
+      store_media_description(hdrs, _media);
 
       // Store non-SDP message bodies if present.
-      store_message_bodies(req);
+      store_message_bodies(hdrs);
     }
 
     // Store contents of Reason header(s) if CANCEL or BYE request.
@@ -385,29 +386,29 @@ void RalfACR::rx_request(pjsip_msg* req, pj_time_val timestamp)
         (req->line.req.method.id == PJSIP_BYE_METHOD))
     {
       pjsip_generic_string_hdr* reason_hdr = (pjsip_generic_string_hdr*)
-                            pjsip_msg_find_hdr_by_name(req, &STR_REASON, NULL);
+                            hdrs.find(&STR_REASON);
       while (reason_hdr != NULL)
       {
         _reasons.push_back(PJUtils::pj_str_to_string(&reason_hdr->hvalue));
         reason_hdr = (pjsip_generic_string_hdr*)
-                pjsip_msg_find_hdr_by_name(req, &STR_REASON, reason_hdr->next);
+                hdrs.find_next((pjsip_hdr*)reason_hdr);
       }
     }
 
     // Store contents of P-Access-Network-Info headers if present.
     pjsip_generic_string_hdr* pani_hdr = (pjsip_generic_string_hdr*)
-                           pjsip_msg_find_hdr_by_name(req, &STR_P_A_N_I, NULL);
+                           hdrs.find(&STR_P_A_N_I);
     while (pani_hdr != NULL)
     {
       _access_network_info.push_back(
                                  PJUtils::pj_str_to_string(&pani_hdr->hvalue));
       pani_hdr = (pjsip_generic_string_hdr*)
-                 pjsip_msg_find_hdr_by_name(req, &STR_P_A_N_I, pani_hdr->next);
+                 hdrs.find_next((pjsip_hdr*)pani_hdr);
     }
 
     // Store contents of P-Visited-Network-ID header.
     pjsip_generic_string_hdr* pvni_hdr = (pjsip_generic_string_hdr*)
-                           pjsip_msg_find_hdr_by_name(req, &STR_P_V_N_I, NULL);
+                           hdrs.find(&STR_P_V_N_I);
     if (pvni_hdr != NULL)
     {
       _visited_network_id = PJUtils::pj_str_to_string(&pvni_hdr->hvalue);
@@ -424,7 +425,7 @@ void RalfACR::rx_request(pjsip_msg* req, pj_time_val timestamp)
   // requests.
 
   // Store the charging function addresses if present.
-  store_charging_addresses(req);
+  store_charging_addresses(hdrs);
 
   if (_node_role == NODE_ROLE_TERMINATING)
   {
@@ -440,6 +441,8 @@ void RalfACR::rx_request(pjsip_msg* req, pj_time_val timestamp)
 /// Called with the request as it is forwarded by this node.
 void RalfACR::tx_request(pjsip_msg* req, pj_time_val timestamp)
 {
+  HeaderIndex hdrs(req);
+
   if (timestamp.sec == -1)
   {
     // Timestamp is unspecified, so get the current time.
@@ -459,10 +462,7 @@ void RalfACR::tx_request(pjsip_msg* req, pj_time_val timestamp)
   if (req->line.req.method.id == PJSIP_INVITE_METHOD)
   {
     pjsip_session_expires_hdr* sess_expires = (pjsip_session_expires_hdr*)
-                             pjsip_msg_find_hdr_by_names(req,
-                                                         &STR_SESSION_EXPIRES,
-                                                         &STR_X,
-                                                         NULL);
+                             hdrs.find(&STR_SESSION_EXPIRES, &STR_X);
     if (sess_expires != NULL)
     {
       _interim_interval = sess_expires->expires;
@@ -478,23 +478,25 @@ void RalfACR::tx_request(pjsip_msg* req, pj_time_val timestamp)
   }
 
   // Store the charging function addresses if present.
-  store_charging_addresses(req);
+  store_charging_addresses(hdrs);
 
   // If this is a terminating request store the SDP and non-SDP bodies from
   // every transmitted request.
   if (_node_role == NODE_ROLE_TERMINATING)
   {
     // Store media description if present.
-    store_media_description(req, _media);
+    store_media_description(hdrs, _media);
 
     // Store non-SDP message bodies if present.
-    store_message_bodies(req);
+    store_message_bodies(hdrs);
   }
 }
 
 /// Called with all non-100 responses as first received by the node.
 void RalfACR::rx_response(pjsip_msg* rsp, pj_time_val timestamp)
 {
+  HeaderIndex hdrs(rsp);
+
   if (timestamp.sec == -1)
   {
     // Timestamp is unspecified, so get the current time.
@@ -509,32 +511,32 @@ void RalfACR::rx_response(pjsip_msg* rsp, pj_time_val timestamp)
       _first_rsp = false;
 
       // Store IOIs and ICID from P-Charging-Vector header if present.
-      store_charging_info(rsp);
+      store_charging_info(hdrs);
 
       if (_node_role == NODE_ROLE_TERMINATING)
       {
         // For terminating requests take the subscription identifiers from
         // P-Asserted-Identity headers in the first response.
-        store_subscription_ids(rsp);
+        store_subscription_ids(hdrs);
 
         // For terminating requests store media from the first received final
         // response.
-        store_media_description(rsp, _media);
+        store_media_description(hdrs, _media);
 
         // Store non-SDP message bodies if present.
-        store_message_bodies(rsp);
+        store_message_bodies(hdrs);
       }
 
       if (rsp->line.status.code >= PJSIP_SC_OK)
       {
         // First 200 OK response, so store the called asserted identities.
-        store_called_asserted_ids(rsp);
+        store_called_asserted_ids(hdrs);
       }
     }
   }
 
   // Store the charging function addresses if present.
-  store_charging_addresses(rsp);
+  store_charging_addresses(hdrs);
 
   // Store the latest status code.
   _status_code = rsp->line.status.code;
@@ -542,6 +544,8 @@ void RalfACR::rx_response(pjsip_msg* rsp, pj_time_val timestamp)
 
 void RalfACR::tx_response(pjsip_msg* rsp, pj_time_val timestamp)
 {
+  HeaderIndex hdrs(rsp);
+
   if (timestamp.sec == -1)
   {
     // Timestamp is unspecified, so get the current time.
@@ -551,15 +555,15 @@ void RalfACR::tx_response(pjsip_msg* rsp, pj_time_val timestamp)
   _rsp_timestamp = timestamp;
 
   // Store the charging function addresses if present.
-  store_charging_addresses(rsp);
+  store_charging_addresses(hdrs);
 
   if (_node_role == NODE_ROLE_ORIGINATING)
   {
     // For originating requests store media from the final transmitted response.
-    store_media_description(rsp, _media);
+    store_media_description(hdrs, _media);
 
     // Store non-SDP message bodies if present.
-    store_message_bodies(rsp);
+    store_message_bodies(hdrs);
   }
 
   if ((_method == "REGISTER") &&
@@ -568,7 +572,7 @@ void RalfACR::tx_response(pjsip_msg* rsp, pj_time_val timestamp)
     // Store the associated URIs from the 200 OK/REGISTER response.  These
     // are stored from the transmitted response to catch the case where the
     // S-CSCF has generated the response itself.
-    store_associated_uris(rsp);
+    store_associated_uris(hdrs);
   }
 
   // Store the latest status code.
@@ -1468,15 +1472,14 @@ void RalfACR::split_sdp(const std::string& sdp, std::vector<std::string>& lines)
   while (start_pos != std::string::npos);
 }
 
-void RalfACR::store_charging_addresses(pjsip_msg* msg)
+void RalfACR::store_charging_addresses(HeaderIndex& hdrs)
 {
   // Only store charging addresses for START or EVENT ACRs - they are not
   // needed for INTERIM or STOP ACRs.
   if ((_record_type == START_RECORD) ||
       (_record_type == EVENT_RECORD))
   {
-    pjsip_p_c_f_a_hdr* p_cfa_hdr = (pjsip_p_c_f_a_hdr*)
-                             pjsip_msg_find_hdr_by_name(msg, &STR_P_C_F_A, NULL);
+    pjsip_p_c_f_a_hdr* p_cfa_hdr = (pjsip_p_c_f_a_hdr*)hdrs.find(&STR_P_C_F_A);
     if (p_cfa_hdr != NULL)
     {
       // Clear out any existing entries.
@@ -1504,16 +1507,14 @@ void RalfACR::store_charging_addresses(pjsip_msg* msg)
   }
 }
 
-void RalfACR::store_subscription_ids(pjsip_msg* msg)
+void RalfACR::store_subscription_ids(HeaderIndex& hdrs)
 {
-  pjsip_routing_hdr* pa_id = (pjsip_routing_hdr*)
-               pjsip_msg_find_hdr_by_name(msg, &STR_P_ASSERTED_IDENTITY, NULL);
+  pjsip_routing_hdr* pa_id = (pjsip_routing_hdr*)hdrs.find(&STR_P_ASSERTED_IDENTITY);
   while (pa_id != NULL)
   {
     pjsip_uri* uri = (pjsip_uri*)pjsip_uri_get_uri(&pa_id->name_addr);
     _subscription_ids.push_back(uri_to_subscription_id(uri));
-    pa_id = (pjsip_routing_hdr*)
-        pjsip_msg_find_hdr_by_name(msg, &STR_P_ASSERTED_IDENTITY, pa_id->next);
+    pa_id = (pjsip_routing_hdr*)hdrs.find_next((pjsip_hdr*)pa_id);
   }
   TRC_DEBUG("Stored %d subscription identifiers", _subscription_ids.size());
 }
@@ -1538,17 +1539,15 @@ RalfACR::SubscriptionId RalfACR::uri_to_subscription_id(pjsip_uri* uri)
   return id;
 }
 
-void RalfACR::store_calling_party_addresses(pjsip_msg* msg)
+void RalfACR::store_calling_party_addresses(HeaderIndex& hdrs)
 {
-  pjsip_routing_hdr* pa_id = (pjsip_routing_hdr*)
-               pjsip_msg_find_hdr_by_name(msg, &STR_P_ASSERTED_IDENTITY, NULL);
+  pjsip_routing_hdr* pa_id = (pjsip_routing_hdr*)hdrs.find(&STR_P_ASSERTED_IDENTITY);
   while (pa_id != NULL)
   {
     pjsip_uri* uri = (pjsip_uri*)pjsip_uri_get_uri(&pa_id->name_addr);
     _calling_party_addresses.push_back(
                          PJUtils::uri_to_string(PJSIP_URI_IN_FROMTO_HDR, uri));
-    pa_id = (pjsip_routing_hdr*)
-        pjsip_msg_find_hdr_by_name(msg, &STR_P_ASSERTED_IDENTITY, pa_id->next);
+    pa_id = (pjsip_routing_hdr*)hdrs.find_next((pjsip_hdr*)pa_id);
   }
 }
 
@@ -1558,39 +1557,34 @@ void RalfACR::store_called_party_address(pjsip_msg* msg)
                PJUtils::uri_to_string(PJSIP_URI_IN_REQ_URI, msg->line.req.uri);
 }
 
-void RalfACR::store_called_asserted_ids(pjsip_msg* msg)
+void RalfACR::store_called_asserted_ids(HeaderIndex& hdrs)
 {
-  pjsip_routing_hdr* pa_id = (pjsip_routing_hdr*)
-               pjsip_msg_find_hdr_by_name(msg, &STR_P_ASSERTED_IDENTITY, NULL);
+  pjsip_routing_hdr* pa_id = (pjsip_routing_hdr*)hdrs.find(&STR_P_ASSERTED_IDENTITY);
   while (pa_id != NULL)
   {
     pjsip_uri* uri = (pjsip_uri*)pjsip_uri_get_uri(&pa_id->name_addr);
     _called_asserted_ids.push_back(
                          PJUtils::uri_to_string(PJSIP_URI_IN_FROMTO_HDR, uri));
-    pa_id = (pjsip_routing_hdr*)
-        pjsip_msg_find_hdr_by_name(msg, &STR_P_ASSERTED_IDENTITY, pa_id->next);
+    pa_id = (pjsip_routing_hdr*)hdrs.find_next((pjsip_hdr*)pa_id);
   }
 }
 
-void RalfACR::store_associated_uris(pjsip_msg* msg)
+void RalfACR::store_associated_uris(HeaderIndex& hdrs)
 {
   TRC_DEBUG("Store associated URIs");
-  pjsip_routing_hdr* pau = (pjsip_routing_hdr*)
-                  pjsip_msg_find_hdr_by_name(msg, &STR_P_ASSOCIATED_URI, NULL);
+  pjsip_routing_hdr* pau = (pjsip_routing_hdr*)hdrs.find(&STR_P_ASSOCIATED_URI);
   while (pau != NULL)
   {
     pjsip_uri* uri = (pjsip_uri*)pjsip_uri_get_uri(&pau->name_addr);
     _associated_uris.push_back(
                          PJUtils::uri_to_string(PJSIP_URI_IN_FROMTO_HDR, uri));
-    pau = (pjsip_routing_hdr*)
-             pjsip_msg_find_hdr_by_name(msg, &STR_P_ASSOCIATED_URI, pau->next);
+    pau = (pjsip_routing_hdr*)hdrs.find_next((pjsip_hdr*)pau);
   }
 }
 
-void RalfACR::store_charging_info(pjsip_msg* msg)
+void RalfACR::store_charging_info(HeaderIndex& hdrs)
 {
-  pjsip_p_c_v_hdr* pcv_hdr = (pjsip_p_c_v_hdr*)
-                             pjsip_msg_find_hdr_by_name(msg, &STR_P_C_V, NULL);
+  pjsip_p_c_v_hdr* pcv_hdr = (pjsip_p_c_v_hdr*)hdrs.find(&STR_P_C_V);
   if (pcv_hdr != NULL)
   {
     TRC_DEBUG("Found P-Charging-Vector header, store information");
@@ -1610,8 +1604,10 @@ void RalfACR::store_charging_info(pjsip_msg* msg)
   }
 }
 
-void RalfACR::store_media_description(pjsip_msg* msg, MediaDescription& description)
+void RalfACR::store_media_description(HeaderIndex& hdrs, MediaDescription& description)
 {
+  pjsip_msg* msg = hdrs.msg();
+
   // If the message has an SDP body store it in the offer or answer slot.
   pjsip_msg_body* body = msg->body;
 
@@ -1625,26 +1621,27 @@ void RalfACR::store_media_description(pjsip_msg* msg, MediaDescription& descript
     if (_method == "ACK")
     {
       // ACKs can only every carry answers.
-      store_media_components(msg, description.answer);
+      store_media_components(hdrs, description.answer);
     }
     else if ((msg->type == PJSIP_REQUEST_MSG) ||
              (description.offer.sdp == ""))
     {
       // Either a request (so by definition an offer), or no offer on the
       // request, so store as the offer.
-      store_media_components(msg, description.offer);
+      store_media_components(hdrs, description.offer);
     }
     else
     {
       // Store the SDP as the answer.
-      store_media_components(msg, description.answer);
+      store_media_components(hdrs, description.answer);
     }
   }
   // LCOV_EXCL_STOP
 }
 
-void RalfACR::store_media_components(pjsip_msg* msg, MediaComponents& components)
+void RalfACR::store_media_components(HeaderIndex& hdrs, MediaComponents& components)
 {
+  pjsip_msg* msg = hdrs.msg();
   pjsip_msg_body* body = msg->body;
 
   // Store the SDP body.
@@ -1670,8 +1667,7 @@ void RalfACR::store_media_components(pjsip_msg* msg, MediaComponents& components
   // from the message (request or response) if present, or the RequestURI from
   // the original request if the message is a response and there is no
   // P-Asserted-Identity.
-  pjsip_routing_hdr* pa_id = (pjsip_routing_hdr*)
-               pjsip_msg_find_hdr_by_name(msg, &STR_P_ASSERTED_IDENTITY, NULL);
+  pjsip_routing_hdr* pa_id = (pjsip_routing_hdr*)hdrs.find(&STR_P_ASSERTED_IDENTITY);
   if (pa_id != NULL)
   {
     pjsip_uri* uri = (pjsip_uri*)pjsip_uri_get_uri(&pa_id->name_addr);
@@ -1684,8 +1680,9 @@ void RalfACR::store_media_components(pjsip_msg* msg, MediaComponents& components
   }
 }
 
-void RalfACR::store_message_bodies(pjsip_msg* msg)
+void RalfACR::store_message_bodies(HeaderIndex& hdrs)
 {
+  pjsip_msg* msg = hdrs.msg();
   pjsip_msg_body* msg_body = msg->body;
 
   if ((msg_body != NULL) &&
@@ -1700,7 +1697,7 @@ void RalfACR::store_message_bodies(pjsip_msg* msg)
                 + PJUtils::pj_str_to_string(&msg_body->content_type.subtype);
     body.length = msg_body->len;
     pjsip_generic_string_hdr* cdisp_hdr = (pjsip_generic_string_hdr*)
-               pjsip_msg_find_hdr_by_name(msg, &STR_CONTENT_DISPOSITION, NULL);
+                                              hdrs.find(&STR_CONTENT_DISPOSITION);
 
     if (cdisp_hdr != NULL)
     {
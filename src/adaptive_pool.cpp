@@ -0,0 +1,287 @@
+/**
+ * @file adaptive_pool.cpp Adaptive sizing and recycling of the PJSIP pools
+ * used for messages.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "adaptive_pool.h"
+#include "log.h"
+
+AdaptivePoolFactory* AdaptivePoolFactory::_instance = NULL;
+
+AdaptivePoolFactory::AdaptivePoolFactory(pj_caching_pool* cp,
+                                         int recalc_interval) :
+  _cp(cp),
+  _recalc_interval(recalc_interval),
+  _create_pool(cp->factory.create_pool),
+  _release_pool(cp->factory.release_pool)
+{
+  for (int ii = 0; ii < NUM_POOL_CLASSES; ++ii)
+  {
+    ClassState& state = _classes[ii];
+    state.initial_size = 0;
+    state.created = 0;
+    state.reused = 0;
+    state.released = 0;
+
+    for (size_t jj = 0; jj < NUM_BUCKETS; ++jj)
+    {
+      state.buckets[jj] = 0;
+    }
+  }
+
+  _instance = this;
+  cp->factory.create_pool = &AdaptivePoolFactory::create_pool;
+  cp->factory.release_pool = &AdaptivePoolFactory::release_pool;
+}
+
+AdaptivePoolFactory::~AdaptivePoolFactory()
+{
+  _cp->factory.create_pool = _create_pool;
+  _cp->factory.release_pool = _release_pool;
+
+  for (int ii = 0; ii < NUM_POOL_CLASSES; ++ii)
+  {
+    ClassState& state = _classes[ii];
+    std::unique_lock<std::mutex> lock(state.free_list_lock);
+
+    for (pj_pool_t* pool : state.free_list)
+    {
+      _release_pool(pool->factory, pool);
+    }
+
+    state.free_list.clear();
+  }
+
+  _instance = NULL;
+}
+
+const char* AdaptivePoolFactory::class_name(PoolClass pool_class)
+{
+  switch (pool_class)
+  {
+  case RDATA:
+    return "rdata";
+
+  case TDATA:
+    return "tdata";
+
+  default:
+    return "other"; // LCOV_EXCL_LINE
+  }
+}
+
+AdaptivePoolFactory::PoolClass AdaptivePoolFactory::classify(const char* name)
+{
+  if (name == NULL)
+  {
+    return NOT_MESSAGE_POOL;
+  }
+  else if (strncmp(name, "rtd", 3) == 0)
+  {
+    return RDATA;
+  }
+  else if (strncmp(name, "tdta", 4) == 0)
+  {
+    return TDATA;
+  }
+
+  return NOT_MESSAGE_POOL;
+}
+
+AdaptivePoolFactory::Stats AdaptivePoolFactory::stats(PoolClass pool_class) const
+{
+  const ClassState& state = _classes[pool_class];
+
+  Stats stats;
+  stats.initial_size = state.initial_size.load();
+  stats.created = state.created.load();
+  stats.reused = state.reused.load();
+
+  std::unique_lock<std::mutex> lock(state.free_list_lock);
+  stats.free = state.free_list.size();
+  return stats;
+}
+
+pj_pool_t* AdaptivePoolFactory::pop_free(ClassState& state)
+{
+  std::unique_lock<std::mutex> lock(state.free_list_lock);
+  pj_pool_t* pool = NULL;
+
+  if (!state.free_list.empty())
+  {
+    pool = state.free_list.back();
+    state.free_list.pop_back();
+  }
+
+  return pool;
+}
+
+bool AdaptivePoolFactory::push_free(ClassState& state, pj_pool_t* pool)
+{
+  std::unique_lock<std::mutex> lock(state.free_list_lock);
+
+  if (state.free_list.size() >= FREE_LIST_SIZE)
+  {
+    return false;
+  }
+
+  state.free_list.push_back(pool);
+  return true;
+}
+
+pj_pool_t* AdaptivePoolFactory::create_pool(pj_pool_factory* factory,
+                                            const char* name,
+                                            pj_size_t initial_size,
+                                            pj_size_t increment_size,
+                                            pj_pool_callback* callback)
+{
+  AdaptivePoolFactory* self = _instance;
+  PoolClass pool_class = classify(name);
+
+  if (pool_class == NOT_MESSAGE_POOL)
+  {
+    return self->_create_pool(factory,
+                              name,
+                              initial_size,
+                              increment_size,
+                              callback);
+  }
+
+  ClassState& state = self->_classes[pool_class];
+  pj_pool_t* pool = pop_free(state);
+
+  if ((pool != NULL) && (pool->increment_size != increment_size))
+  {
+    // LCOV_EXCL_START - PJSIP always uses the same increment for a class.
+    self->_release_pool(factory, pool);
+    pool = NULL;
+    // LCOV_EXCL_STOP
+  }
+
+  if (pool != NULL)
+  {
+    // Name the pool for its new owner, as pj_pool_create would.
+    if (strchr(name, '%') != NULL)
+    {
+      pj_ansi_snprintf(pool->obj_name, sizeof(pool->obj_name), name, pool);
+    }
+    else
+    {
+      pj_ansi_strncpy(pool->obj_name, name, PJ_MAX_OBJ_NAME);
+      pool->obj_name[PJ_MAX_OBJ_NAME - 1] = '\0';
+    }
+
+    pool->callback = callback;
+    ++state.reused;
+    return pool;
+  }
+
+  ++state.created;
+  return self->_create_pool(factory,
+                            name,
+                            std::max(initial_size,
+                                     (pj_size_t)state.initial_size.load()),
+                            increment_size,
+                            callback);
+}
+
+void AdaptivePoolFactory::release_pool(pj_pool_factory* factory,
+                                       pj_pool_t* pool)
+{
+  AdaptivePoolFactory* self = _instance;
+  PoolClass pool_class = classify(pool->obj_name);
+
+  if (pool_class != NOT_MESSAGE_POOL)
+  {
+    self->record_usage(pool_class, pj_pool_get_used_size(pool));
+
+    // Resetting the pool frees all but its first block.  Keep it for reuse
+    // if that is still big enough for a new pool of its class.
+    pj_pool_reset(pool);
+
+    ClassState& state = self->_classes[pool_class];
+
+    if ((pj_pool_get_capacity(pool) >= state.initial_size.load()) &&
+        (push_free(state, pool)))
+    {
+      return;
+    }
+  }
+
+  self->_release_pool(factory, pool);
+}
+
+void AdaptivePoolFactory::record_usage(PoolClass pool_class, size_t used_size)
+{
+  ClassState& state = _classes[pool_class];
+
+  ++state.buckets[std::min(used_size / BUCKET_SIZE, NUM_BUCKETS - 1)];
+
+  if (++state.released % _recalc_interval == 0)
+  {
+    recalculate(state);
+  }
+}
+
+void AdaptivePoolFactory::recalculate(ClassState& state)
+{
+  // If another thread is already recalculating there's no need to do it
+  // again.
+  std::unique_lock<std::mutex> lock(state.recalc_lock, std::try_to_lock);
+  if (!lock.owns_lock())
+  {
+    return; // LCOV_EXCL_LINE
+  }
+
+  uint64_t counts[NUM_BUCKETS];
+  uint64_t total = 0;
+
+  for (size_t ii = 0; ii < NUM_BUCKETS; ++ii)
+  {
+    counts[ii] = state.buckets[ii].load();
+    total += counts[ii];
+
+    // Halve the counts, so that older messages carry less weight in the
+    // next calculation.
+    state.buckets[ii] -= counts[ii] / 2;
+  }
+
+  uint64_t target = (total * TARGET_PERCENTILE + 99) / 100;
+  uint64_t cumulative = 0;
+  size_t bucket = NUM_BUCKETS - 1;
+
+  for (size_t ii = 0; ii < NUM_BUCKETS; ++ii)
+  {
+    cumulative += counts[ii];
+
+    if (cumulative >= target)
+    {
+      bucket = ii;
+      break;
+    }
+  }
+
+  // Size pools to hold the top of the bucket, plus the block header that
+  // the pool's capacity includes but its used size doesn't.
+  size_t initial_size = std::min((bucket + 1) * BUCKET_SIZE + sizeof(pj_pool_block),
+                                 (size_t)MAX_INITIAL_SIZE);
+
+  if (initial_size != state.initial_size.load())
+  {
+    TRC_DEBUG("Changing initial message pool size from %zu to %zu",
+              state.initial_size.load(),
+              initial_size);
+    state.initial_size = initial_size;
+  }
+}
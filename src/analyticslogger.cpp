@@ -25,6 +25,7 @@
 #include <string>
 
 #include "analyticslogger.h"
+#include "fast_clock.h"
 
 AnalyticsLogger::AnalyticsLogger()
 {
@@ -36,20 +37,35 @@ AnalyticsLogger::~AnalyticsLogger()
 
 void AnalyticsLogger::log_with_tag_and_timestamp(char* log)
 {
-  // Add the current UTC time, in RFC3339 format.
+  // Add the current UTC time, in RFC3339 format.  Each thread caches the
+  // date and time to the second, so only needs to format the milliseconds
+  // for most logs.
+  static thread_local time_t cached_sec = -1;
+  static thread_local char cached_datetime[64];
+
   struct timespec timespec;
-  struct tm dt;
-  clock_gettime(CLOCK_REALTIME, &timespec);
-  gmtime_r(&timespec.tv_sec, &dt);
+  FastClock::realtime(&timespec);
+
+  if (timespec.tv_sec != cached_sec)
+  {
+    struct tm dt;
+    gmtime_r(&timespec.tv_sec, &dt);
+    snprintf(cached_datetime,
+             sizeof(cached_datetime),
+             "%4.4d-%2.2d-%2.2dT%2.2d:%2.2d:%2.2d",
+             (dt.tm_year + 1900),
+             (dt.tm_mon + 1),
+             dt.tm_mday,
+             dt.tm_hour,
+             dt.tm_min,
+             dt.tm_sec);
+    cached_sec = timespec.tv_sec;
+  }
+
   char timestamp[100];
   sprintf(timestamp,
-          "%4.4d-%2.2d-%2.2dT%2.2d:%2.2d:%2.2d.%3.3d+00:00",
-          (dt.tm_year + 1900),
-          (dt.tm_mon + 1),
-          dt.tm_mday,
-          dt.tm_hour,
-          dt.tm_min,
-          dt.tm_sec,
+          "%s.%3.3d+00:00",
+          cached_datetime,
           (int)(timespec.tv_nsec / 1000000));
 
   syslog(LOG_INFO, "<analytics> %s %s", timestamp, log);
@@ -9,18 +9,28 @@
  * Metaswitch Networks in a separate written agreement.
  */
 
+#include <unordered_map>
+
 #include "as_communication_tracker.h"
 
+std::atomic<uint64_t> AsCommunicationTracker::_next_id(0);
+
 AsCommunicationTracker::AsCommunicationTracker(Alarm* alarm,
                                                const PDLog2<const char*, const char*>* as_failed_log,
                                                const PDLog1<const char*>* as_ok_log) :
+  _lock("AsCommunicationTracker"),
+  _as_states(),
+  _num_failed(0),
+  _id(_next_id++),
   _next_check_time_ms(current_time_ms() + NEXT_CHECK_INTERVAL_MS),
   _alarm(alarm),
   _as_failed_log(as_failed_log),
-  _as_ok_log(as_ok_log)
+  _as_ok_log(as_ok_log),
+  _terminate(false),
+  _check_lock(),
+  _check_cond(),
+  _check_thread()
 {
-  pthread_mutex_init(&_lock, NULL);
-
   // Clear the alarm on startup so we don't get alarms hanging over from a
   // previous run. If an AS is actually in error, we'll alarm as soon as we
   // detect a failure.
@@ -29,19 +39,34 @@ AsCommunicationTracker::AsCommunicationTracker(Alarm* alarm,
   {
     _alarm->clear();
   }
+
+  _check_thread = std::thread(&AsCommunicationTracker::run_checks, this);
 }
 
 
 AsCommunicationTracker::~AsCommunicationTracker()
 {
-  pthread_mutex_destroy(&_lock);
+  {
+    std::unique_lock<std::mutex> lock(_check_lock);
+    _terminate = true;
+    _check_cond.notify_all();
+  }
+
+  _check_thread.join();
+
+  for (std::pair<const std::string, AsState*>& as : _as_states)
+  {
+    delete as.second;
+  }
 }
 
 
 void AsCommunicationTracker::on_success(const std::string& as_uri)
 {
+  // Nothing to do - an AS is treated as healthy again once it has gone a
+  // whole check period without failures, and that is spotted by the
+  // background checks.
   TRC_DEBUG("Communication with AS %s successful", as_uri.c_str());
-  check_for_healthy_app_servers();
 }
 
 
@@ -50,37 +75,76 @@ void AsCommunicationTracker::on_failure(const std::string& as_uri,
 {
   TRC_DEBUG("Communication with AS %s failed", as_uri.c_str());
 
-  pthread_mutex_lock(&_lock);
+  AsState* as_state = get_as_state(as_uri);
+  as_state->failures++;
 
-  // If we didn't know of any failed ASs, we do now so we should raise the
-  // alarm.
-  if (_as_failures.empty())
+  // The failure must be counted before checking whether the AS is failed.
+  // The check for healthy ASs marks an AS as not failed before reading its
+  // count, so either it sees this failure, or we see the AS isn't failed.
+  if (!as_state->failed)
   {
-    TRC_DEBUG("First failure - raise the alarm");
-    _alarm->set();
+    as_failed(as_state, as_uri, reason);
   }
+}
+
 
-  // Add an entry to the failed ASs map (incrementing the count of failures if
-  // it has already failed).
-  std::map<std::string, int>::iterator as_iter = _as_failures.find(as_uri);
+AsCommunicationTracker::AsState* AsCommunicationTracker::get_as_state(
+                                                      const std::string& as_uri)
+{
+  // Each thread caches the states it has looked up, for each tracker.
+  static thread_local std::unordered_map<uint64_t,
+                                         std::unordered_map<std::string, AsState*>>
+    thread_cache;
 
-  if (as_iter != _as_failures.end())
+  std::unordered_map<std::string, AsState*>& cache = thread_cache[_id];
+  std::unordered_map<std::string, AsState*>::iterator cached = cache.find(as_uri);
+
+  if (cached != cache.end())
+  {
+    return cached->second;
+  }
+
+  _lock.lock();
+
+  AsState*& as_state = _as_states[as_uri];
+  if (as_state == NULL)
   {
-    as_iter->second++;
+    as_state = new AsState();
   }
-  else
+
+  _lock.unlock();
+
+  cache[as_uri] = as_state;
+  return as_state;
+}
+
+
+void AsCommunicationTracker::as_failed(AsState* as_state,
+                                       const std::string& as_uri,
+                                       const std::string& reason)
+{
+  _lock.lock();
+
+  if (!as_state->failed)
   {
+    // If we didn't know of any failed ASs, we do now so we should raise the
+    // alarm.
+    if (_num_failed == 0)
+    {
+      TRC_DEBUG("First failure - raise the alarm");
+      _alarm->set();
+    }
+
     // This is the first time we've spotted that the AS has failed, so log this
     // fact.
     TRC_DEBUG("First failure for this AS - generate log");
     _as_failed_log->log(as_uri.c_str(), reason.c_str());
-    _as_failures[as_uri] = 1;
+
+    as_state->failed = true;
+    _num_failed++;
   }
-  pthread_mutex_unlock(&_lock);
 
-  // Even though communication to this AS has failed, other ASs may have become
-  // healthy recently so we still need to check them.
-  check_for_healthy_app_servers();
+  _lock.unlock();
 }
 
 
@@ -92,7 +156,7 @@ void AsCommunicationTracker::check_for_healthy_app_servers()
 
   if (now > _next_check_time_ms)
   {
-    pthread_mutex_lock(&_lock);
+    _lock.lock();
 
     if (now > _next_check_time_ms)
     {
@@ -101,47 +165,55 @@ void AsCommunicationTracker::check_for_healthy_app_servers()
       // Don't check again for a while.
       _next_check_time_ms = current_time_ms() + NEXT_CHECK_INTERVAL_MS;
 
-      // Iterate through all the AS in our map. If any of them have not had
-      // any failures in the last time period we will log they are now working
-      // correctly and remove them from the map.
+      // Iterate through all the failed ASs. If any of them have not had any
+      // failures in the last time period we will log they are now working
+      // correctly.
       //
-      // We mutate the map as we iterate over it. The non-standard loop
-      // construct avoids iterator invalidation.
-      std::map<std::string, int>::iterator curr_as = _as_failures.begin();
-      std::map<std::string, int>::iterator next_as;
-
       // We build this string for logging which ASs are in failure.
       std::string failed_as_string;
 
-      while (curr_as != _as_failures.end())
+      for (std::pair<const std::string, AsState*>& as : _as_states)
       {
-        next_as = std::next(curr_as);
+        AsState* as_state = as.second;
+
+        if (!as_state->failed)
+        {
+          continue;
+        }
+
+        // Mark the AS as healthy before reading its failure count, so that a
+        // failure racing with this check is either counted here, or sees the
+        // AS as healthy and fails it again (see on_failure).
+        as_state->failed = false;
 
-        if (curr_as->second == 0)
+        if (as_state->failures.exchange(0) == 0)
         {
-          TRC_DEBUG("AS %s has become healthy", curr_as->first.c_str());
-          _as_ok_log->log(curr_as->first.c_str());
-          _as_failures.erase(curr_as);
+          TRC_DEBUG("AS %s has become healthy", as.first.c_str());
+          _as_ok_log->log(as.first.c_str());
+          _num_failed--;
         }
         else
         {
+          as_state->failed = true;
+
           if (failed_as_string != "")
           {
             failed_as_string += ", ";
           }
 
-          failed_as_string += curr_as->first;
-          curr_as->second = 0;
+          failed_as_string += as.first;
         }
-
-        curr_as = next_as;
       }
 
-      if (_as_failures.empty())
+      if (_num_failed == 0)
       {
         TRC_DEBUG("All ASs OK - clear the alarm");
-        // No ASs are currently failed. Clear the alarm.
-        _alarm->clear();
+        // No ASs are currently failed. Clear the alarm.  (_alarm is NULL for
+        // mock trackers in UTs, whose background thread still runs.)
+        if (_alarm)
+        {
+          _alarm->clear();
+        }
       }
       else
       {
@@ -151,7 +223,28 @@ void AsCommunicationTracker::check_for_healthy_app_servers()
       }
     }
 
-    pthread_mutex_unlock(&_lock);
+    _lock.unlock();
+  }
+}
+
+
+void AsCommunicationTracker::run_checks()
+{
+  std::unique_lock<std::mutex> lock(_check_lock);
+
+  while (!_terminate)
+  {
+    // Wait until just after the next check is due.
+    uint64_t now = current_time_ms();
+    uint64_t next_check = _next_check_time_ms.load();
+    uint64_t wait_ms = (next_check >= now) ? (next_check - now + 1) : 1;
+
+    _check_cond.wait_for(lock, std::chrono::milliseconds(wait_ms));
+
+    if (!_terminate)
+    {
+      check_for_healthy_app_servers(); // LCOV_EXCL_LINE - UTs drive checks directly
+    }
   }
 }
 
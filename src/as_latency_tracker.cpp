@@ -0,0 +1,268 @@
+/**
+ * @file as_latency_tracker.cpp Tracking of Application Server response
+ * times, for adaptive AS timeouts and circuit breaking.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <time.h>
+#include <algorithm>
+#include <unordered_map>
+
+#include "as_latency_tracker.h"
+#include "log.h"
+
+std::atomic<uint64_t> AsLatencyTracker::_next_id(0);
+
+AsLatencyTracker::AsState::AsState() :
+  responses(0),
+  p99_ms(0),
+  consecutive_failures(0),
+  open_until_ms(0),
+  trial_start_ms(0)
+{
+  for (int ii = 0; ii < NUM_BUCKETS; ++ii)
+  {
+    buckets[ii] = 0;
+  }
+}
+
+AsLatencyTracker::AsLatencyTracker(int timeout_factor,
+                                   int breaker_threshold,
+                                   int breaker_open_ms) :
+  _timeout_factor(timeout_factor),
+  _breaker_threshold(breaker_threshold),
+  _breaker_open_ms(breaker_open_ms),
+  _lock(),
+  _as_states(),
+  _id(_next_id++)
+{
+}
+
+AsLatencyTracker::~AsLatencyTracker()
+{
+  for (std::pair<const std::string, AsState*>& as : _as_states)
+  {
+    delete as.second;
+  }
+}
+
+void AsLatencyTracker::on_success(const std::string& as_uri,
+                                  uint64_t latency_ms)
+{
+  AsState* as_state = get_as_state(as_uri);
+
+  as_state->consecutive_failures = 0;
+
+  if (as_state->open_until_ms.exchange(0) != 0)
+  {
+    TRC_STATUS("AS %s is responding again - closing its circuit breaker",
+               as_uri.c_str());
+    as_state->trial_start_ms = 0;
+  }
+
+  as_state->buckets[bucket_index(latency_ms)]++;
+
+  if (++as_state->responses % RECALC_INTERVAL == 0)
+  {
+    recalculate(as_state);
+  }
+}
+
+void AsLatencyTracker::on_failure(const std::string& as_uri)
+{
+  if (_breaker_threshold == 0)
+  {
+    return;
+  }
+
+  AsState* as_state = get_as_state(as_uri);
+  int failures = ++as_state->consecutive_failures;
+
+  if ((as_state->open_until_ms != 0) || (failures == _breaker_threshold))
+  {
+    // Either the AS has failed too many times in a row, or the breaker was
+    // already open (so this is the trial request, or a request sent before
+    // the breaker opened) - (re)open the breaker.
+    if (as_state->open_until_ms.exchange(current_time_ms() + _breaker_open_ms) == 0)
+    {
+      TRC_WARNING("AS %s has failed %d times in a row - opening its circuit breaker",
+                  as_uri.c_str(), failures);
+    }
+
+    as_state->trial_start_ms = 0;
+  }
+}
+
+bool AsLatencyTracker::allow_request(const std::string& as_uri)
+{
+  if (_breaker_threshold == 0)
+  {
+    return true;
+  }
+
+  AsState* as_state = get_as_state(as_uri);
+  uint64_t open_until_ms = as_state->open_until_ms;
+
+  if (open_until_ms == 0)
+  {
+    // The breaker is closed.
+    return true;
+  }
+
+  uint64_t now = current_time_ms();
+
+  if (now < open_until_ms)
+  {
+    // The breaker is open.
+    return false;
+  }
+
+  // The breaker is half open, so let a single trial request through.  If
+  // the trial never completes (for example because the transaction was
+  // cancelled) allow another once the open period has passed again.
+  uint64_t trial_start_ms = as_state->trial_start_ms;
+
+  if (((trial_start_ms == 0) ||
+       (now >= trial_start_ms + _breaker_open_ms)) &&
+      (as_state->trial_start_ms.compare_exchange_strong(trial_start_ms, now)))
+  {
+    TRC_DEBUG("Sending trial request to AS %s", as_uri.c_str());
+    return true;
+  }
+
+  return false;
+}
+
+int AsLatencyTracker::timeout_ms(const std::string& as_uri,
+                                 int configured_timeout_ms)
+{
+  if (_timeout_factor == 0)
+  {
+    return configured_timeout_ms;
+  }
+
+  uint64_t p99_ms = get_as_state(as_uri)->p99_ms;
+
+  if (p99_ms == 0)
+  {
+    // Not enough responses seen yet.
+    return configured_timeout_ms;
+  }
+
+  uint64_t timeout = std::max(p99_ms * _timeout_factor,
+                              (uint64_t)MIN_ADAPTIVE_TIMEOUT_MS);
+  return (int)std::min(timeout, (uint64_t)configured_timeout_ms);
+}
+
+AsLatencyTracker::AsState* AsLatencyTracker::get_as_state(const std::string& as_uri)
+{
+  // Each thread caches the states it has looked up, for each tracker.
+  static thread_local std::unordered_map<uint64_t,
+                                         std::unordered_map<std::string, AsState*>>
+    thread_cache;
+
+  std::unordered_map<std::string, AsState*>& cache = thread_cache[_id];
+  std::unordered_map<std::string, AsState*>::iterator cached = cache.find(as_uri);
+
+  if (cached != cache.end())
+  {
+    return cached->second;
+  }
+
+  AsState* as_state;
+  {
+    std::unique_lock<std::mutex> lock(_lock);
+    AsState*& entry = _as_states[as_uri];
+
+    if (entry == NULL)
+    {
+      entry = new AsState();
+    }
+
+    as_state = entry;
+  }
+
+  cache[as_uri] = as_state;
+  return as_state;
+}
+
+void AsLatencyTracker::recalculate(AsState* as_state)
+{
+  // If another thread is already recalculating there's no need to do it
+  // again.
+  std::unique_lock<std::mutex> lock(as_state->recalc_lock, std::try_to_lock);
+  if (!lock.owns_lock())
+  {
+    return; // LCOV_EXCL_LINE
+  }
+
+  uint32_t counts[NUM_BUCKETS];
+  uint64_t total = 0;
+
+  for (int ii = 0; ii < NUM_BUCKETS; ++ii)
+  {
+    counts[ii] = as_state->buckets[ii];
+    total += counts[ii];
+
+    // Halve the counts, so that older responses carry less weight in the
+    // next calculation.
+    as_state->buckets[ii] -= counts[ii] / 2;
+  }
+
+  uint64_t target = (total * 99 + 99) / 100;
+  uint64_t cumulative = 0;
+
+  for (int ii = 0; ii < NUM_BUCKETS; ++ii)
+  {
+    cumulative += counts[ii];
+
+    if (cumulative >= target)
+    {
+      as_state->p99_ms = bucket_upper_bound_ms(ii);
+      break;
+    }
+  }
+}
+
+int AsLatencyTracker::bucket_index(uint64_t latency_ms)
+{
+  if (latency_ms < SUB_BUCKETS)
+  {
+    return latency_ms;
+  }
+
+  // Work out which doubling the response time is in, and then which of the
+  // sub-buckets within it.
+  int octave = 63 - __builtin_clzll(latency_ms);
+  int shift = octave - 3;
+  int bucket = SUB_BUCKETS + shift * SUB_BUCKETS +
+               ((latency_ms >> shift) & (SUB_BUCKETS - 1));
+
+  return std::min(bucket, NUM_BUCKETS - 1);
+}
+
+uint64_t AsLatencyTracker::bucket_upper_bound_ms(int bucket)
+{
+  if (bucket < SUB_BUCKETS)
+  {
+    return bucket + 1;
+  }
+
+  int shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+  int sub_bucket = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+
+  return (uint64_t)(SUB_BUCKETS + sub_bucket + 1) << shift;
+}
+
+uint64_t AsLatencyTracker::current_time_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000 + (ts.tv_nsec / 1000000);
+}
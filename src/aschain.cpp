@@ -9,6 +9,9 @@
  * Metaswitch Networks in a separate written agreement.
  */
 
+#include <string.h>
+#include <stdlib.h>
+#include <new>
 #include <boost/lexical_cast.hpp>
 
 #include "log.h"
@@ -18,6 +21,8 @@
 #include "aschain.h"
 #include "ifchandler.h"
 #include "sproutsasevent.h"
+#include "fast_random.h"
+#include "memory_accounting.h"
 
 /// Create an AsChain.
 //
@@ -288,13 +293,16 @@ void AsChainLink::get_next_application_server(pjsip_msg* msg,
                           _as_chain->_fallback_ifcs;
   got_dummy_as = false;
 
+  // Share one header index between all the iFCs tested.
+  HeaderIndex hdrs(msg);
+
   while (!complete())
   {
     const Ifc& ifc = ifcs[_index];
     if (ifc.filter_matches(_as_chain->session_case(),
                            _as_chain->_is_registered,
                            false,
-                           msg,
+                           hdrs,
                            trail()))
     {
       TRC_DEBUG("Matched iFC %s", to_string().c_str());
@@ -349,15 +357,63 @@ void AsChainLink::on_response(int status_code)
 }
 
 
+// Characters used to identify the shard in the first character of an ODI
+// token. These are the same characters that FastRandom::create_token uses for
+// the rest of the token.
+static const char SHARD_CHARS[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Estimated memory used by each entry in the ODI token table - the key and
+// value, plus the hash table node's next pointer and cached hash.  Tokens are
+// short enough to be stored inline in the std::string.
+static const size_t ODI_TOKEN_ENTRY_BYTES =
+  sizeof(std::pair<const std::string, AsChainLink>) + 2 * sizeof(void*);
+
 AsChainTable::AsChainTable()
 {
-  pthread_mutex_init(&_lock, NULL);
 }
 
 
 AsChainTable::~AsChainTable()
 {
-  pthread_mutex_destroy(&_lock);
+}
+
+
+void* AsChainTable::operator new(size_t size)
+{
+  void* ptr = NULL;
+
+  if (posix_memalign(&ptr, alignof(AsChainTable), size) != 0)
+  {
+    throw std::bad_alloc(); // LCOV_EXCL_LINE
+  }
+
+  return ptr;
+}
+
+
+void AsChainTable::operator delete(void* ptr)
+{
+  free(ptr);
+}
+
+
+AsChainTable::Shard* AsChainTable::shard_for_token(const std::string& token)
+{
+  if (token.length() != (size_t)TOKEN_LENGTH)
+  {
+    return NULL;
+  }
+
+  const char* shard_char = strchr(SHARD_CHARS, token[0]);
+  if ((token[0] == '\0') ||
+      (shard_char == NULL) ||
+      (shard_char - SHARD_CHARS >= NUM_SHARDS))
+  {
+    return NULL;
+  }
+
+  return &_shards[shard_char - SHARD_CHARS];
 }
 
 
@@ -366,32 +422,70 @@ AsChainTable::~AsChainTable()
 void AsChainTable::register_(AsChain* as_chain, std::vector<std::string>& tokens)
 {
   size_t len = as_chain->size() + 1;
-  pthread_mutex_lock(&_lock);
 
+  // Pick a shard for the chain at random, so that load is spread evenly.
+  int shard_ix = FastRandom::uniform(NUM_SHARDS);
+  Shard& shard = _shards[shard_ix];
+
+  // Generate the tokens before taking the lock.
+  size_t first_token = tokens.size();
   for (size_t i = 0; i < len; i++)
   {
     std::string token;
-    Utils::create_random_token(TOKEN_LENGTH, token);
+    FastRandom::create_token(TOKEN_LENGTH, token);
+    token[0] = SHARD_CHARS[shard_ix];
     tokens.push_back(token);
-    _odi_token_map[token] = AsChainLink(as_chain, i);
   }
 
-  pthread_mutex_unlock(&_lock);
+  shard.lock.lock();
+
+  for (size_t i = 0; i < len; i++)
+  {
+    shard.odi_token_map[tokens[first_token + i]] = AsChainLink(as_chain, i);
+  }
+
+  shard.lock.unlock();
+
+  MemoryAccounting::odi_tokens.allocated(len * ODI_TOKEN_ENTRY_BYTES);
 }
 
 
 void AsChainTable::unregister(std::vector<std::string>& tokens)
 {
-  pthread_mutex_lock(&_lock);
+  // The tokens for a chain are normally all in the same shard, so only
+  // switch locks when the shard changes.
+  Shard* locked_shard = NULL;
+  size_t erased = 0;
 
   for (std::vector<std::string>::iterator it = tokens.begin();
        it != tokens.end();
        ++it)
   {
-    _odi_token_map.erase(*it);
+    Shard* shard = shard_for_token(*it);
+    if (shard == NULL)
+    {
+      continue;  // LCOV_EXCL_LINE - we only register well-formed tokens.
+    }
+
+    if (shard != locked_shard)
+    {
+      if (locked_shard != NULL)
+      {
+        locked_shard->lock.unlock();
+      }
+      shard->lock.lock();
+      locked_shard = shard;
+    }
+
+    erased += shard->odi_token_map.erase(*it);
   }
 
-  pthread_mutex_unlock(&_lock);
+  if (locked_shard != NULL)
+  {
+    locked_shard->lock.unlock();
+  }
+
+  MemoryAccounting::odi_tokens.freed(erased * ODI_TOKEN_ENTRY_BYTES);
 }
 
 
@@ -431,12 +525,20 @@ void AsChain::reset_chain(bool using_standard_ifcs)
 // is finished with the link.
 AsChainLink AsChainTable::lookup(const std::string& token)
 {
-  pthread_mutex_lock(&_lock);
-  std::map<std::string, AsChainLink>::const_iterator it =
-                                                    _odi_token_map.find(token);
-  if (it == _odi_token_map.end())
+  // The token identifies the shard it's in, so this is a single probe of one
+  // shard.
+  Shard* shard = shard_for_token(token);
+  if (shard == NULL)
+  {
+    return AsChainLink(NULL, 0);
+  }
+
+  shard->lock.lock();
+  std::unordered_map<std::string, AsChainLink>::const_iterator it =
+                                              shard->odi_token_map.find(token);
+  if (it == shard->odi_token_map.end())
   {
-    pthread_mutex_unlock(&_lock);
+    shard->lock.unlock();
     return AsChainLink(NULL, 0);
   }
   else
@@ -448,13 +550,13 @@ AsChainLink AsChainTable::lookup(const std::string& token)
       // Flag that the AS corresponding to the previous link in the chain has
       // effectively responded.
       as_chain_link._as_chain->_responsive[as_chain_link._index - 1] = true;
-      pthread_mutex_unlock(&_lock);
+      shard->lock.unlock();
       return as_chain_link;
     } else {
       // Failed to increment the count - AS chain must be in the process of
       // being destroyed.  Pretend we didn't find it.
       // LCOV_EXCL_START - Can't hit this window condition in UT.
-      pthread_mutex_unlock(&_lock);
+      shard->lock.unlock();
       return AsChainLink(NULL, 0);
       // LCOV_EXCL_STOP
     }
@@ -16,6 +16,12 @@
 #include <openssl/hmac.h>
 #include "base64.h"
 #include "scscf_utils.h"
+#include "sprout_probes.h"
+
+// The Chronos probes are only fired from this plugin, so their semaphores
+// live here.
+SPROUT_PROBE_DEFINE(chronos_request_start);
+SPROUT_PROBE_DEFINE(chronos_request_finish);
 
 // Configuring PJSIP with a realm of "*" means that all realms are considered.
 const pj_str_t WILDCARD_REALM = pj_str((char*)"*");
@@ -809,11 +815,20 @@ void AuthenticationSproutletTsx::create_challenge(pjsip_digest_credential* crede
                               "\", \"nonce\": \"" + nonce +
                               "\"}";
       TRC_DEBUG("Sending %s to Chronos to set AV timer", chronos_body.c_str());
+      SPROUT_PROBE(chronos_request_start,
+                   trail(),
+                   "POST",
+                   "/authentication-timeout");
       status = _authentication->_chronos->send_post(timer_id,
                                                     30,
                                                     "/authentication-timeout",
                                                     chronos_body,
                                                     trail());
+      SPROUT_PROBE(chronos_request_finish,
+                   trail(),
+                   "POST",
+                   "/authentication-timeout",
+                   status);
       if (status == HTTP_OK)
       {
         TRC_DEBUG("Timer %s successfully stored in Chronos for auth challenge %s",
@@ -854,8 +869,17 @@ void AuthenticationSproutletTsx::create_challenge(pjsip_digest_credential* crede
       if ((_authentication->_chronos) && (auth_challenge->get_timer_id() != ""))
       {
         HTTPCode status;
+        SPROUT_PROBE(chronos_request_start,
+                     trail(),
+                     "DELETE",
+                     auth_challenge->get_timer_id().c_str());
         status = _authentication->_chronos->send_delete(auth_challenge->get_timer_id(),
                                                         trail());
+        SPROUT_PROBE(chronos_request_finish,
+                     trail(),
+                     "DELETE",
+                     auth_challenge->get_timer_id().c_str(),
+                     status);
         if (status == HTTP_OK)
         {
           TRC_DEBUG("Timer deleted for auth_challenge %s", nonce.c_str());
@@ -1069,8 +1093,17 @@ void AuthenticationSproutletTsx::on_rx_initial_request(pjsip_msg* req)
         if ((_authentication->_chronos) && (auth_challenge->get_timer_id() != ""))
         {
           HTTPCode status;
+          SPROUT_PROBE(chronos_request_start,
+                       trail(),
+                       "DELETE",
+                       auth_challenge->get_timer_id().c_str());
           status = _authentication->_chronos->send_delete(auth_challenge->get_timer_id(),
                                                           trail());
+          SPROUT_PROBE(chronos_request_finish,
+                       trail(),
+                       "DELETE",
+                       auth_challenge->get_timer_id().c_str(),
+                       status);
           if (status == HTTP_OK)
           {
             TRC_DEBUG("Timer deleted for auth_challenge %s", auth_challenge->get_nonce().c_str());
@@ -29,6 +29,7 @@ extern "C" {
 #include "constants.h"
 #include "basicproxy.h"
 #include "uri_classifier.h"
+#include "sprout_probes.h"
 
 
 BasicProxy::BasicProxy(pjsip_endpoint* endpt,
@@ -212,6 +213,16 @@ void BasicProxy::on_tsx_state(pjsip_transaction* tsx, pjsip_event* event)
 void BasicProxy::bind_transaction(void* uas_uac_tsx, pjsip_transaction* tsx)
 {
   tsx->mod_data[_mod_tu.id()] = uas_uac_tsx;
+
+  if (SPROUT_PROBE_ENABLED(tsx_create))
+  {
+    ProbeMethod method(&tsx->method);
+    SPROUT_PROBE(tsx_create,
+                 get_trail(tsx),
+                 method.c_str(),
+                 tsx,
+                 (tsx->role == PJSIP_ROLE_UAC));
+  }
 }
 
 
@@ -219,6 +230,16 @@ void BasicProxy::bind_transaction(void* uas_uac_tsx, pjsip_transaction* tsx)
 void BasicProxy::unbind_transaction(pjsip_transaction* tsx)
 {
   tsx->mod_data[_mod_tu.id()] = NULL;
+
+  if (SPROUT_PROBE_ENABLED(tsx_destroy))
+  {
+    ProbeMethod method(&tsx->method);
+    SPROUT_PROBE(tsx_destroy,
+                 get_trail(tsx),
+                 method.c_str(),
+                 tsx,
+                 (tsx->role == PJSIP_ROLE_UAC));
+  }
 }
 
 
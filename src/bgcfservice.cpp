@@ -17,38 +17,84 @@
 #include <stdlib.h>
 
 #include "bgcfservice.h"
+#include "config_image.h"
 #include "log.h"
 #include "sas.h"
 #include "sproutsasevent.h"
 #include "pjutils.h"
 #include "sprout_pd_definitions.h"
 
+const char* BgcfService::IMAGE_DOMAIN = "domain";
+const char* BgcfService::IMAGE_NUMBER = "number";
+
 BgcfService::BgcfService(std::string configuration) :
   _configuration(configuration),
-  _updater(NULL)
+  _updater(NULL),
+  _routes_rw_lock("BgcfService")
 {
   // Create an updater to keep the bgcf routes configured appropriately.
   _updater = new Updater<void, BgcfService>(this, std::mem_fun(&BgcfService::update_routes));
 }
 
 void BgcfService::update_routes()
+{
+  // Use the precompiled image of the configuration if there is an up to date
+  // one, as this is much quicker to load.
+  std::string image_path = ConfigImage::image_path(_configuration);
+  ConfigImage image;
+  ConfigImage::Status image_status = image.open(image_path,
+                                                ConfigImage::BGCF,
+                                                _configuration);
+
+  if (image_status == ConfigImage::OK)
+  {
+    load_image(image);
+    return;
+  }
+  else if (image_status == ConfigImage::STALE)
+  {
+    TRC_WARNING("BGCF configuration image %s is out of date - loading %s instead",
+                image_path.c_str(), _configuration.c_str());
+  }
+  else if (image_status == ConfigImage::INVALID)
+  {
+    TRC_WARNING("BGCF configuration image %s is invalid - loading %s instead",
+                image_path.c_str(), _configuration.c_str());
+  }
+
+  std::map<std::string, std::vector<std::string>> new_domain_routes;
+  std::map<std::string, std::vector<std::string>> new_number_routes;
+
+  if (read_configuration(_configuration, new_domain_routes, new_number_routes))
+  {
+    // Take a write lock on the mutex in RAII style
+    boost::lock_guard<InstrumentedSharedMutex> write_lock(_routes_rw_lock);
+    _domain_routes.swap(new_domain_routes);
+    _number_routes.swap(new_number_routes);
+  }
+}
+
+bool BgcfService::read_configuration(
+                const std::string& configuration,
+                std::map<std::string, std::vector<std::string>>& domain_routes,
+                std::map<std::string, std::vector<std::string>>& number_routes)
 {
   // Check whether the file exists.
   struct stat s;
-  TRC_DEBUG("stat(%s) returns %d", _configuration.c_str(), stat(_configuration.c_str(), &s));
-  if ((stat(_configuration.c_str(), &s) != 0) &&
+  TRC_DEBUG("stat(%s) returns %d", configuration.c_str(), stat(configuration.c_str(), &s));
+  if ((stat(configuration.c_str(), &s) != 0) &&
       (errno == ENOENT))
   {
     TRC_STATUS("No BGCF configuration (file %s does not exist)",
-               _configuration.c_str());
+               configuration.c_str());
     CL_SPROUT_BGCF_FILE_MISSING.log();
-    return;
+    return false;
   }
 
-  TRC_STATUS("Loading BGCF configuration from %s", _configuration.c_str());
+  TRC_STATUS("Loading BGCF configuration from %s", configuration.c_str());
 
   // Read from the file
-  std::ifstream fs(_configuration.c_str());
+  std::ifstream fs(configuration.c_str());
   std::string bgcf_str((std::istreambuf_iterator<char>(fs)),
                         std::istreambuf_iterator<char>());
 
@@ -56,9 +102,9 @@ void BgcfService::update_routes()
   {
     // LCOV_EXCL_START
     TRC_ERROR("Failed to read BGCF configuration data from %s",
-              _configuration.c_str());
+              configuration.c_str());
     CL_SPROUT_BGCF_FILE_EMPTY.log();
-    return;
+    return false;
     // LCOV_EXCL_STOP
   }
 
@@ -72,14 +118,11 @@ void BgcfService::update_routes()
               bgcf_str.c_str(),
               rapidjson::GetParseError_En(doc.GetParseError()));
     CL_SPROUT_BGCF_FILE_INVALID.log();
-    return;
+    return false;
   }
 
   try
   {
-    std::map<std::string, std::vector<std::string>> new_domain_routes;
-    std::map<std::string, std::vector<std::string>> new_number_routes;
-
     JSON_ASSERT_CONTAINS(doc, "routes");
     JSON_ASSERT_ARRAY(doc["routes"]);
     const rapidjson::Value& routes_arr = doc["routes"];
@@ -116,12 +159,12 @@ void BgcfService::update_routes()
         if ((*routes_it).HasMember("domain"))
         {
           routing_value = (*routes_it)["domain"].GetString();
-          new_domain_routes.insert(std::make_pair(routing_value, route_vec));
+          domain_routes.insert(std::make_pair(routing_value, route_vec));
         }
         else
         {
           routing_value = (*routes_it)["number"].GetString();
-          new_number_routes.insert(
+          number_routes.insert(
                     std::make_pair(Utils::remove_visual_separators(routing_value),
                                    route_vec));
         }
@@ -136,17 +179,91 @@ void BgcfService::update_routes()
         CL_SPROUT_BGCF_FILE_INVALID.log();
       }
     }
-
-    // Take a write lock on the mutex in RAII style
-    boost::lock_guard<boost::shared_mutex> write_lock(_routes_rw_lock);
-    _domain_routes = new_domain_routes;
-    _number_routes = new_number_routes;
   }
   catch (JsonFormatError err)
   {
     TRC_ERROR("Badly formed BGCF configuration file - missing routes object");
     CL_SPROUT_BGCF_FILE_INVALID.log();
+    return false;
+  }
+
+  return true;
+}
+
+void BgcfService::load_image(const ConfigImage& image)
+{
+  TRC_STATUS("Loading BGCF configuration from image of %s (%zu entries)",
+             _configuration.c_str(), image.num_records());
+
+  std::map<std::string, std::vector<std::string>> new_domain_routes;
+  std::map<std::string, std::vector<std::string>> new_number_routes;
+
+  for (size_t ii = 0; ii < image.num_records(); ++ii)
+  {
+    // Each record is the type of entry (domain or number), the domain or
+    // number (with visual separators already removed), and then the routes.
+    size_t num_fields = image.num_fields(ii);
+    PJStringView type = image.field(ii, 0);
+    std::map<std::string, std::vector<std::string>>* routes =
+      (type == IMAGE_DOMAIN) ? &new_domain_routes :
+      (type == IMAGE_NUMBER) ? &new_number_routes : NULL;
+
+    if ((num_fields < 2) || (routes == NULL))
+    {
+      TRC_WARNING("Badly formed record %zu in BGCF configuration image", ii);
+      continue;
+    }
+
+    std::vector<std::string> route_vec;
+    route_vec.reserve(num_fields - 2);
+
+    for (size_t jj = 2; jj < num_fields; ++jj)
+    {
+      route_vec.push_back(image.field(ii, jj).str());
+    }
+
+    routes->insert(std::make_pair(image.field(ii, 1).str(), route_vec));
+  }
+
+  // Take a write lock on the mutex in RAII style
+  boost::lock_guard<InstrumentedSharedMutex> write_lock(_routes_rw_lock);
+  _domain_routes.swap(new_domain_routes);
+  _number_routes.swap(new_number_routes);
+}
+
+bool BgcfService::compile_image(const std::string& configuration,
+                                const std::string& image_path)
+{
+  std::map<std::string, std::vector<std::string>> domain_routes;
+  std::map<std::string, std::vector<std::string>> number_routes;
+
+  if (!read_configuration(configuration, domain_routes, number_routes))
+  {
+    return false;
   }
+
+  ConfigImageWriter image(ConfigImage::BGCF);
+
+  for (int ii = 0; ii < 2; ++ii)
+  {
+    const char* type = (ii == 0) ? IMAGE_DOMAIN : IMAGE_NUMBER;
+    const std::map<std::string, std::vector<std::string>>& routes =
+                                      (ii == 0) ? domain_routes : number_routes;
+
+    for (const std::pair<const std::string, std::vector<std::string>>& entry : routes)
+    {
+      std::vector<std::string> fields;
+      fields.reserve(entry.second.size() + 2);
+      fields.push_back(type);
+      fields.push_back(entry.first);
+      fields.insert(fields.end(), entry.second.begin(), entry.second.end());
+      image.add_record(fields);
+    }
+  }
+
+  TRC_STATUS("Writing %zu BGCF routes to %s",
+             image.num_records(), image_path.c_str());
+  return image.write(image_path, configuration);
 }
 
 BgcfService::~BgcfService()
@@ -163,7 +280,7 @@ std::vector<std::string> BgcfService::get_route_from_domain(
   TRC_DEBUG("Getting route for URI domain %s via BGCF lookup", domain.c_str());
 
   // Take a read lock on the mutex in RAII style
-  boost::shared_lock<boost::shared_mutex> read_lock(_routes_rw_lock);
+  boost::shared_lock<InstrumentedSharedMutex> read_lock(_routes_rw_lock);
 
   // First try the specified domain.
   std::map<std::string, std::vector<std::string>>::const_iterator i =
@@ -220,7 +337,7 @@ std::vector<std::string> BgcfService::get_route_from_number(
                                                 SAS::TrailId trail) const
 {
   // Take a read lock on the mutex in RAII style
-  boost::shared_lock<boost::shared_mutex> read_lock(_routes_rw_lock);
+  boost::shared_lock<InstrumentedSharedMutex> read_lock(_routes_rw_lock);
 
   // The number routes map is ordered by length of key. Start from the end of
   // the map to get the longest prefixes first.
@@ -2631,11 +2631,14 @@ void set_target_on_tdata(const struct Target& target, pjsip_tx_data* tdata)
     {
       pj_list_erase(hdr);
     }
-    std::string name_addr_str("<" + PJUtils::public_id_from_uri(tdata->msg->line.req.uri) + ">");
+    pj_str_t public_id = PJUtils::public_id_from_uri(tdata->msg->line.req.uri,
+                                                     tdata->pool);
     pj_str_t called_party_id;
-    pj_strdup2(tdata->pool,
-               &called_party_id,
-               name_addr_str.c_str());
+    called_party_id.ptr = (char*)pj_pool_alloc(tdata->pool, public_id.slen + 2);
+    called_party_id.ptr[0] = '<';
+    memcpy(called_party_id.ptr + 1, public_id.ptr, public_id.slen);
+    called_party_id.ptr[public_id.slen + 1] = '>';
+    called_party_id.slen = public_id.slen + 2;
     hdr = (pjsip_hdr*)pjsip_generic_string_hdr_create(tdata->pool,
                                                       &called_party_id_hdr_name,
                                                       &called_party_id);
@@ -0,0 +1,270 @@
+/**
+ * @file config_image.cpp Precompiled binary images of configuration files.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config_image.h"
+
+const char ConfigImage::MAGIC[8] = {'S', 'P', 'R', 'T', 'C', 'F', 'G', '\0'};
+
+ConfigImage::ConfigImage() :
+  _image(NULL),
+  _image_size(0),
+  _num_records(0),
+  _records(NULL),
+  _fields(NULL),
+  _strings(NULL)
+{
+}
+
+ConfigImage::~ConfigImage()
+{
+  close();
+}
+
+std::string ConfigImage::image_path(const std::string& source_path)
+{
+  return source_path + ".img";
+}
+
+ConfigImage::Status ConfigImage::open(const std::string& path,
+                                      Type type,
+                                      const std::string& source_path)
+{
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return (errno == ENOENT) ? NOT_FOUND : INVALID;
+  }
+
+  struct stat image_stat;
+  if ((fstat(fd, &image_stat) != 0) ||
+      ((size_t)image_stat.st_size < sizeof(Header)))
+  {
+    ::close(fd);
+    return INVALID;
+  }
+
+  // Map the image read-only.  The mapping stays valid after the file is
+  // closed, and if a new image is renamed over this one the mapping keeps
+  // referring to the old contents.
+  void* image = mmap(NULL, image_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (image == MAP_FAILED)
+  {
+    return INVALID; // LCOV_EXCL_LINE
+  }
+
+  const Header* header = (const Header*)image;
+
+  if ((memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) ||
+      (header->version != FORMAT_VERSION) ||
+      (header->type != (uint32_t)type) ||
+      (!check_layout(header, image_stat.st_size)))
+  {
+    munmap(image, image_stat.st_size);
+    return INVALID;
+  }
+
+  // The image is stale if the source has changed since it was compiled.
+  struct stat source_stat;
+  if ((stat(source_path.c_str(), &source_stat) == 0) &&
+      (((int64_t)source_stat.st_mtim.tv_sec != header->source_mtime) ||
+       ((int64_t)source_stat.st_mtim.tv_nsec != header->source_mtime_nsec) ||
+       ((uint64_t)source_stat.st_size != header->source_size)))
+  {
+    munmap(image, image_stat.st_size);
+    return STALE;
+  }
+
+  _image = image;
+  _image_size = image_stat.st_size;
+  _num_records = header->num_records;
+  _records = (const Record*)((const char*)image + header->records_offset);
+  _fields = (const Field*)((const char*)image + header->fields_offset);
+  _strings = (const char*)image + header->strings_offset;
+
+  return OK;
+}
+
+bool ConfigImage::check_layout(const Header* header, size_t image_size)
+{
+  uint64_t records_end = header->records_offset +
+                         (uint64_t)header->num_records * sizeof(Record);
+  uint64_t fields_end = header->fields_offset +
+                        (uint64_t)header->num_fields * sizeof(Field);
+  uint64_t strings_end = header->strings_offset + header->strings_length;
+
+  if ((header->records_offset < sizeof(Header)) ||
+      (records_end > image_size) ||
+      (header->fields_offset < sizeof(Header)) ||
+      (fields_end > image_size) ||
+      (header->strings_offset < sizeof(Header)) ||
+      (strings_end > image_size) ||
+      (header->records_offset % sizeof(uint64_t) != 0) ||
+      (header->fields_offset % sizeof(uint64_t) != 0))
+  {
+    return false;
+  }
+
+  // Check every record and field refers to something inside the image, so
+  // that lookups never need to.
+  const Record* records =
+                  (const Record*)((const char*)header + header->records_offset);
+  const Field* fields =
+                  (const Field*)((const char*)header + header->fields_offset);
+
+  for (uint32_t ii = 0; ii < header->num_records; ++ii)
+  {
+    if ((uint64_t)records[ii].first_field + records[ii].num_fields >
+                                                             header->num_fields)
+    {
+      return false;
+    }
+  }
+
+  for (uint32_t ii = 0; ii < header->num_fields; ++ii)
+  {
+    if ((uint64_t)fields[ii].offset + fields[ii].length >
+                                                         header->strings_length)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void ConfigImage::close()
+{
+  if (_image != NULL)
+  {
+    munmap(_image, _image_size);
+    _image = NULL;
+    _image_size = 0;
+    _num_records = 0;
+    _records = NULL;
+    _fields = NULL;
+    _strings = NULL;
+  }
+}
+
+size_t ConfigImage::num_fields(size_t record) const
+{
+  return (record < _num_records) ? _records[record].num_fields : 0;
+}
+
+PJStringView ConfigImage::field(size_t record, size_t field) const
+{
+  if ((record >= _num_records) || (field >= _records[record].num_fields))
+  {
+    return PJStringView();
+  }
+
+  const Field& f = _fields[_records[record].first_field + field];
+  return PJStringView(_strings + f.offset, f.length);
+}
+
+ConfigImageWriter::ConfigImageWriter(ConfigImage::Type type) :
+  _type(type),
+  _records(),
+  _fields(),
+  _strings()
+{
+}
+
+void ConfigImageWriter::add_record(const std::vector<std::string>& fields)
+{
+  ConfigImage::Record record;
+  record.first_field = _fields.size();
+  record.num_fields = fields.size();
+  _records.push_back(record);
+
+  for (const std::string& value : fields)
+  {
+    ConfigImage::Field field;
+    field.offset = _strings.size();
+    field.length = value.size();
+    _fields.push_back(field);
+    _strings.append(value);
+  }
+}
+
+bool ConfigImageWriter::write(const std::string& path,
+                              const std::string& source_path)
+{
+  ConfigImage::Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ConfigImage::MAGIC, sizeof(header.magic));
+  header.version = ConfigImage::FORMAT_VERSION;
+  header.type = _type;
+
+  struct stat source_stat;
+  if (stat(source_path.c_str(), &source_stat) != 0)
+  {
+    return false;
+  }
+  header.source_mtime = source_stat.st_mtim.tv_sec;
+  header.source_mtime_nsec = source_stat.st_mtim.tv_nsec;
+  header.source_size = source_stat.st_size;
+
+  // Both tables are made up of 8-byte entries, so laying them out straight
+  // after the header keeps them aligned.
+  header.num_records = _records.size();
+  header.num_fields = _fields.size();
+  header.records_offset = sizeof(header);
+  header.fields_offset = header.records_offset +
+                         _records.size() * sizeof(ConfigImage::Record);
+  header.strings_offset = header.fields_offset +
+                          _fields.size() * sizeof(ConfigImage::Field);
+  header.strings_length = _strings.size();
+
+  std::string tmp_path = path + ".tmp";
+  FILE* f = fopen(tmp_path.c_str(), "wb");
+  if (f == NULL)
+  {
+    return false;
+  }
+
+  bool ok =
+    (fwrite(&header, sizeof(header), 1, f) == 1) &&
+    (_records.empty() ||
+     (fwrite(_records.data(), sizeof(ConfigImage::Record), _records.size(), f) ==
+                                                             _records.size())) &&
+    (_fields.empty() ||
+     (fwrite(_fields.data(), sizeof(ConfigImage::Field), _fields.size(), f) ==
+                                                              _fields.size())) &&
+    (_strings.empty() ||
+     (fwrite(_strings.data(), 1, _strings.size(), f) == _strings.size()));
+
+  ok = (fclose(f) == 0) && ok;
+
+  if (ok)
+  {
+    ok = (rename(tmp_path.c_str(), path.c_str()) == 0);
+  }
+
+  if (!ok)
+  {
+    unlink(tmp_path.c_str());
+  }
+
+  return ok;
+}
@@ -20,16 +20,11 @@
 ConnectionTracker::ConnectionTracker(
                               ConnectionsQuiescedInterface *on_quiesced_handler)
 :
+  _lock("ConnectionTracker", true),
   _connection_listeners(),
   _quiescing(PJ_FALSE),
   _on_quiesced_handler(on_quiesced_handler)
 {
-  // Lock has always been MUTEX_RECURSIVE
-  pthread_mutexattr_t attrs;
-  pthread_mutexattr_init(&attrs);
-  pthread_mutexattr_settype(&attrs, PTHREAD_MUTEX_RECURSIVE);
-  pthread_mutex_init(&_lock, &attrs);
-  pthread_mutexattr_destroy(&attrs);
 }
 
 
@@ -45,7 +40,6 @@ ConnectionTracker::~ConnectionTracker()
                                           it->second,
                                           (void *)this);
   }
-  pthread_mutex_destroy(&_lock);
 }
 
 
@@ -66,7 +60,7 @@ void ConnectionTracker::connection_state_update(pjsip_transport *tp,
   {
     TRC_DEBUG("Connection %p has been destroyed", tp);
 
-    pthread_mutex_lock(&_lock);
+    _lock.lock();
     // We expect to only be called on the PJSIP transport thread, and our data
     // race/locking safety is based on this assumption. Raise an error log if
     // this is not the case.
@@ -90,7 +84,7 @@ void ConnectionTracker::connection_state_update(pjsip_transport *tp,
       }
     }
 
-    pthread_mutex_unlock(&_lock);
+    _lock.unlock();
 
     // If quiescing is now complete notify the quiescing manager.
     // Done without the lock to avoid potential deadlock.
@@ -106,7 +100,7 @@ void ConnectionTracker::connection_active(pjsip_transport *tp)
   // We only track connection-oriented transports.
   if ((tp->flag & PJSIP_TRANSPORT_DATAGRAM) == 0)
   {
-    pthread_mutex_lock(&_lock);
+    _lock.lock();
 
     // We expect to be called by only websocket transport threads, or the PJSIP
     // transport thread. We must NOT be called by the PJSIP worker thread.
@@ -150,7 +144,7 @@ void ConnectionTracker::connection_active(pjsip_transport *tp)
         pjsip_transport_shutdown(tp);
       }
     }
-    pthread_mutex_unlock(&_lock);
+    _lock.unlock();
   }
 }
 
@@ -161,7 +155,7 @@ void ConnectionTracker::quiesce()
 
   TRC_STATUS("Start quiescing connections");
 
-  pthread_mutex_lock(&_lock);
+  _lock.lock();
   // We expect to only be called on the PJSIP transport thread, and our data
   // race/locking safety is based on this assumption. Raise an error log if
   // this is not the case.
@@ -202,7 +196,7 @@ void ConnectionTracker::quiesce()
     }
   }
 
-  pthread_mutex_unlock(&_lock);
+  _lock.unlock();
 
   // If quiescing is now complete notify the quiescing manager.
   // Done without the lock to avoid potential deadlock.
@@ -216,7 +210,7 @@ void ConnectionTracker::unquiesce()
 {
   TRC_DEBUG("Unquiesce connections");
 
-  pthread_mutex_lock(&_lock);
+  _lock.lock();
   // We expect to only be called on the PJSIP transport thread, and our data
   // race/locking safety is based on this assumption. Raise an error log if
   // this is not the case.
@@ -231,5 +225,5 @@ void ConnectionTracker::unquiesce()
   assert(_quiescing);
   _quiescing = PJ_FALSE;
 
-  pthread_mutex_unlock(&_lock);
+  _lock.unlock();
 }
@@ -23,6 +23,7 @@
 
 #include "pjutils.h"
 #include "enumservice.h"
+#include "config_image.h"
 #include "dnsresolver.h"
 #include "utils.h"
 #include "log.h"
@@ -95,7 +96,8 @@ bool EnumService::parse_regex_replace(const std::string& regex_replace, boost::r
 
 JSONEnumService::JSONEnumService(std::string configuration):
   _configuration(configuration),
-  _updater(NULL)
+  _updater(NULL),
+  _number_prefixes_rw_lock("JSONEnumService")
 {
   // create and updater which, by default, runs the function when initialized
   _updater = new Updater<void, JSONEnumService>(this,
@@ -103,22 +105,71 @@ JSONEnumService::JSONEnumService(std::string configuration):
 }
 
 void JSONEnumService::update_enum()
+{
+  // Use the precompiled image of the configuration if there is an up to date
+  // one, as this is much quicker to load.
+  std::string image_path = ConfigImage::image_path(_configuration);
+  ConfigImage image;
+  ConfigImage::Status image_status = image.open(image_path,
+                                                ConfigImage::ENUM,
+                                                _configuration);
+
+  if (image_status == ConfigImage::OK)
+  {
+    load_image(image);
+    return;
+  }
+  else if (image_status == ConfigImage::STALE)
+  {
+    TRC_WARNING("ENUM configuration image %s is out of date - loading %s instead",
+                image_path.c_str(), _configuration.c_str());
+  }
+  else if (image_status == ConfigImage::INVALID)
+  {
+    TRC_WARNING("ENUM configuration image %s is invalid - loading %s instead",
+                image_path.c_str(), _configuration.c_str());
+  }
+
+  std::vector<NumberPrefix> new_number_prefixes;
+
+  if (!read_configuration(_configuration, new_number_prefixes))
+  {
+    return;
+  }
+
+  // Create a map (automatically sorted in order of key length) so we can
+  // later match numbers to the most specific prefixes.
+  std::map<std::string, NumberPrefix> new_prefix_regex_map;
+
+  for (const NumberPrefix& pfix : new_number_prefixes)
+  {
+    new_prefix_regex_map.insert(std::make_pair(pfix.prefix, pfix));
+  }
+
+  // Take a write lock on the mutex in RAII style
+  boost::lock_guard<InstrumentedSharedMutex> write_lock(_number_prefixes_rw_lock);
+  _number_prefixes.swap(new_number_prefixes);
+  _prefix_regex_map.swap(new_prefix_regex_map);
+}
+
+bool JSONEnumService::read_configuration(const std::string& configuration,
+                                         std::vector<NumberPrefix>& number_prefixes)
 {
   // Check whether the file exists.
   struct stat s;
-  if ((stat(_configuration.c_str(), &s) != 0) &&
+  if ((stat(configuration.c_str(), &s) != 0) &&
       (errno == ENOENT))
   {
     TRC_STATUS("No ENUM configuration (file %s does not exist)",
-               _configuration.c_str());
-    CL_SPROUT_ENUM_FILE_MISSING.log(_configuration.c_str());
-    return;
+               configuration.c_str());
+    CL_SPROUT_ENUM_FILE_MISSING.log(configuration.c_str());
+    return false;
   }
 
-  TRC_STATUS("Loading ENUM configuration from %s", _configuration.c_str());
+  TRC_STATUS("Loading ENUM configuration from %s", configuration.c_str());
 
   // Read from the file
-  std::ifstream fs(_configuration.c_str());
+  std::ifstream fs(configuration.c_str());
   std::string enum_str((std::istreambuf_iterator<char>(fs)),
                         std::istreambuf_iterator<char>());
 
@@ -126,9 +177,9 @@ void JSONEnumService::update_enum()
   {
     // LCOV_EXCL_START
     TRC_ERROR("Failed to read ENUM configuration data from %s",
-              _configuration.c_str());
-    CL_SPROUT_ENUM_FILE_EMPTY.log(_configuration.c_str());
-    return;
+              configuration.c_str());
+    CL_SPROUT_ENUM_FILE_EMPTY.log(configuration.c_str());
+    return false;
     // LCOV_EXCL_STOP
   }
 
@@ -141,15 +192,12 @@ void JSONEnumService::update_enum()
     TRC_ERROR("Failed to read ENUM configuration data: %s\nError: %s",
               enum_str.c_str(),
               rapidjson::GetParseError_En(doc.GetParseError()));
-    CL_SPROUT_ENUM_FILE_INVALID.log(_configuration.c_str());
-    return;
+    CL_SPROUT_ENUM_FILE_INVALID.log(configuration.c_str());
+    return false;
   }
 
   try
   {
-    std::vector<NumberPrefix> new_number_prefixes;
-    std::map<std::string, NumberPrefix> new_prefix_regex_map;
-
     JSON_ASSERT_CONTAINS(doc, "number_blocks");
     JSON_ASSERT_ARRAY(doc["number_blocks"]);
     const rapidjson::Value& nb_arr = doc["number_blocks"];
@@ -173,11 +221,8 @@ void JSONEnumService::update_enum()
 
         if (parse_regex_replace(regex, pfix.match, pfix.replace))
         {
-          // Create an array in order of entries in json file, and a map
-          // (automatically sorted in order of key length) so we can later
-          // match numbers to the most specific prefixes
-          new_number_prefixes.push_back(pfix);
-          new_prefix_regex_map.insert(std::make_pair(prefix, pfix));
+          // Keep the entries in the order they appear in the json file.
+          number_prefixes.push_back(pfix);
           TRC_STATUS("  Adding number prefix %s, regex=%s",
                      pfix.prefix.c_str(), regex.c_str());
         }
@@ -192,20 +237,87 @@ void JSONEnumService::update_enum()
         // Badly formed number block.
         TRC_WARNING("Badly formed ENUM number block (hit error at %s:%d)",
                     err._file, err._line);
-        CL_SPROUT_ENUM_FILE_INVALID.log(_configuration.c_str());
+        CL_SPROUT_ENUM_FILE_INVALID.log(configuration.c_str());
       }
     }
-
-    // Take a write lock on the mutex in RAII style
-    boost::lock_guard<boost::shared_mutex> write_lock(_number_prefixes_rw_lock);
-    _number_prefixes = new_number_prefixes;
-    _prefix_regex_map = new_prefix_regex_map;
   }
   catch (JsonFormatError err)
   {
     TRC_ERROR("Badly formed ENUM configuration data - missing number_blocks object");
-    CL_SPROUT_ENUM_FILE_INVALID.log(_configuration.c_str());
+    CL_SPROUT_ENUM_FILE_INVALID.log(configuration.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+void JSONEnumService::load_image(const ConfigImage& image)
+{
+  TRC_STATUS("Loading ENUM configuration from image of %s (%zu entries)",
+             _configuration.c_str(), image.num_records());
+
+  std::vector<NumberPrefix> new_number_prefixes;
+  std::map<std::string, NumberPrefix> new_prefix_regex_map;
+  new_number_prefixes.reserve(image.num_records());
+
+  for (size_t ii = 0; ii < image.num_records(); ++ii)
+  {
+    // Each record is the prefix (with visual separators already removed),
+    // and the match and replace parts of the regular expression.  The
+    // compiler has checked the regular expression is valid.
+    if (image.num_fields(ii) != 3)
+    {
+      TRC_WARNING("Badly formed record %zu in ENUM configuration image", ii);
+      continue;
+    }
+
+    NumberPrefix pfix;
+    pfix.prefix = image.field(ii, 0).str();
+    pfix.replace = image.field(ii, 2).str();
+    PJStringView match = image.field(ii, 1);
+
+    try
+    {
+      pfix.match.assign(match.begin(), match.end(), boost::regex::extended);
+    }
+    catch (...)
+    {
+      TRC_WARNING("Badly formed regular expression in ENUM configuration image %s",
+                  match.str().c_str());
+      continue;
+    }
+
+    TRC_DEBUG("  Adding number prefix %s", pfix.prefix.c_str());
+    new_number_prefixes.push_back(pfix);
+    new_prefix_regex_map.insert(std::make_pair(pfix.prefix, pfix));
+  }
+
+  // Take a write lock on the mutex in RAII style
+  boost::lock_guard<InstrumentedSharedMutex> write_lock(_number_prefixes_rw_lock);
+  _number_prefixes.swap(new_number_prefixes);
+  _prefix_regex_map.swap(new_prefix_regex_map);
+}
+
+bool JSONEnumService::compile_image(const std::string& configuration,
+                                    const std::string& image_path)
+{
+  std::vector<NumberPrefix> number_prefixes;
+
+  if (!read_configuration(configuration, number_prefixes))
+  {
+    return false;
   }
+
+  ConfigImageWriter image(ConfigImage::ENUM);
+
+  for (const NumberPrefix& pfix : number_prefixes)
+  {
+    image.add_record({pfix.prefix, pfix.match.str(), pfix.replace});
+  }
+
+  TRC_STATUS("Writing %zu ENUM entries to %s",
+             image.num_records(), image_path.c_str());
+  return image.write(image_path, configuration);
 }
 
 
@@ -231,7 +343,7 @@ std::string JSONEnumService::lookup_uri_from_user(const std::string &user, SAS::
   std::string aus = user_to_aus(user);
 
   // Take a read lock on the mutex in RAII style
-  boost::shared_lock<boost::shared_mutex> read_lock(_number_prefixes_rw_lock);
+  boost::shared_lock<InstrumentedSharedMutex> read_lock(_number_prefixes_rw_lock);
 
   const struct NumberPrefix* pfix = prefix_match(aus);
 
@@ -0,0 +1,126 @@
+/**
+ * @file expiry_jitter.cpp Desynchronisation of registration and subscription
+ * expiry times.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include "expiry_jitter.h"
+#include "fast_random.h"
+#include "log.h"
+
+ExpiryJitter::ExpiryJitter(int max_expires, int jitter_percent) :
+  _jitter_percent((jitter_percent < 0) ? 0 :
+                  (jitter_percent > 100) ? 100 : jitter_percent),
+  // The current bucket is partially elapsed, so the maximum expiry must fit
+  // in the remaining buckets.
+  _bucket_width((max_expires + NUM_BUCKETS - 2) / (NUM_BUCKETS - 1))
+{
+  if (_bucket_width < 1)
+  {
+    _bucket_width = 1;
+  }
+
+  for (int ii = 0; ii < NUM_BUCKETS; ++ii)
+  {
+    _buckets[ii].epoch = -1;
+    _buckets[ii].count = 0;
+  }
+
+  pthread_mutex_init(&_lock, NULL);
+}
+
+ExpiryJitter::~ExpiryJitter()
+{
+  pthread_mutex_destroy(&_lock);
+}
+
+uint32_t ExpiryJitter::count_at(int time)
+{
+  int64_t epoch = time / _bucket_width;
+  Bucket& bucket = _buckets[epoch % NUM_BUCKETS];
+  return (bucket.epoch == epoch) ? bucket.count : 0;
+}
+
+int ExpiryJitter::grant(int expiry, int now, int old_expires)
+{
+  int granted = choose(expiry, now);
+  record(expiry, granted, now, old_expires);
+  return granted;
+}
+
+int ExpiryJitter::choose(int expiry, int now)
+{
+  if ((expiry < MIN_JITTER_EXPIRY) || (_jitter_percent == 0))
+  {
+    return expiry;
+  }
+
+  // Pick two candidates in the range [expiry - max_jitter, expiry].
+  uint32_t max_jitter = ((int64_t)expiry * _jitter_percent) / 100;
+  int candidate1 = expiry - FastRandom::uniform(max_jitter + 1);
+  int candidate2 = expiry - FastRandom::uniform(max_jitter + 1);
+
+  // Use whichever candidate falls in the emptier bucket.
+  pthread_mutex_lock(&_lock);
+  int granted = (count_at(now + candidate2) < count_at(now + candidate1)) ?
+                candidate2 : candidate1;
+  pthread_mutex_unlock(&_lock);
+
+  TRC_DEBUG("Granting expiry of %d seconds (requested %d)", granted, expiry);
+
+  return granted;
+}
+
+void ExpiryJitter::record(int expiry, int granted, int now, int old_expires)
+{
+  if ((expiry < MIN_JITTER_EXPIRY) || (_jitter_percent == 0))
+  {
+    // The expiry wasn't randomised, so isn't tracked.
+    return;
+  }
+
+  pthread_mutex_lock(&_lock);
+
+  // The refresh replaces the old expiry, so remove it from the histogram.
+  if (old_expires > now)
+  {
+    int64_t old_epoch = old_expires / _bucket_width;
+    Bucket& old_bucket = _buckets[old_epoch % NUM_BUCKETS];
+    if ((old_bucket.epoch == old_epoch) && (old_bucket.count > 0))
+    {
+      old_bucket.count--;
+    }
+  }
+
+  int64_t epoch = (now + granted) / _bucket_width;
+  Bucket& bucket = _buckets[epoch % NUM_BUCKETS];
+  if (bucket.epoch != epoch)
+  {
+    bucket.epoch = epoch;
+    bucket.count = 0;
+  }
+  bucket.count++;
+
+  pthread_mutex_unlock(&_lock);
+}
+
+void ExpiryJitter::get_density(int now, std::vector<uint32_t>& density)
+{
+  density.clear();
+  density.reserve(NUM_BUCKETS);
+
+  pthread_mutex_lock(&_lock);
+
+  for (int ii = 0; ii < NUM_BUCKETS; ++ii)
+  {
+    density.push_back(count_at(now + (ii * _bucket_width)));
+  }
+
+  pthread_mutex_unlock(&_lock);
+}
@@ -0,0 +1,369 @@
+/**
+ * @file fast_clock.cpp Low-overhead clock, based on the CPU timestamp counter.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <algorithm>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define FAST_CLOCK_HAVE_TSC 1
+#endif
+
+#include "fast_clock.h"
+#include "log.h"
+
+namespace FastClock
+{
+
+/// How long to measure the TSC for when first calibrating it.
+static const int CALIBRATION_MS = 10;
+
+/// If the TSC clock falls behind the system clock by more than this, jump
+/// forward rather than slewing.
+static const int64_t MAX_SLEW_NS = 1000000;
+
+/// The current calibration, protected by a sequence lock.  The fields are
+/// atomics so that readers racing with an update are well defined - they
+/// spot the update from the sequence number and retry.
+static std::atomic<uint32_t> cal_seq(0);
+static std::atomic<uint64_t> cal_tsc_base(0);
+static std::atomic<uint64_t> cal_ns_base(0);
+static std::atomic<uint64_t> cal_mult(0);
+static std::atomic<int64_t> cal_realtime_offset_ns(0);
+
+static std::atomic<bool> tsc_enabled(false);
+
+/// Wall clock time in seconds, updated by the re-sync thread at each second
+/// boundary so that coarse_time() is just a load.
+static std::atomic<time_t> cached_seconds(0);
+
+static std::mutex sync_lock;
+static std::condition_variable sync_cond;
+static bool sync_terminate = false;
+
+// Allocated rather than static, so that exiting without calling stop() doesn't
+// destroy a running thread.
+static std::thread* sync_thread = NULL;
+
+static uint64_t timespec_to_ns(const struct timespec& ts)
+{
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t system_monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return timespec_to_ns(ts);
+}
+
+#ifdef FAST_CLOCK_HAVE_TSC
+static inline uint64_t read_tsc()
+{
+  return __rdtsc();
+}
+
+static bool have_invariant_tsc()
+{
+  unsigned int eax, ebx, ecx, edx;
+
+  if ((!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx)) ||
+      (eax < 0x80000007))
+  {
+    return false; // LCOV_EXCL_LINE
+  }
+
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  return (edx & (1 << 8)) != 0;
+}
+#else
+static inline uint64_t read_tsc()
+{
+  return 0;
+}
+
+static bool have_invariant_tsc()
+{
+  return false;
+}
+#endif
+
+/// Samples the TSC and the system clocks at (as near as possible) the same
+/// instant.
+static void sample(uint64_t& tsc, uint64_t& mono_ns, uint64_t& real_ns)
+{
+  struct timespec mono;
+  struct timespec real;
+
+  uint64_t tsc_before = read_tsc();
+  clock_gettime(CLOCK_MONOTONIC, &mono);
+  clock_gettime(CLOCK_REALTIME, &real);
+  uint64_t tsc_after = read_tsc();
+
+  tsc = tsc_before + (tsc_after - tsc_before) / 2;
+  mono_ns = timespec_to_ns(mono);
+  real_ns = timespec_to_ns(real);
+}
+
+/// Returns the multiplier (nanoseconds per tick, as 32.32 fixed point) for
+/// the given interval.
+static uint64_t calc_mult(uint64_t ns, uint64_t ticks)
+{
+  return (uint64_t)(((unsigned __int128)ns << 32) / ticks);
+}
+
+static uint64_t tsc_to_ns(uint64_t tsc,
+                          uint64_t tsc_base,
+                          uint64_t ns_base,
+                          uint64_t mult)
+{
+  if (tsc < tsc_base)
+  {
+    // This core's TSC is slightly behind the one the base was read on.  Don't
+    // let the subtraction wrap.
+    return ns_base;
+  }
+
+  return ns_base + (uint64_t)(((unsigned __int128)(tsc - tsc_base) * mult) >> 32);
+}
+
+static void publish(uint64_t tsc_base,
+                    uint64_t ns_base,
+                    uint64_t mult,
+                    int64_t realtime_offset_ns)
+{
+  // There is only ever one writer, so a plain increment to an odd number
+  // marks the update as in progress.
+  cal_seq.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  cal_tsc_base.store(tsc_base, std::memory_order_relaxed);
+  cal_ns_base.store(ns_base, std::memory_order_relaxed);
+  cal_mult.store(mult, std::memory_order_relaxed);
+  cal_realtime_offset_ns.store(realtime_offset_ns, std::memory_order_relaxed);
+
+  cal_seq.fetch_add(1, std::memory_order_release);
+}
+
+/// Reads the TSC clock, and the offset from it to the wall clock.
+static uint64_t read_tsc_clock(int64_t* realtime_offset_ns)
+{
+  uint32_t seq;
+  uint64_t ns;
+
+  do
+  {
+    seq = cal_seq.load(std::memory_order_acquire);
+    uint64_t tsc_base = cal_tsc_base.load(std::memory_order_relaxed);
+    uint64_t ns_base = cal_ns_base.load(std::memory_order_relaxed);
+    uint64_t mult = cal_mult.load(std::memory_order_relaxed);
+
+    if (realtime_offset_ns != NULL)
+    {
+      *realtime_offset_ns = cal_realtime_offset_ns.load(std::memory_order_relaxed);
+    }
+
+    ns = tsc_to_ns(read_tsc(), tsc_base, ns_base, mult);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  while ((seq & 1) || (seq != cal_seq.load(std::memory_order_relaxed)));
+
+  return ns;
+}
+
+static void run_sync(int sync_interval_ms)
+{
+  uint64_t interval_ns = (uint64_t)sync_interval_ms * 1000000;
+  uint64_t last_tsc;
+  uint64_t last_mono_ns;
+  uint64_t real_ns;
+  sample(last_tsc, last_mono_ns, real_ns);
+
+  std::chrono::steady_clock::time_point next_sync =
+    std::chrono::steady_clock::now() + std::chrono::milliseconds(sync_interval_ms);
+
+  std::unique_lock<std::mutex> lock(sync_lock);
+
+  while (!sync_terminate)
+  {
+    // Wake at the next second boundary to update the cached seconds, or at
+    // the next re-sync if that's sooner.
+    struct timespec real;
+    clock_gettime(CLOCK_REALTIME, &real);
+    std::chrono::steady_clock::time_point next_second =
+      std::chrono::steady_clock::now() +
+      std::chrono::nanoseconds(1000000000 - real.tv_nsec);
+    sync_cond.wait_until(lock, std::min(next_sync, next_second));
+
+    if (sync_terminate)
+    {
+      break;
+    }
+
+    cached_seconds.store(time(NULL), std::memory_order_relaxed);
+
+    if (std::chrono::steady_clock::now() < next_sync)
+    {
+      continue;
+    }
+
+    next_sync = std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(sync_interval_ms);
+
+    uint64_t tsc;
+    uint64_t mono_ns;
+    sample(tsc, mono_ns, real_ns);
+
+    if (tsc <= last_tsc)
+    {
+      // LCOV_EXCL_START - the TSC should never go backwards
+      TRC_WARNING("TSC went backwards - reverting to the system clock");
+      tsc_enabled = false;
+      break;
+      // LCOV_EXCL_STOP
+    }
+
+    // Work out the tick rate over the last interval, and where the TSC
+    // clock has got to.
+    uint64_t rate = calc_mult(mono_ns - last_mono_ns, tsc - last_tsc);
+    uint64_t est_ns = read_tsc_clock(NULL);
+    int64_t error_ns = (int64_t)(mono_ns - est_ns);
+
+    uint64_t ns_base = est_ns;
+    uint64_t mult = rate;
+
+    if (error_ns > MAX_SLEW_NS)
+    {
+      // The TSC clock is well behind (for example because this thread was
+      // descheduled for a long time), so jump forwards.
+      ns_base = mono_ns;
+    }
+    else
+    {
+      // Slew the clock so that it catches up with (or waits for) the system
+      // clock over the next interval.  Never let the rate drop too far, so
+      // the clock keeps moving forwards.
+      int64_t slewed_ns = std::max((int64_t)interval_ns + error_ns,
+                                   (int64_t)interval_ns / 2);
+      mult = (uint64_t)(((unsigned __int128)rate * slewed_ns) / interval_ns);
+    }
+
+    // Take the TSC reading for the new base after working out the estimate,
+    // so that the new calibration starts at or after any time already
+    // returned.
+    uint64_t base_tsc = read_tsc();
+    ns_base = std::max(ns_base, read_tsc_clock(NULL));
+    publish(base_tsc, ns_base, mult, (int64_t)(real_ns - mono_ns));
+
+    last_tsc = tsc;
+    last_mono_ns = mono_ns;
+  }
+}
+
+void start(int sync_interval_ms)
+{
+  if ((tsc_enabled) || (!have_invariant_tsc()))
+  {
+    TRC_STATUS("Not using the TSC for timing");
+    return;
+  }
+
+  uint64_t tsc0;
+  uint64_t mono0_ns;
+  uint64_t real_ns;
+  sample(tsc0, mono0_ns, real_ns);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(CALIBRATION_MS));
+
+  uint64_t tsc1;
+  uint64_t mono1_ns;
+  sample(tsc1, mono1_ns, real_ns);
+
+  if (tsc1 <= tsc0)
+  {
+    TRC_WARNING("TSC not advancing - not using it for timing"); // LCOV_EXCL_LINE
+    return;                                                      // LCOV_EXCL_LINE
+  }
+
+  uint64_t mult = calc_mult(mono1_ns - mono0_ns, tsc1 - tsc0);
+  publish(tsc1, mono1_ns, mult, (int64_t)(real_ns - mono1_ns));
+
+  TRC_STATUS("Using the TSC for timing (%.3f ticks/ns)",
+             (double)(tsc1 - tsc0) / (mono1_ns - mono0_ns));
+
+  cached_seconds.store(time(NULL), std::memory_order_relaxed);
+  sync_terminate = false;
+  tsc_enabled = true;
+  sync_thread = new std::thread(run_sync, sync_interval_ms);
+}
+
+void stop()
+{
+  if (sync_thread != NULL)
+  {
+    {
+      std::unique_lock<std::mutex> lock(sync_lock);
+      sync_terminate = true;
+      sync_cond.notify_all();
+    }
+
+    sync_thread->join();
+    delete sync_thread; sync_thread = NULL;
+  }
+
+  tsc_enabled = false;
+}
+
+bool using_tsc()
+{
+  return tsc_enabled;
+}
+
+uint64_t now_ns()
+{
+  if (!tsc_enabled.load(std::memory_order_relaxed))
+  {
+    return system_monotonic_ns();
+  }
+
+  return read_tsc_clock(NULL);
+}
+
+void realtime(struct timespec* ts)
+{
+  if (!tsc_enabled.load(std::memory_order_relaxed))
+  {
+    clock_gettime(CLOCK_REALTIME, ts);
+    return;
+  }
+
+  int64_t offset_ns;
+  uint64_t real_ns = read_tsc_clock(&offset_ns) + offset_ns;
+  ts->tv_sec = real_ns / 1000000000;
+  ts->tv_nsec = real_ns % 1000000000;
+}
+
+time_t coarse_time()
+{
+  if (!tsc_enabled.load(std::memory_order_relaxed))
+  {
+    return time(NULL);
+  }
+
+  return cached_seconds.load(std::memory_order_relaxed);
+}
+
+};
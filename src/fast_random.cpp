@@ -0,0 +1,181 @@
+/**
+ * @file fast_random.cpp Lock-free per-thread random number generation.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "fast_random.h"
+
+static const char BASE64_CHARS[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char BASE64URL_CHARS[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+static const char HEX_CHARS[] = "0123456789abcdef";
+
+// splitmix64, used to expand the seed into the xoshiro state as recommended
+// by its authors.
+static uint64_t splitmix64(uint64_t& x)
+{
+  uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+// Reads a seed from the kernel. This is only done once per thread. If
+// getrandom isn't available we fall back to /dev/urandom, and if that fails
+// too we mix the time and thread ID, which is still good enough to avoid
+// identifier collisions between threads and processes.
+static uint64_t get_seed()
+{
+  uint64_t seed = 0;
+
+#ifdef SYS_getrandom
+  if (syscall(SYS_getrandom, &seed, sizeof(seed), 0) == (long)sizeof(seed))
+  {
+    return seed;
+  }
+#endif
+
+  int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+  if (fd >= 0)
+  {
+    ssize_t len = read(fd, &seed, sizeof(seed));
+    close(fd);
+    if (len == (ssize_t)sizeof(seed))
+    {
+      return seed;
+    }
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  uint64_t mix = ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+  mix ^= ((uint64_t)syscall(SYS_gettid) << 32);
+  mix ^= (uint64_t)getpid();
+  return splitmix64(mix);
+}
+
+/// xoshiro256** generator state for one thread.
+class Xoshiro256
+{
+public:
+  Xoshiro256()
+  {
+    uint64_t seed = get_seed();
+    for (int ii = 0; ii < 4; ++ii)
+    {
+      _s[ii] = splitmix64(seed);
+    }
+  }
+
+  inline uint64_t next()
+  {
+    const uint64_t result = rotl(_s[1] * 5, 7) * 9;
+    const uint64_t t = _s[1] << 17;
+
+    _s[2] ^= _s[0];
+    _s[3] ^= _s[1];
+    _s[1] ^= _s[2];
+    _s[0] ^= _s[3];
+    _s[2] ^= t;
+    _s[3] = rotl(_s[3], 45);
+
+    return result;
+  }
+
+private:
+  uint64_t _s[4];
+};
+
+static thread_local Xoshiro256 generator;
+
+uint64_t FastRandom::next()
+{
+  return generator.next();
+}
+
+uint32_t FastRandom::uniform(uint32_t n)
+{
+  // Lemire's multiply-and-shift method, rejecting the small biased region so
+  // the result is exactly uniform.
+  uint64_t m = (uint64_t)(uint32_t)(generator.next() >> 32) * n;
+  uint32_t low = (uint32_t)m;
+  if (low < n)
+  {
+    uint32_t threshold = (uint32_t)(-n) % n;
+    while (low < threshold)
+    {
+      m = (uint64_t)(uint32_t)(generator.next() >> 32) * n;
+      low = (uint32_t)m;
+    }
+  }
+
+  return (uint32_t)(m >> 32);
+}
+
+// Fills the buffer using six random bits per character, from a 64 character
+// alphabet. Each 64-bit draw provides ten characters.
+static void fill_6bit(char* buf, size_t len, const char* alphabet)
+{
+  while (len > 0)
+  {
+    uint64_t bits = generator.next();
+    size_t chunk = (len < 10) ? len : 10;
+    for (size_t ii = 0; ii < chunk; ++ii)
+    {
+      *buf++ = alphabet[bits & 0x3f];
+      bits >>= 6;
+    }
+    len -= chunk;
+  }
+}
+
+void FastRandom::fill_base64(char* buf, size_t len)
+{
+  fill_6bit(buf, len, BASE64_CHARS);
+}
+
+void FastRandom::fill_base64url(char* buf, size_t len)
+{
+  fill_6bit(buf, len, BASE64URL_CHARS);
+}
+
+void FastRandom::fill_hex(char* buf, size_t len)
+{
+  while (len > 0)
+  {
+    uint64_t bits = generator.next();
+    size_t chunk = (len < 16) ? len : 16;
+    for (size_t ii = 0; ii < chunk; ++ii)
+    {
+      *buf++ = HEX_CHARS[bits & 0xf];
+      bits >>= 4;
+    }
+    len -= chunk;
+  }
+}
+
+void FastRandom::create_token(size_t length, std::string& token)
+{
+  token.resize(length);
+  if (length > 0)
+  {
+    fill_base64(&token[0], length);
+  }
+}
@@ -22,7 +22,8 @@ FIFCService::FIFCService(Alarm* alarm,
                          std::string configuration):
   _alarm(alarm),
   _configuration(configuration),
-  _updater(NULL)
+  _updater(NULL),
+  _sets_rw_lock("FIFCService")
 {
   // Create an updater to keep the fallback iFCs configured correctly.
   _updater = new Updater<void, FIFCService>
@@ -101,7 +102,7 @@ void FIFCService::update_fifcs()
   // If we have reached this point, we are definitely going to update the current
   // fallback ifc list.
   // Take a lock while we do so.
-  boost::lock_guard<boost::shared_mutex> write_lock(_sets_rw_lock);
+  boost::lock_guard<InstrumentedSharedMutex> write_lock(_sets_rw_lock);
   bool any_errors = false;
   _fallback_ifcs.clear();
 
@@ -164,7 +165,7 @@ void FIFCService::update_fifcs()
 std::vector<Ifc> FIFCService::get_fallback_ifcs(rapidxml::xml_document<>* ifc_doc) const
 {
   // Take a read lock on the mutex in RAII style
-  boost::shared_lock<boost::shared_mutex> read_lock(_sets_rw_lock);
+  boost::shared_lock<InstrumentedSharedMutex> read_lock(_sets_rw_lock);
 
   std::vector<Ifc> ifc_vec;
   for (std::string ifc : _fallback_ifcs)
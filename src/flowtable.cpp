@@ -25,15 +25,17 @@ extern "C" {
 #include "pjutils.h"
 #include "stack.h"
 #include "flowtable.h"
+#include "fast_random.h"
+#include "fast_clock.h"
 
 FlowTable::FlowTable(QuiescingManager* qm, SNMP::U32Scalar* connection_count) :
+  _flow_map_lock("FlowTable"),
   _tp2flow_map(),
   _tk2flow_map(),
   _conn_count(connection_count),
   _quiescing(false),
   _qm(qm)
 {
-  pthread_mutex_init(&_flow_map_lock, NULL);
   report_flow_count();
 }
 
@@ -47,8 +49,6 @@ FlowTable::~FlowTable()
   {
     delete i->second;
   }
-
-  pthread_mutex_destroy(&_flow_map_lock);
 }
 
 
@@ -64,7 +64,7 @@ Flow* FlowTable::find_create_flow(pjsip_transport* transport, const pj_sockaddr*
             transport->obj_name, transport->key.type,
             pj_sockaddr_print(raddr, buf, sizeof(buf), 3));
 
-  pthread_mutex_lock(&_flow_map_lock);
+  _flow_map_lock.lock();
 
   std::map<FlowKey, Flow*>::iterator i = _tp2flow_map.find(key);
 
@@ -92,7 +92,7 @@ Flow* FlowTable::find_create_flow(pjsip_transport* transport, const pj_sockaddr*
   // Add a reference to the flow.
   flow->inc_ref();
 
-  pthread_mutex_unlock(&_flow_map_lock);
+  _flow_map_lock.unlock();
 
   return flow;
 }
@@ -110,7 +110,7 @@ Flow* FlowTable::find_flow(pjsip_transport* transport, const pj_sockaddr* raddr)
             transport->obj_name, transport->key.type,
             pj_sockaddr_print(raddr, buf, sizeof(buf), 3));
 
-  pthread_mutex_lock(&_flow_map_lock);
+  _flow_map_lock.lock();
 
   std::map<FlowKey, Flow*>::iterator i = _tp2flow_map.find(key);
 
@@ -125,7 +125,7 @@ Flow* FlowTable::find_flow(pjsip_transport* transport, const pj_sockaddr* raddr)
     TRC_DEBUG("Found flow record %p", flow);
   }
 
-  pthread_mutex_unlock(&_flow_map_lock);
+  _flow_map_lock.unlock();
 
   return flow;
 }
@@ -138,7 +138,7 @@ Flow* FlowTable::find_flow(const std::string& token)
 
   TRC_DEBUG("Find flow for flow token %s", token.c_str());
 
-  pthread_mutex_lock(&_flow_map_lock);
+  _flow_map_lock.lock();
 
   std::map<std::string, Flow*>::iterator i = _tk2flow_map.find(token);
   if (i != _tk2flow_map.end())
@@ -152,7 +152,7 @@ Flow* FlowTable::find_flow(const std::string& token)
     TRC_DEBUG("Found flow record %p", flow);
   }
 
-  pthread_mutex_unlock(&_flow_map_lock);
+  _flow_map_lock.unlock();
 
   return flow;
 }
@@ -175,7 +175,7 @@ void FlowTable::check_quiescing_state()
 
 void FlowTable::remove_flow(Flow* flow)
 {
-  pthread_mutex_lock(&_flow_map_lock);
+  _flow_map_lock.lock();
 
   TRC_DEBUG("Remove flow %p", flow);
 
@@ -199,7 +199,7 @@ void FlowTable::remove_flow(Flow* flow)
 
   check_quiescing_state();
 
-  pthread_mutex_unlock(&_flow_map_lock);
+  _flow_map_lock.unlock();
 }
 
 void FlowTable::report_flow_count()
@@ -212,13 +212,13 @@ void FlowTable::quiesce()
 {
   TRC_DEBUG("FlowTable was kicked to quiesce");
   _quiescing = true;
-  pthread_mutex_lock(&_flow_map_lock);
+  _flow_map_lock.lock();
 
   // If we have no flows, quiesce now - otherwise we do this in
   // remove_flow when the last flow disappears
   check_quiescing_state();
 
-  pthread_mutex_unlock(&_flow_map_lock);
+  _flow_map_lock.unlock();
 }
 
 void FlowTable::unquiesce()
@@ -252,7 +252,7 @@ Flow::Flow(FlowTable* flow_table, pjsip_transport* transport, const pj_sockaddr*
   pthread_mutex_init(&_flow_lock, NULL);
 
   // Create a random base64 encoded token for the flow.
-  Utils::create_random_token(Flow::TOKEN_LENGTH, _token);
+  FastRandom::create_token(Flow::TOKEN_LENGTH, _token);
 
   if (PJSIP_TRANSPORT_IS_RELIABLE(_transport))
   {
@@ -380,7 +380,7 @@ void Flow::set_identity(const pjsip_uri* uri,
                         bool is_default,
                         int expires)
 {
-  int now = time(NULL);
+  int now = FastClock::coarse_time();
 
   // Render the URI to an AoR suitable to look up in the map.
   std::string aor = PJUtils::public_id_from_uri((pjsip_uri*)pjsip_uri_get_uri(uri));
@@ -426,7 +426,7 @@ void Flow::set_identity(const pjsip_uri* uri,
     if ((_timer.id != EXPIRY_TIMER) ||
         (_timer._timer_value.sec > expires))
     {
-      restart_timer(EXPIRY_TIMER, expires - time(NULL));
+      restart_timer(EXPIRY_TIMER, expires - FastClock::coarse_time());
     }
   }
   else
@@ -477,7 +477,7 @@ void Flow::expiry_timer()
   // clients over a single flow.
   pthread_mutex_lock(&_flow_lock);
 
-  int now = time(NULL);
+  int now = FastClock::coarse_time();
   int min_expires = 0;
   for (auth_id_map::const_iterator i = _authorized_ids.begin();
        i != _authorized_ids.end();
@@ -582,17 +582,17 @@ void Flow::inc_ref()
 /// to zero.
 void Flow::dec_ref()
 {
-  pthread_mutex_lock(&_flow_table->_flow_map_lock);
+  _flow_table->_flow_map_lock.lock();
 
   if ((--_refs) == 0)
   {
-    pthread_mutex_unlock(&_flow_table->_flow_map_lock);
+    _flow_table->_flow_map_lock.unlock();
     _flow_table->remove_flow(this);
   }
   else
   {
     TRC_DEBUG("Dialog count now %d for flow %s", _refs, _default_id.c_str());
-    pthread_mutex_unlock(&_flow_table->_flow_map_lock);
+    _flow_table->_flow_map_lock.unlock();
   }
 }
 
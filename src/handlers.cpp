@@ -28,6 +28,12 @@ extern "C" {
 #include "uri_classifier.h"
 #include "sprout_xml_utils.h"
 #include "subscriber_data_utils.h"
+#include "memory_accounting.h"
+#include "io_profiler.h"
+#include "instrumented_mutex.h"
+#include "slow_transactions.h"
+
+#include <unordered_set>
 
 
 static void report_sip_all_register_marker(SAS::TrailId trail, std::string uri_str)
@@ -344,6 +350,99 @@ std::string extract_impu(HttpStack::Request& request)
   return impu;
 }
 
+// Names of the pagination parameters and the field that tells the client
+// where the next page starts.
+static const std::string PARAM_LIMIT = "limit";
+static const std::string PARAM_AFTER = "after";
+static const char* const JSON_NEXT = "next";
+static const char* const JSON_IMPUS = "impus";
+static const char* const JSON_ERROR = "error";
+
+// Responses larger than this don't leave their buffer allocated on the
+// thread afterwards.
+static const size_t MAX_RETAINED_BUFFER = 1024 * 1024;
+
+// Returns a cleared per-thread buffer to serialize a response into. This is
+// reused across requests, so building a document doesn't have to grow a new
+// buffer from scratch each time.
+static rapidjson::StringBuffer& response_buffer()
+{
+  static thread_local rapidjson::StringBuffer sb;
+
+  bool large = (sb.GetSize() > MAX_RETAINED_BUFFER);
+  sb.Clear();
+
+  if (large)
+  {
+    sb.ShrinkToFit();
+  }
+
+  return sb;
+}
+
+// Parses the optional pagination parameters on a management request.
+//
+// @return false if the limit isn't a positive number.
+static bool parse_page_params(HttpStack::Request& req,
+                              std::string& after,
+                              size_t& limit)
+{
+  after = req.param(PARAM_AFTER);
+  limit = 0;
+
+  std::string limit_str = req.param(PARAM_LIMIT);
+  if (!limit_str.empty())
+  {
+    char* end = NULL;
+    long value = strtol(limit_str.c_str(), &end, 10);
+    if ((*end != '\0') || (value <= 0))
+    {
+      TRC_DEBUG("Invalid limit %s", limit_str.c_str());
+      return false;
+    }
+    limit = value;
+  }
+
+  return true;
+}
+
+// Writes a page of a map of bindings or subscriptions as a JSON object
+// member called name. If there are more entries after the page, a "next"
+// member is written as well, giving the value to pass as "after" to get the
+// next page.
+template <class T>
+static void write_page(rapidjson::Writer<rapidjson::StringBuffer>& writer,
+                       const char* name,
+                       const T& entries,
+                       const std::string& after,
+                       size_t limit)
+{
+  typename T::const_iterator it = after.empty() ? entries.begin() :
+                                                  entries.upper_bound(after);
+  const char* last = NULL;
+  size_t count = 0;
+
+  writer.String(name);
+  writer.StartObject();
+  {
+    for (;
+         (it != entries.end()) && ((limit == 0) || (count < limit));
+         ++it, ++count)
+    {
+      writer.String(it->first.c_str());
+      it->second->to_json(writer);
+      last = it->first.c_str();
+    }
+  }
+  writer.EndObject();
+
+  if ((it != entries.end()) && (last != NULL))
+  {
+    writer.String(JSON_NEXT);
+    writer.String(last);
+  }
+}
+
 // Get cached bindings.
 void GetBindingsTask::run()
 {
@@ -355,6 +454,15 @@ void GetBindingsTask::run()
     return;
   }
 
+  std::string after;
+  size_t limit;
+  if (!parse_page_params(_req, after, limit))
+  {
+    send_http_reply(HTTP_BAD_REQUEST);
+    delete this;
+    return;
+  }
+
   SAS::Marker start_marker(trail(), MARKER_ID_START, 3u);
   SAS::report_marker(start_marker);
 
@@ -362,8 +470,7 @@ void GetBindingsTask::run()
 
   Bindings bindings;
   HTTPCode rc = _cfg->_sm->get_bindings(impu, bindings, trail());
-  std::string content = serialize_data(bindings);
-  _req.add_content(content);
+  _req.add_content(serialize_data(bindings, after, limit));
 
   send_http_reply(rc);
 
@@ -376,28 +483,212 @@ void GetBindingsTask::run()
   return;
 }
 
-std::string GetBindingsTask::serialize_data(
-                                const Bindings& bindings)
+std::string GetBindingsTask::serialize_data(const Bindings& bindings,
+                                            const std::string& after,
+                                            size_t limit)
 {
-  rapidjson::StringBuffer sb;
+  rapidjson::StringBuffer& sb = response_buffer();
   rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
 
   writer.StartObject();
+  write_page(writer, JSON_BINDINGS, bindings, after, limit);
+  writer.EndObject();
+
+  return std::string(sb.GetString(), sb.GetSize());
+}
+
+HTTPCode GetBulkBindingsTask::parse_request(const std::string& body)
+{
+  rapidjson::Document doc;
+  doc.Parse<0>(body.c_str());
+
+  if (doc.HasParseError())
   {
-    writer.String(JSON_BINDINGS);
-    writer.StartObject();
+    TRC_INFO("Failed to parse data as JSON: %s\nError: %s",
+             body.c_str(),
+             rapidjson::GetParseError_En(doc.GetParseError()));
+    return HTTP_BAD_REQUEST;
+  }
+
+  try
+  {
+    JSON_ASSERT_CONTAINS(doc, JSON_IMPUS);
+    JSON_ASSERT_ARRAY(doc[JSON_IMPUS]);
+    const rapidjson::Value& impu_arr = doc[JSON_IMPUS];
+
+    if (impu_arr.Size() > MAX_IMPUS)
     {
-      for (BindingPair b : bindings)
+      TRC_INFO("Too many IMPUs requested (%d)", impu_arr.Size());
+      return HTTP_BAD_REQUEST;
+    }
+
+    std::unordered_set<std::string> seen;
+    for (rapidjson::Value::ConstValueIterator impu_it = impu_arr.Begin();
+         impu_it != impu_arr.End();
+         ++impu_it)
+    {
+      if (!impu_it->IsString())
+      {
+        TRC_INFO("Invalid JSON - IMPU isn't a string");
+        return HTTP_BAD_REQUEST;
+      }
+
+      // Each IMPU is a key in the response, so only look each one up once.
+      std::string impu = impu_it->GetString();
+      if (seen.insert(impu).second)
       {
-        writer.String(b.first.c_str());
-        b.second->to_json(writer);
+        _impus.push_back(impu);
       }
     }
-    writer.EndObject();
   }
-  writer.EndObject();
+  catch (JsonFormatError err)
+  {
+    TRC_INFO("IMPUs not available in JSON");
+    return HTTP_BAD_REQUEST;
+  }
+
+  return HTTP_OK;
+}
+
+GetBulkBindingsTask::LookupPool::LookupPool(ExceptionHandler* exception_handler,
+                                            unsigned int num_threads) :
+  ThreadPool<Lookup*>(num_threads,
+                      exception_handler,
+                      &exception_callback,
+                      0)
+{}
+
+void GetBulkBindingsTask::LookupPool::process_work(Lookup*& lookup)
+{
+  lookup->task->look_up(lookup->index);
+  delete lookup; lookup = NULL;
+}
 
-  return sb.GetString();
+void GetBulkBindingsTask::LookupPool::exception_callback(Lookup* lookup)
+{
+  lookup->task->lookup_complete(lookup->index, HTTP_SERVER_ERROR);
+  delete lookup;
+}
+
+// Get the cached bindings for many IMPUs.
+void GetBulkBindingsTask::run()
+{
+  if (_req.method() != htp_method_POST)
+  {
+    send_http_reply(HTTP_BADMETHOD);
+    delete this;
+    return;
+  }
+
+  HTTPCode rc = parse_request(_req.get_rx_body());
+  if (rc != HTTP_OK)
+  {
+    send_http_reply(rc);
+    delete this;
+    return;
+  }
+
+  SAS::Marker start_marker(trail(), MARKER_ID_START, 3u);
+  SAS::report_marker(start_marker);
+
+  _writer.StartObject();
+  _writer.String(JSON_IMPUS);
+  _writer.StartObject();
+
+  size_t num_impus = _impus.size();
+  if (num_impus == 0)
+  {
+    send_response();
+    return;
+  }
+
+  _rcs.resize(num_impus, HTTP_OK);
+  _bindings.resize(num_impus);
+  _complete.resize(num_impus, false);
+
+  // The last lookup to complete deletes this task, so don't touch any members
+  // once the lookups have been started.
+  LookupPool* pool = _cfg->_pool;
+  for (size_t ii = 0; ii < num_impus; ++ii)
+  {
+    if (pool != NULL)
+    {
+      Lookup* lookup = new Lookup();
+      lookup->task = this;
+      lookup->index = ii;
+      pool->add_work(lookup);
+    }
+    else
+    {
+      look_up(ii);
+    }
+  }
+}
+
+void GetBulkBindingsTask::look_up(size_t index)
+{
+  HTTPCode rc = _cfg->_sm->get_bindings(_impus[index],
+                                        _bindings[index],
+                                        trail());
+  lookup_complete(index, rc);
+}
+
+void GetBulkBindingsTask::lookup_complete(size_t index, HTTPCode rc)
+{
+  std::unique_lock<std::mutex> lock(_write_lock);
+  _rcs[index] = rc;
+  _complete[index] = true;
+
+  // Write out this result, and any later ones that were waiting on it, so
+  // their bindings can be freed now rather than when the last lookup is done.
+  bool wrote_last = false;
+  while ((_next_to_write < _impus.size()) && (_complete[_next_to_write]))
+  {
+    write_result(_next_to_write);
+    ++_next_to_write;
+    wrote_last = (_next_to_write == _impus.size());
+  }
+
+  lock.unlock();
+
+  // Only one lookup writes the last result, and every lookup has finished by
+  // then, so nothing else touches the task once we get here.
+  if (wrote_last)
+  {
+    send_response();
+  }
+}
+
+void GetBulkBindingsTask::write_result(size_t index)
+{
+  _writer.String(_impus[index].c_str());
+  _writer.StartObject();
+  if (_rcs[index] == HTTP_OK)
+  {
+    write_page(_writer, JSON_BINDINGS, _bindings[index], "", 0);
+  }
+  else
+  {
+    _writer.String(JSON_ERROR);
+    _writer.Int(_rcs[index]);
+  }
+  _writer.EndObject();
+
+  SubscriberDataUtils::delete_bindings(_bindings[index]);
+}
+
+void GetBulkBindingsTask::send_response()
+{
+  _writer.EndObject();
+  _writer.EndObject();
+
+  _req.add_content(std::string(_sb.GetString(), _sb.GetSize()));
+  send_http_reply(HTTP_OK);
+
+  SAS::Marker end_marker(trail(), MARKER_ID_END, 3u);
+  SAS::report_marker(end_marker);
+
+  delete this;
 }
 
 // Get cached subscriptions.
@@ -411,6 +702,15 @@ void GetSubscriptionsTask::run()
     return;
   }
 
+  std::string after;
+  size_t limit;
+  if (!parse_page_params(_req, after, limit))
+  {
+    send_http_reply(HTTP_BAD_REQUEST);
+    delete this;
+    return;
+  }
+
   SAS::Marker start_marker(trail(), MARKER_ID_START, 3u);
   SAS::report_marker(start_marker);
 
@@ -418,8 +718,7 @@ void GetSubscriptionsTask::run()
 
   Subscriptions subscriptions;
   HTTPCode rc = _cfg->_sm->get_subscriptions(impu, subscriptions, trail());
-  std::string content = serialize_data(subscriptions);
-  _req.add_content(content);
+  _req.add_content(serialize_data(subscriptions, after, limit));
 
   send_http_reply(rc);
 
@@ -433,27 +732,403 @@ void GetSubscriptionsTask::run()
 }
 
 std::string GetSubscriptionsTask::serialize_data(
-                      const Subscriptions& subscriptions)
+                                          const Subscriptions& subscriptions,
+                                          const std::string& after,
+                                          size_t limit)
 {
-  rapidjson::StringBuffer sb;
+  rapidjson::StringBuffer& sb = response_buffer();
   rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
 
   writer.StartObject();
+  write_page(writer, JSON_SUBSCRIPTIONS, subscriptions, after, limit);
+  writer.EndObject();
+
+  return std::string(sb.GetString(), sb.GetSize());
+}
+
+void GetMemoryTask::run()
+{
+  // This interface is read only so reject any non-GETs.
+  if (_req.method() != htp_method_GET)
   {
-    writer.String(JSON_SUBSCRIPTIONS);
+    send_http_reply(HTTP_BADMETHOD);
+    delete this;
+    return;
+  }
+
+  MemoryAccounting::PoolFactoryStats factory;
+  MemoryAccounting::get_factory_stats(_cfg->_cp, factory);
+
+  std::map<std::string, MemoryAccounting::PoolStats> owners;
+  MemoryAccounting::get_pool_stats_by_owner(_cfg->_cp, owners);
+
+  rapidjson::StringBuffer& sb = response_buffer();
+  rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+
+  writer.StartObject();
+  {
+    writer.String("pjsip");
     writer.StartObject();
     {
-      for (SubscriptionPair s : subscriptions)
+      writer.String("used_bytes");
+      writer.Uint64(factory.used_bytes);
+      writer.String("peak_used_bytes");
+      writer.Uint64(factory.peak_used_bytes);
+      writer.String("pools");
+      writer.Uint64(factory.used_pools);
+      writer.String("cached_bytes");
+      writer.Uint64(factory.cached_bytes);
+
+      if (_cfg->_adaptive_pools != NULL)
       {
-        writer.String(s.first.c_str());
-        s.second->to_json(writer);
+        writer.String("message_pools");
+        writer.StartObject();
+        for (int ii = 0; ii < AdaptivePoolFactory::NUM_POOL_CLASSES; ++ii)
+        {
+          AdaptivePoolFactory::PoolClass pool_class =
+                                            (AdaptivePoolFactory::PoolClass)ii;
+          AdaptivePoolFactory::Stats stats =
+                                    _cfg->_adaptive_pools->stats(pool_class);
+
+          writer.String(AdaptivePoolFactory::class_name(pool_class));
+          writer.StartObject();
+          writer.String("initial_size");
+          writer.Uint64(stats.initial_size);
+          writer.String("created");
+          writer.Uint64(stats.created);
+          writer.String("reused");
+          writer.Uint64(stats.reused);
+          writer.String("free");
+          writer.Uint64(stats.free);
+          writer.EndObject();
+        }
+        writer.EndObject();
       }
+
+      writer.String("owners");
+      writer.StartObject();
+      for (const std::pair<const std::string, MemoryAccounting::PoolStats>& owner : owners)
+      {
+        writer.String(owner.first.c_str());
+        writer.StartObject();
+        writer.String("pools");
+        writer.Uint64(owner.second.pools);
+        writer.String("used_bytes");
+        writer.Uint64(owner.second.used_bytes);
+        writer.String("capacity_bytes");
+        writer.Uint64(owner.second.capacity_bytes);
+        writer.EndObject();
+      }
+      writer.EndObject();
+    }
+    writer.EndObject();
+
+    writer.String("subsystems");
+    writer.StartObject();
+    for (size_t ii = 0; ii < MemoryAccounting::NUM_ACCOUNTS; ++ii)
+    {
+      MemoryAccount* account = MemoryAccounting::ACCOUNTS[ii];
+      MemoryAccount::Stats stats = account->stats();
+
+      writer.String(account->name());
+      writer.StartObject();
+      writer.String("bytes");
+      writer.Int64(stats.bytes);
+      writer.String("high_water_bytes");
+      writer.Int64(stats.high_water_bytes);
+      writer.String("allocations");
+      writer.Uint64(stats.allocations);
+      writer.String("frees");
+      writer.Uint64(stats.frees);
+      writer.EndObject();
     }
     writer.EndObject();
   }
   writer.EndObject();
 
-  return sb.GetString();
+  _req.add_content(std::string(sb.GetString(), sb.GetSize()));
+  send_http_reply(HTTP_OK);
+
+  delete this;
+}
+
+void IoProfileTask::run()
+{
+  if (_req.method() == htp_method_DELETE)
+  {
+    IoProfiler::reset();
+    send_http_reply(HTTP_OK);
+    delete this;
+    return;
+  }
+  else if (_req.method() != htp_method_GET)
+  {
+    send_http_reply(HTTP_BADMETHOD);
+    delete this;
+    return;
+  }
+
+  IoProfiler::Profile profile;
+  IoProfiler::get_profile(profile);
+
+  rapidjson::StringBuffer& sb = response_buffer();
+  rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+
+  writer.StartObject();
+  {
+    writer.String("sample_rate");
+    writer.Int(IoProfiler::sample_rate());
+
+    writer.String("sites");
+    writer.StartArray();
+    for (const std::pair<const IoProfiler::SiteKey, IoProfiler::SiteStats>& site : profile)
+    {
+      const IoProfiler::SiteStats& stats = site.second;
+
+      writer.StartObject();
+      writer.String("site");
+      writer.String(site.first.first.c_str());
+      writer.String("sproutlet");
+      writer.String(site.first.second.c_str());
+      writer.String("count");
+      writer.Uint64(stats.count);
+      writer.String("total_us");
+      writer.Uint64(stats.total_us);
+      writer.String("max_us");
+      writer.Uint64(stats.max_us);
+
+      // Only report the buckets that have something in them.  The last
+      // bucket is unbounded, so doesn't have a limit.
+      writer.String("histogram");
+      writer.StartArray();
+      for (int ii = 0; ii < IoProfiler::NUM_BUCKETS; ++ii)
+      {
+        if (stats.buckets[ii] != 0)
+        {
+          writer.StartObject();
+          uint64_t limit_us = IoProfiler::bucket_limit_us(ii);
+          if (limit_us != 0)
+          {
+            writer.String("lt_us");
+            writer.Uint64(limit_us);
+          }
+          writer.String("count");
+          writer.Uint64(stats.buckets[ii]);
+          writer.EndObject();
+        }
+      }
+      writer.EndArray();
+      writer.EndObject();
+    }
+    writer.EndArray();
+  }
+  writer.EndObject();
+
+  _req.add_content(std::string(sb.GetString(), sb.GetSize()));
+  send_http_reply(HTTP_OK);
+
+  delete this;
+}
+
+void LockStatsTask::run()
+{
+  if (_req.method() == htp_method_DELETE)
+  {
+    InstrumentedLock::reset_all_stats();
+    send_http_reply(HTTP_OK);
+    delete this;
+    return;
+  }
+  else if (_req.method() != htp_method_GET)
+  {
+    send_http_reply(HTTP_BADMETHOD);
+    delete this;
+    return;
+  }
+
+  std::map<std::string, LockStats> all_stats;
+  InstrumentedLock::get_all_stats(all_stats);
+
+  rapidjson::StringBuffer& sb = response_buffer();
+  rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+
+  writer.StartObject();
+  {
+    writer.String("locks");
+    writer.StartObject();
+    for (const std::pair<const std::string, LockStats>& lock : all_stats)
+    {
+      const LockStats& stats = lock.second;
+
+      writer.String(lock.first.c_str());
+      writer.StartObject();
+      writer.String("acquisitions");
+      writer.Uint64(stats.acquisitions);
+      writer.String("contended");
+      writer.Uint64(stats.contended);
+      writer.String("wait_us");
+      writer.Uint64(stats.wait_ns / 1000);
+      writer.String("hold_us");
+      writer.Uint64(stats.hold_ns / 1000);
+      writer.String("max_hold_us");
+      writer.Uint64(stats.max_hold_ns / 1000);
+      writer.EndObject();
+    }
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  _req.add_content(std::string(sb.GetString(), sb.GetSize()));
+  send_http_reply(HTTP_OK);
+
+  delete this;
+}
+
+void SlowTransactionsTask::run()
+{
+  if (_req.method() == htp_method_DELETE)
+  {
+    SlowTransactions::reset();
+    send_http_reply(HTTP_OK);
+    delete this;
+    return;
+  }
+  else if (_req.method() != htp_method_GET)
+  {
+    send_http_reply(HTTP_BADMETHOD);
+    delete this;
+    return;
+  }
+
+  SlowTransactions::Report report;
+  SlowTransactions::get_slowest(report);
+
+  rapidjson::StringBuffer& sb = response_buffer();
+  rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+
+  writer.StartObject();
+  {
+    writer.String("methods");
+    writer.StartObject();
+    for (const std::pair<const std::string, std::vector<SlowTransactions::Transaction>>& method : report)
+    {
+      writer.String(method.first.c_str());
+      writer.StartArray();
+      for (const SlowTransactions::Transaction& tsx : method.second)
+      {
+        writer.StartObject();
+        writer.String("latency_us");
+        writer.Uint64(tsx.latency_us);
+        writer.String("timestamp");
+        writer.Int64((int64_t)tsx.timestamp);
+        writer.String("trail");
+        writer.Uint64(tsx.trail);
+        writer.String("method");
+        writer.String(tsx.method.c_str());
+        writer.String("type");
+        writer.String(tsx.request ? "request" : "response");
+        writer.String("call_id");
+        writer.String(tsx.call_id.c_str());
+        writer.String("served_user");
+        writer.String(tsx.served_user.c_str());
+        writer.String("status_code");
+        writer.Int(tsx.status_code);
+
+        writer.String("sproutlets");
+        writer.StartArray();
+        for (const std::string& sproutlet : tsx.sproutlets)
+        {
+          writer.String(sproutlet.c_str());
+        }
+        writer.EndArray();
+
+        writer.String("stages");
+        writer.StartArray();
+        for (const SlowTransactions::Stage& stage : tsx.stages)
+        {
+          writer.StartObject();
+          writer.String("stage");
+          writer.String(SlowTransactions::Stage::type_name(stage.type));
+          if (!stage.name.empty())
+          {
+            writer.String("name");
+            writer.String(stage.name.c_str());
+          }
+          writer.String("us");
+          writer.Uint64(stage.duration_us);
+          writer.EndObject();
+        }
+        writer.EndArray();
+
+        writer.EndObject();
+      }
+      writer.EndArray();
+    }
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  _req.add_content(std::string(sb.GetString(), sb.GetSize()));
+  send_http_reply(HTTP_OK);
+
+  delete this;
+}
+
+/// Writes the density of the expiries granted by a jitter policy.
+static void write_expiry_density(rapidjson::Writer<rapidjson::StringBuffer>& writer,
+                                 const char* name,
+                                 ExpiryJitter* jitter,
+                                 int now)
+{
+  if (jitter == NULL)
+  {
+    return;
+  }
+
+  std::vector<uint32_t> density;
+  jitter->get_density(now, density);
+
+  writer.String(name);
+  writer.StartObject();
+  {
+    writer.String("bucket_s");
+    writer.Int(jitter->bucket_width());
+
+    // One count per bucket, starting with the bucket containing now.
+    writer.String("due");
+    writer.StartArray();
+    for (uint32_t count : density)
+    {
+      writer.Uint(count);
+    }
+    writer.EndArray();
+  }
+  writer.EndObject();
+}
+
+void ExpiryJitterTask::run()
+{
+  if (_req.method() != htp_method_GET)
+  {
+    send_http_reply(HTTP_BADMETHOD);
+    delete this;
+    return;
+  }
+
+  int now = time(NULL);
+
+  rapidjson::StringBuffer& sb = response_buffer();
+  rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+
+  writer.StartObject();
+  write_expiry_density(writer, "registrations", _cfg->_reg_jitter, now);
+  write_expiry_density(writer, "subscriptions", _cfg->_sub_jitter, now);
+  writer.EndObject();
+
+  _req.add_content(std::string(sb.GetString(), sb.GetSize()));
+  send_http_reply(HTTP_OK);
+
+  delete this;
 }
 
 void DeleteImpuTask::run()
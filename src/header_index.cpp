@@ -0,0 +1,334 @@
+/**
+ * @file header_index.cpp Index of the headers in a SIP message by name.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <ctype.h>
+
+#include "header_index.h"
+
+HeaderIndex::HeaderIndex(pjsip_msg* msg) :
+  _msg(msg),
+  _built(false),
+  _entries(),
+  _slots(),
+  _used_slots(0),
+  _first_seq(0),
+  _last_seq(-1)
+{
+}
+
+pjsip_hdr* HeaderIndex::find(const pj_str_t* name)
+{
+  build();
+
+  Slot* slot = find_slot(name);
+  return ((slot != NULL) && (slot->first != NONE)) ?
+                                          _entries[slot->first].hdr : NULL;
+}
+
+pjsip_hdr* HeaderIndex::find(const pj_str_t* name, const pj_str_t* sname)
+{
+  build();
+
+  // Take whichever of the first header with the name and the first header
+  // with the short name comes first in the message.
+  Slot* slots[2] = {find_slot(name), find_slot(sname)};
+  const Entry* first = NULL;
+
+  for (Slot* slot : slots)
+  {
+    if ((slot != NULL) &&
+        (slot->first != NONE) &&
+        ((first == NULL) || (_entries[slot->first].seq < first->seq)))
+    {
+      first = &_entries[slot->first];
+    }
+  }
+
+  return (first != NULL) ? first->hdr : NULL;
+}
+
+pjsip_hdr* HeaderIndex::find_next(const pjsip_hdr* hdr)
+{
+  build();
+
+  int entry = find_entry(hdr);
+
+  if ((entry == NONE) || (_entries[entry].next == NONE))
+  {
+    return NULL;
+  }
+
+  return _entries[_entries[entry].next].hdr;
+}
+
+pjsip_hdr* HeaderIndex::find_next(const pjsip_hdr* hdr,
+                                  const pj_str_t* name,
+                                  const pj_str_t* sname)
+{
+  build();
+
+  int entry = find_entry(hdr);
+
+  if (entry == NONE)
+  {
+    return NULL;
+  }
+
+  // Find the first header with each name after this one, and take whichever
+  // comes first.
+  int64_t seq = _entries[entry].seq;
+  Slot* slots[2] = {find_slot(name), find_slot(sname)};
+  const Entry* next = NULL;
+
+  for (Slot* slot : slots)
+  {
+    if (slot == NULL)
+    {
+      continue;
+    }
+
+    for (int ii = slot->first; ii != NONE; ii = _entries[ii].next)
+    {
+      if (_entries[ii].seq > seq)
+      {
+        if ((next == NULL) || (_entries[ii].seq < next->seq))
+        {
+          next = &_entries[ii];
+        }
+        break;
+      }
+    }
+  }
+
+  return (next != NULL) ? next->hdr : NULL;
+}
+
+void HeaderIndex::first_hdrs(std::vector<pjsip_hdr*>& hdrs)
+{
+  build();
+
+  for (const Slot& slot : _slots)
+  {
+    if ((slot.name != NULL) && (slot.first != NONE))
+    {
+      hdrs.push_back(_entries[slot.first].hdr);
+    }
+  }
+}
+
+void HeaderIndex::add_hdr(pjsip_hdr* hdr)
+{
+  pjsip_msg_add_hdr(_msg, hdr);
+
+  if (_built)
+  {
+    index_hdr(hdr, ++_last_seq, true);
+  }
+}
+
+void HeaderIndex::insert_first_hdr(pjsip_hdr* hdr)
+{
+  pjsip_msg_insert_first_hdr(_msg, hdr);
+
+  if (_built)
+  {
+    index_hdr(hdr, --_first_seq, false);
+  }
+}
+
+void HeaderIndex::remove_hdr(pjsip_hdr* hdr)
+{
+  if (_built)
+  {
+    int entry = find_entry(hdr);
+
+    if (entry != NONE)
+    {
+      Entry& e = _entries[entry];
+      Slot* slot = find_slot(&hdr->name);
+
+      if (e.prev != NONE)
+      {
+        _entries[e.prev].next = e.next;
+      }
+      else
+      {
+        slot->first = e.next;
+      }
+
+      if (e.next != NONE)
+      {
+        _entries[e.next].prev = e.prev;
+      }
+      else
+      {
+        slot->last = e.prev;
+      }
+
+      e.hdr = NULL;
+      e.next = NONE;
+      e.prev = NONE;
+    }
+  }
+
+  pj_list_erase(hdr);
+}
+
+uint32_t HeaderIndex::hash(const pj_str_t* name)
+{
+  // FNV-1a, ignoring case.
+  uint32_t hash = 2166136261u;
+
+  for (pj_ssize_t ii = 0; ii < name->slen; ++ii)
+  {
+    hash ^= (uint8_t)tolower(name->ptr[ii]);
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+void HeaderIndex::build()
+{
+  if (_built)
+  {
+    return;
+  }
+
+  _built = true;
+
+  size_t num_hdrs = 0;
+  for (pjsip_hdr* hdr = _msg->hdr.next; hdr != &_msg->hdr; hdr = hdr->next)
+  {
+    ++num_hdrs;
+  }
+
+  // Size the table so that it is at most half full, even if every header
+  // has a different name.
+  size_t num_slots = 16;
+  while (num_slots < num_hdrs * 2)
+  {
+    num_slots *= 2;
+  }
+
+  _entries.reserve(num_hdrs);
+  _slots.assign(num_slots, Slot{NULL, 0, NONE, NONE});
+
+  for (pjsip_hdr* hdr = _msg->hdr.next; hdr != &_msg->hdr; hdr = hdr->next)
+  {
+    index_hdr(hdr, ++_last_seq, true);
+  }
+}
+
+void HeaderIndex::index_hdr(pjsip_hdr* hdr, int64_t seq, bool at_end)
+{
+  Slot* slot = create_slot(&hdr->name);
+  int entry = _entries.size();
+  _entries.push_back(Entry{hdr, seq, NONE, NONE});
+
+  if (slot->first == NONE)
+  {
+    slot->first = entry;
+    slot->last = entry;
+  }
+  else if (at_end)
+  {
+    _entries[entry].prev = slot->last;
+    _entries[slot->last].next = entry;
+    slot->last = entry;
+  }
+  else
+  {
+    _entries[entry].next = slot->first;
+    _entries[slot->first].prev = entry;
+    slot->first = entry;
+  }
+}
+
+HeaderIndex::Slot* HeaderIndex::find_slot(const pj_str_t* name)
+{
+  uint32_t h = hash(name);
+  size_t mask = _slots.size() - 1;
+
+  for (size_t ii = h & mask; _slots[ii].name != NULL; ii = (ii + 1) & mask)
+  {
+    if ((_slots[ii].hash == h) && (pj_stricmp(_slots[ii].name, name) == 0))
+    {
+      return &_slots[ii];
+    }
+  }
+
+  return NULL;
+}
+
+HeaderIndex::Slot* HeaderIndex::create_slot(const pj_str_t* name)
+{
+  Slot* slot = find_slot(name);
+
+  if (slot != NULL)
+  {
+    return slot;
+  }
+
+  if ((_used_slots + 1) * 2 > _slots.size())
+  {
+    // The table is getting full, so double its size and rehash.
+    std::vector<Slot> old_slots;
+    old_slots.swap(_slots);
+    _slots.assign(old_slots.size() * 2, Slot{NULL, 0, NONE, NONE});
+    size_t mask = _slots.size() - 1;
+
+    for (const Slot& old : old_slots)
+    {
+      if (old.name != NULL)
+      {
+        size_t ii = old.hash & mask;
+        while (_slots[ii].name != NULL)
+        {
+          ii = (ii + 1) & mask;
+        }
+        _slots[ii] = old;
+      }
+    }
+  }
+
+  uint32_t h = hash(name);
+  size_t mask = _slots.size() - 1;
+  size_t ii = h & mask;
+
+  while (_slots[ii].name != NULL)
+  {
+    ii = (ii + 1) & mask;
+  }
+
+  _slots[ii] = Slot{name, h, NONE, NONE};
+  ++_used_slots;
+
+  return &_slots[ii];
+}
+
+int HeaderIndex::find_entry(const pjsip_hdr* hdr)
+{
+  Slot* slot = find_slot(&hdr->name);
+
+  if (slot != NULL)
+  {
+    for (int ii = slot->first; ii != NONE; ii = _entries[ii].next)
+    {
+      if (_entries[ii].hdr == hdr)
+      {
+        return ii;
+      }
+    }
+  }
+
+  return NONE;
+}
@@ -15,6 +15,7 @@
 #include <map>
 
 #include "utils.h"
+#include "fast_clock.h"
 #include "wildcard_utils.h"
 #include "log.h"
 #include "sas.h"
@@ -26,6 +27,7 @@
 #include "snmp_continuous_accumulator_table.h"
 #include "xml_utils.h"
 #include "sprout_xml_utils.h"
+#include "sprout_probes.h"
 
 const std::string HSSConnection::REG = "reg";
 const std::string HSSConnection::CALL = "call";
@@ -84,7 +86,7 @@ HTTPCode HSSConnection::get_auth_vector(const std::string& private_user_identity
                                         rapidjson::Document*& av,
                                         SAS::TrailId trail)
 {
-  Utils::StopWatch stopWatch;
+  FastStopWatch stopWatch;
   stopWatch.start();
 
   SAS::Event event(trail, SASEvent::HTTP_HOMESTEAD_VECTOR, 0);
@@ -147,11 +149,13 @@ HTTPCode HSSConnection::get_json_object(const std::string& path,
                                         rapidjson::Document*& json_object,
                                         SAS::TrailId trail)
 {
+  SPROUT_PROBE(hss_request_start, trail, "GET", path.c_str());
   HttpResponse response = _http->create_request(HttpClient::RequestType::GET, path)
                           .set_sas_trail(trail)
                           .send();
 
   HTTPCode rc = response.get_rc();
+  SPROUT_PROBE(hss_request_finish, trail, "GET", path.c_str(), rc);
 
   if (rc == HTTP_OK)
   {
@@ -212,8 +216,10 @@ HTTPCode HSSConnection::put_for_xml_object(const std::string& path,
     req.add_header("Cache-control: no-cache");
   }
 
+  SPROUT_PROBE(hss_request_start, trail, "PUT", path.c_str());
   HttpResponse response = req.send();
   HTTPCode http_code = response.get_rc();
+  SPROUT_PROBE(hss_request_finish, trail, "PUT", path.c_str(), http_code);
 
   if (http_code == HTTP_OK)
   {
@@ -230,11 +236,13 @@ HTTPCode HSSConnection::get_xml_object(const std::string& path,
                                        rapidxml::xml_document<>*& root,
                                        SAS::TrailId trail)
 {
+  SPROUT_PROBE(hss_request_start, trail, "GET", path.c_str());
   HttpResponse response =_http->create_request(HttpClient::RequestType::GET, path)
                          .set_sas_trail(trail)
                          .send();
 
   HTTPCode http_code = response.get_rc();
+  SPROUT_PROBE(hss_request_finish, trail, "GET", path.c_str(), http_code);
 
   if (http_code == HTTP_OK)
   {
@@ -469,7 +477,7 @@ HTTPCode HSSConnection::put_homestead_xml(const irs_query& irs_query,
                          json_wildcard +
                          "}";
 
-  Utils::StopWatch stopWatch;
+  FastStopWatch stopWatch;
   stopWatch.start();
   HTTPCode http_code = put_for_xml_object(path,
                                           req_body,
@@ -560,7 +568,7 @@ HTTPCode HSSConnection::get_homestead_xml(const std::string& public_id,
 
   rapidxml::xml_document<>* root_underlying_ptr = NULL;
 
-  Utils::StopWatch stopWatch;
+  FastStopWatch stopWatch;
   stopWatch.start();
   HTTPCode http_code = get_xml_object(path, 
                                       root_underlying_ptr, 
@@ -599,7 +607,7 @@ HTTPCode HSSConnection::get_user_auth_status(const std::string& private_user_ide
                                              rapidjson::Document*& user_auth_status,
                                              SAS::TrailId trail)
 {
-  Utils::StopWatch stopWatch;
+  FastStopWatch stopWatch;
   stopWatch.start();
 
   SAS::Event event(trail, SASEvent::HTTP_HOMESTEAD_AUTH_STATUS, 0);
@@ -649,7 +657,7 @@ HTTPCode HSSConnection::get_location_data(const std::string& public_user_identit
                                           rapidjson::Document*& location_data,
                                           SAS::TrailId trail)
 {
-  Utils::StopWatch stopWatch;
+  FastStopWatch stopWatch;
   stopWatch.start();
 
   SAS::Event event(trail, SASEvent::HTTP_HOMESTEAD_LOCATION, 0);
@@ -99,12 +99,14 @@ void Ifc::handle_unusual_ifc(std::string error,
 bool Ifc::spt_matches(const SessionCase& session_case,  //< The session case
                       const bool is_registered,               //< The registration state
                       const bool is_initial_registration,
-                      pjsip_msg* msg,                   //< The message being matched
+                      HeaderIndex& hdrs,                //< The message being matched
                       xml_node<>* spt,                  //< The Service Point Trigger node
                       std::string ifc_str,
                       std::string server_name,
                       SAS::TrailId trail)
 {
+  pjsip_msg* msg = hdrs.msg();
+
   // Find the class node.
   xml_node<>* node = spt->first_node();
   const char* name = NULL;
@@ -219,9 +221,20 @@ bool Ifc::spt_matches(const SessionCase& session_case,  //< The session case
                          server_name, SASEvent::INVALID_IFC_IGNORED, 0, trail);
     }
 
-    for (header = msg->hdr.next; header != &msg->hdr; header = header->next)
+    // Only test each distinct header name against the regex once, rather
+    // than once per header.
+    std::vector<pjsip_hdr*> first_hdrs;
+    hdrs.first_hdrs(first_hdrs);
+
+    for (pjsip_hdr* first_hdr : first_hdrs)
     {
-      if (boost::regex_search(PJUtils::pj_str_to_string(&(header->name)), header_regex))
+      PJStringView header_name = PJUtils::pj_str_view(&(first_hdr->name));
+      if (!boost::regex_search(header_name.begin(), header_name.end(), header_regex))
+      {
+        continue;
+      }
+
+      for (header = first_hdr; header != NULL; header = hdrs.find_next(header))
       {
         if (!spt_content)
         {
@@ -230,7 +243,10 @@ bool Ifc::spt_matches(const SessionCase& session_case,  //< The session case
         }
         else
         {
-          std::string header_value = PJUtils::get_header_value(header);
+          char header_buf[4096];
+          PJStringView header_value = PJUtils::get_header_value(header,
+                                                                header_buf,
+                                                                sizeof(header_buf));
           // status() is nonzero for an uninitialised regex, so we check this in order to only compile it once
           if (content_regex.status())
           {
@@ -243,16 +259,24 @@ bool Ifc::spt_matches(const SessionCase& session_case,  //< The session case
             }
           }
 
-          if (boost::regex_search(header_value, content_regex))
+          if (boost::regex_search(header_value.begin(),
+                                  header_value.end(),
+                                  content_regex))
           {
             // We've found a matching header, and have matching content in one field
             ret = true;
           }
         }
+
+        if (ret)
+        {
+          // Stop processing other headers once we have a match
+          break;
+        }
       }
+
       if (ret)
       {
-        // Stop processing other headers once we have a match
         break;
       }
     }
@@ -439,6 +463,20 @@ bool Ifc::filter_matches(const SessionCase& session_case,
                          const bool is_initial_registration,
                          pjsip_msg* msg,
                          SAS::TrailId trail) const
+{
+  HeaderIndex hdrs(msg);
+  return filter_matches(session_case,
+                        is_registered,
+                        is_initial_registration,
+                        hdrs,
+                        trail);
+}
+
+bool Ifc::filter_matches(const SessionCase& session_case,
+                         const bool is_registered,
+                         const bool is_initial_registration,
+                         HeaderIndex& hdrs,
+                         SAS::TrailId trail) const
 {
   std::string ifc_str;
   rapidxml::print(std::back_inserter(ifc_str), *_ifc, 0);
@@ -527,7 +565,7 @@ bool Ifc::filter_matches(const SessionCase& session_case,
       bool spt_matched = spt_matches(session_case,
                                      is_registered,
                                      is_initial_registration,
-                                     msg,
+                                     hdrs,
                                      spt,
                                      ifc_str,
                                      server_name,
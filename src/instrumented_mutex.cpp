@@ -0,0 +1,282 @@
+/**
+ * @file instrumented_mutex.cpp Mutexes that record how much they contend.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <set>
+
+#include "instrumented_mutex.h"
+#include "fast_clock.h"
+
+// All the instrumented locks that exist, plus the statistics of the ones
+// that have been destroyed.  These are allocated on first use, so that locks
+// in static objects can register whatever the construction order.
+static std::mutex& registry_lock()
+{
+  static std::mutex* lock = new std::mutex();
+  return *lock;
+}
+
+static std::set<InstrumentedLock*>& registry()
+{
+  static std::set<InstrumentedLock*>* locks = new std::set<InstrumentedLock*>();
+  return *locks;
+}
+
+static std::map<std::string, LockStats>& destroyed_stats()
+{
+  static std::map<std::string, LockStats>* stats =
+                                         new std::map<std::string, LockStats>();
+  return *stats;
+}
+
+void LockStats::merge(const LockStats& other)
+{
+  acquisitions += other.acquisitions;
+  contended += other.contended;
+  wait_ns += other.wait_ns;
+  hold_ns += other.hold_ns;
+  max_hold_ns = std::max(max_hold_ns, other.max_hold_ns);
+}
+
+InstrumentedLock::InstrumentedLock(const char* site) :
+  _site(site),
+  _acquisitions(0),
+  _contended(0),
+  _wait_ns(0),
+  _hold_ns(0),
+  _max_hold_ns(0),
+  _hold_start_ns(0)
+{
+  std::unique_lock<std::mutex> lock(registry_lock());
+  registry().insert(this);
+}
+
+InstrumentedLock::~InstrumentedLock()
+{
+  std::unique_lock<std::mutex> lock(registry_lock());
+  registry().erase(this);
+  destroyed_stats()[_site].merge(stats());
+}
+
+void InstrumentedLock::get_all_stats(std::map<std::string, LockStats>& stats)
+{
+  std::unique_lock<std::mutex> lock(registry_lock());
+  stats = destroyed_stats();
+
+  for (InstrumentedLock* instrumented_lock : registry())
+  {
+    stats[instrumented_lock->_site].merge(instrumented_lock->stats());
+  }
+}
+
+void InstrumentedLock::reset_all_stats()
+{
+  std::unique_lock<std::mutex> lock(registry_lock());
+  destroyed_stats().clear();
+
+  for (InstrumentedLock* instrumented_lock : registry())
+  {
+    instrumented_lock->reset();
+  }
+}
+
+void InstrumentedLock::acquired(bool contended, uint64_t wait_start_ns)
+{
+  _acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+  if (contended)
+  {
+    waited(wait_start_ns);
+  }
+}
+
+void InstrumentedLock::waited(uint64_t wait_start_ns)
+{
+  _contended.fetch_add(1, std::memory_order_relaxed);
+  _wait_ns.fetch_add(FastClock::now_ns() - wait_start_ns,
+                     std::memory_order_relaxed);
+}
+
+void InstrumentedLock::hold_starts()
+{
+  _hold_start_ns = FastClock::now_ns();
+}
+
+void InstrumentedLock::hold_ends()
+{
+  uint64_t hold_ns = FastClock::now_ns() - _hold_start_ns;
+  _hold_ns.fetch_add(hold_ns, std::memory_order_relaxed);
+
+  // Only the holder updates the maximum, so there's no need to loop.
+  if (hold_ns > _max_hold_ns.load(std::memory_order_relaxed))
+  {
+    _max_hold_ns.store(hold_ns, std::memory_order_relaxed);
+  }
+}
+
+LockStats InstrumentedLock::stats() const
+{
+  LockStats stats;
+  stats.acquisitions = _acquisitions.load(std::memory_order_relaxed);
+  stats.contended = _contended.load(std::memory_order_relaxed);
+  stats.wait_ns = _wait_ns.load(std::memory_order_relaxed);
+  stats.hold_ns = _hold_ns.load(std::memory_order_relaxed);
+  stats.max_hold_ns = _max_hold_ns.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void InstrumentedLock::reset()
+{
+  // This races with the lock being taken, so an acquisition in progress may
+  // be counted in the old or the new statistics.
+  _acquisitions.store(0, std::memory_order_relaxed);
+  _contended.store(0, std::memory_order_relaxed);
+  _wait_ns.store(0, std::memory_order_relaxed);
+  _hold_ns.store(0, std::memory_order_relaxed);
+  _max_hold_ns.store(0, std::memory_order_relaxed);
+}
+
+InstrumentedMutex::InstrumentedMutex(const char* site, bool recursive) :
+  InstrumentedLock(site),
+  _depth(0)
+{
+  pthread_mutexattr_t attrs;
+  pthread_mutexattr_init(&attrs);
+
+  if (recursive)
+  {
+    pthread_mutexattr_settype(&attrs, PTHREAD_MUTEX_RECURSIVE);
+  }
+
+  pthread_mutex_init(&_mutex, &attrs);
+  pthread_mutexattr_destroy(&attrs);
+}
+
+InstrumentedMutex::~InstrumentedMutex()
+{
+  pthread_mutex_destroy(&_mutex);
+}
+
+void InstrumentedMutex::lock()
+{
+  // Try to take the lock first, so that the clock is only read if the lock
+  // is contended.
+  if (pthread_mutex_trylock(&_mutex) == 0)
+  {
+    acquired(false, 0);
+  }
+  else
+  {
+    uint64_t wait_start_ns = FastClock::now_ns();
+    pthread_mutex_lock(&_mutex);
+    acquired(true, wait_start_ns);
+  }
+
+  // Only time the outermost hold of a recursive mutex.
+  if (_depth++ == 0)
+  {
+    hold_starts();
+  }
+}
+
+bool InstrumentedMutex::try_lock()
+{
+  if (pthread_mutex_trylock(&_mutex) != 0)
+  {
+    return false;
+  }
+
+  acquired(false, 0);
+
+  if (_depth++ == 0)
+  {
+    hold_starts();
+  }
+
+  return true;
+}
+
+void InstrumentedMutex::unlock()
+{
+  if (--_depth == 0)
+  {
+    hold_ends();
+  }
+
+  pthread_mutex_unlock(&_mutex);
+}
+
+InstrumentedSharedMutex::InstrumentedSharedMutex(const char* site) :
+  InstrumentedLock(site),
+  _mutex()
+{
+}
+
+InstrumentedSharedMutex::~InstrumentedSharedMutex()
+{
+}
+
+void InstrumentedSharedMutex::lock()
+{
+  if (_mutex.try_lock())
+  {
+    acquired(false, 0);
+  }
+  else
+  {
+    uint64_t wait_start_ns = FastClock::now_ns();
+    _mutex.lock();
+    acquired(true, wait_start_ns);
+  }
+
+  hold_starts();
+}
+
+bool InstrumentedSharedMutex::try_lock()
+{
+  if (!_mutex.try_lock())
+  {
+    return false;
+  }
+
+  acquired(false, 0);
+  hold_starts();
+  return true;
+}
+
+void InstrumentedSharedMutex::unlock()
+{
+  hold_ends();
+  _mutex.unlock();
+}
+
+void InstrumentedSharedMutex::lock_shared()
+{
+  // Uncontended shared acquisitions aren't recorded, so that readers don't
+  // write to the statistics.
+  if (!_mutex.try_lock_shared())
+  {
+    uint64_t wait_start_ns = FastClock::now_ns();
+    _mutex.lock_shared();
+    waited(wait_start_ns);
+  }
+}
+
+bool InstrumentedSharedMutex::try_lock_shared()
+{
+  return _mutex.try_lock_shared();
+}
+
+void InstrumentedSharedMutex::unlock_shared()
+{
+  _mutex.unlock_shared();
+}
@@ -0,0 +1,214 @@
+/**
+ * @file io_profiler.cpp Sampling profiler for blocking IO on worker threads.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "io_profiler.h"
+#include "fast_clock.h"
+
+namespace IoProfiler
+{
+
+/// The sproutlet name to use for IO done outside any sproutlet.
+static const std::string NO_SPROUTLET = "none";
+
+static std::atomic<int> profile_sample_rate(0);
+
+/// A thread's profile, and the IO regions it currently has open.  The lock
+/// is only ever contended by a reader merging the profiles.
+class ThreadProfile
+{
+public:
+  ThreadProfile();
+  ~ThreadProfile();
+
+  struct Region
+  {
+    bool sampled;
+    uint64_t start_ns;
+    std::string site;
+    const std::string* sproutlet;
+  };
+
+  std::mutex lock;
+  Profile profile;
+  std::vector<Region> regions;
+  uint32_t num_regions;
+};
+
+// The profiles of all running threads, plus the merged profiles of threads
+// that have exited.
+static std::mutex registry_lock;
+static std::set<ThreadProfile*> thread_profiles;
+static Profile exited_profile;
+
+static thread_local const std::string* current_sproutlet = NULL;
+
+ThreadProfile::ThreadProfile() :
+  lock(),
+  profile(),
+  regions(),
+  num_regions(0)
+{
+  std::unique_lock<std::mutex> registry(registry_lock);
+  thread_profiles.insert(this);
+}
+
+ThreadProfile::~ThreadProfile()
+{
+  std::unique_lock<std::mutex> registry(registry_lock);
+  thread_profiles.erase(this);
+
+  for (const std::pair<const SiteKey, SiteStats>& site : profile)
+  {
+    exited_profile[site.first].merge(site.second);
+  }
+}
+
+static ThreadProfile& thread_profile()
+{
+  static thread_local ThreadProfile profile;
+  return profile;
+}
+
+void SiteStats::add(uint64_t duration_us)
+{
+  int bucket = 0;
+
+  if (duration_us > 1)
+  {
+    bucket = std::min(63 - __builtin_clzll(duration_us), NUM_BUCKETS - 1);
+  }
+
+  ++count;
+  total_us += duration_us;
+  max_us = std::max(max_us, duration_us);
+  ++buckets[bucket];
+}
+
+void SiteStats::merge(const SiteStats& other)
+{
+  count += other.count;
+  total_us += other.total_us;
+  max_us = std::max(max_us, other.max_us);
+
+  for (int ii = 0; ii < NUM_BUCKETS; ++ii)
+  {
+    buckets[ii] += other.buckets[ii];
+  }
+}
+
+void set_sample_rate(int sample_rate)
+{
+  profile_sample_rate = std::max(sample_rate, 0);
+}
+
+int sample_rate()
+{
+  return profile_sample_rate;
+}
+
+void io_started(const std::string& reason)
+{
+  ThreadProfile& tp = thread_profile();
+  int rate = profile_sample_rate.load(std::memory_order_relaxed);
+
+  // Every region is pushed, sampled or not, so that nested regions complete
+  // against the right start.
+  ThreadProfile::Region region;
+  region.sampled = (rate > 0) && ((tp.num_regions++ % rate) == 0);
+  region.start_ns = 0;
+  region.sproutlet = NULL;
+
+  if (region.sampled)
+  {
+    region.site = reason;
+    region.sproutlet = current_sproutlet;
+    region.start_ns = FastClock::now_ns();
+  }
+
+  tp.regions.push_back(region);
+}
+
+void io_completed(const std::string& reason)
+{
+  ThreadProfile& tp = thread_profile();
+
+  if (tp.regions.empty())
+  {
+    // The hook was installed part way through a region.
+    return;
+  }
+
+  const ThreadProfile::Region& region = tp.regions.back();
+
+  if (region.sampled)
+  {
+    uint64_t duration_us = (FastClock::now_ns() - region.start_ns) / 1000;
+    SiteKey key(region.site,
+                (region.sproutlet != NULL) ? *region.sproutlet : NO_SPROUTLET);
+
+    std::unique_lock<std::mutex> lock(tp.lock);
+    tp.profile[key].add(duration_us);
+  }
+
+  tp.regions.pop_back();
+}
+
+void get_profile(Profile& profile)
+{
+  std::unique_lock<std::mutex> registry(registry_lock);
+  profile = exited_profile;
+
+  for (ThreadProfile* tp : thread_profiles)
+  {
+    std::unique_lock<std::mutex> lock(tp->lock);
+
+    for (const std::pair<const SiteKey, SiteStats>& site : tp->profile)
+    {
+      profile[site.first].merge(site.second);
+    }
+  }
+}
+
+void reset()
+{
+  std::unique_lock<std::mutex> registry(registry_lock);
+  exited_profile.clear();
+
+  for (ThreadProfile* tp : thread_profiles)
+  {
+    std::unique_lock<std::mutex> lock(tp->lock);
+    tp->profile.clear();
+  }
+}
+
+uint64_t bucket_limit_us(int bucket)
+{
+  return (bucket < NUM_BUCKETS - 1) ? (2ull << bucket) : 0;
+}
+
+SproutletScope::SproutletScope(const std::string& sproutlet) :
+  _prev_sproutlet(current_sproutlet)
+{
+  current_sproutlet = &sproutlet;
+}
+
+SproutletScope::~SproutletScope()
+{
+  current_sproutlet = _prev_sproutlet;
+}
+
+};
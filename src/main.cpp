@@ -32,6 +32,8 @@ extern "C" {
 #include <list>
 #include <queue>
 #include <string>
+#include <thread>
+#include <functional>
 #include <boost/filesystem.hpp>
 
 #include "logger.h"
@@ -40,6 +42,7 @@ extern "C" {
 #include "analyticslogger.h"
 #include "subscriber_manager.h"
 #include "stack.h"
+#include "memory_accounting.h"
 #include "bono.h"
 #include "hssconnection.h"
 #include "xdmconnection.h"
@@ -83,6 +86,10 @@ extern "C" {
 #include "snmp_counter_table.h"
 #include "snmp_counter_by_scope_table.h"
 #include "snmp_success_fail_count_table.h"
+#include "sharded_stats.h"
+#include "fast_clock.h"
+#include "io_profiler.h"
+#include "slow_transactions.h"
 #include "snmp_agent.h"
 #include "ralf_processor.h"
 #include "sprout_alarmdefinition.h"
@@ -97,9 +104,14 @@ enum OptionTypes
   OPT_ADDITIONAL_HOME_DOMAINS,
   OPT_EMERGENCY_REG_ACCEPTED,
   OPT_SUB_MAX_EXPIRES,
+  OPT_EXPIRY_JITTER,
   OPT_DNS_SERVER,
   OPT_TARGET_LATENCY_US,
   OPT_OVERRIDE_NPDI,
+  OPT_IN_DIALOG_FAST_PATH,
+  OPT_IO_PROFILE_SAMPLE_RATE,
+  OPT_SLOW_TRANSACTIONS,
+  OPT_SLOW_TRANSACTIONS_WINDOW,
   OPT_MAX_TOKENS,
   OPT_INIT_TOKEN_RATE,
   OPT_MIN_TOKEN_RATE,
@@ -113,6 +125,8 @@ enum OptionTypes
   OPT_DNS_TIMEOUT,
   OPT_SESSION_CONTINUED_TIMEOUT_MS,
   OPT_SESSION_TERMINATED_TIMEOUT_MS,
+  OPT_AS_ADAPTIVE_TIMEOUT_FACTOR,
+  OPT_AS_CIRCUIT_BREAKER_THRESHOLD,
   OPT_STATELESS_PROXIES,
   OPT_MAX_SPROUTLET_DEPTH,
   OPT_RALF_THREADS,
@@ -183,6 +197,7 @@ const static struct pj_getopt_option long_opt[] =
   { "enforce-global-only-lookups",  no_argument,       0, 'g'},
   { "reg-max-expires",              required_argument, 0, 'e'},
   { "sub-max-expires",              required_argument, 0, OPT_SUB_MAX_EXPIRES},
+  { "expiry-jitter",                required_argument, 0, OPT_EXPIRY_JITTER},
   { "pjsip-threads",                required_argument, 0, 'P'},
   { "worker-threads",               required_argument, 0, 'W'},
   { "analytics",                    required_argument, 0, 'a'},
@@ -198,6 +213,10 @@ const static struct pj_getopt_option long_opt[] =
   { "interactive",                  no_argument,       0, 't'},
   { "help",                         no_argument,       0, 'h'},
   { "override-npdi",                no_argument,       0, OPT_OVERRIDE_NPDI},
+  { "in-dialog-fast-path",          no_argument,       0, OPT_IN_DIALOG_FAST_PATH},
+  { "io-profile-sample-rate",       required_argument, 0, OPT_IO_PROFILE_SAMPLE_RATE},
+  { "slow-transactions",            required_argument, 0, OPT_SLOW_TRANSACTIONS},
+  { "slow-transactions-window",     required_argument, 0, OPT_SLOW_TRANSACTIONS_WINDOW},
   { "max-tokens",                   required_argument, 0, OPT_MAX_TOKENS},
   { "init-token-rate",              required_argument, 0, OPT_INIT_TOKEN_RATE},
   { "min-token-rate",               required_argument, 0, OPT_MIN_TOKEN_RATE},
@@ -211,6 +230,8 @@ const static struct pj_getopt_option long_opt[] =
   { "dns-timeout",                  required_argument, 0, OPT_DNS_TIMEOUT},
   { "session-continued-timeout",    required_argument, 0, OPT_SESSION_CONTINUED_TIMEOUT_MS},
   { "session-terminated-timeout",   required_argument, 0, OPT_SESSION_TERMINATED_TIMEOUT_MS},
+  { "as-adaptive-timeout-factor",   required_argument, 0, OPT_AS_ADAPTIVE_TIMEOUT_FACTOR},
+  { "as-circuit-breaker-threshold", required_argument, 0, OPT_AS_CIRCUIT_BREAKER_THRESHOLD},
   { "stateless-proxies",            required_argument, 0, OPT_STATELESS_PROXIES},
   { "non-registering-pbxes",        required_argument, 0, OPT_NON_REGISTERING_PBXES},
   { "ralf-threads",                 required_argument, 0, OPT_RALF_THREADS},
@@ -336,6 +357,10 @@ static void usage(void)
        "                            The maximum allowed registration period (in seconds)\n"
        "     --sub-max-expires <expiry>\n"
        "                            The maximum allowed subscription period (in seconds)\n"
+       "     --expiry-jitter <percent>\n"
+       "                            Shorten granted registration and subscription periods by a\n"
+       "                            random amount of up to this percentage, so that devices that\n"
+       "                            register together don't refresh together (default: 0, disabled)\n"
        "     --default-session-expires <expiry>\n"
        "                            The session expiry period to request\n"
        "                            (in seconds. Min 90. Defaults to 600)\n"
@@ -375,6 +400,22 @@ static void usage(void)
        "     --alarms-enabled       Whether SNMP alarms are enabled (default: false)\n"
        "     --override-npdi        Whether the deployment should check for number portability data on \n"
        "                            requests that already have the 'npdi' indicator (default: false)\n"
+       "     --in-dialog-fast-path  Whether the S-CSCF should forward in-dialog requests that it isn't\n"
+       "                            billing, other than INVITEs and UPDATEs, without processing them\n"
+       "                            (default: false)\n"
+       "     --io-profile-sample-rate N\n"
+       "                            Profile one in every N blocking IO operations on the worker threads,\n"
+       "                            reported on the management interface at /io-profile. If this is 0,\n"
+       "                            IO is not profiled (default: 0)\n"
+       "     --slow-transactions N\n"
+       "                            The number of the slowest SIP messages to keep for each method,\n"
+       "                            reported on the management interface at /slow-transactions. If\n"
+       "                            this is 0, the slowest messages are not kept (default: 10)\n"
+       "     --slow-transactions-window <secs>\n"
+       "                            How long to keep each of the slowest SIP messages for\n"
+       "                            (default: 300).  The window rolls forward in tenths,\n"
+       "                            so the slowest messages are those from the last 90-100%\n"
+       "                            of it.\n"
        "     --exception-max-ttl <secs>\n"
        "                            The maximum time before the process exits if it hits an exception.\n"
        "                            The actual time is randomised.\n"
@@ -402,6 +443,16 @@ static void usage(void)
        "                            If an Application Server with default handling of 'terminate session'\n"
        "                            is unresponsive, this is the time that sprout will wait (in ms)\n"
        "                            before terminating the session.\n"
+       "     --as-adaptive-timeout-factor <factor>\n"
+       "                            If set, the time that sprout waits for an Application Server with\n"
+       "                            default handling of 'continue session' is this multiple of the 99th\n"
+       "                            percentile of the AS's recent response times, if that is shorter\n"
+       "                            than the session continued timeout (default: 0, disabled)\n"
+       "     --as-circuit-breaker-threshold <failures>\n"
+       "                            If set, an Application Server with default handling of 'continue\n"
+       "                            session' that fails this many times in a row is bypassed for 30\n"
+       "                            seconds, after which a single request is sent to it to check whether\n"
+       "                            it has recovered (default: 0, disabled)\n"
        "     --stateless-proxies <comma-separated-list>\n"
        "                            A comma separated list of domain names that are treated as SIP\n"
        "                            stateless proxies. This field should reflect how the servers are\n"
@@ -864,6 +915,14 @@ static pj_status_t init_options(int argc, char* argv[], struct options* options)
       }
       break;
 
+    case OPT_EXPIRY_JITTER:
+      {
+        VALIDATE_INT_PARAM(options->expiry_jitter_percent,
+                           expiry_jitter,
+                           Expiry jitter percentage);
+      }
+      break;
+
     case OPT_TARGET_LATENCY_US:
       {
         VALIDATE_INT_PARAM_NON_ZERO(options->target_latency_us,
@@ -1000,6 +1059,35 @@ static pj_status_t init_options(int argc, char* argv[], struct options* options)
       TRC_INFO("Number portability lookups will be done on URIs containing the 'npdi' indicator");
       break;
 
+    case OPT_IN_DIALOG_FAST_PATH:
+      options->in_dialog_fast_path = true;
+      TRC_INFO("Unbilled in-dialog requests will bypass S-CSCF processing");
+      break;
+
+    case OPT_IO_PROFILE_SAMPLE_RATE:
+      {
+        VALIDATE_INT_PARAM(options->io_profile_sample_rate,
+                           io_profile_sample_rate,
+                           Rate at which worker thread IO is profiled);
+      }
+      break;
+
+    case OPT_SLOW_TRANSACTIONS:
+      {
+        VALIDATE_INT_PARAM(options->slow_transactions,
+                           slow_transactions,
+                           Number of slowest SIP messages kept per method);
+      }
+      break;
+
+    case OPT_SLOW_TRANSACTIONS_WINDOW:
+      {
+        VALIDATE_INT_PARAM_NON_ZERO(options->slow_transactions_window,
+                                    slow_transactions_window,
+                                    Time for which the slowest SIP messages are kept);
+      }
+      break;
+
     case OPT_EXCEPTION_MAX_TTL:
       {
         VALIDATE_INT_PARAM(options->exception_max_ttl,
@@ -1070,6 +1158,22 @@ static pj_status_t init_options(int argc, char* argv[], struct options* options)
       }
       break;
 
+    case OPT_AS_ADAPTIVE_TIMEOUT_FACTOR:
+      {
+        VALIDATE_INT_PARAM(options->as_adaptive_timeout_factor,
+                           as_adaptive_timeout_factor,
+                           AS adaptive timeout factor);
+      }
+      break;
+
+    case OPT_AS_CIRCUIT_BREAKER_THRESHOLD:
+      {
+        VALIDATE_INT_PARAM(options->as_circuit_breaker_threshold,
+                           as_circuit_breaker_threshold,
+                           AS circuit breaker threshold);
+      }
+      break;
+
     case OPT_STATELESS_PROXIES:
       {
         std::vector<std::string> stateless_proxies;
@@ -1411,6 +1515,8 @@ SIFCService* sifc_service = NULL;
 FIFCService* fifc_service = NULL;
 SasService* sas_service = NULL;
 IFCConfiguration ifc_configuration = {};
+ExpiryJitter* reg_expiry_jitter = NULL;
+ExpiryJitter* sub_expiry_jitter = NULL;
 
 int create_astaire_stores(struct options opt,
                           AstaireResolver*& astaire_resolver,
@@ -1625,6 +1731,44 @@ void create_chronos_connection(struct options opt,
 
 }
 
+/// Runs a set of independent start-up tasks (typically loading configuration
+/// files) concurrently, returning once they have all completed.
+static void run_startup_tasks(const std::vector<std::function<void()>>& tasks)
+{
+  std::vector<std::thread> threads;
+  threads.reserve(tasks.size());
+
+  for (const std::function<void()>& task : tasks)
+  {
+    threads.push_back(std::thread(task));
+  }
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+}
+
+/// Records how long a phase of start-up took, logging it and reporting it in
+/// the supplied statistic (if there is one).
+static void report_startup_phase(const char* phase,
+                                 Utils::StopWatch& stopwatch,
+                                 SNMP::U32Scalar* statistic)
+{
+  unsigned long duration_us = 0;
+  stopwatch.stop();
+
+  if (stopwatch.read(duration_us))
+  {
+    TRC_STATUS("Start-up phase %s took %lums", phase, duration_us / 1000);
+
+    if (statistic != NULL)
+    {
+      statistic->value = duration_us / 1000;
+    }
+  }
+}
+
 /*
  * main()
  */
@@ -1651,6 +1795,16 @@ int main(int argc, char* argv[])
   CommunicationMonitor* remote_astaire_comm_monitor = NULL;
   CommunicationMonitor* ralf_comm_monitor = NULL;
   RPHService* rph_service = NULL;
+  SNMP::U32Scalar* startup_stack_time = NULL;
+  SNMP::U32Scalar* startup_config_time = NULL;
+  SNMP::U32Scalar* startup_plugin_time = NULL;
+  SNMP::U32Scalar* startup_total_time = NULL;
+  MemoryAccounting::Reporter* memory_reporter = NULL;
+
+  // Time the whole of start-up, and each of its slower phases.
+  Utils::StopWatch startup_stopwatch;
+  Utils::StopWatch phase_stopwatch;
+  startup_stopwatch.start();
 
   // Set up our exception signal handler for asserts and segfaults.
   signal(SIGABRT, signal_handler);
@@ -1677,6 +1831,7 @@ int main(int argc, char* argv[])
   opt.reg_max_expires = 300;
 
   opt.sub_max_expires = 0;
+  opt.expiry_jitter_percent = 0;
   opt.record_routing_model = 1;
   opt.default_session_expires = 10 * 60;
   opt.worker_threads = 1;
@@ -1697,6 +1852,10 @@ int main(int argc, char* argv[])
   opt.daemon = PJ_FALSE;
   opt.interactive = PJ_FALSE;
   opt.override_npdi = PJ_FALSE;
+  opt.in_dialog_fast_path = PJ_FALSE;
+  opt.io_profile_sample_rate = 0;
+  opt.slow_transactions = SlowTransactions::DEFAULT_COUNT;
+  opt.slow_transactions_window = SlowTransactions::DEFAULT_WINDOW_S;
   opt.exception_max_ttl = 600;
   opt.sip_blacklist_duration = SIPResolver::DEFAULT_BLACKLIST_DURATION;
   opt.http_blacklist_duration = HttpResolver::DEFAULT_BLACKLIST_DURATION;
@@ -1706,6 +1865,8 @@ int main(int argc, char* argv[])
   opt.dns_timeout = DnsCachedResolver::DEFAULT_TIMEOUT;
   opt.session_continued_timeout_ms = SCSCFSproutlet::DEFAULT_SESSION_CONTINUED_TIMEOUT;
   opt.session_terminated_timeout_ms = SCSCFSproutlet::DEFAULT_SESSION_TERMINATED_TIMEOUT;
+  opt.as_adaptive_timeout_factor = 0;
+  opt.as_circuit_breaker_threshold = 0;
   opt.stateless_proxies.clear();
   opt.max_sproutlet_depth = SproutletProxy::DEFAULT_MAX_SPROUTLET_DEPTH;
   opt.ralf_threads = 25;
@@ -1765,6 +1926,9 @@ int main(int argc, char* argv[])
 
   init_pjsip_logging(opt.log_level, opt.log_to_file, opt.log_directory);
 
+  // Start the clock used for latency accounting before anything is timed.
+  FastClock::start();
+
   std::stringstream options_ss;
   for (int ii = 0; ii < argc; ii++)
   {
@@ -1903,6 +2067,7 @@ int main(int argc, char* argv[])
   SNMP::SuccessFailCountByPriorityAndScopeTable* queue_success_fail_table;
   SNMP::CounterByScopeTable* requests_counter;
   SNMP::CounterByScopeTable* overload_counter;
+  SNMP::CounterByScopeTable* options_fast_path_counter;
 
   SNMP::IPCountTable* homestead_cxn_count = NULL;
 
@@ -1938,6 +2103,8 @@ int main(int argc, char* argv[])
                                                          ".1.2.826.0.1.1578918.9.2.4");
     overload_counter = SNMP::CounterByScopeTable::create("bono_rejected_overload",
                                                          ".1.2.826.0.1.1578918.9.2.5");
+    options_fast_path_counter = SNMP::CounterByScopeTable::create("bono_options_fast_path",
+                                                                  ".1.2.826.0.1.1578918.9.2.8");
   }
   else
   {
@@ -1951,6 +2118,8 @@ int main(int argc, char* argv[])
                                                          ".1.2.826.0.1.1578918.9.3.6");
     overload_counter = SNMP::CounterByScopeTable::create("sprout_rejected_overload",
                                                          ".1.2.826.0.1.1578918.9.3.7");
+    options_fast_path_counter = SNMP::CounterByScopeTable::create("sprout_options_fast_path",
+                                                                  ".1.2.826.0.1.1578918.9.3.56");
 
     homestead_cxn_count = SNMP::IPCountTable::create("sprout_homestead_cxn_count",
                                                      ".1.2.826.0.1.1578918.9.3.3.1");
@@ -1992,7 +2161,50 @@ int main(int argc, char* argv[])
                                                            "1.2.826.0.1.1578918.9.3.44");
     accept_for_remote_alias_tbl = SNMP::CounterTable::create("accept_for_remote_alias",
                                                            "1.2.826.0.1.1578918.9.3.45");
-  }
+
+    startup_stack_time = new SNMP::U32Scalar("sprout_startup_stack_init_time",
+                                             ".1.2.826.0.1.1578918.9.3.46");
+    startup_config_time = new SNMP::U32Scalar("sprout_startup_config_load_time",
+                                              ".1.2.826.0.1.1578918.9.3.47");
+    startup_plugin_time = new SNMP::U32Scalar("sprout_startup_plugin_load_time",
+                                              ".1.2.826.0.1.1578918.9.3.48");
+    startup_total_time = new SNMP::U32Scalar("sprout_startup_total_time",
+                                             ".1.2.826.0.1.1578918.9.3.49");
+  }
+
+  // The statistics that are updated on every message are updated per thread,
+  // and merged into the SNMP tables in the background.
+  ShardedStatsFlusher* stats_flusher = new ShardedStatsFlusher();
+  latency_table =
+    new ShardedAccumulator<SNMP::EventAccumulatorByScopeTable>(latency_table,
+                                                               stats_flusher);
+  queue_size_table =
+    new ShardedAccumulator<SNMP::EventAccumulatorByScopeTable>(queue_size_table,
+                                                               stats_flusher);
+  requests_counter =
+    new ShardedCounter<SNMP::CounterByScopeTable>(requests_counter,
+                                                  stats_flusher);
+
+  if (!opt.pcscf_enabled)
+  {
+    homestead_latency_table =
+      new ShardedAccumulator<SNMP::EventAccumulatorTable>(homestead_latency_table,
+                                                          stats_flusher);
+    homestead_mar_latency_table =
+      new ShardedAccumulator<SNMP::EventAccumulatorTable>(homestead_mar_latency_table,
+                                                          stats_flusher);
+    homestead_sar_latency_table =
+      new ShardedAccumulator<SNMP::EventAccumulatorTable>(homestead_sar_latency_table,
+                                                          stats_flusher);
+    homestead_uar_latency_table =
+      new ShardedAccumulator<SNMP::EventAccumulatorTable>(homestead_uar_latency_table,
+                                                          stats_flusher);
+    homestead_lir_latency_table =
+      new ShardedAccumulator<SNMP::EventAccumulatorTable>(homestead_lir_latency_table,
+                                                          stats_flusher);
+  }
+
+  stats_flusher->start();
 
   // Create Sprout's alarm objects.
   alarm_manager = new AlarmManager();
@@ -2070,6 +2282,7 @@ int main(int argc, char* argv[])
   SasService* sas_service = new SasService(opt.sas_system_name, system_type_sas, opt.sas_signaling_if);
 
   // Initialize the PJSIP stack and associated subsystems.
+  phase_stopwatch.start();
   status = init_stack(opt.pcscf_trusted_port,
                       opt.pcscf_untrusted_port,
                       opt.port_scscf,
@@ -2100,6 +2313,15 @@ int main(int argc, char* argv[])
     return 1;
   }
 
+  report_startup_phase("stack initialisation", phase_stopwatch, startup_stack_time);
+
+  if (!opt.pcscf_enabled)
+  {
+    // Report the memory used by the PJSIP pools and Sprout's subsystems in
+    // SNMP.
+    memory_reporter = new MemoryAccounting::Reporter(&stack_data.cp);
+  }
+
   //If the flag is set, disable UDP-to-TCP uplift.
   if (opt.disable_tcp_switch)
   {
@@ -2141,45 +2363,37 @@ int main(int argc, char* argv[])
     CL_SPROUT_NO_RALF_CONFIGURED.log();
   }
 
-  // Initialise the OPTIONS handling module.
-  init_options();
+  // Initialise the OPTIONS handling modules.
+  init_options(options_fast_path_counter);
+
+  // Load the shared iFC, fallback iFC, ENUM and RPH configuration.  Each
+  // service reads its configuration file when it is created, and they don't
+  // depend on each other, so create them in parallel.  Their alarms are
+  // created on this thread first.
+  phase_stopwatch.start();
+  std::vector<std::function<void()>> config_tasks;
 
   if (opt.hss_server != "")
   {
-    // Create a connection to the HSS.
-    TRC_STATUS("Creating connection to HSS %s with HTTP timeout %d",
-               opt.hss_server.c_str(), opt.homestead_timeout);
-    sifc_service = new SIFCService(new Alarm(alarm_manager,
-                                             "sprout",
-                                             AlarmDef::SPROUT_SIFC_STATUS,
-                                             AlarmDef::CRITICAL),
-                                   no_shared_ifcs_set_table);
-    hss_connection = new HSSConnection(opt.hss_server,
-                                       http_resolver,
-                                       load_monitor,
-                                       homestead_cxn_count,
-                                       homestead_latency_table,
-                                       homestead_mar_latency_table,
-                                       homestead_sar_latency_table,
-                                       homestead_uar_latency_table,
-                                       homestead_lir_latency_table,
-                                       hss_comm_monitor,
-                                       sifc_service,
-                                       opt.homestead_timeout);
+    Alarm* sifc_alarm = new Alarm(alarm_manager,
+                                  "sprout",
+                                  AlarmDef::SPROUT_SIFC_STATUS,
+                                  AlarmDef::CRITICAL);
+    config_tasks.push_back([sifc_alarm, no_shared_ifcs_set_table]()
+    {
+      sifc_service = new SIFCService(sifc_alarm, no_shared_ifcs_set_table);
+    });
   }
 
   // Create FIFC service
-  fifc_service = new FIFCService(new Alarm(alarm_manager,
-                                           "sprout",
-                                           AlarmDef::SPROUT_FIFC_STATUS,
-                                           AlarmDef::CRITICAL));
-
-  // Create the IFC Configuration
-  ifc_configuration = IFCConfiguration(opt.apply_fallback_ifcs,
-                                       opt.reject_if_no_matching_ifcs,
-                                       opt.dummy_app_server,
-                                       no_matching_ifcs_tbl,
-                                       no_matching_fallback_ifcs_tbl);
+  Alarm* fifc_alarm = new Alarm(alarm_manager,
+                                "sprout",
+                                AlarmDef::SPROUT_FIFC_STATUS,
+                                AlarmDef::CRITICAL);
+  config_tasks.push_back([fifc_alarm]()
+  {
+    fifc_service = new FIFCService(fifc_alarm);
+  });
 
   // Create ENUM service.
   if (!opt.enum_servers.empty())
@@ -2193,7 +2407,11 @@ int main(int argc, char* argv[])
   else if (!opt.enum_file.empty())
   {
     TRC_STATUS("Reading from an ENUM file");
-    enum_service = new JSONEnumService(opt.enum_file);
+    std::string enum_file = opt.enum_file;
+    config_tasks.push_back([enum_file]()
+    {
+      enum_service = new JSONEnumService(enum_file);
+    });
   }
   else if (opt.default_tel_uri_translation)
   {
@@ -2203,10 +2421,43 @@ int main(int argc, char* argv[])
 
   // Create RPH service.
   TRC_STATUS("Setting up RPH service");
-  rph_service = new RPHService(new Alarm(alarm_manager,
-                                         "sprout",
-                                         AlarmDef::SPROUT_RPH_STATUS,
-                                         AlarmDef::CRITICAL));
+  Alarm* rph_alarm = new Alarm(alarm_manager,
+                               "sprout",
+                               AlarmDef::SPROUT_RPH_STATUS,
+                               AlarmDef::CRITICAL);
+  config_tasks.push_back([rph_alarm, &rph_service]()
+  {
+    rph_service = new RPHService(rph_alarm);
+  });
+
+  run_startup_tasks(config_tasks);
+  report_startup_phase("configuration loading", phase_stopwatch, startup_config_time);
+
+  if (opt.hss_server != "")
+  {
+    // Create a connection to the HSS.
+    TRC_STATUS("Creating connection to HSS %s with HTTP timeout %d",
+               opt.hss_server.c_str(), opt.homestead_timeout);
+    hss_connection = new HSSConnection(opt.hss_server,
+                                       http_resolver,
+                                       load_monitor,
+                                       homestead_cxn_count,
+                                       homestead_latency_table,
+                                       homestead_mar_latency_table,
+                                       homestead_sar_latency_table,
+                                       homestead_uar_latency_table,
+                                       homestead_lir_latency_table,
+                                       hss_comm_monitor,
+                                       sifc_service,
+                                       opt.homestead_timeout);
+  }
+
+  // Create the IFC Configuration
+  ifc_configuration = IFCConfiguration(opt.apply_fallback_ifcs,
+                                       opt.reject_if_no_matching_ifcs,
+                                       opt.dummy_app_server,
+                                       no_matching_ifcs_tbl,
+                                       no_matching_fallback_ifcs_tbl);
 
   if (opt.pcscf_enabled)
   {
@@ -2296,6 +2547,16 @@ int main(int argc, char* argv[])
                                              notify_sender,
                                              registration_sender);
 
+  if (opt.expiry_jitter_percent > 0)
+  {
+    // Randomise granted expiries so that devices that register together
+    // don't stay synchronised.
+    reg_expiry_jitter = new ExpiryJitter(opt.reg_max_expires,
+                                         opt.expiry_jitter_percent);
+    sub_expiry_jitter = new ExpiryJitter(opt.sub_max_expires,
+                                         opt.expiry_jitter_percent);
+  }
+
   // Start the HTTP stack early as plugins might need to register handlers
   // with it.
   HttpStack* http_stack_sig = new HttpStack(opt.http_threads,
@@ -2331,6 +2592,7 @@ int main(int argc, char* argv[])
   }
 
   // Load the sproutlet plugins.
+  phase_stopwatch.start();
   PluginLoader* loader = new PluginLoader("/usr/share/clearwater/sprout/plugins",
                                           opt);
 
@@ -2341,6 +2603,8 @@ int main(int argc, char* argv[])
     return 1;
   }
 
+  report_startup_phase("plug-in loading", phase_stopwatch, startup_plugin_time);
+
   // Must happen after all SNMP tables have been registered.
   if (opt.pcscf_enabled)
   {
@@ -2388,6 +2652,10 @@ int main(int argc, char* argv[])
   init_common_sip_processing(requests_counter,
                              hc);
 
+  IoProfiler::set_sample_rate(opt.io_profile_sample_rate);
+  SlowTransactions::configure(opt.slow_transactions,
+                              opt.slow_transactions_window);
+
   init_thread_dispatcher(opt.worker_threads,
                          latency_table,
                          queue_size_table,
@@ -2435,6 +2703,19 @@ int main(int argc, char* argv[])
 
   GetBindingsTask::Config get_bindings_config(subscriber_manager);
   GetSubscriptionsTask::Config get_subscriptions_config(subscriber_manager);
+  GetBulkBindingsTask::LookupPool* bulk_bindings_pool =
+    new GetBulkBindingsTask::LookupPool(exception_handler,
+                                        GetBulkBindingsTask::NUM_LOOKUP_THREADS);
+  bulk_bindings_pool->start();
+  GetBulkBindingsTask::Config get_bulk_bindings_config(subscriber_manager,
+                                                       bulk_bindings_pool);
+  GetMemoryTask::Config get_memory_config(&stack_data.cp,
+                                          stack_data.adaptive_pools);
+  IoProfileTask::Config io_profile_config;
+  LockStatsTask::Config lock_stats_config;
+  SlowTransactionsTask::Config slow_transactions_config;
+  ExpiryJitterTask::Config expiry_jitter_config(reg_expiry_jitter,
+                                                sub_expiry_jitter);
 
   HttpStackUtils::TimerHandler<ChronosAoRTimeoutTask, AoRTimeoutTask::Config> aor_timeout_handler(&aor_timeout_config);
   HttpStackUtils::TimerHandler<ChronosAuthTimeoutTask, AuthTimeoutTask::Config> auth_timeout_handler(&auth_timeout_config);
@@ -2444,6 +2725,12 @@ int main(int argc, char* argv[])
 
   HttpStackUtils::SpawningHandler<GetBindingsTask, GetBindingsTask::Config> get_bindings_handler(&get_bindings_config);
   HttpStackUtils::SpawningHandler<GetSubscriptionsTask, GetSubscriptionsTask::Config> get_subscriptions_handler(&get_subscriptions_config);
+  HttpStackUtils::SpawningHandler<GetBulkBindingsTask, GetBulkBindingsTask::Config> get_bulk_bindings_handler(&get_bulk_bindings_config);
+  HttpStackUtils::SpawningHandler<GetMemoryTask, GetMemoryTask::Config> get_memory_handler(&get_memory_config);
+  HttpStackUtils::SpawningHandler<IoProfileTask, IoProfileTask::Config> io_profile_handler(&io_profile_config);
+  HttpStackUtils::SpawningHandler<LockStatsTask, LockStatsTask::Config> lock_stats_handler(&lock_stats_config);
+  HttpStackUtils::SpawningHandler<SlowTransactionsTask, SlowTransactionsTask::Config> slow_transactions_handler(&slow_transactions_config);
+  HttpStackUtils::SpawningHandler<ExpiryJitterTask, ExpiryJitterTask::Config> expiry_jitter_handler(&expiry_jitter_config);
 
   HttpStackUtils::SpawningHandler<DeleteImpuTask, DeleteImpuTask::Config> delete_impu_handler(&delete_impu_config);
 
@@ -2479,6 +2766,18 @@ int main(int argc, char* argv[])
                                         &get_bindings_handler);
       http_stack_mgmt->register_handler("^/impu/[^/]+/subscriptions$",
                                         &get_subscriptions_handler);
+      http_stack_mgmt->register_handler("^/impus/bindings$",
+                                        &get_bulk_bindings_handler);
+      http_stack_mgmt->register_handler("^/memory$",
+                                        &get_memory_handler);
+      http_stack_mgmt->register_handler("^/io-profile$",
+                                        &io_profile_handler);
+      http_stack_mgmt->register_handler("^/locks$",
+                                        &lock_stats_handler);
+      http_stack_mgmt->register_handler("^/slow-transactions$",
+                                        &slow_transactions_handler);
+      http_stack_mgmt->register_handler("^/expiry-jitter$",
+                                        &expiry_jitter_handler);
       http_stack_mgmt->register_handler("^/impu/[^/]+$",
                                         &delete_impu_handler);
       http_stack_mgmt->bind_unix_socket(SPROUT_HTTP_MGMT_SOCKET_PATH);
@@ -2492,6 +2791,8 @@ int main(int argc, char* argv[])
     }
   }
 
+  report_startup_phase("total", startup_stopwatch, startup_total_time);
+
   // Wait here until the quit semaphore is signaled.
   sem_wait(&term_sem);
 
@@ -2531,6 +2832,11 @@ int main(int argc, char* argv[])
     }
   }
 
+  // Stop the bulk bindings lookups once nothing can queue any more.
+  bulk_bindings_pool->stop();
+  bulk_bindings_pool->join();
+  delete bulk_bindings_pool; bulk_bindings_pool = NULL;
+
   // Terminate the PJSIP thread and the worker threads to exit.  We kill
   // the PJSIP thread first - if we killed the worker threads first the
   // rx_msg_q will stop getting serviced so could fill up blocking
@@ -2564,6 +2870,8 @@ int main(int argc, char* argv[])
   }
 
   destroy_options();
+
+  delete memory_reporter; memory_reporter = NULL;
   destroy_stack();
 
   delete http_stack_sig; http_stack_sig = NULL;
@@ -2578,6 +2886,8 @@ int main(int argc, char* argv[])
   delete exception_handler;
   delete load_monitor;
   delete subscriber_manager;
+  delete reg_expiry_jitter;
+  delete sub_expiry_jitter;
   delete notify_sender;
   delete s4;
   delete local_aor_store;
@@ -2644,6 +2954,7 @@ int main(int argc, char* argv[])
   delete queue_size_table;
   delete requests_counter;
   delete overload_counter;
+  delete options_fast_path_counter;
 
   delete homestead_cxn_count;
 
@@ -2654,6 +2965,10 @@ int main(int argc, char* argv[])
   delete homestead_lir_latency_table;
   delete no_shared_ifcs_set_table;
 
+  // The sharded statistics have all been deleted, so the flusher has nothing
+  // left to flush.
+  delete stats_flusher;
+
   delete token_rate_table;
   delete smoothed_latency_scalar;
   delete target_latency_scalar;
@@ -2668,6 +2983,10 @@ int main(int argc, char* argv[])
 
   delete route_to_remote_alias_tbl;
   delete accept_for_remote_alias_tbl;
+  delete startup_stack_time;
+  delete startup_config_time;
+  delete startup_plugin_time;
+  delete startup_total_time;
 
   hc->stop_thread();
   delete hc;
@@ -2680,6 +2999,8 @@ int main(int argc, char* argv[])
 
   sem_destroy(&term_sem);
 
+  FastClock::stop();
+
   return 0;
 }
 
@@ -0,0 +1,197 @@
+/**
+ * @file memory_accounting.cpp Accounting of the memory used by Sprout's
+ * subsystems.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "memory_accounting.h"
+
+MemoryAccount::MemoryAccount(const char* name) :
+  _name(name),
+  _bytes(0),
+  _high_water_bytes(0),
+  _allocations(0),
+  _frees(0)
+{
+}
+
+void MemoryAccount::allocated(size_t bytes)
+{
+  int64_t now = (_bytes += bytes);
+  ++_allocations;
+  update_high_water(now);
+}
+
+void MemoryAccount::freed(size_t bytes)
+{
+  _bytes -= bytes;
+  ++_frees;
+}
+
+void MemoryAccount::replaced(size_t bytes)
+{
+  _bytes = bytes;
+  ++_allocations;
+  update_high_water(bytes);
+}
+
+void MemoryAccount::update_high_water(int64_t bytes)
+{
+  int64_t high_water = _high_water_bytes.load();
+  while ((bytes > high_water) &&
+         (!_high_water_bytes.compare_exchange_weak(high_water, bytes)))
+  {
+  }
+}
+
+MemoryAccount::Stats MemoryAccount::stats() const
+{
+  Stats stats;
+  stats.bytes = _bytes.load();
+  stats.high_water_bytes = _high_water_bytes.load();
+  stats.allocations = _allocations.load();
+  stats.frees = _frees.load();
+  return stats;
+}
+
+namespace MemoryAccounting
+{
+
+MemoryAccount odi_tokens("odi_tokens");
+MemoryAccount acr_queue("acr_queue");
+MemoryAccount shared_ifcs("shared_ifcs");
+
+MemoryAccount* const ACCOUNTS[] = {&odi_tokens, &acr_queue, &shared_ifcs};
+const size_t NUM_ACCOUNTS = sizeof(ACCOUNTS) / sizeof(ACCOUNTS[0]);
+
+/// Pool name prefixes, and the owner they indicate.
+static const struct
+{
+  const char* prefix;
+  const char* owner;
+} POOL_OWNERS[] =
+{
+  {"tsx", "tsx"},
+  {"rtd", "rdata"},
+  {"tdta", "tdata"},
+  {"dlg", "dialog"},
+  {"app-route", "sproutlet"},
+  {"sprout-bono", "stack"},
+};
+
+std::string pool_owner(const char* pool_name)
+{
+  for (size_t ii = 0; ii < sizeof(POOL_OWNERS) / sizeof(POOL_OWNERS[0]); ++ii)
+  {
+    if (strncmp(pool_name,
+                POOL_OWNERS[ii].prefix,
+                strlen(POOL_OWNERS[ii].prefix)) == 0)
+    {
+      return POOL_OWNERS[ii].owner;
+    }
+  }
+
+  return "other";
+}
+
+void get_factory_stats(pj_caching_pool* cp, PoolFactoryStats& stats)
+{
+  stats.used_bytes = cp->used_size;
+  stats.peak_used_bytes = cp->peak_used_size;
+  stats.used_pools = cp->used_count;
+  stats.cached_bytes = cp->capacity;
+}
+
+void get_pool_stats_by_owner(pj_caching_pool* cp,
+                             std::map<std::string, PoolStats>& stats)
+{
+  pj_lock_acquire(cp->lock);
+
+  for (pj_pool_t* pool = (pj_pool_t*)cp->used_list.next;
+       pool != (pj_pool_t*)&cp->used_list;
+       pool = pool->next)
+  {
+    PoolStats& owner_stats = stats[pool_owner(pj_pool_getobjname(pool))];
+    owner_stats.pools++;
+    owner_stats.used_bytes += pj_pool_get_used_size(pool);
+    owner_stats.capacity_bytes += pj_pool_get_capacity(pool);
+  }
+
+  pj_lock_release(cp->lock);
+}
+
+// LCOV_EXCL_START - The reporter just copies figures into SNMP scalars.
+
+Reporter::Reporter(pj_caching_pool* cp, int interval_ms) :
+  _cp(cp),
+  _interval_ms(interval_ms),
+  _pool_kbytes("sprout_pjsip_pool_kbytes", ".1.2.826.0.1.1578918.9.3.50"),
+  _pool_peak_kbytes("sprout_pjsip_pool_peak_kbytes", ".1.2.826.0.1.1578918.9.3.51"),
+  _pool_count("sprout_pjsip_pool_count", ".1.2.826.0.1.1578918.9.3.52"),
+  _odi_token_kbytes("sprout_odi_token_kbytes", ".1.2.826.0.1.1578918.9.3.53"),
+  _acr_queue_kbytes("sprout_acr_queue_kbytes", ".1.2.826.0.1.1578918.9.3.54"),
+  _shared_ifc_kbytes("sprout_shared_ifc_kbytes", ".1.2.826.0.1.1578918.9.3.55"),
+  _terminate(false),
+  _lock(),
+  _cond(),
+  _thread()
+{
+  report();
+  _thread = std::thread(&Reporter::run, this);
+}
+
+Reporter::~Reporter()
+{
+  {
+    std::unique_lock<std::mutex> lock(_lock);
+    _terminate = true;
+    _cond.notify_all();
+  }
+
+  _thread.join();
+}
+
+void Reporter::run()
+{
+  std::unique_lock<std::mutex> lock(_lock);
+
+  while (!_terminate)
+  {
+    _cond.wait_for(lock, std::chrono::milliseconds(_interval_ms));
+
+    if (!_terminate)
+    {
+      report();
+    }
+  }
+}
+
+void Reporter::report()
+{
+  PoolFactoryStats factory;
+  get_factory_stats(_cp, factory);
+
+  _pool_kbytes.value = factory.used_bytes / 1024;
+  _pool_peak_kbytes.value = factory.peak_used_bytes / 1024;
+  _pool_count.value = factory.used_pools;
+
+  // An estimate can briefly go negative if frees are recorded before the
+  // matching allocations, so clamp at zero.
+  _odi_token_kbytes.value = std::max(odi_tokens.stats().bytes, (int64_t)0) / 1024;
+  _acr_queue_kbytes.value = std::max(acr_queue.stats().bytes, (int64_t)0) / 1024;
+  _shared_ifc_kbytes.value = std::max(shared_ifcs.stats().bytes, (int64_t)0) / 1024;
+}
+
+// LCOV_EXCL_STOP
+
+}
@@ -32,6 +32,40 @@ static int xml_print_body(struct pjsip_msg_body *msg_body,
                       PJ_TRUE);
 }
 
+// Returns the bindings that aren't emergency registrations. Emergency
+// registrations are rare, so in the common case this returns the original
+// bindings and only builds a filtered map (of the same Binding pointers) in
+// filtered if it has to.
+static const Bindings& non_emergency_bindings(const Bindings& bindings,
+                                              Bindings& filtered)
+{
+  bool has_emergency = false;
+
+  for (BindingPair binding_pair : bindings)
+  {
+    if (binding_pair.second->_emergency_registration)
+    {
+      has_emergency = true;
+      break;
+    }
+  }
+
+  if (!has_emergency)
+  {
+    return bindings;
+  }
+
+  for (BindingPair binding_pair : bindings)
+  {
+    if (!binding_pair.second->_emergency_registration)
+    {
+      filtered.insert(filtered.end(), binding_pair);
+    }
+  }
+
+  return filtered;
+}
+
 NotifySender::NotifySender()
 {
 }
@@ -55,25 +89,12 @@ void NotifySender::send_notifys(const std::string& aor_id,
 
   // Don't include any emergency registrations in the NOTIFYs - TS specs
   // say that they shouldn't be present.
-  Bindings orig_bindings;
-
-  for (BindingPair binding_pair : orig_aor.bindings())
-  {
-    if (!binding_pair.second->_emergency_registration)
-    {
-      orig_bindings.insert(binding_pair);
-    }
-  }
-
-  Bindings updated_bindings;
-
-  for (BindingPair binding_pair : updated_aor.bindings())
-  {
-    if (!binding_pair.second->_emergency_registration)
-    {
-      updated_bindings.insert(binding_pair);
-    }
-  }
+  Bindings orig_filtered;
+  const Bindings& orig_bindings =
+                   non_emergency_bindings(orig_aor.bindings(), orig_filtered);
+  Bindings updated_filtered;
+  const Bindings& updated_bindings =
+             non_emergency_bindings(updated_aor.bindings(), updated_filtered);
 
   ClassifiedBindings classified_bindings;
   SubscriberDataUtils::classify_bindings(aor_id,
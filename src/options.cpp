@@ -20,11 +20,15 @@ extern "C" {
 #include "sproutsasevent.h"
 #include "pjutils.h"
 #include "uri_classifier.h"
+#include "options.h"
 
 //
 // mod_options handles SIP OPTIONS polls targeted at this system.
 //
 static pj_bool_t on_rx_request(pjsip_rx_data *rdata);
+static pj_bool_t fast_path_on_rx_request(pjsip_rx_data *rdata);
+
+static SNMP::CounterByScopeTable* fast_path_counter = NULL;
 
 pjsip_module mod_options =
 {
@@ -43,6 +47,45 @@ pjsip_module mod_options =
   NULL,                               // on_tsx_state()
 };
 
+//
+// mod_options_fast_path answers the same OPTIONS polls on the transport
+// thread, before the thread dispatcher, so that polls from P-CSCFs, SBCs and
+// load balancers aren't cloned, queued to a worker thread or subject to
+// overload control.  Common SIP processing has already run at this point, so
+// malformed requests have been rejected and SAS logging of node-local OPTIONS
+// has been suppressed.
+//
+// This has the same priority as the thread dispatcher, so it must be
+// registered first.
+//
+pjsip_module mod_options_fast_path =
+{
+  NULL, NULL,                         // prev, next
+  pj_str("mod-options-fast-path"),    // Name
+  -1,                                 // Id
+  PJSIP_MOD_PRIORITY_TRANSPORT_LAYER-1, // Priority
+  NULL,                               // load()
+  NULL,                               // start()
+  NULL,                               // stop()
+  NULL,                               // unload()
+  &fast_path_on_rx_request,           // on_rx_request()
+  NULL,                               // on_rx_response()
+  NULL,                               // on_tx_request()
+  NULL,                               // on_tx_response()
+  NULL,                               // on_tsx_state()
+};
+
+
+// Returns whether a request is an OPTIONS poll targeted at this node, with
+// either no route header or a single local route header.
+static bool is_local_options_poll(pjsip_rx_data* rdata)
+{
+  return ((rdata->msg_info.msg->line.req.method.id == PJSIP_OPTIONS_METHOD) &&
+          (URIClassifier::classify_uri(rdata->msg_info.msg->line.req.uri) ==
+                                                           NODE_LOCAL_SIP_URI) &&
+          PJUtils::check_route_headers(rdata));
+}
+
 
 pj_bool_t on_rx_request(pjsip_rx_data* rdata)
 {
@@ -50,36 +93,61 @@ pj_bool_t on_rx_request(pjsip_rx_data* rdata)
   SAS::Event event(get_trail(rdata), SASEvent::BEGIN_OPTIONS_MODULE, 0);
   SAS::report_event(event);
 
-  URIClass uri_class = URIClassifier::classify_uri(rdata->msg_info.msg->line.req.uri);
-  if (rdata->msg_info.msg->line.req.method.id == PJSIP_OPTIONS_METHOD)
+  if (is_local_options_poll(rdata))
   {
-    if ((uri_class == NODE_LOCAL_SIP_URI) &&
-        PJUtils::check_route_headers(rdata))
+    // OPTIONS targetted at this node/home domain, and there's either no route
+    // header or a single local route header. Respond statelessly.
+    PJUtils::respond_stateless(stack_data.endpt, rdata, 200, NULL, NULL, NULL);
+    return PJ_TRUE;
+  }
+
+  return PJ_FALSE;
+}
+
+
+pj_bool_t fast_path_on_rx_request(pjsip_rx_data* rdata)
+{
+  if (is_local_options_poll(rdata))
+  {
+    TRC_DEBUG("Answering OPTIONS poll %p on the transport thread", rdata);
+    PJUtils::respond_stateless(stack_data.endpt, rdata, 200, NULL, NULL, NULL);
+
+    if (fast_path_counter != NULL)
     {
-      // OPTIONS targetted at this node/home domain, and there's either no route
-      // header or a single local route header. espond statelessly.
-      PJUtils::respond_stateless(stack_data.endpt, rdata, 200, NULL, NULL, NULL);
-      return PJ_TRUE;
+      fast_path_counter->increment();
     }
+
+    return PJ_TRUE;
   }
 
   return PJ_FALSE;
 }
 
 
-pj_status_t init_options()
+pj_status_t init_options(SNMP::CounterByScopeTable* fast_path_counter_arg)
 {
   pj_status_t status;
 
+  fast_path_counter = fast_path_counter_arg;
+
   // Register the options module.
   status = pjsip_endpt_register_module(stack_data.endpt, &mod_options);
 
+  // Register the fast path module.
+  if (status == PJ_SUCCESS)
+  {
+    status = pjsip_endpt_register_module(stack_data.endpt,
+                                         &mod_options_fast_path);
+  }
+
   return status;
 }
 
 
 void destroy_options()
 {
+  pjsip_endpt_unregister_module(stack_data.endpt, &mod_options_fast_path);
   pjsip_endpt_unregister_module(stack_data.endpt, &mod_options);
+  fast_path_counter = NULL;
 }
 
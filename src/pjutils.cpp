@@ -31,6 +31,7 @@ extern "C" {
 #include "enumservice.h"
 #include "uri_classifier.h"
 #include "thread_dispatcher.h"
+#include "fast_random.h"
 
 
 static void on_tsx_state(pjsip_transaction*, pjsip_event*);
@@ -177,9 +178,86 @@ std::string PJUtils::body_to_string(pjsip_msg_body* body)
 }
 
 
+/// Buffer-based printer for an identity derived from a URI.  Returns the
+/// number of characters written, 0 if the URI has no identity, or -1 if the
+/// buffer is too small.
+typedef int (*IdentityPrinter)(const pjsip_uri* uri, char* buf, size_t size);
+
+/// The size of the stack buffer that identities are first printed into.
+/// Nearly all identities fit, so the heap is only used for unusually long
+/// ones.
+static const size_t IDENTITY_BUF_SIZE = 500;
+
+/// Prints an identity into a heap buffer, growing the buffer until the
+/// identity fits.  This is the fallback for identities that don't fit in
+/// IDENTITY_BUF_SIZE.
+static std::string print_identity_to_heap(IdentityPrinter printer,
+                                          const pjsip_uri* uri)
+{
+  std::vector<char> buf(IDENTITY_BUF_SIZE);
+  int len;
+
+  do
+  {
+    buf.resize(buf.size() * 2);
+    len = printer(uri, buf.data(), buf.size());
+  }
+  while ((len < 0) && (buf.size() < PJSIP_MAX_PKT_LEN));
+
+  return (len > 0) ? std::string(buf.data(), len) : std::string();
+}
+
+/// Prints an identity into a std::string.
+static std::string print_identity(IdentityPrinter printer, const pjsip_uri* uri)
+{
+  char buf[IDENTITY_BUF_SIZE];
+  int len = printer(uri, buf, sizeof(buf));
+
+  if (len < 0)
+  {
+    return print_identity_to_heap(printer, uri);
+  }
+
+  return std::string(buf, len);
+}
+
+/// Prints an identity into a string allocated from the pool.
+static pj_str_t print_identity(IdentityPrinter printer,
+                               const pjsip_uri* uri,
+                               pj_pool_t* pool)
+{
+  char buf[IDENTITY_BUF_SIZE];
+  int len = printer(uri, buf, sizeof(buf));
+  pj_str_t id = {NULL, 0};
+
+  if (len < 0)
+  {
+    std::string heap_id = print_identity_to_heap(printer, uri);
+    pj_strdup2(pool, &id, heap_id.c_str());
+  }
+  else if (len > 0)
+  {
+    id.ptr = (char*)pj_pool_alloc(pool, len);
+    memcpy(id.ptr, buf, len);
+    id.slen = len;
+  }
+
+  return id;
+}
+
 /// Returns a canonical IMS public user identity from a URI as per TS 23.003
 /// 13.4.
 std::string PJUtils::public_id_from_uri(const pjsip_uri* uri)
+{
+  return print_identity(&PJUtils::public_id_from_uri, uri);
+}
+
+/// Prints the canonical IMS public user identity for a URI into a caller
+/// supplied buffer, without allocating.
+///
+/// @returns The number of characters written, 0 if the URI scheme has no
+///          public identity, or -1 if the buffer is too small.
+int PJUtils::public_id_from_uri(const pjsip_uri* uri, char* buf, size_t size)
 {
   if (PJSIP_URI_SCHEME_IS_SIP(uri))
   {
@@ -196,7 +274,10 @@ std::string PJUtils::public_id_from_uri(const pjsip_uri* uri)
     public_id.other_param.next = NULL;
     public_id.header_param.next = NULL;
     public_id.userinfo_param.next = NULL;
-    return uri_to_string(PJSIP_URI_IN_FROMTO_HDR, (pjsip_uri*)&public_id);
+    return pjsip_uri_print(PJSIP_URI_IN_FROMTO_HDR,
+                           (pjsip_uri*)&public_id,
+                           buf,
+                           size);
   }
   else if (PJSIP_URI_SCHEME_IS_TEL(uri))
   {
@@ -206,14 +287,24 @@ std::string PJUtils::public_id_from_uri(const pjsip_uri* uri)
     public_id.ext_param.slen = 0;
     public_id.isub_param.slen = 0;
     public_id.other_param.next = NULL;
-    return uri_to_string(PJSIP_URI_IN_FROMTO_HDR, (pjsip_uri*)&public_id);
+    return pjsip_uri_print(PJSIP_URI_IN_FROMTO_HDR,
+                           (pjsip_uri*)&public_id,
+                           buf,
+                           size);
   }
   else
   {
-    return std::string();
+    return 0;
   }
 }
 
+/// Returns the canonical IMS public user identity for a URI as a string
+/// allocated from the supplied pool.
+pj_str_t PJUtils::public_id_from_uri(const pjsip_uri* uri, pj_pool_t* pool)
+{
+  return print_identity(&PJUtils::public_id_from_uri, uri, pool);
+}
+
 pj_bool_t PJUtils::valid_public_id_from_uri(const pjsip_uri* uri, std::string& impu)
 {
   impu = public_id_from_uri(uri);
@@ -225,33 +316,69 @@ pj_bool_t PJUtils::valid_public_id_from_uri(const pjsip_uri* uri, std::string& i
 // scheme.
 std::string PJUtils::default_private_id_from_uri(const pjsip_uri* uri)
 {
-  std::string id;
+  return print_identity(&PJUtils::default_private_id_from_uri, uri);
+}
+
+/// Returns the default private ID for a URI as a string allocated from the
+/// supplied pool.
+pj_str_t PJUtils::default_private_id_from_uri(const pjsip_uri* uri, pj_pool_t* pool)
+{
+  return print_identity(&PJUtils::default_private_id_from_uri, uri, pool);
+}
+
+// Appends a pj_str_t to a buffer, returning false if it doesn't fit.
+static bool append_pj_str(char* buf, size_t size, size_t& len, const pj_str_t* str)
+{
+  if ((size_t)str->slen > size - len)
+  {
+    return false;
+  }
+
+  memcpy(buf + len, str->ptr, str->slen);
+  len += str->slen;
+  return true;
+}
+
+// Prints the default private ID for a URI into a caller supplied buffer.
+//
+// @returns The number of characters written, 0 if the URI scheme is not
+//          supported, or -1 if the buffer is too small.
+int PJUtils::default_private_id_from_uri(const pjsip_uri* uri, char* buf, size_t size)
+{
+  static const pj_str_t AT = {(char*)"@", 1};
+  const pj_str_t* user = NULL;
+  const pj_str_t* host = NULL;
+
   if (PJSIP_URI_SCHEME_IS_SIP(uri) ||
       PJSIP_URI_SCHEME_IS_SIPS(uri))
   {
     pjsip_sip_uri* sip_uri = (pjsip_sip_uri*)uri;
-    if (sip_uri->user.slen > 0)
-    {
-      id = PJUtils::pj_str_to_string(&sip_uri->user) + "@" + PJUtils::pj_str_to_string(&sip_uri->host);
-    }
-    else
-    {
-      id = PJUtils::pj_str_to_string(&sip_uri->host);
-    }
+    user = (sip_uri->user.slen > 0) ? &sip_uri->user : NULL;
+    host = &sip_uri->host;
   }
   else if (PJSIP_URI_SCHEME_IS_TEL(uri))
   {
-    id = PJUtils::pj_str_to_string(&((pjsip_tel_uri*)uri)->number) +
-               "@" + PJUtils::pj_str_to_string(&stack_data.default_home_domain);
+    user = &((pjsip_tel_uri*)uri)->number;
+    host = &stack_data.default_home_domain;
   }
   else
   {
     const pj_str_t* scheme = pjsip_uri_get_scheme(uri);
     TRC_WARNING("Unsupported scheme \"%.*s\" in To header when determining private ID - ignoring",
                 scheme->slen, scheme->ptr);
+    return 0;
   }
 
-  return id;
+  size_t len = 0;
+  if (((user != NULL) &&
+       (!append_pj_str(buf, size, len, user) ||
+        !append_pj_str(buf, size, len, &AT))) ||
+      !append_pj_str(buf, size, len, host))
+  {
+    return -1;
+  }
+
+  return len;
 }
 
 /// Extract the domain from a SIP URI, or if its another type of URI, return
@@ -369,8 +496,8 @@ void PJUtils::add_integrity_protected_indication(pjsip_tx_data* tdata, Integrity
     // Construct a default private identifier from the URI in the To header.
     TRC_DEBUG("Construct default private identity");
     pjsip_uri* to_uri = (pjsip_uri*)pjsip_uri_get_uri(PJSIP_MSG_TO_HDR(tdata->msg)->uri);
-    std::string private_id = PJUtils::default_private_id_from_uri(to_uri);
-    pj_strdup2(tdata->pool, &auth_hdr->credential.digest.username, private_id.c_str());
+    auth_hdr->credential.digest.username =
+                      PJUtils::default_private_id_from_uri(to_uri, tdata->pool);
     pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)auth_hdr);
   }
   pjsip_param* new_param = (pjsip_param*) pj_pool_alloc(tdata->pool, sizeof(pjsip_param));
@@ -1044,8 +1171,10 @@ void PJUtils::blacklist(AddrInfo& server)
 
 /// Substitutes the branch identifier in the top Via header with a new unique
 /// identifier.  This is used when forking requests and when retrying requests
-/// to alternate servers.  This code is taken from pjsip_generate_branch_id
-/// for the case when the branch ID is calculated from a GUID.
+/// to alternate servers.  This produces branch IDs in the same format as
+/// pjsip_generate_branch_id does for the case when the branch ID is
+/// calculated from a GUID, but takes the random part from the per-thread
+/// generator rather than the locked PJLIB one.
 void PJUtils::generate_new_branch_id(pjsip_tx_data* tdata)
 {
   pjsip_via_hdr* via = (pjsip_via_hdr*)
@@ -1057,13 +1186,12 @@ void PJUtils::generate_new_branch_id(pjsip_tx_data* tdata)
             PJSIP_RFC3261_BRANCH_ID,
             PJSIP_RFC3261_BRANCH_LEN);
 
-  pj_str_t tmp;
-  tmp.ptr = via->branch_param.ptr + PJSIP_RFC3261_BRANCH_LEN + 2;
+  char* random_part = via->branch_param.ptr + PJSIP_RFC3261_BRANCH_LEN + 2;
   // Add "Pj" between the RFC3261 prefix and the random string to be consistent
   // with branch IDs generated by PJSIP.
-  *(tmp.ptr-2) = 'P';
-  *(tmp.ptr-1) = 'j';
-  pj_generate_unique_string(&tmp);
+  *(random_part-2) = 'P';
+  *(random_part-1) = 'j';
+  FastRandom::fill_base64url(random_part, PJ_GUID_STRING_LENGTH);
 
   via->branch_param.slen = PJSIP_MAX_BRANCH_LEN;
 }
@@ -1817,20 +1945,32 @@ std::string PJUtils::get_header_value(pjsip_hdr* header)
 {
 #define MAX_HDR_SIZE 4096
   char buf[MAX_HDR_SIZE] = "";
-  char* buf2 = buf;
+  PJStringView value = get_header_value(header, buf, sizeof(buf));
+  return value.str();
+}
 
-  int len = pjsip_hdr_print_on(header, buf2, MAX_HDR_SIZE);
+// Prints the value of a header (without the name and colon) into a caller
+// supplied buffer, and returns a view of the value within that buffer. The
+// view is empty if the header doesn't fit in the buffer.
+PJStringView PJUtils::get_header_value(pjsip_hdr* header, char* buf, size_t size)
+{
+  int len = pjsip_hdr_print_on(header, buf, size);
+  if (len <= 0)
+  {
+    return PJStringView();
+  }
 
-  // Eat up to the first colon.
-  while (*buf2 != ':') { buf2++; len--; }
+  const char* start = buf;
+  const char* end = buf + len;
 
-  // Now eat the colon.
-  buf2++; len --;
+  // Eat up to the first colon, then the colon itself.
+  while ((start < end) && (*start != ':')) { start++; }
+  if (start < end) { start++; }
 
   // Eat any leading whitespace.
-  while (*buf2 == ' ') { buf2++; len--; }
+  while ((start < end) && (*start == ' ')) { start++; }
 
-  return std::string(buf2, len);
+  return PJStringView(start, end - start);
 }
 
 // Add SAS marker for the specified message's P-Charging-Vector IMS Charging ID
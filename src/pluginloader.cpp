@@ -15,6 +15,7 @@
 #include <dlfcn.h>
 
 #include "log.h"
+#include "utils.h"
 #include "pluginloader.h"
 
 // LCOV_EXCL_START - Plugin Loader isn't covered at all by UTs
@@ -100,9 +101,22 @@ bool PluginLoader::load(std::list<Sproutlet*>& sproutlets)
         break;
       }
 
+      // Time how long each plug-in takes to load, as this includes reading
+      // any configuration its Sproutlets need.
+      Utils::StopWatch stopwatch;
+      stopwatch.start();
+
       std::list<Sproutlet*> plugin_sproutlets;
       plugins_loaded = p.plugin->load(_opt, plugin_sproutlets);
 
+      unsigned long load_time_us = 0;
+      stopwatch.stop();
+      if (stopwatch.read(load_time_us))
+      {
+        TRC_STATUS("Plug-in %s took %lums to load",
+                   p.name.c_str(), load_time_us / 1000);
+      }
+
       if (!plugins_loaded)
       {
         // There was an error loading one of the plugins. Return an error
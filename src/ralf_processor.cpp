@@ -10,6 +10,8 @@
  */
 #include "ralf_processor.h"
 #include "exception_handler.h"
+#include "memory_accounting.h"
+#include "sprout_probes.h"
 
 /// Constructor.
 RalfProcessor::RalfProcessor(HttpConnection* ralf_connection,
@@ -37,19 +39,34 @@ RalfProcessor::~RalfProcessor()
 /// Adds a ralf request to the queue
 void RalfProcessor::send_request_to_ralf(RalfRequest* rr)
 {
+  MemoryAccounting::acr_queue.allocated(request_size(rr));
   _thread_pool->add_work(rr);
 }
 
+/// Estimates the memory used by a queued request.
+size_t RalfProcessor::request_size(const RalfRequest* rr)
+{
+  return sizeof(RalfRequest) + rr->path.capacity() + rr->message.capacity();
+}
+
 // Send the ACR to Ralf
 void RalfProcessor::Pool::process_work(RalfProcessor::RalfRequest*& rr)
 {
   // Send the request. Penalties are set via the load monitor if the
   // request fails in the HttpClient
-  _ralf_connection->create_request(HttpClient::RequestType::POST, rr->path)
-  .set_sas_trail(rr->trail)
-  .set_body(rr->message)
-  .send();
+  SPROUT_PROBE(ralf_request_start, rr->trail, "POST", rr->path.c_str());
+  HttpResponse response =
+    _ralf_connection->create_request(HttpClient::RequestType::POST, rr->path)
+    .set_sas_trail(rr->trail)
+    .set_body(rr->message)
+    .send();
+  SPROUT_PROBE(ralf_request_finish,
+               rr->trail,
+               "POST",
+               rr->path.c_str(),
+               response.get_rc());
 
+  MemoryAccounting::acr_queue.freed(request_size(rr));
   delete rr; rr = NULL;
 }
 
@@ -53,11 +53,13 @@ RegistrarSproutlet::RegistrarSproutlet(const std::string& name,
                                        SubscriberManager* sm,
                                        ACRFactory* rfacr_factory,
                                        int cfg_max_expires,
-                                       SNMP::RegistrationStatsTables* reg_stats_tbls) :
+                                       SNMP::RegistrationStatsTables* reg_stats_tbls,
+                                       ExpiryJitter* expiry_jitter) :
   Sproutlet(name, port, uri, "", aliases, NULL, NULL, network_function),
   _sm(sm),
   _acr_factory(rfacr_factory),
   _max_expires(cfg_max_expires),
+  _expiry_jitter(expiry_jitter),
   _reg_stats_tbls(reg_stats_tbls),
   _next_hop_service(next_hop_service)
 {
@@ -814,9 +816,6 @@ void RegistrarSproutletTsx::get_bindings_from_req(
         binding->_emergency_registration =
                                     PJUtils::is_emergency_registration(contact);
 
-        // If the new expiry is less than the current expiry, and it's an
-        // emergency registration, don't update the expiry time
-        int new_expiry = now + expiry;
         int old_expiry = 0;
 
         if (current_bindings.find(binding_id) != current_bindings.end())
@@ -824,6 +823,22 @@ void RegistrarSproutletTsx::get_bindings_from_req(
           old_expiry = current_bindings.at(binding_id)->_expires;
         }
 
+        // Randomise the expiry of normal registrations, if configured, so
+        // that devices that registered together don't refresh together.
+        int binding_expiry = expiry;
+
+        if ((_registrar->_expiry_jitter != NULL) &&
+            (!binding->_emergency_registration))
+        {
+          binding_expiry = _registrar->_expiry_jitter->grant(expiry,
+                                                             now,
+                                                             old_expiry);
+        }
+
+        // If the new expiry is less than the current expiry, and it's an
+        // emergency registration, don't update the expiry time
+        int new_expiry = now + binding_expiry;
+
         if ((binding->_emergency_registration) &&
             (new_expiry < old_expiry))
         {
@@ -193,6 +193,9 @@ void RegistrationSender::match_application_servers(pjsip_msg* received_register_
 {
   matched_dummy_as = false;
 
+  // Share one header index between all the iFCs tested.
+  HeaderIndex hdrs(received_register_msg);
+
   // Go through the list of iFCs and find which application servers should be
   // invoked for this request. Save off any application servers that don't
   // match a dummy AS.
@@ -201,7 +204,7 @@ void RegistrationSender::match_application_servers(pjsip_msg* received_register_
     if (ifc.filter_matches(SessionCase::Originating,
                            true,
                            is_initial_registration,
-                           received_register_msg,
+                           hdrs,
                            trail))
     {
       if ((ifc.as_invocation().server_name) ==
@@ -240,7 +243,7 @@ void RegistrationSender::match_application_servers(pjsip_msg* received_register_
       if (ifc.filter_matches(SessionCase::Originating,
                              true,
                              is_initial_registration,
-                             received_register_msg,
+                             hdrs,
                              trail))
       {
         if (ifc.as_invocation().server_name == _ifc_configuration._dummy_as)
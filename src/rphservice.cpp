@@ -31,7 +31,8 @@ RPHService::RPHService(Alarm* alarm,
                        std::string configuration) :
   _alarm(alarm),
   _configuration(configuration),
-  _updater(NULL)
+  _updater(NULL),
+  _sets_rw_lock("RPHService")
 {
   // Create an updater to keep the RPH values configured appropriately.
   _updater = new Updater<void, RPHService>
@@ -187,7 +188,7 @@ void RPHService::update_rph()
 
   // At this point, we're definitely going to override the RPH map we currently have so
   // take the lock and update the map.
-  boost::lock_guard<boost::shared_mutex> write_lock(_sets_rw_lock);
+  boost::lock_guard<InstrumentedSharedMutex> write_lock(_sets_rw_lock);
   _rph_map = new_rph_map;
 
   // We've successfully uploaded RPH configuration so log and clear the alarm.
@@ -201,7 +202,7 @@ SIPEventPriorityLevel RPHService::lookup_priority(std::string rph_value,
   SIPEventPriorityLevel priority = SIPEventPriorityLevel::NORMAL_PRIORITY;
 
   // Take a read lock on the mutex in RAII style
-  boost::shared_lock<boost::shared_mutex> read_lock(_sets_rw_lock);
+  boost::shared_lock<InstrumentedSharedMutex> read_lock(_sets_rw_lock);
 
   // Lookup the key in the map. If it doesn't exist, we will return the default
   // priority of 0.
@@ -43,6 +43,7 @@ private:
   AuthenticationSproutlet* _auth_sproutlet;
   Alarm* _sess_cont_as_alarm;
   Alarm* _sess_term_as_alarm;
+  AsLatencyTracker* _as_latency_tracker;
 
   SNMP::SuccessFailCountByRequestTypeTable* _incoming_sip_transactions_tbl;
   SNMP::SuccessFailCountByRequestTypeTable* _outgoing_sip_transactions_tbl;
@@ -60,6 +61,10 @@ SCSCFPlugin::SCSCFPlugin() :
   _scscf_sproutlet(NULL),
   _subscription_sproutlet(NULL),
   _registrar_sproutlet(NULL),
+  _auth_sproutlet(NULL),
+  _sess_cont_as_alarm(NULL),
+  _sess_term_as_alarm(NULL),
+  _as_latency_tracker(NULL),
   _incoming_sip_transactions_tbl(NULL),
   _outgoing_sip_transactions_tbl(NULL)
 {
@@ -137,6 +142,15 @@ bool SCSCFPlugin::load(struct options& opt, std::list<Sproutlet*>& sproutlets)
                                    &CL_SPROUT_SESS_CONT_AS_COMM_FAILURE,
                                    &CL_SPROUT_SESS_CONT_AS_COMM_SUCCESS);
 
+    if ((opt.as_adaptive_timeout_factor > 0) ||
+        (opt.as_circuit_breaker_threshold > 0))
+    {
+      // Track AS response times and failures, to shorten AS timeouts and
+      // bypass failing ASs.
+      _as_latency_tracker = new AsLatencyTracker(opt.as_adaptive_timeout_factor,
+                                                 opt.as_circuit_breaker_threshold);
+    }
+
     _scscf_sproutlet = new SCSCFSproutlet(PROXY_SERVICE_NAME,
                                           opt.prefix_scscf,
                                           opt.uri_scscf,
@@ -158,7 +172,9 @@ bool SCSCFPlugin::load(struct options& opt, std::list<Sproutlet*>& sproutlets)
                                           opt.session_continued_timeout_ms,
                                           opt.session_terminated_timeout_ms,
                                           sess_term_as_tracker,
-                                          sess_cont_as_tracker);
+                                          sess_cont_as_tracker,
+                                          _as_latency_tracker);
+    _scscf_sproutlet->set_in_dialog_fast_path(opt.in_dialog_fast_path);
     ok = ok && _scscf_sproutlet->init();
     sproutlets.push_front(_scscf_sproutlet);
 
@@ -169,7 +185,8 @@ bool SCSCFPlugin::load(struct options& opt, std::list<Sproutlet*>& sproutlets)
                                                         PROXY_SERVICE_NAME,
                                                         subscriber_manager,
                                                         scscf_acr_factory,
-                                                        opt.sub_max_expires);
+                                                        opt.sub_max_expires,
+                                                        sub_expiry_jitter);
     ok = ok && _subscription_sproutlet->init();
     sproutlets.push_front(_subscription_sproutlet);
 
@@ -189,7 +206,8 @@ bool SCSCFPlugin::load(struct options& opt, std::list<Sproutlet*>& sproutlets)
                                                   subscriber_manager,
                                                   scscf_acr_factory,
                                                   opt.reg_max_expires,
-                                                  &reg_stats_tbls);
+                                                  &reg_stats_tbls,
+                                                  reg_expiry_jitter);
 
     ok = ok && _registrar_sproutlet->init();
     sproutlets.push_front(_registrar_sproutlet);
@@ -242,6 +260,7 @@ void SCSCFPlugin::unload()
   delete _auth_sproutlet; _auth_sproutlet = NULL;
   delete _sess_term_as_alarm; _sess_term_as_alarm = NULL;
   delete _sess_cont_as_alarm; _sess_cont_as_alarm = NULL;
+  delete _as_latency_tracker; _as_latency_tracker = NULL;
   delete reg_stats_tbls.init_reg_tbl;
   delete reg_stats_tbls.re_reg_tbl;
   delete reg_stats_tbls.de_reg_tbl;
@@ -22,12 +22,14 @@
 #include "sas.h"
 #include "sproutsasevent.h"
 #include "sprout_pd_definitions.h"
+#include "fast_random.h"
 
 SCSCFSelector::SCSCFSelector(const std::string& fallback_scscf_uri,
                              std::string configuration) :
   _fallback_scscf_uri(fallback_scscf_uri),
   _configuration(configuration),
-  _updater(NULL)
+  _updater(NULL),
+  _scscfs_rw_lock("SCSCFSelector")
 {
   // create an updater
   _updater = new Updater<void, SCSCFSelector>(this, std::mem_fun(&SCSCFSelector::update_scscf));
@@ -147,7 +149,7 @@ void SCSCFSelector::update_scscf()
   }
 
   // Take a write lock on the mutex in RAII style
-  boost::lock_guard<boost::shared_mutex> write_lock(_scscfs_rw_lock);
+  boost::lock_guard<InstrumentedSharedMutex> write_lock(_scscfs_rw_lock);
   _scscfs = new_scscfs;
 }
 
@@ -166,7 +168,7 @@ std::string SCSCFSelector::get_scscf(const std::vector<int> &mandatory,
   // Take a read lock on the mutex in RAII style. See
   // http://www.boost.org/doc/libs/1_41_0/doc/html/thread/synchronization.html
   // for documentation.
-  boost::shared_lock<boost::shared_mutex> read_lock(_scscfs_rw_lock);
+  boost::shared_lock<InstrumentedSharedMutex> read_lock(_scscfs_rw_lock);
 
   // There's at least one S-CSCF, so check if any match the capabilities requested
   std::string reject_str;
@@ -278,8 +280,7 @@ std::string SCSCFSelector::get_scscf(const std::vector<int> &mandatory,
 
   // There are multiple S-CSCFs that match on all mandatory capabilities, the highest number of optional
   // capabilities, and the highest priority. Select one using a weighted random choice.
-  srand(time(NULL));
-  int random = (sum != 0) ? rand() % sum : 0;
+  int random = (sum != 0) ? FastRandom::uniform(sum) : 0;
 
   int index = 0;
   int accumulator = matches[index].weight;
@@ -22,6 +22,7 @@
 #include "wildcard_utils.h"
 #include "associated_uris.h"
 #include "scscf_utils.h"
+#include "slow_transactions.h"
 
 // Constant indicating there is no served user for a request.
 const char* NO_SERVED_USER = "";
@@ -48,7 +49,8 @@ SCSCFSproutlet::SCSCFSproutlet(const std::string& name,
                                int session_continued_timeout_ms,
                                int session_terminated_timeout_ms,
                                AsCommunicationTracker* sess_term_as_tracker,
-                               AsCommunicationTracker* sess_cont_as_tracker) :
+                               AsCommunicationTracker* sess_cont_as_tracker,
+                               AsLatencyTracker* as_latency_tracker) :
   Sproutlet(name,
             port,
             uri,
@@ -67,6 +69,7 @@ SCSCFSproutlet::SCSCFSproutlet(const std::string& name,
   _enum_service(enum_service),
   _acr_factory(acr_factory),
   _override_npdi(override_npdi),
+  _in_dialog_fast_path(false),
   _fifcservice(fifcservice),
   _ifc_configuration(ifc_configuration),
   _session_continued_timeout_ms(session_continued_timeout_ms),
@@ -76,7 +79,8 @@ SCSCFSproutlet::SCSCFSproutlet(const std::string& name,
   _icscf_uri_str(icscf_uri),
   _bgcf_uri_str(bgcf_uri),
   _sess_term_as_tracker(sess_term_as_tracker),
-  _sess_cont_as_tracker(sess_cont_as_tracker)
+  _sess_cont_as_tracker(sess_cont_as_tracker),
+  _as_latency_tracker(as_latency_tracker)
 {
   _routed_by_preloaded_route_tbl = SNMP::CounterTable::create("scscf_routed_by_preloaded_route",
                                                               "1.2.826.0.1.1578918.9.3.26");
@@ -178,11 +182,54 @@ SproutletTsx* SCSCFSproutlet::get_tsx(SproutletHelper* helper,
                                       pj_pool_t* pool,
                                       SAS::TrailId trail)
 {
+  if ((_in_dialog_fast_path) && (is_uninteresting_in_dialog_request(req)))
+  {
+    // The S-CSCF has nothing to do for this request, so decline it.  The
+    // proxy strips our Route header and forwards the request on to the next
+    // hop (or to the next Sproutlet that wants it) without creating an
+    // S-CSCF transaction.
+    TRC_DEBUG("Forwarding in-dialog request without S-CSCF processing");
+    return NULL;
+  }
+
   pjsip_method_e req_type = req->line.req.method.id;
   return (SproutletTsx*)new SCSCFSproutletTsx(this, _next_hop_service, req_type);
 }
 
 
+// Checks whether an in-dialog request needs no S-CSCF processing.  This is
+// the case if it was routed to us using a Record-Route that we marked as not
+// billable, and session timer processing doesn't apply to it.  The AS chain
+// isn't used for in-dialog requests, so the billing role is all the dialog
+// context we need.
+bool SCSCFSproutlet::is_uninteresting_in_dialog_request(pjsip_msg* req) const
+{
+  pjsip_method_e req_type = req->line.req.method.id;
+
+  if ((PJSIP_MSG_TO_HDR(req)->tag.slen == 0) ||
+      (req_type == PJSIP_INVITE_METHOD) ||
+      (req_type == PJSIP_CANCEL_METHOD) ||
+      (pjsip_method_cmp(&req->line.req.method, &METHOD_UPDATE) == 0))
+  {
+    return false;
+  }
+
+  pjsip_route_hdr* route = (pjsip_route_hdr*)pjsip_msg_find_hdr(req,
+                                                                PJSIP_H_ROUTE,
+                                                                NULL);
+
+  if ((route == NULL) || (!PJSIP_URI_SCHEME_IS_SIP(route->name_addr.uri)))
+  {
+    return false;
+  }
+
+  pjsip_sip_uri* uri = (pjsip_sip_uri*)pjsip_uri_get_uri(route->name_addr.uri);
+  pjsip_param* param = pjsip_param_find(&uri->other_param, &STR_BILLING_ROLE);
+
+  return ((param != NULL) && (pj_strcmp(&param->value, &STR_CHARGE_NONE) == 0));
+}
+
+
 // Returns the service name of the entire S-CSCF.
 const std::string SCSCFSproutlet::scscf_service_name() const
 {
@@ -326,11 +373,17 @@ void SCSCFSproutlet::track_app_serv_comm_failure(const std::string& uri,
   {
     as_tracker->on_failure(uri, reason);
   }
+
+  if (_as_latency_tracker != NULL)
+  {
+    _as_latency_tracker->on_failure(uri);
+  }
 }
 
 
 void SCSCFSproutlet::track_app_serv_comm_success(const std::string& uri,
-                                                 DefaultHandling default_handling)
+                                                 DefaultHandling default_handling,
+                                                 uint64_t latency_ms)
 {
   AsCommunicationTracker* as_tracker = (default_handling == SESSION_CONTINUED) ?
                                        _sess_cont_as_tracker :
@@ -339,6 +392,37 @@ void SCSCFSproutlet::track_app_serv_comm_success(const std::string& uri,
   {
     as_tracker->on_success(uri);
   }
+
+  if (_as_latency_tracker != NULL)
+  {
+    _as_latency_tracker->on_success(uri, latency_ms);
+  }
+}
+
+
+bool SCSCFSproutlet::should_invoke_app_serv(const std::string& uri,
+                                            DefaultHandling default_handling)
+{
+  // Only bypass ASs that the session can continue without.
+  return ((default_handling != SESSION_CONTINUED) ||
+          (_as_latency_tracker == NULL) ||
+          (_as_latency_tracker->allow_request(uri)));
+}
+
+
+int SCSCFSproutlet::app_serv_timeout_ms(const std::string& uri,
+                                        DefaultHandling default_handling)
+{
+  if (default_handling != SESSION_CONTINUED)
+  {
+    // Timing out an AS with default handling of SESSION_TERMINATED fails the
+    // call, so always give it the full configured time.
+    return _session_terminated_timeout_ms;
+  }
+
+  return (_as_latency_tracker != NULL) ?
+         _as_latency_tracker->timeout_ms(uri, _session_continued_timeout_ms) :
+         _session_continued_timeout_ms;
 }
 
 uint64_t SCSCFSproutlet::track_session_setup_time(uint64_t tsx_start_time_usec,
@@ -385,6 +469,7 @@ SCSCFSproutletTsx::SCSCFSproutletTsx(SCSCFSproutlet* scscf,
   _record_session_setup_time(false),
   _tsx_start_time_usec(0),
   _video_call(false),
+  _as_request_time_ms(0),
   _impi(),
   _auto_reg(false),
   _wildcard(""),
@@ -494,6 +579,11 @@ void SCSCFSproutletTsx::on_rx_initial_request(pjsip_msg* req)
   // It will also set the S-CSCF URI
   status_code = determine_served_user(req);
 
+  if ((_as_chain_link.is_set()) && (SlowTransactions::recording()))
+  {
+    SlowTransactions::set_served_user(_as_chain_link.served_user());
+  }
+
   // Pass the received request to the ACR.
   // @TODO - request timestamp???
   ACR* acr = get_acr();
@@ -837,8 +927,10 @@ void SCSCFSproutletTsx::on_rx_response(pjsip_msg* rsp, int fork_id)
         // receive we only track one success.
         if ((st_code > PJSIP_SC_TRYING) && (!_seen_1xx))
         {
-          _scscf->track_app_serv_comm_success(_as_chain_link.uri(),
-                                              _as_chain_link.default_handling());
+          _scscf->track_app_serv_comm_success(
+                       _as_chain_link.uri(),
+                       _as_chain_link.default_handling(),
+                       AsLatencyTracker::current_time_ms() - _as_request_time_ms);
         }
       }
     }
@@ -1589,7 +1681,31 @@ void SCSCFSproutletTsx::route_to_as(pjsip_msg* req, const std::string& server_na
                         PJUtils::uri_from_string(server_name, get_pool(req));
 
   if ((as_uri != NULL) &&
-      (PJSIP_URI_SCHEME_IS_SIP(as_uri)))
+      (PJSIP_URI_SCHEME_IS_SIP(as_uri)) &&
+      (!_scscf->should_invoke_app_serv(_as_chain_link.uri(),
+                                       _as_chain_link.default_handling())))
+  {
+    // The AS has been failing, so its circuit breaker is open.  It has
+    // default handling of SESSION_CONTINUED, so bypass it straight away
+    // rather than waiting for it to fail again.
+    TRC_DEBUG("Bypass AS %s as its circuit breaker is open", server_name.c_str());
+    SAS::Event bypass_as(trail(), SASEvent::BYPASS_AS, 2);
+    bypass_as.add_var_param("AS circuit breaker open");
+    bypass_as.add_static_param(_as_chain_link.complete());
+    SAS::report_event(bypass_as);
+
+    _as_chain_link = _as_chain_link.next();
+    if (_session_case->is_originating())
+    {
+      apply_originating_services(req);
+    }
+    else
+    {
+      apply_terminating_services(req);
+    }
+  }
+  else if ((as_uri != NULL) &&
+           (PJSIP_URI_SCHEME_IS_SIP(as_uri)))
   {
     // AS URI is valid, so encode the AS hop and the return hop in Route headers.
     std::string odi_value = PJUtils::pj_str_to_string(&STR_ODI_PREFIX) +
@@ -1669,13 +1785,15 @@ void SCSCFSproutletTsx::route_to_as(pjsip_msg* req, const std::string& server_na
     }
     pjsip_msg_add_hdr(req, (pjsip_hdr*)psu_hdr);
 
-    // Forward the request.
+    // Forward the request, timing the AS's response from before it is sent.
+    _as_request_time_ms = AsLatencyTracker::current_time_ms();
     send_request(req);
 
-    // Start the liveness timer for the AS.
-    int timeout = ((_as_chain_link.default_handling() == SESSION_CONTINUED) ?
-                   _scscf->_session_continued_timeout_ms :
-                   _scscf->_session_terminated_timeout_ms);
+    // Start the liveness timer for the AS.  For ASs that the session can
+    // continue without, this may be shorter than configured if the AS
+    // normally responds quickly.
+    int timeout = _scscf->app_serv_timeout_ms(_as_chain_link.uri(),
+                                              _as_chain_link.default_handling());
 
     if (timeout != 0)
     {
@@ -1784,15 +1902,19 @@ void SCSCFSproutletTsx::route_to_ue_bindings(pjsip_msg* req)
 {
   // Get the public user identity corresponding to the RequestURI.
   pjsip_uri* req_uri = req->line.req.uri;
-  std::string public_id = PJUtils::public_id_from_uri(req_uri);
+  pj_pool_t* pool = get_pool(req);
+  pj_str_t public_id_str = PJUtils::public_id_from_uri(req_uri, pool);
+  std::string public_id = PJUtils::pj_str_to_string(&public_id_str);
 
   // Add a P-Called-Party-ID header containing the public user identity,
   // replacing any existing header.
-  pj_pool_t* pool = get_pool(req);
   PJUtils::remove_hdr(req, &STR_P_CALLED_PARTY_ID);
-  std::string name_addr_str("<" + public_id + ">");
   pj_str_t called_party_id;
-  pj_strdup2(pool, &called_party_id, name_addr_str.c_str());
+  called_party_id.ptr = (char*)pj_pool_alloc(pool, public_id_str.slen + 2);
+  called_party_id.ptr[0] = '<';
+  memcpy(called_party_id.ptr + 1, public_id_str.ptr, public_id_str.slen);
+  called_party_id.ptr[public_id_str.slen + 1] = '>';
+  called_party_id.slen = public_id_str.slen + 2;
   pjsip_hdr* hdr = (pjsip_hdr*)
                         pjsip_generic_string_hdr_create(pool,
                                                         &STR_P_CALLED_PARTY_ID,
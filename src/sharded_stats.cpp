@@ -0,0 +1,96 @@
+/**
+ * @file sharded_stats.cpp Statistics that are updated per thread and merged
+ * into the underlying SNMP tables in the background.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include "sharded_stats.h"
+
+int ShardedStatistic::thread_shard()
+{
+  static std::atomic<int> next_shard(0);
+  static thread_local int shard = next_shard++ % NUM_SHARDS;
+  return shard;
+}
+
+ShardedStatsFlusher::ShardedStatsFlusher(int interval_ms) :
+  _interval_ms(interval_ms),
+  _stats_lock(),
+  _stats(),
+  _terminate(false),
+  _run_lock(),
+  _run_cond(),
+  _thread()
+{
+}
+
+ShardedStatsFlusher::~ShardedStatsFlusher()
+{
+  if (_thread.joinable())
+  {
+    {
+      std::unique_lock<std::mutex> lock(_run_lock);
+      _terminate = true;
+      _run_cond.notify_all();
+    }
+
+    _thread.join();
+  }
+
+  flush_all();
+}
+
+void ShardedStatsFlusher::start()
+{
+  _thread = std::thread(&ShardedStatsFlusher::run, this);
+}
+
+void ShardedStatsFlusher::add(ShardedStatistic* stat)
+{
+  std::unique_lock<std::mutex> lock(_stats_lock);
+  _stats.push_back(stat);
+}
+
+void ShardedStatsFlusher::remove(ShardedStatistic* stat)
+{
+  // Waits for any flush in progress, so the statistic isn't flushed after
+  // this returns.
+  std::unique_lock<std::mutex> lock(_stats_lock);
+  _stats.erase(std::remove(_stats.begin(), _stats.end(), stat), _stats.end());
+}
+
+void ShardedStatsFlusher::flush_all()
+{
+  std::unique_lock<std::mutex> lock(_stats_lock);
+
+  for (ShardedStatistic* stat : _stats)
+  {
+    stat->flush();
+  }
+}
+
+void ShardedStatsFlusher::run()
+{
+  std::unique_lock<std::mutex> lock(_run_lock);
+
+  while (!_terminate)
+  {
+    _run_cond.wait_for(lock, std::chrono::milliseconds(_interval_ms));
+
+    if (!_terminate)
+    {
+      lock.unlock();
+      flush_all();
+      lock.lock();
+    }
+  }
+}
@@ -19,6 +19,7 @@
 #include "sproutsasevent.h"
 #include "sprout_pd_definitions.h"
 #include "utils.h"
+#include "memory_accounting.h"
 #include "rapidxml/rapidxml_print.hpp"
 
 SIFCService::SIFCService(Alarm* alarm,
@@ -27,7 +28,8 @@ SIFCService::SIFCService(Alarm* alarm,
   _alarm(alarm),
   _no_shared_ifcs_set_tbl(no_shared_ifcs_set_tbl),
   _configuration(configuration),
-  _updater(NULL)
+  _updater(NULL),
+  _sets_rw_lock("SIFCService")
 {
   // Create an updater to keep the shared iFC sets configured appropriately.
   _updater = new Updater<void, SIFCService>
@@ -94,7 +96,7 @@ void SIFCService::update_sets()
 
   // At this point, we're definitely going to override the iFCs we've got.
   // Update our map, taking a lock while we do so.
-  boost::lock_guard<boost::shared_mutex> write_lock(_sets_rw_lock);
+  boost::lock_guard<InstrumentedSharedMutex> write_lock(_sets_rw_lock);
   _shared_ifc_sets.clear();
   bool any_errors = false;
 
@@ -174,6 +176,19 @@ void SIFCService::update_sets()
     _shared_ifc_sets.insert(std::make_pair(set_id, ifc_set));
   }
 
+  // Account for the memory now held by the sets.
+  size_t bytes = 0;
+  for (const std::pair<const int32_t, std::vector<std::pair<int32_t, std::string>>>& entry :
+         _shared_ifc_sets)
+  {
+    bytes += sizeof(entry);
+    for (const std::pair<int32_t, std::string>& ifc : entry.second)
+    {
+      bytes += sizeof(ifc) + ifc.second.capacity();
+    }
+  }
+  MemoryAccounting::shared_ifcs.replaced(bytes);
+
   if (any_errors)
   {
     set_alarm();
@@ -199,7 +214,7 @@ void SIFCService::get_ifcs_from_id(std::multimap<int32_t, Ifc>& ifc_map,
                                    SAS::TrailId trail) const
 {
   // Take a read lock on the mutex in RAII style
-  boost::shared_lock<boost::shared_mutex> read_lock(_sets_rw_lock);
+  boost::shared_lock<InstrumentedSharedMutex> read_lock(_sets_rw_lock);
 
   for (int id : ids)
   {
@@ -24,6 +24,8 @@ extern "C" {
 #include "utils.h"
 #include "pjutils.h"
 #include "sip_connection_pool.h"
+#include "fast_random.h"
+#include "fast_clock.h"
 
 SIPConnectionPool::SIPConnectionPool(pjsip_host_port* target,
                                int num_connections,
@@ -42,12 +44,12 @@ SIPConnectionPool::SIPConnectionPool(pjsip_host_port* target,
   _recycler(NULL),
   _terminated(false),
   _active_connections(0),
+  _tp_hash_lock("SIPConnectionPool"),
   _sprout_count_tbl(sprout_count_tbl)
 {
   TRC_STATUS("Creating connection pool to %.*s:%d", _target.host.slen, _target.host.ptr, _target.port);
   TRC_STATUS("  connections = %d, recycle time = %d +/- %d seconds", _num_connections, _recycle_period, _recycle_margin);
 
-  pthread_mutex_init(&_tp_hash_lock, NULL);
   _tp_hash.resize(_num_connections);
 }
 
@@ -97,13 +99,13 @@ pjsip_transport* SIPConnectionPool::get_connection()
 {
   pjsip_transport* tp = NULL;
 
-  pthread_mutex_lock(&_tp_hash_lock);
+  _tp_hash_lock.lock();
 
   if (_active_connections > 0)
   {
     // Select a transport by starting at a random point in the hash and
     // stepping through the hash until a connected entry is found.
-    int start_slot = rand() % _num_connections;
+    int start_slot = FastRandom::uniform(_num_connections);
     int ii = start_slot;
     while (!_tp_hash[ii].connected)
     {
@@ -125,7 +127,7 @@ pjsip_transport* SIPConnectionPool::get_connection()
     }
   }
 
-  pthread_mutex_unlock(&_tp_hash_lock);
+  _tp_hash_lock.unlock();
 
   return tp;
 }
@@ -233,7 +235,7 @@ pj_status_t SIPConnectionPool::create_connection(int hash_slot)
   }
 
   // Store the new transport in the hash slot, but marked as disconnected.
-  pthread_mutex_lock(&_tp_hash_lock);
+  _tp_hash_lock.lock();
   _tp_hash[hash_slot].tp = tp;
   _tp_hash[hash_slot].listener_key = key;
   _tp_hash[hash_slot].connected = PJ_FALSE;
@@ -242,7 +244,7 @@ pj_status_t SIPConnectionPool::create_connection(int hash_slot)
   // Don't increment the connection count here, wait until we get confirmation
   // that the transport is connected.
 
-  pthread_mutex_unlock(&_tp_hash_lock);
+  _tp_hash_lock.unlock();
 
   return PJ_SUCCESS;
 }
@@ -250,7 +252,7 @@ pj_status_t SIPConnectionPool::create_connection(int hash_slot)
 
 void SIPConnectionPool::quiesce_connection(int hash_slot)
 {
-  pthread_mutex_lock(&_tp_hash_lock);
+  _tp_hash_lock.lock();
   pjsip_transport* tp = _tp_hash[hash_slot].tp;
 
   if (tp != NULL)
@@ -275,7 +277,7 @@ void SIPConnectionPool::quiesce_connection(int hash_slot)
 
     // Release the lock now so we don't have a deadlock if pjsip_transport_shutdown
     // calls the transport state listener.
-    pthread_mutex_unlock(&_tp_hash_lock);
+    _tp_hash_lock.unlock();
 
     // Quiesce the transport.  PJSIP will destroy the transport when there
     // are no further references to it.
@@ -286,7 +288,7 @@ void SIPConnectionPool::quiesce_connection(int hash_slot)
   }
   else
   {
-    pthread_mutex_unlock(&_tp_hash_lock);
+    _tp_hash_lock.unlock();
   }
 }
 
@@ -303,7 +305,7 @@ void SIPConnectionPool::quiesce_connections()
 void SIPConnectionPool::transport_state_update(pjsip_transport* tp, pjsip_transport_state state)
 {
   // Transport state has changed.
-  pthread_mutex_lock(&_tp_hash_lock);
+  _tp_hash_lock.lock();
 
   std::map<pjsip_transport*, int>::const_iterator i = _tp_map.find(tp);
 
@@ -324,8 +326,12 @@ void SIPConnectionPool::transport_state_update(pjsip_transport* tp, pjsip_transp
         // Compute a TTL for the connection.  To avoid all the recycling being
         // synchronized we set the TTL to the specified average recycle time
         // perturbed by a random factor.
-        int ttl = _recycle_period + (rand() % (2 * _recycle_margin)) - _recycle_margin;
-        _tp_hash[hash_slot].recycle_time = time(NULL) + ttl;
+        int ttl = _recycle_period;
+        if (_recycle_margin > 0)
+        {
+          ttl += (int)FastRandom::uniform(2 * _recycle_margin) - _recycle_margin;
+        }
+        _tp_hash[hash_slot].recycle_time = FastClock::coarse_time() + ttl;
       }
       else
       {
@@ -390,7 +396,7 @@ void SIPConnectionPool::transport_state_update(pjsip_transport* tp, pjsip_transp
     }
   }
 
-  pthread_mutex_unlock(&_tp_hash_lock);
+  _tp_hash_lock.unlock();
 }
 
 
@@ -408,7 +414,7 @@ void SIPConnectionPool::recycle_connections()
     sleep(1);
 #endif
 
-    int now = time(NULL);
+    int now = FastClock::coarse_time();
 
     // Walk the vector of connections.  This is safe to do without the lock
     // because the vector is immutable.
@@ -0,0 +1,426 @@
+/**
+ * @file sip_scan.cpp Vectorised scanning of SIP message buffers.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__SSE2__)
+#include <immintrin.h>
+#define SIP_SCAN_X86 1
+#endif
+
+#include "sip_scan.h"
+
+// Function pointer types for the two primitives that have vectorised
+// implementations. Everything else is built on top of these.
+typedef const char* (*find_char_fn)(const char*, const char*, char);
+typedef const char* (*find_eoh_fn)(const char*, const char*);
+
+//
+// Scalar implementations.
+//
+
+static const char* find_char_scalar(const char* p, const char* end, char c)
+{
+  const void* found = memchr(p, c, end - p);
+  return (const char*)found;
+}
+
+static const char* find_eoh_scalar(const char* p, const char* end)
+{
+  while (end - p >= 3)
+  {
+    p = (const char*)memchr(p, '\n', end - p - 2);
+    if (p == NULL)
+    {
+      return NULL;
+    }
+    else if ((p[1] == '\r') && (p[2] == '\n'))
+    {
+      return p;
+    }
+    ++p;
+  }
+
+  return NULL;
+}
+
+#ifdef SIP_SCAN_X86
+
+//
+// SSE2 implementations. SSE2 is part of the x86_64 baseline so these need no
+// runtime check.
+//
+
+static const char* find_char_sse2(const char* p, const char* end, char c)
+{
+  const __m128i needle = _mm_set1_epi8(c);
+
+  while (end - p >= 16)
+  {
+    __m128i block = _mm_loadu_si128((const __m128i*)p);
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+    if (mask != 0)
+    {
+      return p + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+
+  return find_char_scalar(p, end, c);
+}
+
+static const char* find_eoh_sse2(const char* p, const char* end)
+{
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+
+  // Compare three overlapping loads so that bit i of the mask is set if and
+  // only if p[i], p[i+1], p[i+2] is "\n\r\n".
+  while (end - p >= 18)
+  {
+    __m128i b0 = _mm_loadu_si128((const __m128i*)p);
+    __m128i b1 = _mm_loadu_si128((const __m128i*)(p + 1));
+    __m128i b2 = _mm_loadu_si128((const __m128i*)(p + 2));
+    __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(b0, lf),
+                                _mm_and_si128(_mm_cmpeq_epi8(b1, cr),
+                                              _mm_cmpeq_epi8(b2, lf)));
+    int mask = _mm_movemask_epi8(hit);
+    if (mask != 0)
+    {
+      return p + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+
+  return find_eoh_scalar(p, end);
+}
+
+//
+// AVX2 implementations. These are compiled for AVX2 regardless of the
+// compiler flags, and only called if the CPU reports AVX2 support.
+//
+
+__attribute__((target("avx2")))
+static const char* find_char_avx2(const char* p, const char* end, char c)
+{
+  const __m256i needle = _mm256_set1_epi8(c);
+
+  while (end - p >= 32)
+  {
+    __m256i block = _mm256_loadu_si256((const __m256i*)p);
+    unsigned int mask =
+      (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+    if (mask != 0)
+    {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+
+  return find_char_sse2(p, end, c);
+}
+
+__attribute__((target("avx2")))
+static const char* find_eoh_avx2(const char* p, const char* end)
+{
+  const __m256i lf = _mm256_set1_epi8('\n');
+  const __m256i cr = _mm256_set1_epi8('\r');
+
+  while (end - p >= 34)
+  {
+    __m256i b0 = _mm256_loadu_si256((const __m256i*)p);
+    __m256i b1 = _mm256_loadu_si256((const __m256i*)(p + 1));
+    __m256i b2 = _mm256_loadu_si256((const __m256i*)(p + 2));
+    __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(b0, lf),
+                                   _mm256_and_si256(_mm256_cmpeq_epi8(b1, cr),
+                                                    _mm256_cmpeq_epi8(b2, lf)));
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(hit);
+    if (mask != 0)
+    {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+
+  return find_eoh_sse2(p, end);
+}
+
+#endif
+
+//
+// Implementation selection.
+//
+
+static SipScan::Level current_level = SipScan::Level::SCALAR;
+static find_char_fn find_char_impl = find_char_scalar;
+static find_eoh_fn find_eoh_impl = find_eoh_scalar;
+
+// Select the best implementation for this CPU at start of day.
+static struct SipScanInit
+{
+  SipScanInit() { SipScan::set_level(SipScan::detect_level()); }
+} sip_scan_init;
+
+SipScan::Level SipScan::detect_level()
+{
+#ifdef SIP_SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+  {
+    return Level::AVX2;
+  }
+  return Level::SSE2;
+#else
+  return Level::SCALAR;
+#endif
+}
+
+SipScan::Level SipScan::level()
+{
+  return current_level;
+}
+
+void SipScan::set_level(Level level)
+{
+  Level supported = detect_level();
+  if (level > supported)
+  {
+    level = supported;
+  }
+
+  switch (level)
+  {
+#ifdef SIP_SCAN_X86
+  case Level::AVX2:
+    find_char_impl = find_char_avx2;
+    find_eoh_impl = find_eoh_avx2;
+    break;
+
+  case Level::SSE2:
+    find_char_impl = find_char_sse2;
+    find_eoh_impl = find_eoh_sse2;
+    break;
+#endif
+
+  default:
+    level = Level::SCALAR;
+    find_char_impl = find_char_scalar;
+    find_eoh_impl = find_eoh_scalar;
+    break;
+  }
+
+  current_level = level;
+}
+
+const char* SipScan::level_name(Level level)
+{
+  switch (level)
+  {
+  case Level::AVX2:
+    return "AVX2";
+
+  case Level::SSE2:
+    return "SSE2";
+
+  default:
+    return "scalar";
+  }
+}
+
+const char* SipScan::find_char(const char* buf, size_t len, char c)
+{
+  return find_char_impl(buf, buf + len, c);
+}
+
+const char* SipScan::find_end_of_headers(const char* buf, size_t len)
+{
+  return find_eoh_impl(buf, buf + len);
+}
+
+//
+// Message framing.
+//
+
+// Characters permitted in a SIP token (RFC 3261 section 25.1). This matches
+// PJSIP's TOKEN_SPEC.
+static inline bool is_token_char(char c)
+{
+  return (((c >= 'a') && (c <= 'z')) ||
+          ((c >= 'A') && (c <= 'Z')) ||
+          ((c >= '0') && (c <= '9')) ||
+          ((c != '\0') && (strchr("-.!%*_+`'~", c) != NULL)));
+}
+
+// Skips whitespace in the same way as the PJSIP scanner does when parsing
+// headers, including folded continuation lines.
+static inline const char* skip_header_ws(const char* p, const char* end)
+{
+  while (p < end)
+  {
+    if ((*p == ' ') || (*p == '\t'))
+    {
+      ++p;
+    }
+    else if ((*p == '\r') &&
+             (end - p >= 3) &&
+             (p[1] == '\n') &&
+             ((p[2] == ' ') || (p[2] == '\t')))
+    {
+      p += 3;
+    }
+    else if ((*p == '\n') &&
+             (end - p >= 2) &&
+             ((p[1] == ' ') || (p[1] == '\t')))
+    {
+      p += 2;
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  return p;
+}
+
+static const char CONTENT_LENGTH[] = "Content-Length";
+static const size_t CONTENT_LENGTH_LEN = sizeof(CONTENT_LENGTH) - 1;
+
+// Attempts to parse a Content-Length header starting at line, which must end
+// before hdr_end.  As in PJSIP, the name must be exactly "Content-Length" or
+// "l", and the value must be followed by the end of the line.
+//
+// @returns The content length, or -1 if this isn't a valid Content-Length
+//          header.
+static int parse_content_length(const char* line, const char* hdr_end)
+{
+  const char* p = line;
+
+  // Header name.
+  while ((p < hdr_end) && is_token_char(*p))
+  {
+    ++p;
+  }
+
+  size_t name_len = p - line;
+  if (!(((name_len == CONTENT_LENGTH_LEN) &&
+         (strncasecmp(line, CONTENT_LENGTH, CONTENT_LENGTH_LEN) == 0)) ||
+        ((name_len == 1) && ((*line == 'l') || (*line == 'L')))))
+  {
+    return -1;
+  }
+
+  p = skip_header_ws(p, hdr_end);
+
+  // Colon.
+  if ((p >= hdr_end) || (*p != ':'))
+  {
+    return -1;
+  }
+  p = skip_header_ws(p + 1, hdr_end);
+
+  // Value, which must contain at least one digit.
+  unsigned long value = 0;
+  const char* digits = p;
+  while ((p < hdr_end) && (*p >= '0') && (*p <= '9'))
+  {
+    value = (value * 10) + (*p - '0');
+    ++p;
+  }
+
+  if (p == digits)
+  {
+    return -1;
+  }
+
+  // End of line.
+  p = skip_header_ws(p, hdr_end);
+  if ((p >= hdr_end) || ((*p != '\r') && (*p != '\n')))
+  {
+    return -1;
+  }
+
+  return (int)value;
+}
+
+static inline bool is_content_length_name(const char* line,
+                                          const char* hdr_end)
+{
+  if ((*line == 'C') || (*line == 'c'))
+  {
+    return (((size_t)(hdr_end - line) >= CONTENT_LENGTH_LEN) &&
+            (strncasecmp(line, CONTENT_LENGTH, CONTENT_LENGTH_LEN) == 0));
+  }
+  else if ((*line == 'L') || (*line == 'l'))
+  {
+    // Compact form.
+    return ((hdr_end - line >= 2) &&
+            ((line[1] == ' ') || (line[1] == '\t') || (line[1] == ':')));
+  }
+
+  return false;
+}
+
+pj_status_t SipScan::find_msg(const char* buf,
+                              pj_size_t size,
+                              pj_bool_t is_datagram,
+                              pj_size_t* msg_size)
+{
+  *msg_size = size;
+
+  if (is_datagram)
+  {
+    return PJ_SUCCESS;
+  }
+
+  const char* end = buf + size;
+  const char* eoh = find_eoh_impl(buf, end);
+  if (eoh == NULL)
+  {
+    return PJSIP_EPARTIALMSG;
+  }
+
+  const char* hdr_end = eoh + 1;
+  const char* body_start = eoh + 3;
+
+  // Walk the header lines looking for Content-Length. As in PJSIP, the
+  // start line is skipped.
+  int content_length = -1;
+  const char* line = find_char_impl(buf, end, '\n');
+  while ((line != NULL) && (line < hdr_end))
+  {
+    ++line;
+
+    if (is_content_length_name(line, hdr_end))
+    {
+      content_length = parse_content_length(line, hdr_end);
+      if (content_length != -1)
+      {
+        break;
+      }
+    }
+
+    line = find_char_impl(line, end, '\n');
+  }
+
+  if (content_length == -1)
+  {
+    return PJSIP_EMISSINGHDR;
+  }
+
+  if (body_start + content_length > end)
+  {
+    return PJSIP_EPARTIALMSG;
+  }
+
+  *msg_size = content_length + (body_start - buf);
+  return PJ_SUCCESS;
+}
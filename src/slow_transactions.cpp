@@ -0,0 +1,579 @@
+/**
+ * @file slow_transactions.cpp Records the slowest SIP messages processed by
+ * the worker threads, with a breakdown of where the time went.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include "slow_transactions.h"
+#include "pjutils.h"
+#include "fast_clock.h"
+
+namespace SlowTransactions
+{
+
+static std::atomic<int> slow_count(DEFAULT_COUNT);
+static std::atomic<uint64_t> slow_window_ns(DEFAULT_WINDOW_S * 1000000000ull);
+
+/// The methods that are kept separately.  Messages for any other method are
+/// kept together under OTHER_METHOD.
+static const char* const METHODS[] = {"INVITE",
+                                      "ACK",
+                                      "BYE",
+                                      "CANCEL",
+                                      "OPTIONS",
+                                      "REGISTER",
+                                      "SUBSCRIBE",
+                                      "NOTIFY",
+                                      "PUBLISH",
+                                      "MESSAGE",
+                                      "INFO",
+                                      "PRACK",
+                                      "UPDATE",
+                                      "REFER"};
+static const int NUM_METHODS = sizeof(METHODS) / sizeof(METHODS[0]);
+static const char* const OTHER_METHOD = "other";
+
+/// The number of slices each window is divided into.  See Reservoir.
+static const uint64_t NUM_SLICES = 10;
+
+/// The slowest messages for one method.
+///
+/// The window is divided into NUM_SLICES slices by completion time, and the
+/// slowest messages are kept for each slice.  The slowest messages in the
+/// window are then the slowest of those kept for the slices in it.  A fast
+/// message is only missed if it shares its slice with enough slower messages
+/// that have already left the window, so the report covers the rolling
+/// window to within one slice.
+class Reservoir
+{
+public:
+  Reservoir() :
+    _lock(),
+    _entries(),
+    _threshold_us(0),
+    _expiry_ns(UINT64_MAX)
+  {}
+
+  /// Whether a message with this latency might be kept.  This is checked
+  /// without the lock, so that fast messages are discarded cheaply - they
+  /// can only be kept if they are slower than the fastest message kept for
+  /// the current slice, if a new slice has started, or if a kept message
+  /// has left the window.
+  bool might_keep(uint64_t latency_us, uint64_t now_ns) const
+  {
+    return ((latency_us > _threshold_us.load(std::memory_order_relaxed)) ||
+            (now_ns >= _expiry_ns.load(std::memory_order_relaxed)));
+  }
+
+  void add(const Transaction& tsx, uint64_t now_ns, size_t count, uint64_t window_ns);
+  void get(std::vector<Transaction>& tsxs,
+           uint64_t now_ns,
+           size_t count,
+           uint64_t window_ns);
+  void clear();
+
+private:
+  struct Entry
+  {
+    uint64_t completed_ns;
+    Transaction tsx;
+  };
+
+  typedef std::vector<Entry>::iterator EntryIterator;
+
+  void expire(uint64_t now_ns, uint64_t window_ns);
+  EntryIterator fastest(uint64_t slice, uint64_t slice_ns);
+  size_t slice_size(uint64_t slice, uint64_t slice_ns) const;
+  void update_limits(uint64_t now_ns, size_t count, uint64_t window_ns);
+
+  std::mutex _lock;
+  std::vector<Entry> _entries;
+
+  // Messages no slower than this are not kept, unless a kept message has
+  // expired or the slice has ended.  Zero when there's space for more
+  // messages in the current slice.
+  std::atomic<uint64_t> _threshold_us;
+
+  // When the oldest message kept leaves the window, or the current slice
+  // ends, whichever is sooner.
+  std::atomic<uint64_t> _expiry_ns;
+};
+
+static Reservoir reservoirs[NUM_METHODS + 1];
+
+/// A stage of the message being recorded on a thread.
+struct RecordStage
+{
+  Stage::Type type;
+  std::string name;
+  uint64_t duration_ns;
+};
+
+/// The record of the message being processed on a thread.  This is reused
+/// from message to message, so that recording doesn't allocate once the
+/// thread has seen each of its stages.
+class ThreadRecord
+{
+public:
+  ThreadRecord() :
+    active(false),
+    start_ns(0),
+    mark_ns(0),
+    queue_us(0),
+    status_code(0),
+    served_user(),
+    stages(),
+    num_stages(0),
+    open_stages()
+  {}
+
+  /// Charges the time since the last mark to the innermost open stage (or to
+  /// Sprout if no stage is open), and moves the mark on.
+  void charge(uint64_t now_ns)
+  {
+    size_t stage = open_stages.empty() ? (size_t)SPROUT_STAGE : open_stages.back();
+    stages[stage].duration_ns += now_ns - mark_ns;
+    mark_ns = now_ns;
+  }
+
+  size_t find_or_add_stage(Stage::Type type, const std::string& name);
+
+  void enter(Stage::Type type, const std::string& name)
+  {
+    charge(FastClock::now_ns());
+    open_stages.push_back(find_or_add_stage(type, name));
+  }
+
+  void leave(Stage::Type type)
+  {
+    charge(FastClock::now_ns());
+
+    if ((!open_stages.empty()) && (stages[open_stages.back()].type == type))
+    {
+      open_stages.pop_back();
+    }
+  }
+
+  enum
+  {
+    QUEUE_STAGE = 0,
+    SPROUT_STAGE = 1
+  };
+
+  bool active;
+  uint64_t start_ns;
+  uint64_t mark_ns;
+  uint64_t queue_us;
+  int status_code;
+  std::string served_user;
+  std::vector<RecordStage> stages;
+  size_t num_stages;
+
+  /// The stages that are in progress, innermost last.
+  std::vector<size_t> open_stages;
+};
+
+static ThreadRecord& thread_record()
+{
+  static thread_local ThreadRecord record;
+  return record;
+}
+
+const char* Stage::type_name(Type type)
+{
+  switch (type)
+  {
+  case QUEUE:
+    return "queue";
+
+  case SPROUT:
+    return "sprout";
+
+  case SPROUTLET:
+    return "sproutlet";
+
+  case IO:
+    return "io";
+  }
+
+  return "unknown"; // LCOV_EXCL_LINE
+}
+
+void Reservoir::add(const Transaction& tsx,
+                    uint64_t now_ns,
+                    size_t count,
+                    uint64_t window_ns)
+{
+  std::unique_lock<std::mutex> lock(_lock);
+  expire(now_ns, window_ns);
+
+  // Add the message, then drop the fastest messages in its slice until the
+  // slice is back down to the count.  This may drop the message we've just
+  // added.
+  Entry entry;
+  entry.completed_ns = now_ns;
+  entry.tsx = tsx;
+  _entries.push_back(entry);
+
+  uint64_t slice_ns = std::max(window_ns / NUM_SLICES, (uint64_t)1);
+  uint64_t slice = now_ns / slice_ns;
+
+  while (slice_size(slice, slice_ns) > count)
+  {
+    _entries.erase(fastest(slice, slice_ns));
+  }
+
+  update_limits(now_ns, count, window_ns);
+}
+
+void Reservoir::get(std::vector<Transaction>& tsxs,
+                    uint64_t now_ns,
+                    size_t count,
+                    uint64_t window_ns)
+{
+  std::unique_lock<std::mutex> lock(_lock);
+  expire(now_ns, window_ns);
+
+  for (const Entry& entry : _entries)
+  {
+    tsxs.push_back(entry.tsx);
+  }
+
+  std::sort(tsxs.begin(),
+            tsxs.end(),
+            [](const Transaction& a, const Transaction& b)
+            {
+              return a.latency_us > b.latency_us;
+            });
+
+  // Merge the slices, keeping the slowest messages over the whole window.
+  if (tsxs.size() > count)
+  {
+    tsxs.resize(count);
+  }
+}
+
+void Reservoir::clear()
+{
+  std::unique_lock<std::mutex> lock(_lock);
+  _entries.clear();
+  _threshold_us = 0;
+  _expiry_ns = UINT64_MAX;
+}
+
+void Reservoir::expire(uint64_t now_ns, uint64_t window_ns)
+{
+  _entries.erase(std::remove_if(_entries.begin(),
+                                _entries.end(),
+                                [now_ns, window_ns](const Entry& entry)
+                                {
+                                  return entry.completed_ns + window_ns <= now_ns;
+                                }),
+                 _entries.end());
+}
+
+Reservoir::EntryIterator Reservoir::fastest(uint64_t slice, uint64_t slice_ns)
+{
+  EntryIterator fastest = _entries.end();
+
+  for (EntryIterator it = _entries.begin(); it != _entries.end(); ++it)
+  {
+    if ((it->completed_ns / slice_ns == slice) &&
+        ((fastest == _entries.end()) ||
+         (it->tsx.latency_us < fastest->tsx.latency_us)))
+    {
+      fastest = it;
+    }
+  }
+
+  return fastest;
+}
+
+size_t Reservoir::slice_size(uint64_t slice, uint64_t slice_ns) const
+{
+  return std::count_if(_entries.begin(),
+                       _entries.end(),
+                       [slice, slice_ns](const Entry& entry)
+                       {
+                         return entry.completed_ns / slice_ns == slice;
+                       });
+}
+
+void Reservoir::update_limits(uint64_t now_ns,
+                              size_t count,
+                              uint64_t window_ns)
+{
+  uint64_t slice_ns = std::max(window_ns / NUM_SLICES, (uint64_t)1);
+  uint64_t slice = now_ns / slice_ns;
+  uint64_t threshold_us = 0;
+
+  // Once the current slice ends, the next message starts a new one, so
+  // must be considered whatever its latency.
+  uint64_t expiry_ns = (slice + 1) * slice_ns;
+
+  if (slice_size(slice, slice_ns) >= count)
+  {
+    threshold_us = fastest(slice, slice_ns)->tsx.latency_us;
+  }
+
+  for (const Entry& entry : _entries)
+  {
+    expiry_ns = std::min(expiry_ns, entry.completed_ns + window_ns);
+  }
+
+  _threshold_us = threshold_us;
+  _expiry_ns = expiry_ns;
+}
+
+size_t ThreadRecord::find_or_add_stage(Stage::Type type, const std::string& name)
+{
+  for (size_t ii = 0; ii < num_stages; ++ii)
+  {
+    if ((stages[ii].type == type) && (stages[ii].name == name))
+    {
+      return ii;
+    }
+  }
+
+  // Reuse a slot from an earlier message if there is one.
+  if (num_stages == stages.size())
+  {
+    stages.push_back(RecordStage());
+  }
+
+  RecordStage& stage = stages[num_stages];
+  stage.type = type;
+  stage.name = name;
+  stage.duration_ns = 0;
+
+  return num_stages++;
+}
+
+/// The name of the method of the message, taken from the CSeq for responses.
+static const pj_str_t* method_name(pjsip_rx_data* rdata)
+{
+  pjsip_msg* msg = rdata->msg_info.msg;
+
+  if (msg->type == PJSIP_REQUEST_MSG)
+  {
+    return &msg->line.req.method.name;
+  }
+  else if (rdata->msg_info.cseq != NULL)
+  {
+    return &rdata->msg_info.cseq->method.name;
+  }
+
+  return NULL;
+}
+
+static int method_index(const pj_str_t* name)
+{
+  if (name != NULL)
+  {
+    for (int ii = 0; ii < NUM_METHODS; ++ii)
+    {
+      if (pj_strcmp2(name, METHODS[ii]) == 0)
+      {
+        return ii;
+      }
+    }
+  }
+
+  return NUM_METHODS;
+}
+
+void configure(int count, int window_s)
+{
+  slow_count = std::max(count, 0);
+  slow_window_ns = (uint64_t)std::max(window_s, 1) * 1000000000ull;
+}
+
+void get_slowest(Report& report)
+{
+  uint64_t now_ns = FastClock::now_ns();
+  size_t count = slow_count.load();
+  uint64_t window_ns = slow_window_ns.load();
+
+  for (int ii = 0; ii <= NUM_METHODS; ++ii)
+  {
+    std::vector<Transaction> tsxs;
+    reservoirs[ii].get(tsxs, now_ns, count, window_ns);
+
+    if (!tsxs.empty())
+    {
+      report[(ii < NUM_METHODS) ? METHODS[ii] : OTHER_METHOD] = tsxs;
+    }
+  }
+}
+
+void reset()
+{
+  for (int ii = 0; ii <= NUM_METHODS; ++ii)
+  {
+    reservoirs[ii].clear();
+  }
+}
+
+void start(uint64_t queue_us)
+{
+  if (slow_count.load(std::memory_order_relaxed) == 0)
+  {
+    return;
+  }
+
+  ThreadRecord& record = thread_record();
+  record.active = true;
+  record.start_ns = FastClock::now_ns();
+  record.mark_ns = record.start_ns;
+  record.queue_us = queue_us;
+  record.status_code = 0;
+  record.served_user.clear();
+  record.num_stages = 0;
+  record.open_stages.clear();
+
+  // The queue and Sprout stages are always the first two.
+  record.find_or_add_stage(Stage::QUEUE, "");
+  record.stages[ThreadRecord::QUEUE_STAGE].duration_ns = queue_us * 1000;
+  record.find_or_add_stage(Stage::SPROUT, "");
+}
+
+void finish(pjsip_rx_data* rdata, SAS::TrailId trail)
+{
+  ThreadRecord& record = thread_record();
+
+  if (!record.active)
+  {
+    return;
+  }
+
+  record.active = false;
+
+  uint64_t now_ns = FastClock::now_ns();
+  record.charge(now_ns);
+
+  uint64_t latency_us = record.queue_us + (now_ns - record.start_ns) / 1000;
+  const pj_str_t* method = method_name(rdata);
+  Reservoir& reservoir = reservoirs[method_index(method)];
+  int count = slow_count.load(std::memory_order_relaxed);
+
+  if ((count == 0) || (!reservoir.might_keep(latency_us, now_ns)))
+  {
+    // This is the path that almost all messages take.
+    return;
+  }
+
+  Transaction tsx;
+  tsx.latency_us = latency_us;
+  tsx.timestamp = FastClock::coarse_time();
+  tsx.trail = trail;
+  tsx.request = (rdata->msg_info.msg->type == PJSIP_REQUEST_MSG);
+  tsx.served_user = record.served_user;
+  tsx.status_code = record.status_code;
+
+  if (method != NULL)
+  {
+    tsx.method = PJUtils::pj_str_to_string(method);
+  }
+
+  if (rdata->msg_info.cid != NULL)
+  {
+    tsx.call_id = PJUtils::pj_str_to_string(&rdata->msg_info.cid->id);
+  }
+
+  for (size_t ii = 0; ii < record.num_stages; ++ii)
+  {
+    const RecordStage& record_stage = record.stages[ii];
+
+    Stage stage;
+    stage.type = record_stage.type;
+    stage.name = record_stage.name;
+    stage.duration_us = record_stage.duration_ns / 1000;
+    tsx.stages.push_back(stage);
+
+    if (stage.type == Stage::SPROUTLET)
+    {
+      tsx.sproutlets.push_back(stage.name);
+    }
+  }
+
+  reservoir.add(tsx, now_ns, count, slow_window_ns.load());
+}
+
+bool recording()
+{
+  return thread_record().active;
+}
+
+void set_served_user(const std::string& served_user)
+{
+  ThreadRecord& record = thread_record();
+
+  if (record.active)
+  {
+    record.served_user = served_user;
+  }
+}
+
+void response_sent(int status_code)
+{
+  ThreadRecord& record = thread_record();
+
+  if (record.active)
+  {
+    record.status_code = status_code;
+  }
+}
+
+void io_started(const std::string& reason)
+{
+  ThreadRecord& record = thread_record();
+
+  if (record.active)
+  {
+    record.enter(Stage::IO, reason);
+  }
+}
+
+void io_completed(const std::string& reason)
+{
+  ThreadRecord& record = thread_record();
+
+  if (record.active)
+  {
+    record.leave(Stage::IO);
+  }
+}
+
+SproutletStage::SproutletStage(const std::string& sproutlet) :
+  _recording(false)
+{
+  ThreadRecord& record = thread_record();
+
+  if (record.active)
+  {
+    record.enter(Stage::SPROUTLET, sproutlet);
+    _recording = true;
+  }
+}
+
+SproutletStage::~SproutletStage()
+{
+  ThreadRecord& record = thread_record();
+
+  if ((_recording) && (record.active))
+  {
+    record.leave(Stage::SPROUTLET);
+  }
+}
+
+};
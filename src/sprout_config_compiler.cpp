@@ -0,0 +1,86 @@
+/**
+ * @file sprout_config_compiler.cpp Offline compiler for Sprout's routing
+ * configuration files.
+ *
+ * Compiles enum.json or bgcf.json into a binary image that Sprout loads in
+ * place of the JSON file (see config_image.h).  The image is written
+ * alongside the source file, so it should be recompiled whenever the source
+ * file changes - Sprout ignores images that are out of date.
+ *
+ * Usage: sprout_config_compiler (enum|bgcf) <source file> [<image file>]
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <stdio.h>
+#include <string>
+
+#include "log.h"
+#include "utils.h"
+#include "enumservice.h"
+#include "bgcfservice.h"
+#include "config_image.h"
+
+// LCOV_EXCL_START - The compiler is a thin wrapper around the services'
+// compile_image functions, which are covered by their own UTs.
+
+static void usage(const char* name)
+{
+  fprintf(stderr,
+          "Usage: %s (enum|bgcf) <source file> [<image file>]\n"
+          "\n"
+          "Compiles an ENUM or BGCF JSON configuration file into a binary image\n"
+          "that Sprout loads in its place.  By default the image is written to\n"
+          "<source file>%s.\n",
+          name,
+          ConfigImage::image_path("").c_str());
+}
+
+int main(int argc, char* argv[])
+{
+  if ((argc < 3) || (argc > 4))
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::string type = argv[1];
+  std::string source_path = argv[2];
+  std::string image_path = (argc == 4) ?
+                           argv[3] : ConfigImage::image_path(source_path);
+
+  // Log to stdout, so that problems with the configuration are reported to
+  // whoever is compiling it.
+  Utils::daemon_log_setup(argc, argv, false, "", Log::STATUS_LEVEL, false);
+
+  bool success;
+
+  if (type == "enum")
+  {
+    success = JSONEnumService::compile_image(source_path, image_path);
+  }
+  else if (type == "bgcf")
+  {
+    success = BgcfService::compile_image(source_path, image_path);
+  }
+  else
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (!success)
+  {
+    fprintf(stderr, "Failed to compile %s\n", source_path.c_str());
+    return 1;
+  }
+
+  return 0;
+}
+
+// LCOV_EXCL_STOP
@@ -0,0 +1,65 @@
+/**
+ * @file sprout_probes.cpp Static (USDT) tracepoints on Sprout's SIP hot path.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <algorithm>
+#include <string.h>
+
+#include "sprout_probes.h"
+
+SPROUT_PROBE_DEFINE(dispatch_enqueue);
+SPROUT_PROBE_DEFINE(dispatch_dequeue);
+SPROUT_PROBE_DEFINE(sproutlet_entry);
+SPROUT_PROBE_DEFINE(sproutlet_exit);
+SPROUT_PROBE_DEFINE(hss_request_start);
+SPROUT_PROBE_DEFINE(hss_request_finish);
+SPROUT_PROBE_DEFINE(s4_request_start);
+SPROUT_PROBE_DEFINE(s4_request_finish);
+SPROUT_PROBE_DEFINE(ralf_request_start);
+SPROUT_PROBE_DEFINE(ralf_request_finish);
+SPROUT_PROBE_DEFINE(tsx_create);
+SPROUT_PROBE_DEFINE(tsx_destroy);
+
+ProbeMethod::ProbeMethod(const pjsip_method* method)
+{
+  set(&method->name);
+}
+
+ProbeMethod::ProbeMethod(const pjsip_msg* msg)
+{
+  _name[0] = '\0';
+
+  if (msg == NULL)
+  {
+    return;
+  }
+  else if (msg->type == PJSIP_REQUEST_MSG)
+  {
+    set(&msg->line.req.method.name);
+  }
+  else
+  {
+    const pjsip_cseq_hdr* cseq = (const pjsip_cseq_hdr*)
+                           pjsip_msg_find_hdr(msg, PJSIP_H_CSEQ, NULL);
+
+    if (cseq != NULL)
+    {
+      set(&cseq->method.name);
+    }
+  }
+}
+
+void ProbeMethod::set(const pj_str_t* name)
+{
+  // Longer (extension) methods are truncated.
+  size_t len = std::min((size_t)name->slen, sizeof(_name) - 1);
+  memcpy(_name, name->ptr, len);
+  _name[len] = '\0';
+}
@@ -24,11 +24,23 @@ extern "C" {
 #include "sproutsasevent.h"
 #include "sproutletproxy.h"
 #include "snmp_sip_request_types.h"
+#include "io_profiler.h"
+#include "slow_transactions.h"
+#include "sprout_probes.h"
 
 const pj_str_t SproutletProxy::STR_SERVICE = {"service", 7};
 
 const ForkState NULL_FORK_STATE = {PJSIP_TSX_STATE_NULL, NONE};
 
+/// Gets the method of a message passed to a Sproutlet callback, for the
+/// callback's entry and exit probes.  The message is NULL for callbacks that
+/// aren't passed one.  The method is only copied out if a tracer is attached.
+static ProbeMethod probe_method(const pjsip_msg* msg)
+{
+  return ProbeMethod((SPROUT_PROBE_ENABLED(sproutlet_entry) ||
+                      SPROUT_PROBE_ENABLED(sproutlet_exit)) ? msg : NULL);
+}
+
 /// Constructor.
 SproutletProxy::SproutletProxy(pjsip_endpoint* endpt,
                                int priority,
@@ -1339,6 +1351,7 @@ void SproutletProxy::UASTsx::tx_response(SproutletWrapper* downstream,
     if (_tsx != NULL)
     {
       int st_code = rsp->msg->line.status.code;
+      SlowTransactions::response_sent(st_code);
       set_trail(rsp, trail());
       on_tx_response(rsp);
       pj_status_t status = pjsip_tsx_send_msg(_tsx, rsp);
@@ -2278,17 +2291,27 @@ void SproutletWrapper::rx_request(pjsip_tx_data* req, int allowed_host_state)
     // @TODO
   }
 
+  // Attribute the time the Sproutlet takes, and any IO it does, to it.
+  IoProfiler::SproutletScope io_scope(_service_name);
+  SlowTransactions::SproutletStage slow_stage(_service_name);
+
   if (PJSIP_MSG_TO_HDR(clone)->tag.slen == 0)
   {
     TRC_VERBOSE("%s pass initial request %s to Sproutlet",
                 _id.c_str(), msg_info(clone));
+    ProbeMethod method = probe_method(clone);
+    probe_entry("on_rx_initial_request", method);
     _sproutlet_tsx->on_rx_initial_request(clone);
+    probe_exit("on_rx_initial_request", method);
   }
   else
   {
     TRC_VERBOSE("%s pass in dialog request %s to Sproutlet",
                 _id.c_str(), msg_info(clone));
+    ProbeMethod method = probe_method(clone);
+    probe_entry("on_rx_in_dialog_request", method);
     _sproutlet_tsx->on_rx_in_dialog_request(clone);
+    probe_exit("on_rx_in_dialog_request", method);
   }
 
   // We consider an ACK transaction to be complete immediately after the
@@ -2355,7 +2378,12 @@ void SproutletWrapper::rx_response(pjsip_tx_data* rsp,
       }
     }
   }
+  IoProfiler::SproutletScope io_scope(_service_name);
+  SlowTransactions::SproutletStage slow_stage(_service_name);
+  ProbeMethod method = probe_method(rsp->msg);
+  probe_entry("on_rx_response", method);
   _sproutlet_tsx->on_rx_response(rsp->msg, fork_id);
+  probe_exit("on_rx_response", method);
 
   process_actions(false);
 }
@@ -2363,8 +2391,13 @@ void SproutletWrapper::rx_response(pjsip_tx_data* rsp,
 void SproutletWrapper::rx_cancel(pjsip_tx_data* cancel, const std::string& reason)
 {
   TRC_VERBOSE("%s received CANCEL request", _id.c_str());
+  IoProfiler::SproutletScope io_scope(_service_name);
+  SlowTransactions::SproutletStage slow_stage(_service_name);
+  ProbeMethod method = probe_method(cancel->msg);
+  probe_entry("on_rx_cancel", method);
   _sproutlet_tsx->on_rx_cancel(PJSIP_SC_REQUEST_TERMINATED,
                            cancel->msg);
+  probe_exit("on_rx_cancel", method);
   pjsip_tx_data_dec_ref(cancel);
   cancel_pending_forks(PJSIP_SC_REQUEST_TERMINATED, reason);
   process_actions(false);
@@ -2376,7 +2409,12 @@ void SproutletWrapper::rx_error(int status_code, const std::string& reason)
               _id.c_str(),
               status_code,
               reason.c_str());
+  IoProfiler::SproutletScope io_scope(_service_name);
+  SlowTransactions::SproutletStage slow_stage(_service_name);
+  ProbeMethod method = probe_method(NULL);
+  probe_entry("on_rx_cancel", method);
   _sproutlet_tsx->on_rx_cancel(status_code, NULL);
+  probe_exit("on_rx_cancel", method);
   cancel_pending_forks(status_code, reason);
 
   // Consider the transaction to be complete as no final response should be
@@ -2433,7 +2471,12 @@ void SproutletWrapper::rx_fork_error(ForkErrorState fork_error, int fork_id)
 
       // Pass the response to the application.
       register_tdata(rsp);
+      IoProfiler::SproutletScope io_scope(_service_name);
+      SlowTransactions::SproutletStage slow_stage(_service_name);
+      ProbeMethod method = probe_method(rsp->msg);
+      probe_entry("on_rx_response", method);
       _sproutlet_tsx->on_rx_response(rsp->msg, fork_id);
+      probe_exit("on_rx_response", method);
       process_actions(false);
     }
   }
@@ -2443,7 +2486,12 @@ void SproutletWrapper::on_timer_pop(TimerID id, void* context)
 {
   TRC_DEBUG("Processing timer pop, id = %ld", id);
   _pending_timers.erase(id);
+  IoProfiler::SproutletScope io_scope(_service_name);
+  SlowTransactions::SproutletStage slow_stage(_service_name);
+  ProbeMethod method = probe_method(NULL);
+  probe_entry("on_timer_expiry", method);
   _sproutlet_tsx->on_timer_expiry(context);
+  probe_exit("on_timer_expiry", method);
   process_actions(false);
 }
 
@@ -2825,6 +2873,35 @@ void SproutletWrapper::log_inter_sproutlet(pjsip_tx_data* tdata,
               buf);
 }
 
+/// Fires the probes for entry to and exit from a Sproutlet callback.  The
+/// method is taken from the message before the callback (see probe_method),
+/// as the Sproutlet may free the message.
+void SproutletWrapper::probe_entry(const char* callback,
+                                   const ProbeMethod& method)
+{
+  if (SPROUT_PROBE_ENABLED(sproutlet_entry))
+  {
+    SPROUT_PROBE(sproutlet_entry,
+                 trail(),
+                 _service_name.c_str(),
+                 callback,
+                 method.c_str());
+  }
+}
+
+void SproutletWrapper::probe_exit(const char* callback,
+                                  const ProbeMethod& method)
+{
+  if (SPROUT_PROBE_ENABLED(sproutlet_exit))
+  {
+    SPROUT_PROBE(sproutlet_exit,
+                 trail(),
+                 _service_name.c_str(),
+                 callback,
+                 method.c_str());
+  }
+}
+
 bool SproutletWrapper::is_network_func_boundary() const
 {
   // If this network function has a different name to the upstream one, then
@@ -51,6 +51,7 @@ extern "C" {
 #include "sprout_pd_definitions.h"
 #include "uri_classifier.h"
 #include "namespace_hop.h"
+#include "adaptive_pool.h"
 
 class StackQuiesceHandler;
 
@@ -556,6 +557,10 @@ pj_status_t init_pjsip()
 
   // Must create a pool factory before we can allocate any memory.
   pj_caching_pool_init(&stack_data.cp, &pj_pool_factory_default_policy, 0);
+
+  // Size and recycle the pools used for messages adaptively.
+  stack_data.adaptive_pools = new AdaptivePoolFactory(&stack_data.cp);
+
   // Create the endpoint.
   status = pjsip_endpt_create(&stack_data.cp.factory, NULL, &stack_data.endpt);
   PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
@@ -902,6 +907,10 @@ pj_status_t init_stack(int pcscf_trusted_port,
     stack_data.name.push_back(alias_pj_str);
   }
 
+  // Now that all the home domains and local names are known, build the sets
+  // the URI classifier uses to recognise them.
+  URIClassifier::update_host_sets();
+
   // Set up the Last Value Cache, accumulators and counters.
   std::string process_name;
   if ((stack_data.pcscf_trusted_port != 0) &&
@@ -958,6 +967,7 @@ pj_status_t stop_pjsip_thread()
 void term_pjsip()
 {
   pjsip_endpt_destroy(stack_data.endpt);
+  delete stack_data.adaptive_pools; stack_data.adaptive_pools = NULL;
   pj_pool_release(stack_data.pool);
   pj_caching_pool_destroy(&stack_data.cp);
   pj_shutdown();
@@ -339,6 +339,37 @@ Bindings SubscriberDataUtils::copy_active_bindings(const Bindings& bindings,
   return copy_bindings;
 }
 
+Bindings SubscriberDataUtils::take_active_bindings(Bindings& bindings,
+                                                   int now,
+                                                   SAS::TrailId trail)
+{
+  Bindings active_bindings;
+  Bindings::iterator it = bindings.begin();
+  while (it != bindings.end())
+  {
+    if (it->second->_expires - now > 0)
+    {
+      // Hand the binding over to the caller. The end hint makes each insert
+      // constant time, as the source map is already in key order.
+      active_bindings.insert(active_bindings.end(), *it);
+      it = bindings.erase(it);
+    }
+    else
+    {
+      SAS::Event event(trail, SASEvent::BINDING_EXPIRED, 0);
+      event.add_var_param(it->second->_address_of_record);
+      event.add_var_param(it->second->_uri);
+      event.add_var_param(it->second->_cid);
+      event.add_static_param(it->second->_expires);
+      event.add_static_param(now);
+      SAS::report_event(event);
+      ++it;
+    }
+  }
+
+  return active_bindings;
+}
+
 Subscriptions SubscriberDataUtils::copy_subscriptions(const Subscriptions& subscriptions)
 {
   Subscriptions copy_subscriptions;
@@ -13,6 +13,7 @@
 #include "sproutsasevent.h"
 #include "aor_utils.h"
 #include "pjutils.h"
+#include "sprout_probes.h"
 
 SubscriberManager::SubscriberManager(S4* s4,
                                      HSSConnection* hss_connection,
@@ -92,9 +93,9 @@ HTTPCode SubscriberManager::register_subscriber_internal(const std::string& aor_
     updated_aor->_scscf_uri = server_name;
 
     // PUT a new AoR.
-    HTTPCode rc = _s4->handle_put(aor_id,
-                                  *updated_aor,
-                                  trail);
+    HTTPCode rc = s4_put(aor_id,
+                         *updated_aor,
+                         trail);
 
     // If the PUT resulted in precondition failed (which happens if there is
     // already an AoR in the store), we retry with a reregister.
@@ -125,8 +126,9 @@ HTTPCode SubscriberManager::register_subscriber_internal(const std::string& aor_
 
     log_updated_bindings(*updated_aor, add_bindings, now);
 
-    // Get all bindings to return to the caller
-    all_bindings = SubscriberDataUtils::copy_active_bindings(updated_aor->bindings(),
+    // Get all bindings to return to the caller. The AoR is deleted below, so
+    // hand its bindings over rather than copying them.
+    all_bindings = SubscriberDataUtils::take_active_bindings(updated_aor->_bindings,
                                                              now,
                                                              trail);
   }
@@ -195,10 +197,10 @@ HTTPCode SubscriberManager::reregister_subscriber_internal(const std::string& ao
 
   AoR* orig_aor = NULL;
   uint64_t unused_version;
-  HTTPCode rc = _s4->handle_get(aor_id,
-                                &orig_aor,
-                                unused_version,
-                                trail);
+  HTTPCode rc = s4_get(aor_id,
+                       &orig_aor,
+                       unused_version,
+                       trail);
 
   // We are reregistering a subscriber, so there must be an existing AoR in the
   // store.
@@ -247,10 +249,10 @@ HTTPCode SubscriberManager::reregister_subscriber_internal(const std::string& ao
               associated_uris);
 
   // PATCH the existing AoR.
-  rc = _s4->handle_patch(aor_id,
-                         patch_object,
-                         &updated_aor,
-                         trail);
+  rc = s4_patch(aor_id,
+                patch_object,
+                &updated_aor,
+                trail);
 
   // If we didn't find an existing AoR, that means the subscriber does not
   // currently exist. We might want to retry by registering the subscriber
@@ -287,11 +289,6 @@ HTTPCode SubscriberManager::reregister_subscriber_internal(const std::string& ao
                     subscription_ids_to_remove,
                     now);
 
-  // Get all bindings to return to the caller
-  all_bindings = SubscriberDataUtils::copy_active_bindings(updated_aor->bindings(),
-                                                           now,
-                                                           trail);
-
   send_notifys(aor_id,
                orig_aor,
                updated_aor,
@@ -299,6 +296,13 @@ HTTPCode SubscriberManager::reregister_subscriber_internal(const std::string& ao
                now,
                trail);
 
+  // Get all bindings to return to the caller. This must be done after the
+  // NOTIFYs are sent, as it hands the bindings over from the updated AoR
+  // rather than copying them.
+  all_bindings = SubscriberDataUtils::take_active_bindings(updated_aor->_bindings,
+                                                           now,
+                                                           trail);
+
   // Update HSS if all bindings expired.
   if (all_bindings.empty())
   {
@@ -348,10 +352,10 @@ HTTPCode SubscriberManager::remove_bindings(const std::string& public_id,
   // Get the original AoR from S4.
   AoR* orig_aor = NULL;
   uint64_t unused_version;
-  rc = _s4->handle_get(aor_id,
-                       &orig_aor,
-                       unused_version,
-                       trail);
+  rc = s4_get(aor_id,
+              &orig_aor,
+              unused_version,
+              trail);
 
   if (rc != HTTP_OK)
   {
@@ -392,10 +396,10 @@ HTTPCode SubscriberManager::remove_bindings(const std::string& public_id,
 
   // PATCH the existing AoR.
   AoR* updated_aor = NULL;
-  rc = _s4->handle_patch(aor_id,
-                         patch_object,
-                         &updated_aor,
-                         trail);
+  rc = s4_patch(aor_id,
+                patch_object,
+                &updated_aor,
+                trail);
 
   if (rc != HTTP_OK)
   {
@@ -413,11 +417,6 @@ HTTPCode SubscriberManager::remove_bindings(const std::string& public_id,
                     subscription_ids_to_remove,
                     now);
 
-  // Get all bindings to return to the caller
-  bindings = SubscriberDataUtils::copy_active_bindings(updated_aor->bindings(),
-                                                       now,
-                                                       trail);
-
   send_notifys(aor_id,
                orig_aor,
                updated_aor,
@@ -425,6 +424,13 @@ HTTPCode SubscriberManager::remove_bindings(const std::string& public_id,
                now,
                trail);
 
+  // Get all bindings to return to the caller. This must be done after the
+  // NOTIFYs are sent, as it hands the bindings over from the updated AoR
+  // rather than copying them.
+  bindings = SubscriberDataUtils::take_active_bindings(updated_aor->_bindings,
+                                                       now,
+                                                       trail);
+
   // Update HSS if all bindings expired.
   if (bindings.empty())
   {
@@ -516,10 +522,10 @@ HTTPCode SubscriberManager::modify_subscriptions(
 
   AoR* orig_aor = NULL;
   uint64_t unused_version;
-  rc = _s4->handle_get(aor_id,
-                       &orig_aor,
-                       unused_version,
-                       trail);
+  rc = s4_get(aor_id,
+              &orig_aor,
+              unused_version,
+              trail);
 
   // There must be an existing AoR since there must be bindings to subscribe to.
   if (rc != HTTP_OK)
@@ -539,10 +545,10 @@ HTTPCode SubscriberManager::modify_subscriptions(
 
   // PATCH the existing AoR.
   AoR* updated_aor = NULL;
-  rc = _s4->handle_patch(aor_id,
-                         patch_object,
-                         &updated_aor,
-                         trail);
+  rc = s4_patch(aor_id,
+                patch_object,
+                &updated_aor,
+                trail);
 
   if (rc != HTTP_OK)
   {
@@ -605,10 +611,10 @@ HTTPCode SubscriberManager::deregister_subscriber(const std::string& public_id,
   do
   {
     uint64_t version;
-    rc = _s4->handle_get(aor_id,
-                         &orig_aor,
-                         version,
-                         trail);
+    rc = s4_get(aor_id,
+                &orig_aor,
+                version,
+                trail);
 
     if (rc != HTTP_OK)
     {
@@ -640,9 +646,9 @@ HTTPCode SubscriberManager::deregister_subscriber(const std::string& public_id,
     log_removed_bindings(*orig_aor,
                          binding_ids);
 
-    rc = _s4->handle_delete(aor_id,
-                            version,
-                            trail);
+    rc = s4_delete(aor_id,
+                   version,
+                   trail);
   } while (rc == HTTP_PRECONDITION_FAILED);
 
   if ((rc != HTTP_OK) && (rc != HTTP_NO_CONTENT))
@@ -695,10 +701,10 @@ HTTPCode SubscriberManager::get_bindings(const std::string& aor_id,
 
   AoR* aor = NULL;
   uint64_t unused_version;
-  HTTPCode rc = _s4->handle_get(aor_id,
-                                &aor,
-                                unused_version,
-                                trail);
+  HTTPCode rc = s4_get(aor_id,
+                       &aor,
+                       unused_version,
+                       trail);
   if (rc != HTTP_OK)
   {
     TRC_DEBUG("Retrieving bindings for AoR %s failed during GET with return code %d",
@@ -707,8 +713,9 @@ HTTPCode SubscriberManager::get_bindings(const std::string& aor_id,
     return rc;
   }
 
-  // Set the bindings to return to the caller.
-  bindings = SubscriberDataUtils::copy_active_bindings(aor->bindings(),
+  // Set the bindings to return to the caller. The AoR is only used to carry
+  // the bindings out of the store, so take them rather than copying them.
+  bindings = SubscriberDataUtils::take_active_bindings(aor->_bindings,
                                                        time(NULL),
                                                        trail);
 
@@ -725,10 +732,10 @@ HTTPCode SubscriberManager::get_subscriptions(const std::string& aor_id,
 
   AoR* aor = NULL;
   uint64_t unused_version;
-  HTTPCode rc = _s4->handle_get(aor_id,
-                                &aor,
-                                unused_version,
-                                trail);
+  HTTPCode rc = s4_get(aor_id,
+                       &aor,
+                       unused_version,
+                       trail);
   if (rc != HTTP_OK)
   {
     TRC_DEBUG("Retrieving subscriptions for AoR %s failed during GET with return code %d",
@@ -780,10 +787,10 @@ HTTPCode SubscriberManager::update_associated_uris(const std::string& aor_id,
   // Get the original AoR from S4.
   AoR* orig_aor = NULL;
   uint64_t unused_version;
-  HTTPCode rc = _s4->handle_get(aor_id,
-                                &orig_aor,
-                                unused_version,
-                                trail);
+  HTTPCode rc = s4_get(aor_id,
+                       &orig_aor,
+                       unused_version,
+                       trail);
 
   if (rc != HTTP_OK)
   {
@@ -799,10 +806,10 @@ HTTPCode SubscriberManager::update_associated_uris(const std::string& aor_id,
 
   // PATCH the existing AoR.
   AoR* updated_aor = NULL;
-  rc = _s4->handle_patch(aor_id,
-                         patch_object,
-                         &updated_aor,
-                         trail);
+  rc = s4_patch(aor_id,
+                patch_object,
+                &updated_aor,
+                trail);
 
   if (rc != HTTP_OK)
   {
@@ -843,10 +850,10 @@ void SubscriberManager::handle_timer_pop_internal(const std::string& aor_id,
   // Get the original AoR from S4.
   AoR* orig_aor = NULL;
   uint64_t unused_version;
-  HTTPCode rc = _s4->handle_get(aor_id,
-                                &orig_aor,
-                                unused_version,
-                                trail);
+  HTTPCode rc = s4_get(aor_id,
+                       &orig_aor,
+                       unused_version,
+                       trail);
   if (rc != HTTP_OK)
   {
     TRC_DEBUG("Handling timer pop for AoR %s failed during GET with return code %d",
@@ -895,10 +902,10 @@ void SubscriberManager::handle_timer_pop_internal(const std::string& aor_id,
                 subscription_ids_to_remove);
 
     // PATCH the existing AoR.
-    rc = _s4->handle_patch(aor_id,
-                           patch_object,
-                           &updated_aor,
-                           trail);
+    rc = s4_patch(aor_id,
+                  patch_object,
+                  &updated_aor,
+                  trail);
 
     if (rc != HTTP_OK)
     {
@@ -1014,6 +1021,48 @@ HTTPCode SubscriberManager::get_cached_default_id(const std::string& public_id,
   return rc;
 }
 
+HTTPCode SubscriberManager::s4_get(const std::string& aor_id,
+                                   AoR** aor,
+                                   uint64_t& version,
+                                   SAS::TrailId trail)
+{
+  SPROUT_PROBE(s4_request_start, trail, "GET", aor_id.c_str());
+  HTTPCode rc = _s4->handle_get(aor_id, aor, version, trail);
+  SPROUT_PROBE(s4_request_finish, trail, "GET", aor_id.c_str(), rc);
+  return rc;
+}
+
+HTTPCode SubscriberManager::s4_put(const std::string& aor_id,
+                                   AoR& aor,
+                                   SAS::TrailId trail)
+{
+  SPROUT_PROBE(s4_request_start, trail, "PUT", aor_id.c_str());
+  HTTPCode rc = _s4->handle_put(aor_id, aor, trail);
+  SPROUT_PROBE(s4_request_finish, trail, "PUT", aor_id.c_str(), rc);
+  return rc;
+}
+
+HTTPCode SubscriberManager::s4_patch(const std::string& aor_id,
+                                     PatchObject& patch_object,
+                                     AoR** aor,
+                                     SAS::TrailId trail)
+{
+  SPROUT_PROBE(s4_request_start, trail, "PATCH", aor_id.c_str());
+  HTTPCode rc = _s4->handle_patch(aor_id, patch_object, aor, trail);
+  SPROUT_PROBE(s4_request_finish, trail, "PATCH", aor_id.c_str(), rc);
+  return rc;
+}
+
+HTTPCode SubscriberManager::s4_delete(const std::string& aor_id,
+                                      uint64_t version,
+                                      SAS::TrailId trail)
+{
+  SPROUT_PROBE(s4_request_start, trail, "DELETE", aor_id.c_str());
+  HTTPCode rc = _s4->handle_delete(aor_id, version, trail);
+  SPROUT_PROBE(s4_request_finish, trail, "DELETE", aor_id.c_str(), rc);
+  return rc;
+}
+
 std::vector<std::string> SubscriberManager::subscriptions_to_remove(const Bindings& orig_bindings,
                                                                     const Subscriptions& orig_subscriptions,
                                                                     const Bindings& bindings_to_update,
@@ -41,11 +41,13 @@ SubscriptionSproutlet::SubscriptionSproutlet(const std::string& name,
                                              const std::string& next_hop_service,
                                              SubscriberManager* sm,
                                              ACRFactory* acr_factory,
-                                             int cfg_max_expires) :
+                                             int cfg_max_expires,
+                                             ExpiryJitter* expiry_jitter) :
   Sproutlet(name, port, uri, "", {}, NULL, NULL, network_function),
   _sm(sm),
   _acr_factory(acr_factory),
   _max_expires(cfg_max_expires),
+  _expiry_jitter(expiry_jitter),
   _next_hop_service(next_hop_service)
 {
 }
@@ -117,7 +119,7 @@ bool SubscriptionSproutlet::handle_request(pjsip_msg* req,
   pjsip_event_hdr* event =
            (pjsip_event_hdr*)pjsip_msg_find_hdr_by_name(req, &event_name, NULL);
 
-  if (!event || (PJUtils::pj_str_to_string(&event->event_type) != "reg"))
+  if (!event || (PJUtils::pj_str_view(&event->event_type) != "reg"))
   {
     // The Event header is missing or doesn't match "reg"
     TRC_DEBUG("Not processing subscribe that's not for the 'reg' package");
@@ -319,6 +321,20 @@ void SubscriptionSproutletTsx::process_subscription_request(pjsip_msg* req)
     expiry = _subscription->_max_expires;
   }
 
+  // Randomise the expiry, if configured, so that devices that subscribed
+  // together don't refresh together.  The expiry is only recorded in the
+  // jitter histogram once the subscription has been stored.  A refresh
+  // doesn't remove the expiry it replaces, which would need another lookup
+  // of the subscription - the stale count ages out of the histogram when
+  // the old expiry falls due.
+  int requested_expiry = expiry;
+  int now = time(NULL);
+
+  if ((expiry != 0) && (_subscription->_expiry_jitter != NULL))
+  {
+    expiry = _subscription->_expiry_jitter->choose(expiry, now);
+  }
+
   // Create a subscription object from the request that we can pass down to
   // be set into/updated in the different stores
   Subscription* new_subscription = create_subscription(req, expiry);
@@ -361,6 +377,11 @@ void SubscriptionSproutletTsx::process_subscription_request(pjsip_msg* req)
     // The subscribe was successful. SAS log, and add headers to the response.
     TRC_DEBUG("The subscribe has been successful");
 
+    if ((expiry != 0) && (_subscription->_expiry_jitter != NULL))
+    {
+      _subscription->_expiry_jitter->record(requested_expiry, expiry, now);
+    }
+
     SAS::Event sub_accepted(trail_id, SASEvent::SUBSCRIBE_ACCEPTED, 0);
     SAS::report_event(sub_accepted);
 
@@ -483,18 +504,6 @@ Subscription* SubscriptionSproutletTsx::create_subscription(pjsip_msg* req,
                                                      route_hdr->next);
   }
 
-  pjsip_expires_hdr* expires =
-             (pjsip_expires_hdr*)pjsip_msg_find_hdr(req, PJSIP_H_EXPIRES, NULL);
-  expiry = (expires != NULL) ?
-             expires->ivalue :
-             SubscriptionSproutlet::DEFAULT_SUBSCRIPTION_EXPIRES;
-
-  if (expiry > _subscription->_max_expires)
-  {
-    // Expiry is too long, set it to the maximum.
-    expiry = _subscription->_max_expires;
-  }
-
   subscription->_to_tag = subscription_id;
   subscription->_req_uri = contact_uri;
   subscription->_cid = cid;
@@ -48,6 +48,9 @@ extern "C" {
 #include "snmp_event_accumulator_table.h"
 #include "snmp_event_accumulator_by_scope_table.h"
 #include "thread_dispatcher.h"
+#include "io_profiler.h"
+#include "slow_transactions.h"
+#include "sprout_probes.h"
 
 static const boost::regex EMERGENCY_SERVICES_URI = boost::regex("service.*:sos.*", boost::regex::icase);
 
@@ -115,13 +118,13 @@ static pjsip_module mod_thread_dispatcher =
 };
 
 // LCOV_EXCL_START
-static void pause_stopwatch(Utils::StopWatch& s, const std::string& reason)
+static void pause_stopwatch(FastStopWatch& s, const std::string& reason)
 {
   TRC_DEBUG("Pausing stopwatch due to %s", reason.c_str());
   s.stop();
 }
 
-static void resume_stopwatch(Utils::StopWatch& s, const std::string& reason)
+static void resume_stopwatch(FastStopWatch& s, const std::string& reason)
 {
   TRC_DEBUG("Resuming stopwatch after %s", reason.c_str());
   s.start();
@@ -192,6 +195,20 @@ bool process_queue_element()
 
         SAS::TrailId trail = get_trail(rdata);
 
+        // Record where the time goes while processing the message, in case
+        // it's one of the slowest.
+        SlowTransactions::start(latency_us);
+
+        if (SPROUT_PROBE_ENABLED(dispatch_dequeue))
+        {
+          ProbeMethod method(rdata->msg_info.msg);
+          SPROUT_PROBE(dispatch_dequeue,
+                       trail,
+                       method.c_str(),
+                       probe_status_code(rdata->msg_info.msg),
+                       latency_us);
+        }
+
         if ((latency_us > (request_on_queue_timeout_us)) &&
             (rdata->msg_info.msg->type == PJSIP_REQUEST_MSG))
         {
@@ -223,6 +240,8 @@ bool process_queue_element()
             SAS::report_marker(end_marker);
 
             reject_with_retry_header(rdata, PJSIP_SC_SERVICE_UNAVAILABLE);
+            SlowTransactions::response_sent(PJSIP_SC_SERVICE_UNAVAILABLE);
+            SlowTransactions::finish(rdata, trail);
             pjsip_rx_data_free_cloned(rdata);
           }
         }
@@ -259,6 +278,7 @@ bool process_queue_element()
             {
               TRC_DEBUG("Returning 500 response following exception");
               reject_with_retry_header(rdata, PJSIP_SC_INTERNAL_SERVER_ERROR);
+              SlowTransactions::response_sent(PJSIP_SC_INTERNAL_SERVER_ERROR);
             }
 
             if (num_worker_threads == 1)
@@ -298,6 +318,7 @@ bool process_queue_element()
             TRC_ERROR("Failed to get done timestamp: %s", strerror(errno)); // LCOV_EXCL_LINE
           }
 
+          SlowTransactions::finish(rdata, trail);
           pjsip_rx_data_free_cloned(rdata);
         }
       }
@@ -361,6 +382,14 @@ int worker_thread(void* p)
   // will not work properly.
   CW_IO_CALLS_REQUIRED();
 
+  // Profile the IO this thread does (if enabled).
+  Utils::IOHook io_profiler_hook(&IoProfiler::io_started,
+                                 &IoProfiler::io_completed);
+
+  // Record the IO this thread does against the message it's processing.
+  Utils::IOHook slow_transactions_hook(&SlowTransactions::io_started,
+                                       &SlowTransactions::io_completed);
+
   bool rc = true;
 
   while (rc) {
@@ -651,6 +680,16 @@ static pj_bool_t threads_on_rx_msg(pjsip_rx_data* rdata)
   {
     queue_success_fail_table->increment_attempts(qe.priority); // LCOV_EXCL_LINE
   }
+
+  if (SPROUT_PROBE_ENABLED(dispatch_enqueue))
+  {
+    ProbeMethod method(clone_rdata->msg_info.msg);
+    SPROUT_PROBE(dispatch_enqueue,
+                 trail,
+                 method.c_str(),
+                 probe_status_code(clone_rdata->msg_info.msg));
+  }
+
   sip_event_queue.push(qe);
 
   // return TRUE to flag that we have absorbed the incoming message.
@@ -8,58 +8,253 @@
  */
 
 #include <vector>
-#include <boost/regex.hpp>
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
 #include "uri_classifier.h"
 #include "stack.h"
 #include "constants.h"
 
-// Regexes that match global and local numbers:
+// Character classes for global and local numbers:
 // - A global number starts with "+" followed by a combination of digits "0-9"
 //   and visual separators ",-()".
 // - A local number can contain a combination of hexdigits "0-9A-F", "*#" and
 //   visual separators ",-()".
-static const boost::regex CHARS_ALLOWED_IN_GLOBAL_NUM = boost::regex("\\+[0-9,\\-\\(\\)]*");
-static const boost::regex CHARS_ALLOWED_IN_LOCAL_NUM = boost::regex("[0-9A-F\\*#,\\-\\(\\)]*");
+//
+// These are looked up in a table rather than matched with a regex, as they're
+// checked for most URIs we classify.
+static const unsigned char CHAR_GLOBAL_NUM = 0x01;
+static const unsigned char CHAR_LOCAL_NUM = 0x02;
 
-std::vector<pj_str_t*> URIClassifier::home_domains;
-bool URIClassifier::enforce_global;
-bool URIClassifier::enforce_user_phone;
+static struct NumberCharTable
+{
+  unsigned char flags[256];
 
-bool URIClassifier::is_user_numeric(pj_str_t user)
+  NumberCharTable()
+  {
+    memset(flags, 0, sizeof(flags));
+
+    for (const char* c = "0123456789,-()"; *c != '\0'; ++c)
+    {
+      flags[(unsigned char)*c] |= (CHAR_GLOBAL_NUM | CHAR_LOCAL_NUM);
+    }
+
+    for (const char* c = "ABCDEF*#"; *c != '\0'; ++c)
+    {
+      flags[(unsigned char)*c] |= CHAR_LOCAL_NUM;
+    }
+  }
+} number_chars;
+
+// Checks that every character in the range belongs to the character class.
+static bool all_chars_in_class(const char* start,
+                               const char* end,
+                               unsigned char char_class)
 {
-  return Utils::is_user_numeric(user.ptr, user.slen);
+  for (const char* c = start; c < end; ++c)
+  {
+    if (!(number_chars.flags[(unsigned char)*c] & char_class))
+    {
+      return false;
+    }
+  }
+
+  return true;
 }
 
-static bool is_home_domain(pj_str_t host)
+// Equivalent to matching "\+[0-9,\-\(\)]*".
+static bool is_global_number(const char* start, const char* end)
+{
+  return ((start < end) &&
+          (*start == '+') &&
+          all_chars_in_class(start + 1, end, CHAR_GLOBAL_NUM));
+}
+
+// Equivalent to matching "[0-9A-F\*#,\-\(\)]*".
+static bool is_local_number(const char* start, const char* end)
+{
+  return all_chars_in_class(start, end, CHAR_LOCAL_NUM);
+}
+
+// Find the user part minus any parameters. This is the first non-empty
+// ';'-separated token after trimming whitespace.
+//
+// @returns false if the user part doesn't contain such a token.
+static bool user_without_params(const pj_str_t& user,
+                                const char** start,
+                                const char** end)
+{
+  const char* p = user.ptr;
+  const char* user_end = user.ptr + user.slen;
+
+  while (p < user_end)
+  {
+    const char* token_end = (const char*)memchr(p, ';', user_end - p);
+    if (token_end == NULL)
+    {
+      token_end = user_end;
+    }
+
+    const char* token_start = p;
+    while ((token_start < token_end) && isspace((unsigned char)*token_start))
+    {
+      ++token_start;
+    }
+    const char* token_last = token_end;
+    while ((token_last > token_start) && isspace((unsigned char)token_last[-1]))
+    {
+      --token_last;
+    }
+
+    if (token_last > token_start)
+    {
+      *start = token_start;
+      *end = token_last;
+      return true;
+    }
+
+    p = token_end + 1;
+  }
+
+  return false;
+}
+
+URIClassifier::HostSet::HostSet() :
+  _mask(0),
+  _size(0),
+  _slots()
+{
+}
+
+uint32_t URIClassifier::HostSet::hash(const pj_str_t* host)
+{
+  // FNV-1a over the lower-cased host.
+  uint32_t h = 2166136261u;
+  for (pj_ssize_t ii = 0; ii < host->slen; ++ii)
+  {
+    h ^= (uint32_t)tolower((unsigned char)host->ptr[ii]);
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+void URIClassifier::HostSet::clear()
+{
+  _slots.clear();
+  _mask = 0;
+  _size = 0;
+}
+
+void URIClassifier::HostSet::insert(const pj_str_t* host)
 {
-    for (unsigned int i = 0; i < URIClassifier::home_domains.size(); ++i)
+  if (contains(host))
+  {
+    return;
+  }
+
+  // Keep the load factor at or below one half so that probe sequences stay
+  // short.
+  if ((_size + 1) * 2 > _slots.size())
+  {
+    std::vector<Slot> old_slots;
+    old_slots.swap(_slots);
+    _slots.resize(std::max<size_t>(16, old_slots.size() * 2));
+    _mask = _slots.size() - 1;
+    _size = 0;
+
+    for (Slot& slot : old_slots)
     {
-      if (pj_stricmp(&host, URIClassifier::home_domains[i]) == 0)
+      if (slot.used)
       {
-        return true;
+        insert_slot(slot);
       }
     }
+  }
 
-  // Doesn't match
-  return false;
+  Slot slot;
+  slot.used = true;
+  slot.hash = hash(host);
+  slot.host.assign(host->ptr, host->slen);
+  insert_slot(slot);
 }
 
-static bool is_local_name(pj_str_t host)
+void URIClassifier::HostSet::insert_slot(Slot& slot)
 {
-  for (std::vector<pj_str_t>::iterator it = stack_data.name.begin();
-       it != stack_data.name.end();
-       ++it)
+  size_t ii = slot.hash & _mask;
+  while (_slots[ii].used)
   {
-    if (pj_stricmp(&host, &(*it)) == 0)
+    ii = (ii + 1) & _mask;
+  }
+
+  _slots[ii].used = true;
+  _slots[ii].hash = slot.hash;
+  _slots[ii].host.swap(slot.host);
+  ++_size;
+}
+
+bool URIClassifier::HostSet::contains(const pj_str_t* host) const
+{
+  if (_size == 0)
+  {
+    return false;
+  }
+
+  uint32_t h = hash(host);
+  size_t ii = h & _mask;
+  while (_slots[ii].used)
+  {
+    const Slot& slot = _slots[ii];
+    if ((slot.hash == h) &&
+        (slot.host.length() == (size_t)host->slen) &&
+        (strncasecmp(slot.host.data(), host->ptr, host->slen) == 0))
     {
       return true;
     }
+    ii = (ii + 1) & _mask;
   }
 
-  // Doesn't match
   return false;
 }
 
+std::vector<pj_str_t*> URIClassifier::home_domains;
+bool URIClassifier::enforce_global;
+bool URIClassifier::enforce_user_phone;
+
+static URIClassifier::HostSet home_domain_set;
+static URIClassifier::HostSet local_name_set;
+
+void URIClassifier::update_host_sets()
+{
+  home_domain_set.clear();
+  for (pj_str_t* domain : home_domains)
+  {
+    home_domain_set.insert(domain);
+  }
+
+  local_name_set.clear();
+  for (const pj_str_t& name : stack_data.name)
+  {
+    local_name_set.insert(&name);
+  }
+}
+
+bool URIClassifier::is_user_numeric(pj_str_t user)
+{
+  return Utils::is_user_numeric(user.ptr, user.slen);
+}
+
+static bool is_home_domain(pj_str_t host)
+{
+  return home_domain_set.contains(&host);
+}
+
+static bool is_local_name(pj_str_t host)
+{
+  return local_name_set.contains(&host);
+}
+
 // Determine the type of a URI.
 //
 // Parameters:
@@ -110,9 +305,8 @@ URIClass URIClassifier::classify_uri(const pjsip_uri* uri, bool prefer_sip, bool
   {
     // TEL URIs can only represent phone numbers - decide if it's a global (E.164) number or not
     pjsip_tel_uri* tel_uri = (pjsip_tel_uri*)uri;
-    std::string user = PJUtils::pj_str_to_string(&tel_uri->number);
-    boost::match_results<std::string::const_iterator> results;
-    if (boost::regex_match(user, results, CHARS_ALLOWED_IN_GLOBAL_NUM))
+    const char* number = tel_uri->number.ptr;
+    if (is_global_number(number, number + tel_uri->number.slen))
     {
       ret = GLOBAL_PHONE_NUMBER;
     }
@@ -144,18 +338,16 @@ URIClass URIClassifier::classify_uri(const pjsip_uri* uri, bool prefer_sip, bool
          (home_domain && treat_number_as_phone && !is_gruu)))
     {
       // Get the user part minus any parameters.
-      std::string user = PJUtils::pj_str_to_string(&sip_uri->user);
-      if (!user.empty())
+      const char* user_start;
+      const char* user_end;
+      if (user_without_params(sip_uri->user, &user_start, &user_end))
       {
-        std::vector<std::string> user_tokens;
-        Utils::split_string(user, ';', user_tokens, 0, true);
-        boost::match_results<std::string::const_iterator> results;
-        if (boost::regex_match(user_tokens[0], results, CHARS_ALLOWED_IN_GLOBAL_NUM))
+        if (is_global_number(user_start, user_end))
         {
           ret = GLOBAL_PHONE_NUMBER;
           classified = true;
         }
-        else if (boost::regex_match(user_tokens[0], results, CHARS_ALLOWED_IN_LOCAL_NUM))
+        else if (is_local_number(user_start, user_end))
         {
           ret = enforce_global ? LOCAL_PHONE_NUMBER : GLOBAL_PHONE_NUMBER;
           classified = true;
@@ -169,7 +361,10 @@ URIClass URIClassifier::classify_uri(const pjsip_uri* uri, bool prefer_sip, bool
     }
   }
 
-  std::string uri_str = PJUtils::uri_to_string(PJSIP_URI_IN_OTHER, uri);
-  TRC_DEBUG("Classified URI %s as %d", uri_str.c_str(), (int)ret);
+  if (Log::enabled(Log::DEBUG_LEVEL))
+  {
+    std::string uri_str = PJUtils::uri_to_string(PJSIP_URI_IN_OTHER, uri);
+    TRC_DEBUG("Classified URI %s as %d", uri_str.c_str(), (int)ret);
+  }
   return ret;
 }
@@ -0,0 +1,178 @@
+/**
+ * @file adaptive_pool_test.cpp UT for the adaptive message pool handling.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "adaptive_pool.h"
+
+class AdaptivePoolTest : public ::testing::Test
+{
+  pj_caching_pool cp;
+  AdaptivePoolFactory* factory;
+
+  virtual void SetUp()
+  {
+    pj_init();
+    pj_caching_pool_init(&cp, NULL, 0);
+    factory = new AdaptivePoolFactory(&cp, 10);
+  }
+
+  virtual void TearDown()
+  {
+    delete factory; factory = NULL;
+    pj_caching_pool_destroy(&cp);
+    pj_shutdown();
+  }
+
+  pj_pool_t* create_tdata_pool()
+  {
+    return pj_pool_create(&cp.factory, "tdta%p", 4000, 4000, NULL);
+  }
+};
+
+// Check that pools are classified by name.
+TEST_F(AdaptivePoolTest, Classify)
+{
+  EXPECT_EQ(AdaptivePoolFactory::RDATA, AdaptivePoolFactory::classify("rtd%p"));
+  EXPECT_EQ(AdaptivePoolFactory::TDATA, AdaptivePoolFactory::classify("tdta0x1234"));
+  EXPECT_EQ(AdaptivePoolFactory::NOT_MESSAGE_POOL, AdaptivePoolFactory::classify("tsx%p"));
+  EXPECT_EQ(AdaptivePoolFactory::NOT_MESSAGE_POOL, AdaptivePoolFactory::classify(NULL));
+}
+
+// Check that a released message pool is reused, and renamed for its new
+// owner.
+TEST_F(AdaptivePoolTest, Reuse)
+{
+  pj_pool_t* pool = create_tdata_pool();
+  pj_pool_alloc(pool, 100);
+  pj_pool_release(pool);
+
+  pj_pool_t* reused = pj_pool_create(&cp.factory, "tdta-reused", 4000, 4000, NULL);
+  EXPECT_EQ(pool, reused);
+  EXPECT_STREQ("tdta-reused", pj_pool_getobjname(reused));
+
+  AdaptivePoolFactory::Stats stats = factory->stats(AdaptivePoolFactory::TDATA);
+  EXPECT_EQ(1u, stats.created);
+  EXPECT_EQ(1u, stats.reused);
+
+  pj_pool_release(reused);
+}
+
+// Check that other pools are passed straight through to the caching pool.
+TEST_F(AdaptivePoolTest, OtherPools)
+{
+  pj_pool_t* pool = pj_pool_create(&cp.factory, "tsx%p", 4000, 4000, NULL);
+  pj_pool_release(pool);
+  EXPECT_EQ(0u, cp.used_count);
+
+  AdaptivePoolFactory::Stats stats = factory->stats(AdaptivePoolFactory::TDATA);
+  EXPECT_EQ(0u, stats.created);
+  EXPECT_EQ(0u, stats.reused);
+}
+
+// Check that the free-list doesn't grow beyond its limit.
+TEST_F(AdaptivePoolTest, FreeListLimit)
+{
+  std::vector<pj_pool_t*> pools;
+
+  for (size_t ii = 0; ii < AdaptivePoolFactory::FREE_LIST_SIZE + 1; ++ii)
+  {
+    pools.push_back(create_tdata_pool());
+  }
+
+  for (pj_pool_t* pool : pools)
+  {
+    pj_pool_release(pool);
+  }
+
+  EXPECT_EQ((size_t)AdaptivePoolFactory::FREE_LIST_SIZE, cp.used_count);
+  EXPECT_EQ((size_t)AdaptivePoolFactory::FREE_LIST_SIZE,
+            factory->stats(AdaptivePoolFactory::TDATA).free);
+}
+
+// Check that a pool created on one thread and released on another is reused
+// by any thread, as happens to rdata pools cloned on the transport thread and
+// freed on a worker thread.
+TEST_F(AdaptivePoolTest, CrossThreadReuse)
+{
+  pj_pool_t* pool = NULL;
+
+  std::thread creator([&]()
+  {
+    pj_thread_desc desc;
+    pj_thread_t* thread;
+    pj_thread_register("creator", desc, &thread);
+    pool = pj_pool_create(&cp.factory, "rtd%p", 4000, 4000, NULL);
+  });
+  creator.join();
+  ASSERT_TRUE(pool != NULL);
+
+  std::thread releaser([&]()
+  {
+    pj_thread_desc desc;
+    pj_thread_t* thread;
+    pj_thread_register("releaser", desc, &thread);
+    pj_pool_release(pool);
+  });
+  releaser.join();
+
+  EXPECT_EQ(1u, factory->stats(AdaptivePoolFactory::RDATA).free);
+
+  pj_pool_t* reused = pj_pool_create(&cp.factory, "rtd%p", 4000, 4000, NULL);
+  EXPECT_EQ(pool, reused);
+
+  AdaptivePoolFactory::Stats stats = factory->stats(AdaptivePoolFactory::RDATA);
+  EXPECT_EQ(1u, stats.created);
+  EXPECT_EQ(1u, stats.reused);
+  EXPECT_EQ(0u, stats.free);
+
+  pj_pool_release(reused);
+}
+
+// Check that the initial size of new pools grows to fit large messages.
+TEST_F(AdaptivePoolTest, AdaptiveSize)
+{
+  for (int ii = 0; ii < 10; ++ii)
+  {
+    pj_pool_t* pool = create_tdata_pool();
+    pj_pool_alloc(pool, 6000);
+    pj_pool_release(pool);
+  }
+
+  AdaptivePoolFactory::Stats stats = factory->stats(AdaptivePoolFactory::TDATA);
+  EXPECT_GT(stats.initial_size, 6000u);
+  EXPECT_LE(stats.initial_size, (size_t)AdaptivePoolFactory::MAX_INITIAL_SIZE);
+
+  // The pool on the free-list was too small to keep, so a new pool is
+  // created with the new initial size.
+  pj_pool_t* pool = create_tdata_pool();
+  EXPECT_GE(pj_pool_get_capacity(pool), stats.initial_size);
+  EXPECT_EQ(2u, factory->stats(AdaptivePoolFactory::TDATA).created);
+
+  pj_pool_release(pool);
+}
+
+// Check that uninstalling the factory returns pools on the free-lists to
+// the caching pool.
+TEST_F(AdaptivePoolTest, Uninstall)
+{
+  pj_pool_release(create_tdata_pool());
+  EXPECT_EQ(1u, cp.used_count);
+
+  delete factory; factory = NULL;
+  EXPECT_EQ(0u, cp.used_count);
+
+  // Pools are now handled by the caching pool directly.
+  pj_pool_release(create_tdata_pool());
+  EXPECT_EQ(0u, cp.used_count);
+}
@@ -9,6 +9,8 @@
  * Metaswitch Networks in a separate written agreement.
  */
 
+#include <thread>
+#include <vector>
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 
@@ -84,17 +86,15 @@ static void advance_time()
 //
 // Testcases.
 //
-// Note that in these tests for the communication tracker to treat a failed AS
-// as having recovered, it needs to see two success calls in subsequent 5
-// minute periods. This is because the state of the ASs is only checked when
-// you actually calls the communication tracker.
+// The communication tracker checks the state of the ASs on a background
+// thread once every 5 minutes.  These tests drive the checks directly, after
+// the first call to the tracker in each 5 minute period.
 //
-// As such each on_success call checks the AS health in
-// the previous period. So the first call checks the period in which the AS
-// was failing (so does not treat the AS as being healthy) wheras only on the
-// second call do we see the AS being healthy.
-//
-// This looks worse in UT than in real life!
+// For the communication tracker to treat a failed AS as having recovered, it
+// needs to see a whole period without failures. So the first check after a
+// failing AS starts succeeding covers the period in which the AS was failing
+// (so does not treat the AS as being healthy) whereas only the second check
+// sees the AS being healthy.
 //
 
 // Test that is an AS is healthy, nothing happens.
@@ -103,12 +103,15 @@ TEST_F(AsCommunicationTrackerTest, SuccessIsIdempotent)
   EXPECT_CALL(*_mock_alarm, clear()).Times(AtLeast(1));
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 }
 
 
@@ -122,6 +125,7 @@ TEST_F(AsCommunicationTrackerTest, SingleAsFailure)
   EXPECT_CALL(*_mock_error_log, log(StrEq(AS1), StrEq("Some failure reason")));
   advance_time();
   _comm_tracker->on_failure(AS1, "Some failure reason");
+  _comm_tracker->check_for_healthy_app_servers();
 
   // The AS starts succeeding again.
   EXPECT_CALL(*_mock_alarm, clear()).Times(AtLeast(1));
@@ -129,9 +133,11 @@ TEST_F(AsCommunicationTrackerTest, SingleAsFailure)
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 }
 
 
@@ -147,14 +153,19 @@ TEST_F(AsCommunicationTrackerTest, OngoingAsFailure)
   // The AS is still failed.
   advance_time();
   _comm_tracker->on_failure(AS1, "Timeout");
+  _comm_tracker->check_for_healthy_app_servers();
   advance_time();
   _comm_tracker->on_failure(AS1, "Timeout");
+  _comm_tracker->check_for_healthy_app_servers();
   advance_time();
   _comm_tracker->on_failure(AS1, "Timeout");
+  _comm_tracker->check_for_healthy_app_servers();
   advance_time();
   _comm_tracker->on_failure(AS1, "Timeout");
+  _comm_tracker->check_for_healthy_app_servers();
   advance_time();
   _comm_tracker->on_failure(AS1, "Timeout");
+  _comm_tracker->check_for_healthy_app_servers();
 
   // The AS succeeds.
   EXPECT_CALL(*_mock_alarm, clear()).Times(AtLeast(1));
@@ -162,9 +173,11 @@ TEST_F(AsCommunicationTrackerTest, OngoingAsFailure)
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 }
 
 
@@ -184,9 +197,11 @@ TEST_F(AsCommunicationTrackerTest, FailSucceedFailSucceed)
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 
   // Clear out our mock object so we correctly check when the AS fails again.
   Mock::VerifyAndClearExpectations(_mock_alarm);
@@ -196,6 +211,7 @@ TEST_F(AsCommunicationTrackerTest, FailSucceedFailSucceed)
   EXPECT_CALL(*_mock_error_log, log(_, _));
   advance_time();
   _comm_tracker->on_failure(AS1, "Timeout");
+  _comm_tracker->check_for_healthy_app_servers();
 
   // The AS succeeds again.
   EXPECT_CALL(*_mock_alarm, clear()).Times(AtLeast(1));
@@ -203,9 +219,11 @@ TEST_F(AsCommunicationTrackerTest, FailSucceedFailSucceed)
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 
 }
 
@@ -226,24 +244,29 @@ TEST_F(AsCommunicationTrackerTest, MultipleAsFailures)
 
   advance_time();
   _comm_tracker->on_failure(AS1, "Timeout");
+  _comm_tracker->check_for_healthy_app_servers();
   _comm_tracker->on_success(AS2);
 
   advance_time();
   _comm_tracker->on_failure(AS1, "Timeout");
+  _comm_tracker->check_for_healthy_app_servers();
   _comm_tracker->on_success(AS2);
 
   // AS2 starts to fail. AS1 still failed.
   EXPECT_CALL(*_mock_error_log, log(StrEq(AS2), StrEq("Transport Error")));
   advance_time();
   _comm_tracker->on_failure(AS1, "Timeout");
+  _comm_tracker->check_for_healthy_app_servers();
   _comm_tracker->on_failure(AS2, "Transport Error");
 
   advance_time();
   _comm_tracker->on_failure(AS1, "Timeout");
+  _comm_tracker->check_for_healthy_app_servers();
   _comm_tracker->on_failure(AS2, "Transport Error");
 
   advance_time();
   _comm_tracker->on_failure(AS1, "Timeout");
+  _comm_tracker->check_for_healthy_app_servers();
   _comm_tracker->on_failure(AS2, "Transport Error");
 
   // AS1 recovers. AS2 still failed.
@@ -251,10 +274,12 @@ TEST_F(AsCommunicationTrackerTest, MultipleAsFailures)
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
   _comm_tracker->on_failure(AS2, "Transport Error");
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
   _comm_tracker->on_failure(AS2, "Transport Error");
 
   // Both ASs now Ok.
@@ -263,10 +288,12 @@ TEST_F(AsCommunicationTrackerTest, MultipleAsFailures)
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
   _comm_tracker->on_success(AS2);
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
   _comm_tracker->on_success(AS2);
 }
 
@@ -282,9 +309,11 @@ TEST_F(AsCommunicationTrackerTest, MultipleFailureReasons)
   EXPECT_CALL(*_mock_error_log, log(StrEq(AS1), StrEq("Some failure reason")));
   advance_time();
   _comm_tracker->on_failure(AS1, "Some failure reason");
+  _comm_tracker->check_for_healthy_app_servers();
 
   advance_time();
   _comm_tracker->on_failure(AS1, "Another failure reason");
+  _comm_tracker->check_for_healthy_app_servers();
 
   // The AS starts succeeding again.
   EXPECT_CALL(*_mock_alarm, clear()).Times(AtLeast(1));
@@ -292,9 +321,11 @@ TEST_F(AsCommunicationTrackerTest, MultipleFailureReasons)
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 
   advance_time();
   _comm_tracker->on_success(AS1);
+  _comm_tracker->check_for_healthy_app_servers();
 
   // The AS starts failing again but for a different reason.
   EXPECT_CALL(*_mock_alarm, set());
@@ -302,4 +333,41 @@ TEST_F(AsCommunicationTrackerTest, MultipleFailureReasons)
 
   advance_time();
   _comm_tracker->on_failure(AS1, "Another failure reason");
+  _comm_tracker->check_for_healthy_app_servers();
+}
+
+
+// Test that concurrent failures of the same AS only raise the alarm and
+// generate the failure log once.
+TEST_F(AsCommunicationTrackerTest, ConcurrentFailures)
+{
+  EXPECT_CALL(*_mock_alarm, set()).Times(1);
+  EXPECT_CALL(*_mock_error_log, log(StrEq(AS1), StrEq("Timeout"))).Times(1);
+
+  std::vector<std::thread> threads;
+  for (int ii = 0; ii < 10; ++ii)
+  {
+    threads.push_back(std::thread([this]()
+    {
+      for (int jj = 0; jj < 100; ++jj)
+      {
+        _comm_tracker->on_failure(AS1, "Timeout");
+      }
+    }));
+  }
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  // The AS recovers once the failures stop.
+  EXPECT_CALL(*_mock_alarm, clear()).Times(AtLeast(1));
+  EXPECT_CALL(*_mock_ok_log, log(StrEq(AS1)));
+
+  advance_time();
+  _comm_tracker->check_for_healthy_app_servers();
+
+  advance_time();
+  _comm_tracker->check_for_healthy_app_servers();
 }
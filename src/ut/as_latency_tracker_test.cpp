@@ -0,0 +1,168 @@
+/**
+ * @file as_latency_tracker_test.cpp UT for the AS latency tracker.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include "gtest/gtest.h"
+
+#include "as_latency_tracker.h"
+#include "test_interposer.hpp"
+
+class AsLatencyTrackerTest : public ::testing::Test
+{
+  void TearDown()
+  {
+    cwtest_reset_time();
+  }
+
+  const std::string AS1 = "sip:as1.homedomain";
+  const std::string AS2 = "sip:as2.homedomain";
+
+  const int CONFIGURED_TIMEOUT = 2000;
+  const int OPEN_MS = 30000;
+
+  // Records enough responses from an AS for its timeout to be recalculated.
+  void respond(AsLatencyTracker& tracker,
+               const std::string& as_uri,
+               uint64_t latency_ms)
+  {
+    for (int ii = 0; ii < AsLatencyTracker::RECALC_INTERVAL; ++ii)
+    {
+      tracker.on_success(as_uri, latency_ms);
+    }
+  }
+};
+
+// Check that the timeout is based on the AS's recent response times, once
+// enough responses have been seen.
+TEST_F(AsLatencyTrackerTest, AdaptiveTimeout)
+{
+  AsLatencyTracker tracker(3, 0);
+
+  for (int ii = 0; ii < AsLatencyTracker::RECALC_INTERVAL - 1; ++ii)
+  {
+    tracker.on_success(AS1, 50);
+  }
+  EXPECT_EQ(CONFIGURED_TIMEOUT, tracker.timeout_ms(AS1, CONFIGURED_TIMEOUT));
+
+  // 50ms falls in the 48-51ms bucket, so the timeout is 3 * 52ms.
+  tracker.on_success(AS1, 50);
+  EXPECT_EQ(156, tracker.timeout_ms(AS1, CONFIGURED_TIMEOUT));
+
+  // Other ASs are unaffected.
+  EXPECT_EQ(CONFIGURED_TIMEOUT, tracker.timeout_ms(AS2, CONFIGURED_TIMEOUT));
+}
+
+// Check that the timeout is driven by the slowest responses.
+TEST_F(AsLatencyTrackerTest, AdaptiveTimeoutPercentile)
+{
+  AsLatencyTracker tracker(2, 0);
+
+  for (int ii = 0; ii < 90; ++ii)
+  {
+    tracker.on_success(AS1, 10);
+  }
+  for (int ii = 0; ii < 10; ++ii)
+  {
+    tracker.on_success(AS1, 200);
+  }
+
+  // 200ms falls in the 192-207ms bucket, so the timeout is 2 * 208ms.
+  EXPECT_EQ(416, tracker.timeout_ms(AS1, CONFIGURED_TIMEOUT));
+}
+
+// Check that adaptive timeouts are clamped.
+TEST_F(AsLatencyTrackerTest, AdaptiveTimeoutBounds)
+{
+  AsLatencyTracker tracker(3, 0);
+
+  respond(tracker, AS1, 1);
+  EXPECT_EQ((int)AsLatencyTracker::MIN_ADAPTIVE_TIMEOUT_MS,
+            tracker.timeout_ms(AS1, CONFIGURED_TIMEOUT));
+
+  respond(tracker, AS2, 1000);
+  EXPECT_EQ(CONFIGURED_TIMEOUT, tracker.timeout_ms(AS2, CONFIGURED_TIMEOUT));
+}
+
+// Check that the configured timeout is used if adaptive timeouts are
+// disabled.
+TEST_F(AsLatencyTrackerTest, AdaptiveTimeoutDisabled)
+{
+  AsLatencyTracker tracker(0, 0);
+
+  respond(tracker, AS1, 50);
+  EXPECT_EQ(CONFIGURED_TIMEOUT, tracker.timeout_ms(AS1, CONFIGURED_TIMEOUT));
+}
+
+// Check that the circuit breaker opens after enough consecutive failures,
+// lets a trial request through once it has been open for long enough, and
+// closes if that succeeds.
+TEST_F(AsLatencyTrackerTest, CircuitBreaker)
+{
+  AsLatencyTracker tracker(0, 3, OPEN_MS);
+
+  tracker.on_failure(AS1);
+  tracker.on_failure(AS1);
+  EXPECT_TRUE(tracker.allow_request(AS1));
+
+  // A success resets the count.
+  tracker.on_success(AS1, 10);
+  tracker.on_failure(AS1);
+  tracker.on_failure(AS1);
+  EXPECT_TRUE(tracker.allow_request(AS1));
+
+  tracker.on_failure(AS1);
+  EXPECT_FALSE(tracker.allow_request(AS1));
+  EXPECT_TRUE(tracker.allow_request(AS2));
+
+  // Once the breaker has been open for long enough, a single trial request
+  // is allowed.
+  cwtest_advance_time_ms(OPEN_MS);
+  EXPECT_TRUE(tracker.allow_request(AS1));
+  EXPECT_FALSE(tracker.allow_request(AS1));
+
+  // The trial fails, so the breaker opens again.
+  tracker.on_failure(AS1);
+  cwtest_advance_time_ms(OPEN_MS - 1);
+  EXPECT_FALSE(tracker.allow_request(AS1));
+
+  // The next trial succeeds, so the breaker closes.
+  cwtest_advance_time_ms(1);
+  EXPECT_TRUE(tracker.allow_request(AS1));
+  tracker.on_success(AS1, 10);
+  EXPECT_TRUE(tracker.allow_request(AS1));
+  EXPECT_TRUE(tracker.allow_request(AS1));
+}
+
+// Check that another trial request is allowed if the first never completes.
+TEST_F(AsLatencyTrackerTest, CircuitBreakerTrialLost)
+{
+  AsLatencyTracker tracker(0, 1, OPEN_MS);
+
+  tracker.on_failure(AS1);
+  cwtest_advance_time_ms(OPEN_MS);
+  EXPECT_TRUE(tracker.allow_request(AS1));
+  EXPECT_FALSE(tracker.allow_request(AS1));
+
+  cwtest_advance_time_ms(OPEN_MS);
+  EXPECT_TRUE(tracker.allow_request(AS1));
+}
+
+// Check that failures never block requests if circuit breaking is disabled.
+TEST_F(AsLatencyTrackerTest, CircuitBreakerDisabled)
+{
+  AsLatencyTracker tracker(3, 0);
+
+  for (int ii = 0; ii < 10; ++ii)
+  {
+    tracker.on_failure(AS1);
+  }
+
+  EXPECT_TRUE(tracker.allow_request(AS1));
+}
@@ -162,6 +162,41 @@ TEST_F(AsChainTest, Basics)
   EXPECT_TRUE(res.complete());
 }
 
+// All the ODI tokens for a chain are stored in the same shard, and malformed
+// tokens are rejected without a lookup.
+TEST_F(AsChainTest, OdiTokenSharding)
+{
+  IFCConfiguration ifc_configuration(false, false, "", &SNMP::FAKE_COUNTER_TABLE, &SNMP::FAKE_COUNTER_TABLE);
+  Ifcs ifcs = matching_ifcs(2, "sip:as1", "sip:as2");
+  AsChain as_chain(_as_chain_table, SessionCase::Originating, "sip:5755550011@homedomain", true, 0, ifcs, NULL, NULL, ifc_configuration, "sip:scscf.homedomain");
+  AsChainLink as_chain_link(&as_chain, 0u);
+
+  ASSERT_EQ(3u, as_chain._odi_tokens.size());
+  for (const std::string& token : as_chain._odi_tokens)
+  {
+    EXPECT_EQ(10u, token.length());
+    EXPECT_EQ(as_chain._odi_tokens[0][0], token[0]);
+  }
+
+  // Each token finds the right link.
+  for (size_t ii = 1; ii < as_chain._odi_tokens.size(); ++ii)
+  {
+    AsChainLink res = _as_chain_table->lookup(as_chain._odi_tokens[ii]);
+    EXPECT_EQ(&as_chain, res._as_chain);
+    EXPECT_EQ(ii, res._index);
+    res.release();
+  }
+
+  // Tokens of the wrong length or with an invalid shard character aren't
+  // found.
+  std::string token = as_chain._odi_tokens[1];
+  EXPECT_FALSE(_as_chain_table->lookup(token.substr(1)).is_set());
+  EXPECT_FALSE(_as_chain_table->lookup(token + "x").is_set());
+  token[0] = '!';
+  EXPECT_FALSE(_as_chain_table->lookup(token).is_set());
+  EXPECT_FALSE(_as_chain_table->lookup("").is_set());
+}
+
 // We have matching standard iFCs - we should select the ASs from
 // those iFCs and no more.
 TEST_F(AsChainTest, MatchingStandardiFCs)
@@ -11,12 +11,16 @@
 
 #include <string>
 #include <vector>
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 #include "utils.h"
 #include "sas.h"
 #include "bgcfservice.h"
+#include "config_image.h"
 #include "fakelogger.h"
 #include "test_utils.hpp"
 
@@ -161,3 +165,88 @@ TEST_F(BgcfServiceTest, NumberRouteTests)
   ET("+654-(3.21)", "sip3.example.com").test(bgcf_, RoutingType::NUMBER_ROUTE);
   ET("+654!-(321)", "").test(bgcf_, RoutingType::NUMBER_ROUTE);
 }
+
+/// Fixture for tests that compile the configuration into an image.  The
+/// source file is copied to a temporary directory, so that the image is
+/// written there.
+class BgcfServiceImageTest : public BgcfServiceTest
+{
+  void SetUp()
+  {
+    char dir[] = "/tmp/bgcfservice_test.XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    _dir = dir;
+    _config = _dir + "/bgcf.json";
+    _image = ConfigImage::image_path(_config);
+    copy_config("/test_bgcf.json");
+  }
+
+  void TearDown()
+  {
+    unlink(_config.c_str());
+    unlink(_image.c_str());
+    rmdir(_dir.c_str());
+  }
+
+  void copy_config(const std::string& ut_file)
+  {
+    std::ifstream src(string(UT_DIR).append(ut_file).c_str());
+    std::ofstream dst(_config.c_str(), std::ios::trunc);
+    dst << src.rdbuf();
+  }
+
+  std::string _dir;
+  std::string _config;
+  std::string _image;
+};
+
+TEST_F(BgcfServiceImageTest, LoadFromImage)
+{
+  ASSERT_TRUE(BgcfService::compile_image(_config, _image));
+
+  // Remove the source file, so the routes can only come from the image.
+  unlink(_config.c_str());
+  CapturingTestLogger log;
+  BgcfService bgcf_(_config);
+  EXPECT_TRUE(log.contains("Loading BGCF configuration from image"));
+
+  ET("198.147.226.2",              "ec2-54-243-253-10.compute-1.amazonaws.com").test(bgcf_, RoutingType::DOMAIN_ROUTE);
+  ET("billy2",                     ""                  ).test(bgcf_, RoutingType::DOMAIN_ROUTE);
+  ET("multiple-nodes.example.com", "sip2.example.com,sip3.example.com").test(bgcf_, RoutingType::DOMAIN_ROUTE);
+  ET("+123-123", "sip.example.com").test(bgcf_, RoutingType::NUMBER_ROUTE);
+  ET("+123", "sip2.example.com").test(bgcf_, RoutingType::NUMBER_ROUTE);
+  ET("+654-(3.21)", "sip3.example.com").test(bgcf_, RoutingType::NUMBER_ROUTE);
+}
+
+TEST_F(BgcfServiceImageTest, StaleImage)
+{
+  ASSERT_TRUE(BgcfService::compile_image(_config, _image));
+
+  // Change the source file after compiling it.  The image is ignored.
+  copy_config("/test_bgcf_default_route.json");
+  CapturingTestLogger log;
+  BgcfService bgcf_(_config);
+  EXPECT_TRUE(log.contains("is out of date"));
+
+  ET("billy2", "sip.example.com").test(bgcf_, RoutingType::DOMAIN_ROUTE);
+}
+
+TEST_F(BgcfServiceImageTest, InvalidImage)
+{
+  std::ofstream image(_image.c_str());
+  image << "This is not a configuration image";
+  image.close();
+
+  CapturingTestLogger log;
+  BgcfService bgcf_(_config);
+  EXPECT_TRUE(log.contains("is invalid"));
+
+  ET("foreign-domain.example.com", "sip.example.com").test(bgcf_, RoutingType::DOMAIN_ROUTE);
+}
+
+TEST_F(BgcfServiceImageTest, CompileInvalidConfig)
+{
+  copy_config("/test_bgcf_parse_error.json");
+  EXPECT_FALSE(BgcfService::compile_image(_config, _image));
+  EXPECT_NE(0, access(_image.c_str(), F_OK));
+}
@@ -10,6 +10,11 @@
  */
 
 #include <string>
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -17,6 +22,7 @@
 #include "utils.h"
 #include "sas.h"
 #include "enumservice.h"
+#include "config_image.h"
 #include "fakednsresolver.hpp"
 #include "fakelogger.h"
 #include "test_utils.hpp"
@@ -82,6 +88,40 @@ private:
 };
 
 
+/// Fixture for tests that compile the configuration into an image.  The
+/// source file is copied to a temporary directory, so that the image is
+/// written there.
+class JSONEnumServiceImageTest : public JSONEnumServiceTest
+{
+  void SetUp()
+  {
+    char dir[] = "/tmp/enumservice_test.XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    _dir = dir;
+    _config = _dir + "/enum.json";
+    _image = ConfigImage::image_path(_config);
+  }
+
+  void TearDown()
+  {
+    unlink(_config.c_str());
+    unlink(_image.c_str());
+    rmdir(_dir.c_str());
+  }
+
+  void copy_config(const std::string& ut_file)
+  {
+    std::ifstream src(string(UT_DIR).append(ut_file).c_str());
+    std::ofstream dst(_config.c_str(), std::ios::trunc);
+    dst << src.rdbuf();
+  }
+
+  std::string _dir;
+  std::string _config;
+  std::string _image;
+};
+
+
 TEST_F(DummyEnumServiceTest, SimpleTests)
 {
   DummyEnumService enum_("ut.cw-ngv.com");
@@ -102,6 +142,79 @@ TEST_F(JSONEnumServiceTest, SimpleTests)
   ET("+16108580277", "sip:+16108580277@198.147.226.2"   ).test(enum_);
 }
 
+TEST_F(JSONEnumServiceImageTest, LoadFromImage)
+{
+  copy_config("/test_enum.json");
+  ASSERT_TRUE(JSONEnumService::compile_image(_config, _image));
+
+  // Remove the source file, so the configuration can only come from the
+  // image.
+  unlink(_config.c_str());
+  CapturingTestLogger log;
+  JSONEnumService enum_(_config);
+  EXPECT_TRUE(log.contains("Loading ENUM configuration from image"));
+
+  ET("+15108580271", "sip:+15108580271@ut.cw-ngv.com"   ).test(enum_);
+  ET("+15108580277", "sip:+15108580277@utext.cw-ngv.com").test(enum_);
+  ET("214+4324",     "sip:2144324@198.147.226.2"        ).test(enum_);
+  ET("6505551234",   "sip:6505551234@ut-int.cw-ngv.com" ).test(enum_);
+  ET("+16108580277", "sip:+16108580277@198.147.226.2"   ).test(enum_);
+}
+
+TEST_F(JSONEnumServiceImageTest, BadRegexNotCompiled)
+{
+  // Entries with bad regular expressions are rejected by the compiler, so
+  // aren't in the image.
+  copy_config("/test_enum_bad_regex.json");
+  ASSERT_TRUE(JSONEnumService::compile_image(_config, _image));
+  unlink(_config.c_str());
+  JSONEnumService enum_(_config);
+
+  ET("+15108580271", "sip:+15108580271@ut.cw-ngv.com").test(enum_);
+  ET("+15108580273", "").test(enum_);
+  ET("+15108580275", "").test(enum_);
+}
+
+TEST_F(JSONEnumServiceImageTest, StaleImage)
+{
+  copy_config("/test_enum.json");
+  ASSERT_TRUE(JSONEnumService::compile_image(_config, _image));
+
+  // Change the source file after compiling it.  The image is ignored.
+  copy_config("/test_enum_regex.json");
+  CapturingTestLogger log;
+  JSONEnumService enum_(_config);
+  EXPECT_TRUE(log.contains("is out of date"));
+
+  ET("01115108580271", "sip:5108580271@ut.cw-ngv.com").test(enum_);
+}
+
+TEST_F(JSONEnumServiceImageTest, StaleImageSameSecond)
+{
+  // Set the source file's modification time to a fixed point, and compile it.
+  copy_config("/test_enum.json");
+  struct timespec times[2];
+  times[0].tv_sec = times[1].tv_sec = 1500000000;
+  times[0].tv_nsec = times[1].tv_nsec = 100;
+  ASSERT_EQ(0, utimensat(AT_FDCWD, _config.c_str(), times, 0));
+  ASSERT_TRUE(JSONEnumService::compile_image(_config, _image));
+
+  // Touch the source file within the same second, without changing its size.
+  // The image is still spotted as out of date.
+  times[0].tv_nsec = times[1].tv_nsec = 200;
+  ASSERT_EQ(0, utimensat(AT_FDCWD, _config.c_str(), times, 0));
+  CapturingTestLogger log;
+  JSONEnumService enum_(_config);
+  EXPECT_TRUE(log.contains("is out of date"));
+}
+
+TEST_F(JSONEnumServiceImageTest, CompileInvalidConfig)
+{
+  copy_config("/test_enum_missing_block.json");
+  EXPECT_FALSE(JSONEnumService::compile_image(_config, _image));
+  EXPECT_NE(0, access(_image.c_str(), F_OK));
+}
+
 TEST_F(JSONEnumServiceTest, NoMatch)
 {
   JSONEnumService enum_(string(UT_DIR).append("/test_enum_no_match.json"));
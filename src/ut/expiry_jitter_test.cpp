@@ -0,0 +1,146 @@
+/**
+ * @file expiry_jitter_test.cpp UT for the expiry desynchronisation policy.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include "gtest/gtest.h"
+
+#include "expiry_jitter.h"
+
+class ExpiryJitterTest : public ::testing::Test
+{
+};
+
+// Check that zero and short expiries are never changed, and that a policy
+// with no jitter grants what was asked for.
+TEST_F(ExpiryJitterTest, Unchanged)
+{
+  ExpiryJitter jitter(300, 20);
+  EXPECT_EQ(0, jitter.grant(0, 1000));
+  EXPECT_EQ(ExpiryJitter::MIN_JITTER_EXPIRY - 1,
+            jitter.grant(ExpiryJitter::MIN_JITTER_EXPIRY - 1, 1000));
+
+  ExpiryJitter no_jitter(300, 0);
+  EXPECT_EQ(300, no_jitter.grant(300, 1000));
+}
+
+// Check that granted expiries are never longer than requested, or shorter
+// than the configured percentage allows.
+TEST_F(ExpiryJitterTest, Bounds)
+{
+  ExpiryJitter jitter(600, 20);
+  bool shortened = false;
+
+  for (int ii = 0; ii < 1000; ++ii)
+  {
+    int expiry = jitter.grant(600, 1000);
+    ASSERT_LE(expiry, 600);
+    ASSERT_GE(expiry, 480);
+    shortened = shortened || (expiry < 600);
+  }
+
+  EXPECT_TRUE(shortened);
+}
+
+// Check that a burst of registrations at the same time is spread across the
+// jitter range, rather than all falling due together.
+TEST_F(ExpiryJitterTest, SpreadsBurst)
+{
+  ExpiryJitter jitter(600, 50);
+  int now = 1000;
+
+  for (int ii = 0; ii < 3000; ++ii)
+  {
+    jitter.grant(600, now);
+  }
+
+  std::vector<uint32_t> density;
+  jitter.get_density(now, density);
+  ASSERT_EQ((size_t)ExpiryJitter::NUM_BUCKETS, density.size());
+
+  // The expiries fall in the second half of the interval, which covers
+  // around 30 buckets, so an even spread is around 100 per bucket.
+  uint32_t total = 0;
+  uint32_t busiest = 0;
+  for (uint32_t count : density)
+  {
+    total += count;
+    busiest = std::max(busiest, count);
+  }
+
+  EXPECT_EQ(3000u, total);
+  EXPECT_LT(busiest, 200u);
+}
+
+// Check that a refresh replaces the expiry it refreshes in the histogram.
+TEST_F(ExpiryJitterTest, RefreshReplacesOldExpiry)
+{
+  ExpiryJitter jitter(600, 10);
+  int now = 1000;
+
+  int expiry = jitter.grant(600, now);
+  int refreshed = jitter.grant(600, now + 300, now + expiry);
+
+  std::vector<uint32_t> density;
+  jitter.get_density(now + 300, density);
+
+  uint32_t total = 0;
+  for (uint32_t count : density)
+  {
+    total += count;
+  }
+
+  EXPECT_EQ(1u, total);
+  EXPECT_EQ(1u, density[refreshed / jitter.bucket_width()] +
+                density[(refreshed / jitter.bucket_width()) + 1]);
+}
+
+// Check that counts for times that have passed are not reported.
+TEST_F(ExpiryJitterTest, DensityAgesOut)
+{
+  ExpiryJitter jitter(600, 10);
+  int now = 1000;
+
+  jitter.grant(600, now);
+
+  std::vector<uint32_t> density;
+  jitter.get_density(now + 1200, density);
+
+  for (uint32_t count : density)
+  {
+    EXPECT_EQ(0u, count);
+  }
+}
+
+// Check that choosing an expiry doesn't record it until record() is called.
+TEST_F(ExpiryJitterTest, ChooseThenRecord)
+{
+  ExpiryJitter jitter(600, 50);
+  int now = 1000;
+  std::vector<uint32_t> density;
+
+  int expiry = jitter.choose(600, now);
+  EXPECT_LE(300, expiry);
+  EXPECT_GE(600, expiry);
+
+  jitter.get_density(now, density);
+  EXPECT_EQ(0u, std::accumulate(density.begin(), density.end(), 0u));
+
+  jitter.record(600, expiry, now);
+  jitter.get_density(now, density);
+  EXPECT_EQ(1u, std::accumulate(density.begin(), density.end(), 0u));
+
+  // Expiries that weren't randomised aren't recorded.
+  jitter.record(0, 0, now);
+  jitter.get_density(now, density);
+  EXPECT_EQ(1u, std::accumulate(density.begin(), density.end(), 0u));
+}
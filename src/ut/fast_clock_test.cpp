@@ -0,0 +1,73 @@
+/**
+ * @file fast_clock_test.cpp UT for the fast clock and stopwatch.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include "gtest/gtest.h"
+
+#include "fast_clock.h"
+#include "test_interposer.hpp"
+
+// The fast clock isn't started in UT, so these tests check the system clock
+// fallback, which lets the UT control time.
+class FastClockTest : public ::testing::Test
+{
+  void SetUp()
+  {
+    cwtest_completely_control_time();
+  }
+
+  void TearDown()
+  {
+    cwtest_reset_time();
+  }
+};
+
+// Check that the clock follows the system clock when not started.
+TEST_F(FastClockTest, SystemClockFallback)
+{
+  EXPECT_FALSE(FastClock::using_tsc());
+
+  uint64_t start_ms = FastClock::now_ms();
+  time_t start_s = FastClock::coarse_time();
+  cwtest_advance_time_ms(5000);
+
+  EXPECT_EQ(start_ms + 5000, FastClock::now_ms());
+  EXPECT_EQ(start_s + 5, FastClock::coarse_time());
+}
+
+// Check that the stopwatch measures elapsed time, excluding any time it is
+// stopped for.
+TEST_F(FastClockTest, StopWatch)
+{
+  FastStopWatch stopwatch;
+  unsigned long elapsed_us = 0;
+
+  stopwatch.start();
+  cwtest_advance_time_ms(10);
+  EXPECT_TRUE(stopwatch.read(elapsed_us));
+  EXPECT_EQ(10000u, elapsed_us);
+
+  // Time while stopped isn't counted.
+  stopwatch.stop();
+  cwtest_advance_time_ms(100);
+  EXPECT_TRUE(stopwatch.read(elapsed_us));
+  EXPECT_EQ(10000u, elapsed_us);
+
+  stopwatch.resume();
+  cwtest_advance_time_ms(5);
+  EXPECT_TRUE(stopwatch.read(elapsed_us));
+  EXPECT_EQ(15000u, elapsed_us);
+
+  // Starting again resets the time.
+  stopwatch.start();
+  cwtest_advance_time_ms(1);
+  EXPECT_TRUE(stopwatch.read(elapsed_us));
+  EXPECT_EQ(1000u, elapsed_us);
+}
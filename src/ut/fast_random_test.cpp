@@ -0,0 +1,118 @@
+/**
+ * @file fast_random_test.cpp UT for the per-thread random number generator.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <string>
+#include <set>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include "gtest/gtest.h"
+
+#include "fast_random.h"
+
+class FastRandomTest : public ::testing::Test
+{
+};
+
+// Check that uniform never returns a value outside the range, and that every
+// value in a small range is hit.
+TEST_F(FastRandomTest, UniformRange)
+{
+  int counts[7] = {0};
+  for (int ii = 0; ii < 7000; ++ii)
+  {
+    uint32_t value = FastRandom::uniform(7);
+    ASSERT_LT(value, 7u);
+    counts[value]++;
+  }
+
+  for (int ii = 0; ii < 7; ++ii)
+  {
+    EXPECT_GT(counts[ii], 0);
+  }
+
+  EXPECT_EQ(0u, FastRandom::uniform(1));
+}
+
+TEST_F(FastRandomTest, Base64Alphabet)
+{
+  std::string token;
+  FastRandom::create_token(1000, token);
+  EXPECT_EQ(1000u, token.length());
+  EXPECT_EQ(std::string::npos,
+            token.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                    "abcdefghijklmnopqrstuvwxyz"
+                                    "0123456789+/"));
+
+  char buf[1001];
+  memset(buf, 0, sizeof(buf));
+  FastRandom::fill_base64url(buf, 1000);
+  EXPECT_EQ(1000u, strlen(buf));
+  EXPECT_EQ(std::string::npos,
+            std::string(buf).find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                               "abcdefghijklmnopqrstuvwxyz"
+                                               "0123456789-_"));
+
+  memset(buf, 0, sizeof(buf));
+  FastRandom::fill_hex(buf, 1000);
+  EXPECT_EQ(1000u, strlen(buf));
+  EXPECT_EQ(std::string::npos,
+            std::string(buf).find_first_not_of("0123456789abcdef"));
+}
+
+// The buffer encoders must not write past the requested length.
+TEST_F(FastRandomTest, NoOverrun)
+{
+  char buf[32];
+  for (size_t len = 0; len < 20; ++len)
+  {
+    memset(buf, '!', sizeof(buf));
+    FastRandom::fill_base64(buf, len);
+    EXPECT_EQ('!', buf[len]);
+    FastRandom::fill_hex(buf, len);
+    EXPECT_EQ('!', buf[len]);
+  }
+}
+
+// Tokens generated on different threads must not collide - each thread seeds
+// its own generator.
+TEST_F(FastRandomTest, TokensUniqueAcrossThreads)
+{
+  const int NUM_THREADS = 4;
+  const int NUM_TOKENS = 1000;
+  std::vector<std::string> tokens[NUM_THREADS];
+  std::vector<std::thread> threads;
+
+  for (int ii = 0; ii < NUM_THREADS; ++ii)
+  {
+    threads.push_back(std::thread([&tokens, ii]()
+    {
+      for (int jj = 0; jj < NUM_TOKENS; ++jj)
+      {
+        std::string token;
+        FastRandom::create_token(16, token);
+        tokens[ii].push_back(token);
+      }
+    }));
+  }
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  std::set<std::string> unique_tokens;
+  for (int ii = 0; ii < NUM_THREADS; ++ii)
+  {
+    unique_tokens.insert(tokens[ii].begin(), tokens[ii].end());
+  }
+  EXPECT_EQ((size_t)(NUM_THREADS * NUM_TOKENS), unique_tokens.size());
+}
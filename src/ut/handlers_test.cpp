@@ -27,6 +27,14 @@
 #include "rapidjson/document.h"
 #include "handlers_test.h"
 #include "aor_test_utils.h"
+#include "io_profiler.h"
+#include "instrumented_mutex.h"
+#include "slow_transactions.h"
+#include "expiry_jitter.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
 using namespace std;
 using ::testing::_;
@@ -34,6 +42,7 @@ using ::testing::Return;
 using ::testing::InSequence;
 using ::testing::SetArgReferee;
 using ::testing::SaveArg;
+using ::testing::InvokeWithoutArgs;
 
 const std::string HSS_REG_STATE = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
                                   "<ClearwaterRegData>"
@@ -579,6 +588,559 @@ TEST_F(GetBindingsTest, BadMethod)
   task->run();
 }
 
+// Test getting the bindings for an IMPU a page at a time.
+TEST_F(GetBindingsTest, Paginated)
+{
+  std::string aor_id = "sip:6505550231@homedomain";
+
+  // Request the first page of two bindings.
+  MockHttpStack::Request req(stack,
+                             "/impu/sip%3A6505550231%40homedomain/bindings",
+                             "",
+                             "?limit=2");
+  GetBindingsTask::Config config(sm);
+  GetBindingsTask* task = new GetBindingsTask(req, &config, 0);
+
+  Bindings bindings;
+  bindings["123"] = AoRTestUtils::build_binding(aor_id, time(NULL), "123");
+  bindings["456"] = AoRTestUtils::build_binding(aor_id, time(NULL), "456");
+  bindings["789"] = AoRTestUtils::build_binding(aor_id, time(NULL), "789");
+
+  EXPECT_CALL(*sm, get_bindings(aor_id, _, _))
+    .WillOnce(DoAll(SetArgReferee<1>(bindings),
+                    Return(HTTP_OK)));
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+
+  task->run();
+
+  // The first page has the first two bindings, and says where the next page
+  // starts.
+  rapidjson::Document document;
+  document.Parse(req.content().c_str());
+  EXPECT_EQ(2, document["bindings"].MemberCount());
+  EXPECT_TRUE(document["bindings"].HasMember("123"));
+  EXPECT_TRUE(document["bindings"].HasMember("456"));
+  ASSERT_TRUE(document.HasMember("next"));
+  EXPECT_EQ(std::string("456"), document["next"].GetString());
+
+  // Request the next page.
+  MockHttpStack::Request req2(stack,
+                              "/impu/sip%3A6505550231%40homedomain/bindings",
+                              "",
+                              "?limit=2&after=456");
+  task = new GetBindingsTask(req2, &config, 0);
+
+  Bindings bindings2;
+  bindings2["123"] = AoRTestUtils::build_binding(aor_id, time(NULL), "123");
+  bindings2["456"] = AoRTestUtils::build_binding(aor_id, time(NULL), "456");
+  bindings2["789"] = AoRTestUtils::build_binding(aor_id, time(NULL), "789");
+
+  EXPECT_CALL(*sm, get_bindings(aor_id, _, _))
+    .WillOnce(DoAll(SetArgReferee<1>(bindings2),
+                    Return(HTTP_OK)));
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+
+  task->run();
+
+  // The last page has the remaining binding, and no next field.
+  rapidjson::Document document2;
+  document2.Parse(req2.content().c_str());
+  EXPECT_EQ(1, document2["bindings"].MemberCount());
+  EXPECT_TRUE(document2["bindings"].HasMember("789"));
+  EXPECT_FALSE(document2.HasMember("next"));
+}
+
+// Test that an invalid page size is rejected.
+TEST_F(GetBindingsTest, BadLimit)
+{
+  MockHttpStack::Request req(stack,
+                             "/impu/sip%3A6505550231%40homedomain/bindings",
+                             "",
+                             "?limit=0");
+  GetBindingsTask::Config config(sm);
+  GetBindingsTask* task = new GetBindingsTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 400, _));
+  task->run();
+}
+
+//
+// Test fetching bindings for many IMPUs at once.
+//
+
+class GetBulkBindingsTest : public TestWithMockSM
+{
+};
+
+// Test getting the bindings for several IMPUs, where one lookup fails.
+TEST_F(GetBulkBindingsTest, MultipleImpus)
+{
+  std::string body = "{\"impus\": [\"sip:6505550231@homedomain\", "
+                                    "\"sip:6505550232@homedomain\", "
+                                    "\"sip:6505550233@homedomain\"]}";
+  MockHttpStack::Request req(stack,
+                             "/impus/bindings",
+                             "",
+                             "",
+                             body,
+                             htp_method_POST);
+  GetBulkBindingsTask::Config config(sm);
+  GetBulkBindingsTask* task = new GetBulkBindingsTask(req, &config, 0);
+
+  Bindings bindings_1;
+  bindings_1["123"] = AoRTestUtils::build_binding("sip:6505550231@homedomain",
+                                                  time(NULL),
+                                                  "123");
+  Bindings bindings_2;
+  bindings_2["456"] = AoRTestUtils::build_binding("sip:6505550232@homedomain",
+                                                  time(NULL),
+                                                  "456");
+
+  EXPECT_CALL(*sm, get_bindings("sip:6505550231@homedomain", _, _))
+    .WillOnce(DoAll(SetArgReferee<1>(bindings_1),
+                    Return(HTTP_OK)));
+  EXPECT_CALL(*sm, get_bindings("sip:6505550232@homedomain", _, _))
+    .WillOnce(DoAll(SetArgReferee<1>(bindings_2),
+                    Return(HTTP_OK)));
+  EXPECT_CALL(*sm, get_bindings("sip:6505550233@homedomain", _, _))
+    .WillOnce(Return(HTTP_NOT_FOUND));
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+
+  task->run();
+
+  rapidjson::Document document;
+  document.Parse(req.content().c_str());
+  ASSERT_TRUE(document.HasMember("impus"));
+  const rapidjson::Value& impus = document["impus"];
+  EXPECT_EQ(3, impus.MemberCount());
+  EXPECT_TRUE(impus["sip:6505550231@homedomain"]["bindings"].HasMember("123"));
+  EXPECT_TRUE(impus["sip:6505550232@homedomain"]["bindings"].HasMember("456"));
+  EXPECT_EQ(404, impus["sip:6505550233@homedomain"]["error"].GetInt());
+}
+
+// Test that an IMPU that is requested twice is only looked up and reported
+// once.
+TEST_F(GetBulkBindingsTest, DuplicateImpus)
+{
+  std::string body = "{\"impus\": [\"sip:6505550231@homedomain\", "
+                                    "\"sip:6505550231@homedomain\"]}";
+  MockHttpStack::Request req(stack,
+                             "/impus/bindings",
+                             "",
+                             "",
+                             body,
+                             htp_method_POST);
+  GetBulkBindingsTask::Config config(sm);
+  GetBulkBindingsTask* task = new GetBulkBindingsTask(req, &config, 0);
+
+  EXPECT_CALL(*sm, get_bindings("sip:6505550231@homedomain", _, _))
+    .WillOnce(Return(HTTP_NOT_FOUND));
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+
+  task->run();
+
+  EXPECT_EQ("{\"impus\":{\"sip:6505550231@homedomain\":{\"error\":404}}}",
+            req.content());
+}
+
+// Test that the lookups run on the lookup pool, and the response is sent
+// once they have all completed.
+TEST_F(GetBulkBindingsTest, LookupPool)
+{
+  GetBulkBindingsTask::LookupPool pool(NULL, 2);
+  pool.start();
+
+  std::string body = "{\"impus\": [\"sip:6505550231@homedomain\", "
+                                    "\"sip:6505550232@homedomain\", "
+                                    "\"sip:6505550233@homedomain\"]}";
+  MockHttpStack::Request req(stack,
+                             "/impus/bindings",
+                             "",
+                             "",
+                             body,
+                             htp_method_POST);
+  GetBulkBindingsTask::Config config(sm, &pool);
+  GetBulkBindingsTask* task = new GetBulkBindingsTask(req, &config, 0);
+
+  std::mutex lock;
+  std::condition_variable cond;
+  bool replied = false;
+
+  EXPECT_CALL(*sm, get_bindings(_, _, _))
+    .Times(3)
+    .WillRepeatedly(Return(HTTP_NOT_FOUND));
+  EXPECT_CALL(*stack, send_reply(_, 200, _))
+    .WillOnce(InvokeWithoutArgs([&]()
+    {
+      std::unique_lock<std::mutex> l(lock);
+      replied = true;
+      cond.notify_all();
+    }));
+
+  task->run();
+
+  {
+    std::unique_lock<std::mutex> l(lock);
+    EXPECT_TRUE(cond.wait_for(l, std::chrono::seconds(5), [&]{ return replied; }));
+  }
+
+  pool.stop();
+  pool.join();
+
+  rapidjson::Document document;
+  document.Parse(req.content().c_str());
+  ASSERT_FALSE(document.HasParseError());
+  EXPECT_EQ(3, document["impus"].MemberCount());
+
+  // The results are written in request order, whichever lookup finished
+  // first.
+  std::string content = req.content();
+  size_t pos_1 = content.find("sip:6505550231@homedomain");
+  size_t pos_2 = content.find("sip:6505550232@homedomain");
+  size_t pos_3 = content.find("sip:6505550233@homedomain");
+  EXPECT_LT(pos_1, pos_2);
+  EXPECT_LT(pos_2, pos_3);
+  EXPECT_NE(std::string::npos, pos_3);
+}
+
+// Test that an invalid body is rejected.
+TEST_F(GetBulkBindingsTest, BadBody)
+{
+  MockHttpStack::Request req(stack,
+                             "/impus/bindings",
+                             "",
+                             "",
+                             "{\"impus\": [1]}",
+                             htp_method_POST);
+  GetBulkBindingsTask::Config config(sm);
+  GetBulkBindingsTask* task = new GetBulkBindingsTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 400, _));
+  task->run();
+}
+
+// Test that a bulk request with GET method gets rejected.
+TEST_F(GetBulkBindingsTest, BadMethod)
+{
+  MockHttpStack::Request req(stack, "/impus/bindings", "");
+  GetBulkBindingsTask::Config config(sm);
+  GetBulkBindingsTask* task = new GetBulkBindingsTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 405, _));
+  task->run();
+}
+
+//
+// Test fetching sprout's memory usage.
+//
+
+class GetMemoryTest : public TestWithMockSM
+{
+  pj_caching_pool cp;
+
+  virtual void SetUp()
+  {
+    TestWithMockSM::SetUp();
+    pj_init();
+    pj_caching_pool_init(&cp, NULL, 0);
+  }
+
+  virtual void TearDown()
+  {
+    pj_caching_pool_destroy(&cp);
+    pj_shutdown();
+    TestWithMockSM::TearDown();
+  }
+};
+
+// Test that the memory usage is reported, broken down by pool owner and
+// subsystem.
+TEST_F(GetMemoryTest, MainlineTest)
+{
+  pj_pool_t* pool = pj_pool_create(&cp.factory, "tsx%p", 1024, 1024, NULL);
+
+  MockHttpStack::Request req(stack, "/memory", "");
+  GetMemoryTask::Config config(&cp);
+  GetMemoryTask* task = new GetMemoryTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+  task->run();
+
+  rapidjson::Document document;
+  document.Parse(req.content().c_str());
+  ASSERT_FALSE(document.HasParseError());
+
+  ASSERT_TRUE(document.HasMember("pjsip"));
+  const rapidjson::Value& pjsip = document["pjsip"];
+  EXPECT_EQ(1u, pjsip["pools"].GetUint64());
+  EXPECT_EQ(pj_pool_get_capacity(pool), pjsip["used_bytes"].GetUint64());
+  ASSERT_TRUE(pjsip["owners"].HasMember("tsx"));
+  EXPECT_EQ(1u, pjsip["owners"]["tsx"]["pools"].GetUint64());
+
+  ASSERT_TRUE(document.HasMember("subsystems"));
+  EXPECT_TRUE(document["subsystems"].HasMember("odi_tokens"));
+  EXPECT_TRUE(document["subsystems"].HasMember("acr_queue"));
+  EXPECT_TRUE(document["subsystems"].HasMember("shared_ifcs"));
+
+  pj_pool_release(pool);
+}
+
+// Test that a memory request with PUT method gets rejected.
+TEST_F(GetMemoryTest, BadMethod)
+{
+  MockHttpStack::Request req(stack, "/memory", "", "", "", htp_method_PUT);
+  GetMemoryTask::Config config(&cp);
+  GetMemoryTask* task = new GetMemoryTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 405, _));
+  task->run();
+}
+
+//
+// Test fetching and clearing the IO profile.
+//
+
+class IoProfileTest : public TestWithMockSM
+{
+  virtual void TearDown()
+  {
+    IoProfiler::set_sample_rate(0);
+    IoProfiler::reset();
+    cwtest_reset_time();
+    TestWithMockSM::TearDown();
+  }
+};
+
+// Test that the profile is reported for each call site.
+TEST_F(IoProfileTest, Get)
+{
+  cwtest_completely_control_time();
+  IoProfiler::set_sample_rate(1);
+  IoProfiler::io_started("DNS NAPTR query");
+  cwtest_advance_time_ms(3);
+  IoProfiler::io_completed("DNS NAPTR query");
+
+  MockHttpStack::Request req(stack, "/io-profile", "");
+  IoProfileTask::Config config;
+  IoProfileTask* task = new IoProfileTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+  task->run();
+
+  rapidjson::Document document;
+  document.Parse(req.content().c_str());
+  ASSERT_FALSE(document.HasParseError());
+
+  EXPECT_EQ(1, document["sample_rate"].GetInt());
+  ASSERT_EQ(1u, document["sites"].Size());
+  const rapidjson::Value& site = document["sites"][0];
+  EXPECT_EQ(std::string("DNS NAPTR query"), site["site"].GetString());
+  EXPECT_EQ(std::string("none"), site["sproutlet"].GetString());
+  EXPECT_EQ(1u, site["count"].GetUint64());
+  EXPECT_EQ(3000u, site["max_us"].GetUint64());
+  ASSERT_EQ(1u, site["histogram"].Size());
+  EXPECT_EQ(4096u, site["histogram"][0]["lt_us"].GetUint64());
+}
+
+// Test that a DELETE clears the profile.
+TEST_F(IoProfileTest, Delete)
+{
+  IoProfiler::set_sample_rate(1);
+  IoProfiler::io_started("HTTP");
+  IoProfiler::io_completed("HTTP");
+
+  MockHttpStack::Request req(stack, "/io-profile", "", "", "", htp_method_DELETE);
+  IoProfileTask::Config config;
+  IoProfileTask* task = new IoProfileTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+  task->run();
+
+  IoProfiler::Profile profile;
+  IoProfiler::get_profile(profile);
+  EXPECT_TRUE(profile.empty());
+}
+
+// Test that an IO profile request with PUT method gets rejected.
+TEST_F(IoProfileTest, BadMethod)
+{
+  MockHttpStack::Request req(stack, "/io-profile", "", "", "", htp_method_PUT);
+  IoProfileTask::Config config;
+  IoProfileTask* task = new IoProfileTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 405, _));
+  task->run();
+}
+
+//
+// Test fetching and clearing the lock contention statistics.
+//
+
+class LockStatsTest : public TestWithMockSM
+{
+};
+
+// Test that the statistics are reported for each lock site.
+TEST_F(LockStatsTest, Get)
+{
+  InstrumentedLock::reset_all_stats();
+  InstrumentedMutex mutex("test_handler_lock");
+  mutex.lock();
+  mutex.unlock();
+
+  MockHttpStack::Request req(stack, "/locks", "");
+  LockStatsTask::Config config;
+  LockStatsTask* task = new LockStatsTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+  task->run();
+
+  rapidjson::Document document;
+  document.Parse(req.content().c_str());
+  ASSERT_FALSE(document.HasParseError());
+
+  ASSERT_TRUE(document["locks"].HasMember("test_handler_lock"));
+  const rapidjson::Value& lock = document["locks"]["test_handler_lock"];
+  EXPECT_EQ(1u, lock["acquisitions"].GetUint64());
+  EXPECT_EQ(0u, lock["contended"].GetUint64());
+  EXPECT_TRUE(lock.HasMember("wait_us"));
+  EXPECT_TRUE(lock.HasMember("hold_us"));
+  EXPECT_TRUE(lock.HasMember("max_hold_us"));
+}
+
+// Test that a DELETE clears the statistics.
+TEST_F(LockStatsTest, Delete)
+{
+  InstrumentedMutex mutex("test_handler_lock");
+  mutex.lock();
+  mutex.unlock();
+
+  MockHttpStack::Request req(stack, "/locks", "", "", "", htp_method_DELETE);
+  LockStatsTask::Config config;
+  LockStatsTask* task = new LockStatsTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+  task->run();
+
+  std::map<std::string, LockStats> all_stats;
+  InstrumentedLock::get_all_stats(all_stats);
+  EXPECT_EQ(0u, all_stats["test_handler_lock"].acquisitions);
+}
+
+// Test that a lock statistics request with PUT method gets rejected.
+TEST_F(LockStatsTest, BadMethod)
+{
+  MockHttpStack::Request req(stack, "/locks", "", "", "", htp_method_PUT);
+  LockStatsTask::Config config;
+  LockStatsTask* task = new LockStatsTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 405, _));
+  task->run();
+}
+
+//
+// Test fetching and clearing the slowest SIP messages.
+//
+
+class SlowTransactionsTaskTest : public TestWithMockSM
+{
+};
+
+// Test that the slowest messages are reported by method.
+TEST_F(SlowTransactionsTaskTest, Get)
+{
+  SlowTransactions::reset();
+
+  MockHttpStack::Request req(stack, "/slow-transactions", "");
+  SlowTransactionsTask::Config config;
+  SlowTransactionsTask* task = new SlowTransactionsTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+  task->run();
+
+  rapidjson::Document document;
+  document.Parse(req.content().c_str());
+  ASSERT_FALSE(document.HasParseError());
+  ASSERT_TRUE(document.HasMember("methods"));
+  EXPECT_TRUE(document["methods"].IsObject());
+}
+
+// Test that a DELETE clears the slowest messages.
+TEST_F(SlowTransactionsTaskTest, Delete)
+{
+  MockHttpStack::Request req(stack, "/slow-transactions", "", "", "", htp_method_DELETE);
+  SlowTransactionsTask::Config config;
+  SlowTransactionsTask* task = new SlowTransactionsTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+  task->run();
+
+  SlowTransactions::Report report;
+  SlowTransactions::get_slowest(report);
+  EXPECT_TRUE(report.empty());
+}
+
+// Test that a slow transactions request with PUT method gets rejected.
+TEST_F(SlowTransactionsTaskTest, BadMethod)
+{
+  MockHttpStack::Request req(stack, "/slow-transactions", "", "", "", htp_method_PUT);
+  SlowTransactionsTask::Config config;
+  SlowTransactionsTask* task = new SlowTransactionsTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 405, _));
+  task->run();
+}
+
+//
+// Test fetching the density of jittered expiries.
+//
+
+class ExpiryJitterTaskTest : public TestWithMockSM
+{
+};
+
+// Test that the density is reported for each configured policy.
+TEST_F(ExpiryJitterTaskTest, Get)
+{
+  ExpiryJitter reg_jitter(600, 20);
+  reg_jitter.grant(600, time(NULL));
+
+  MockHttpStack::Request req(stack, "/expiry-jitter", "");
+  ExpiryJitterTask::Config config(&reg_jitter, NULL);
+  ExpiryJitterTask* task = new ExpiryJitterTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 200, _));
+  task->run();
+
+  rapidjson::Document document;
+  document.Parse(req.content().c_str());
+  ASSERT_FALSE(document.HasParseError());
+  EXPECT_FALSE(document.HasMember("subscriptions"));
+  ASSERT_TRUE(document.HasMember("registrations"));
+
+  const rapidjson::Value& reg = document["registrations"];
+  EXPECT_EQ(reg_jitter.bucket_width(), reg["bucket_s"].GetInt());
+  ASSERT_EQ((rapidjson::SizeType)ExpiryJitter::NUM_BUCKETS, reg["due"].Size());
+
+  uint32_t total = 0;
+  for (rapidjson::SizeType ii = 0; ii < reg["due"].Size(); ++ii)
+  {
+    total += reg["due"][ii].GetUint();
+  }
+  EXPECT_EQ(1u, total);
+}
+
+// Test that an expiry jitter request with DELETE method gets rejected.
+TEST_F(ExpiryJitterTaskTest, BadMethod)
+{
+  MockHttpStack::Request req(stack, "/expiry-jitter", "", "", "", htp_method_DELETE);
+  ExpiryJitterTask::Config config(NULL, NULL);
+  ExpiryJitterTask* task = new ExpiryJitterTask(req, &config, 0);
+
+  EXPECT_CALL(*stack, send_reply(_, 405, _));
+  task->run();
+}
+
 //
 // Test fetching sprout's subscriptions.
 //
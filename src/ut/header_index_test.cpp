@@ -0,0 +1,201 @@
+/**
+ * @file header_index_test.cpp UT for the SIP message header index.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <string>
+#include <set>
+#include "gtest/gtest.h"
+
+#include "siptest.hpp"
+#include "header_index.h"
+#include "constants.h"
+
+using namespace std;
+
+static const pj_str_t STR_X_TEST = pj_str((char*)"X-Test");
+static const pj_str_t STR_MISSING = pj_str((char*)"X-Missing");
+
+class HeaderIndexTest : public SipTest
+{
+public:
+  static void SetUpTestCase()
+  {
+    SipTest::SetUpTestCase();
+  }
+
+  static void TearDownTestCase()
+  {
+    SipTest::TearDownTestCase();
+  }
+
+  pjsip_msg* parse()
+  {
+    string msg =
+      "INVITE sip:6505550001@homedomain SIP/2.0\r\n"
+      "Via: SIP/2.0/TCP 10.83.18.38:36530;rport;branch=z9hG4bKPjmo1aimuq33BAI4rjhgQgBr4sY5e9kSPI\r\n"
+      "From: <sip:6505550000@homedomain>;tag=10.114.61.213+1+8c8b232a+5fb751cf\r\n"
+      "To: <sip:6505550001@homedomain>\r\n"
+      "Route: <sip:sprout.homedomain;lr>\r\n"
+      "P-Asserted-Identity: <sip:6505550000@homedomain>\r\n"
+      "a: *;+g.3gpp.icsi-ref=\"urn%3Aurn-7%3A3gpp-service.ims.icsi.mmtel\"\r\n"
+      "Route: <sip:scscf.homedomain;lr>\r\n"
+      "Accept-Contact: *;video\r\n"
+      "P-Asserted-Identity: <tel:6505550000>\r\n"
+      "Max-Forwards: 68\r\n"
+      "Call-ID: 0gQAAC8WAAACBAAALxYAAAL8P3UbW8l4mT8YBkKGRKc5SOHaJ1gMRqsUOO4ohntC@10.114.61.213\r\n"
+      "CSeq: 16567 INVITE\r\n"
+      "Content-Length: 0\r\n\r\n";
+
+    return parse_msg(msg);
+  }
+
+  pjsip_hdr* create_hdr(const pj_str_t* name, const char* value)
+  {
+    pj_str_t hvalue = pj_str((char*)value);
+    return (pjsip_hdr*)pjsip_generic_string_hdr_create(stack_data.pool,
+                                                       name,
+                                                       &hvalue);
+  }
+};
+
+// Check that lookups return the same headers as PJSIP's own searches.
+TEST_F(HeaderIndexTest, Find)
+{
+  pjsip_msg* msg = parse();
+  HeaderIndex hdrs(msg);
+
+  pjsip_hdr* route = hdrs.find(&STR_ROUTE);
+  EXPECT_EQ(pjsip_msg_find_hdr_by_name(msg, &STR_ROUTE, NULL), route);
+
+  route = hdrs.find_next(route);
+  ASSERT_TRUE(route != NULL);
+  EXPECT_EQ(pjsip_msg_find_hdr_by_name(msg, &STR_ROUTE, route), route);
+  EXPECT_TRUE(hdrs.find_next(route) == NULL);
+
+  // Lookups ignore case.
+  pj_str_t lower = pj_str((char*)"p-asserted-identity");
+  EXPECT_EQ(pjsip_msg_find_hdr_by_name(msg, &STR_P_ASSERTED_IDENTITY, NULL),
+            hdrs.find(&lower));
+
+  EXPECT_TRUE(hdrs.find(&STR_MISSING) == NULL);
+}
+
+// Check that lookups by name and short name return headers in message
+// order.
+TEST_F(HeaderIndexTest, FindShortName)
+{
+  pjsip_msg* msg = parse();
+  HeaderIndex hdrs(msg);
+
+  pjsip_hdr* expected = (pjsip_hdr*)
+    pjsip_msg_find_hdr_by_names(msg,
+                                &STR_ACCEPT_CONTACT,
+                                &STR_ACCEPT_CONTACT_SHORT,
+                                NULL);
+  pjsip_hdr* hdr = hdrs.find(&STR_ACCEPT_CONTACT, &STR_ACCEPT_CONTACT_SHORT);
+  int count = 0;
+
+  while (hdr != NULL)
+  {
+    EXPECT_EQ(expected, hdr);
+    count++;
+    expected = (pjsip_hdr*)
+      pjsip_msg_find_hdr_by_names(msg,
+                                  &STR_ACCEPT_CONTACT,
+                                  &STR_ACCEPT_CONTACT_SHORT,
+                                  expected->next);
+    hdr = hdrs.find_next(hdr, &STR_ACCEPT_CONTACT, &STR_ACCEPT_CONTACT_SHORT);
+  }
+
+  EXPECT_TRUE(expected == NULL);
+  EXPECT_EQ(2, count);
+}
+
+// Check that the index returns the first header with each distinct name.
+TEST_F(HeaderIndexTest, FirstHdrs)
+{
+  pjsip_msg* msg = parse();
+  HeaderIndex hdrs(msg);
+
+  std::vector<pjsip_hdr*> first_hdrs;
+  hdrs.first_hdrs(first_hdrs);
+
+  std::set<pjsip_hdr*> expected;
+  for (pjsip_hdr* hdr = msg->hdr.next; hdr != &msg->hdr; hdr = hdr->next)
+  {
+    expected.insert((pjsip_hdr*)pjsip_msg_find_hdr_by_name(msg, &hdr->name, NULL));
+  }
+
+  EXPECT_EQ(expected,
+            std::set<pjsip_hdr*>(first_hdrs.begin(), first_hdrs.end()));
+  EXPECT_EQ(expected.size(), first_hdrs.size());
+}
+
+// Check that headers added and removed through the index are reflected in
+// both the index and the message.
+TEST_F(HeaderIndexTest, AddRemove)
+{
+  pjsip_msg* msg = parse();
+  HeaderIndex hdrs(msg);
+
+  // Headers added before the index is built are picked up when it is.
+  pjsip_hdr* middle = create_hdr(&STR_X_TEST, "middle");
+  hdrs.add_hdr(middle);
+  EXPECT_EQ(middle, hdrs.find(&STR_X_TEST));
+
+  pjsip_hdr* last = create_hdr(&STR_X_TEST, "last");
+  hdrs.add_hdr(last);
+  pjsip_hdr* first = create_hdr(&STR_X_TEST, "first");
+  hdrs.insert_first_hdr(first);
+
+  EXPECT_EQ(first, hdrs.find(&STR_X_TEST));
+  EXPECT_EQ(middle, hdrs.find_next(first));
+  EXPECT_EQ(last, hdrs.find_next(middle));
+  EXPECT_EQ(first, pjsip_msg_find_hdr_by_name(msg, &STR_X_TEST, NULL));
+
+  hdrs.remove_hdr(middle);
+  EXPECT_EQ(last, hdrs.find_next(first));
+  EXPECT_EQ(last, pjsip_msg_find_hdr_by_name(msg, &STR_X_TEST, first->next));
+
+  hdrs.remove_hdr(first);
+  hdrs.remove_hdr(last);
+  EXPECT_TRUE(hdrs.find(&STR_X_TEST) == NULL);
+  EXPECT_TRUE(pjsip_msg_find_hdr_by_name(msg, &STR_X_TEST, NULL) == NULL);
+}
+
+// Check that the index copes with messages with many different headers.
+TEST_F(HeaderIndexTest, ManyHeaders)
+{
+  pjsip_msg* msg = parse();
+  HeaderIndex hdrs(msg);
+  hdrs.find(&STR_ROUTE);
+
+  std::vector<std::string> names;
+  for (int ii = 0; ii < 100; ++ii)
+  {
+    names.push_back("X-Header-" + std::to_string(ii));
+  }
+
+  for (const std::string& name : names)
+  {
+    pj_str_t pj_name = pj_str((char*)name.c_str());
+    hdrs.add_hdr(create_hdr(&pj_name, "value"));
+  }
+
+  for (const std::string& name : names)
+  {
+    pj_str_t pj_name = pj_str((char*)name.c_str());
+    EXPECT_EQ(pjsip_msg_find_hdr_by_name(msg, &pj_name, NULL),
+              hdrs.find(&pj_name));
+  }
+
+  EXPECT_EQ(pjsip_msg_find_hdr_by_name(msg, &STR_ROUTE, NULL),
+            hdrs.find(&STR_ROUTE));
+}
@@ -0,0 +1,180 @@
+/**
+ * @file instrumented_mutex_test.cpp UT for the instrumented mutexes.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <unistd.h>
+#include <thread>
+#include "gtest/gtest.h"
+
+#include "instrumented_mutex.h"
+#include "test_interposer.hpp"
+
+class InstrumentedMutexTest : public ::testing::Test
+{
+  void SetUp()
+  {
+    InstrumentedLock::reset_all_stats();
+  }
+
+  void TearDown()
+  {
+    cwtest_reset_time();
+  }
+
+public:
+  static LockStats stats_for(const std::string& site)
+  {
+    std::map<std::string, LockStats> all_stats;
+    InstrumentedLock::get_all_stats(all_stats);
+    return all_stats[site];
+  }
+};
+
+// Check that acquisitions and hold times are recorded.
+TEST_F(InstrumentedMutexTest, Uncontended)
+{
+  cwtest_completely_control_time();
+  InstrumentedMutex mutex("test_uncontended");
+
+  {
+    std::unique_lock<InstrumentedMutex> lock(mutex);
+    cwtest_advance_time_ms(2);
+  }
+
+  mutex.lock();
+  cwtest_advance_time_ms(1);
+  mutex.unlock();
+
+  LockStats stats = stats_for("test_uncontended");
+  EXPECT_EQ(2u, stats.acquisitions);
+  EXPECT_EQ(0u, stats.contended);
+  EXPECT_EQ(3000000u, stats.hold_ns);
+  EXPECT_EQ(2000000u, stats.max_hold_ns);
+
+  // Resetting clears the statistics.
+  InstrumentedLock::reset_all_stats();
+  stats = stats_for("test_uncontended");
+  EXPECT_EQ(0u, stats.acquisitions);
+  EXPECT_EQ(0u, stats.max_hold_ns);
+}
+
+// Check that a lock that is already held is counted as contended.
+TEST_F(InstrumentedMutexTest, Contended)
+{
+  InstrumentedMutex mutex("test_contended");
+  std::atomic<bool> started(false);
+  mutex.lock();
+
+  std::thread thread([&mutex, &started]()
+  {
+    started = true;
+    mutex.lock();
+    mutex.unlock();
+  });
+
+  // Give the thread time to block on the lock.
+  while (!started)
+  {
+    std::this_thread::yield();
+  }
+  usleep(100000);
+
+  mutex.unlock();
+  thread.join();
+
+  LockStats stats = stats_for("test_contended");
+  EXPECT_EQ(2u, stats.acquisitions);
+  EXPECT_EQ(1u, stats.contended);
+}
+
+// Check that only the outermost hold of a recursive mutex is timed, and that
+// locks with the same site are reported together, even once destroyed.
+TEST_F(InstrumentedMutexTest, RecursiveAndSameSite)
+{
+  cwtest_completely_control_time();
+  InstrumentedMutex mutex("test_recursive", true);
+
+  {
+    InstrumentedMutex other("test_recursive");
+    other.lock();
+    other.unlock();
+  }
+
+  mutex.lock();
+  cwtest_advance_time_ms(1);
+  mutex.lock();
+  cwtest_advance_time_ms(1);
+  mutex.unlock();
+  cwtest_advance_time_ms(1);
+  mutex.unlock();
+
+  LockStats stats = stats_for("test_recursive");
+  EXPECT_EQ(3u, stats.acquisitions);
+  EXPECT_EQ(3000000u, stats.hold_ns);
+  EXPECT_EQ(3000000u, stats.max_hold_ns);
+}
+
+// Check that a shared mutex only counts and times exclusive acquisitions.
+TEST_F(InstrumentedMutexTest, SharedMutex)
+{
+  cwtest_completely_control_time();
+  InstrumentedSharedMutex mutex("test_shared");
+
+  {
+    boost::shared_lock<InstrumentedSharedMutex> read_lock(mutex);
+    EXPECT_TRUE(mutex.try_lock_shared());
+    EXPECT_FALSE(mutex.try_lock());
+    mutex.unlock_shared();
+    cwtest_advance_time_ms(5);
+  }
+
+  {
+    boost::lock_guard<InstrumentedSharedMutex> write_lock(mutex);
+    cwtest_advance_time_ms(1);
+  }
+
+  // Only the exclusive acquisition is counted.
+  LockStats stats = stats_for("test_shared");
+  EXPECT_EQ(1u, stats.acquisitions);
+  EXPECT_EQ(0u, stats.contended);
+  EXPECT_EQ(1000000u, stats.hold_ns);
+}
+
+// Check that a reader that has to wait for a shared mutex is counted as
+// contended.
+TEST_F(InstrumentedMutexTest, SharedMutexContendedReader)
+{
+  InstrumentedSharedMutex mutex("test_shared_contended");
+  std::atomic<bool> started(false);
+  mutex.lock();
+
+  std::thread thread([&mutex, &started]()
+  {
+    started = true;
+    mutex.lock_shared();
+    mutex.unlock_shared();
+  });
+
+  // Give the thread time to block on the lock.
+  while (!started)
+  {
+    std::this_thread::yield();
+  }
+  usleep(100000);
+
+  mutex.unlock();
+  thread.join();
+
+  LockStats stats = stats_for("test_shared_contended");
+  EXPECT_EQ(1u, stats.acquisitions);
+  EXPECT_EQ(1u, stats.contended);
+}
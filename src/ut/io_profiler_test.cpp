@@ -0,0 +1,124 @@
+/**
+ * @file io_profiler_test.cpp UT for the blocking IO profiler.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <thread>
+#include "gtest/gtest.h"
+
+#include "io_profiler.h"
+#include "test_interposer.hpp"
+
+class IoProfilerTest : public ::testing::Test
+{
+  void SetUp()
+  {
+    IoProfiler::reset();
+    IoProfiler::set_sample_rate(1);
+    cwtest_completely_control_time();
+  }
+
+  void TearDown()
+  {
+    IoProfiler::set_sample_rate(0);
+    IoProfiler::reset();
+    cwtest_reset_time();
+  }
+
+public:
+  static void do_io(const std::string& site, int duration_ms)
+  {
+    IoProfiler::io_started(site);
+    cwtest_advance_time_ms(duration_ms);
+    IoProfiler::io_completed(site);
+  }
+};
+
+// Check that IO is recorded against its call site and sproutlet.
+TEST_F(IoProfilerTest, SitesAndSproutlets)
+{
+  do_io("DNS NAPTR query", 2);
+
+  {
+    std::string sproutlet = "scscf";
+    IoProfiler::SproutletScope scope(sproutlet);
+    do_io("HTTP", 10);
+    do_io("HTTP", 30);
+  }
+
+  IoProfiler::Profile profile;
+  IoProfiler::get_profile(profile);
+  ASSERT_EQ(2u, profile.size());
+
+  const IoProfiler::SiteStats& dns = profile[IoProfiler::SiteKey("DNS NAPTR query", "none")];
+  EXPECT_EQ(1u, dns.count);
+  EXPECT_EQ(2000u, dns.total_us);
+
+  const IoProfiler::SiteStats& http = profile[IoProfiler::SiteKey("HTTP", "scscf")];
+  EXPECT_EQ(2u, http.count);
+  EXPECT_EQ(40000u, http.total_us);
+  EXPECT_EQ(30000u, http.max_us);
+
+  // 10ms falls in [8192, 16384)us and 30ms in [16384, 32768)us.
+  EXPECT_EQ(1u, http.buckets[13]);
+  EXPECT_EQ(1u, http.buckets[14]);
+  EXPECT_EQ(16384u, IoProfiler::bucket_limit_us(13));
+  EXPECT_EQ(0u, IoProfiler::bucket_limit_us(IoProfiler::NUM_BUCKETS - 1));
+
+  // Resetting clears the profile.
+  IoProfiler::reset();
+  IoProfiler::get_profile(profile);
+  EXPECT_TRUE(profile.empty());
+}
+
+// Check that nested IO regions are each timed correctly.
+TEST_F(IoProfilerTest, Nested)
+{
+  IoProfiler::io_started("outer");
+  cwtest_advance_time_ms(1);
+  do_io("inner", 5);
+  IoProfiler::io_completed("outer");
+
+  IoProfiler::Profile profile;
+  IoProfiler::get_profile(profile);
+  EXPECT_EQ(5000u, profile[IoProfiler::SiteKey("inner", "none")].total_us);
+  EXPECT_EQ(6000u, profile[IoProfiler::SiteKey("outer", "none")].total_us);
+}
+
+// Check that only one in every sample_rate regions is recorded, and that
+// nothing is recorded when profiling is disabled.
+TEST_F(IoProfilerTest, Sampling)
+{
+  IoProfiler::set_sample_rate(4);
+
+  for (int ii = 0; ii < 8; ++ii)
+  {
+    do_io("memcached", 1);
+  }
+
+  IoProfiler::set_sample_rate(0);
+  do_io("memcached", 1);
+
+  IoProfiler::Profile profile;
+  IoProfiler::get_profile(profile);
+  EXPECT_EQ(2u, profile[IoProfiler::SiteKey("memcached", "none")].count);
+}
+
+// Check that the profiles of threads are kept after they exit.
+TEST_F(IoProfilerTest, ThreadExit)
+{
+  std::thread thread([]() { do_io("HTTP", 1); });
+  thread.join();
+
+  do_io("HTTP", 1);
+
+  IoProfiler::Profile profile;
+  IoProfiler::get_profile(profile);
+  EXPECT_EQ(2u, profile[IoProfiler::SiteKey("HTTP", "none")].count);
+}
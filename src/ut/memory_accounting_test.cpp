@@ -0,0 +1,109 @@
+/**
+ * @file memory_accounting_test.cpp UT for the memory accounting.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <map>
+#include <string>
+#include "gtest/gtest.h"
+
+#include "memory_accounting.h"
+
+class MemoryAccountingTest : public ::testing::Test
+{
+  pj_caching_pool cp;
+
+  virtual void SetUp()
+  {
+    pj_init();
+    pj_caching_pool_init(&cp, NULL, 0);
+  }
+
+  virtual void TearDown()
+  {
+    pj_caching_pool_destroy(&cp);
+    pj_shutdown();
+  }
+};
+
+// Check that an account tracks allocations, frees and the high-water mark.
+TEST_F(MemoryAccountingTest, Account)
+{
+  MemoryAccount account("test");
+  EXPECT_STREQ("test", account.name());
+
+  account.allocated(100);
+  account.allocated(50);
+  account.freed(120);
+
+  MemoryAccount::Stats stats = account.stats();
+  EXPECT_EQ(30, stats.bytes);
+  EXPECT_EQ(150, stats.high_water_bytes);
+  EXPECT_EQ(2u, stats.allocations);
+  EXPECT_EQ(1u, stats.frees);
+
+  // Replacing the contents resets the total, but not the high-water mark
+  // unless it is exceeded.
+  account.replaced(80);
+  stats = account.stats();
+  EXPECT_EQ(80, stats.bytes);
+  EXPECT_EQ(150, stats.high_water_bytes);
+
+  account.replaced(200);
+  stats = account.stats();
+  EXPECT_EQ(200, stats.bytes);
+  EXPECT_EQ(200, stats.high_water_bytes);
+}
+
+// Check that pools are attributed to the right owners.
+TEST_F(MemoryAccountingTest, PoolOwner)
+{
+  EXPECT_EQ("tsx", MemoryAccounting::pool_owner("tsx0x1234"));
+  EXPECT_EQ("rdata", MemoryAccounting::pool_owner("rtd0x1234"));
+  EXPECT_EQ("tdata", MemoryAccounting::pool_owner("tdta0x1234"));
+  EXPECT_EQ("dialog", MemoryAccounting::pool_owner("dlg0x1234"));
+  EXPECT_EQ("sproutlet", MemoryAccounting::pool_owner("app-route-1"));
+  EXPECT_EQ("other", MemoryAccounting::pool_owner("unknown"));
+  EXPECT_EQ("other", MemoryAccounting::pool_owner(""));
+}
+
+// Check that the pools in use are totalled up by owner.
+TEST_F(MemoryAccountingTest, PoolStatsByOwner)
+{
+  pj_pool_t* tsx_pool_1 = pj_pool_create(&cp.factory, "tsx%p", 1024, 1024, NULL);
+  pj_pool_t* tsx_pool_2 = pj_pool_create(&cp.factory, "tsx%p", 1024, 1024, NULL);
+  pj_pool_t* rdata_pool = pj_pool_create(&cp.factory, "rtd%p", 2048, 1024, NULL);
+  pj_pool_alloc(tsx_pool_1, 100);
+
+  std::map<std::string, MemoryAccounting::PoolStats> owners;
+  MemoryAccounting::get_pool_stats_by_owner(&cp, owners);
+
+  ASSERT_EQ(2u, owners.size());
+  EXPECT_EQ(2u, owners["tsx"].pools);
+  EXPECT_EQ(pj_pool_get_used_size(tsx_pool_1) + pj_pool_get_used_size(tsx_pool_2),
+            owners["tsx"].used_bytes);
+  EXPECT_EQ(pj_pool_get_capacity(tsx_pool_1) + pj_pool_get_capacity(tsx_pool_2),
+            owners["tsx"].capacity_bytes);
+  EXPECT_EQ(1u, owners["rdata"].pools);
+  EXPECT_EQ(pj_pool_get_capacity(rdata_pool), owners["rdata"].capacity_bytes);
+
+  MemoryAccounting::PoolFactoryStats factory;
+  MemoryAccounting::get_factory_stats(&cp, factory);
+  EXPECT_EQ(3u, factory.used_pools);
+  EXPECT_EQ(owners["tsx"].capacity_bytes + owners["rdata"].capacity_bytes,
+            factory.used_bytes);
+
+  pj_pool_release(tsx_pool_1);
+  pj_pool_release(tsx_pool_2);
+  pj_pool_release(rdata_pool);
+
+  owners.clear();
+  MemoryAccounting::get_pool_stats_by_owner(&cp, owners);
+  EXPECT_TRUE(owners.empty());
+}
@@ -17,6 +17,7 @@
 #include "utils.h"
 #include "analyticslogger.h"
 #include "options.h"
+#include "fakesnmp.hpp"
 
 using namespace std;
 
@@ -175,3 +176,65 @@ TEST_F(OptionsTest, SimpleMainline)
   free_txdata();
 }
 
+
+/// Fixture for the OPTIONS fast path.
+class OptionsFastPathTest : public SipTest
+{
+public:
+  static SNMP::FakeCounterByScopeTable _counter;
+
+  static void SetUpTestCase()
+  {
+    SipTest::SetUpTestCase();
+    pj_status_t ret = init_options(&_counter);
+    ASSERT_EQ(PJ_SUCCESS, ret);
+  }
+
+  static void TearDownTestCase()
+  {
+    destroy_options();
+    SipTest::TearDownTestCase();
+  }
+
+  OptionsFastPathTest() : SipTest(&mod_options_fast_path)
+  {
+    _counter.reset_count();
+  }
+
+  ~OptionsFastPathTest()
+  {
+  }
+};
+
+SNMP::FakeCounterByScopeTable OptionsFastPathTest::_counter;
+
+// Check that a local OPTIONS poll is answered and counted.
+TEST_F(OptionsFastPathTest, SimpleMainline)
+{
+  Message msg;
+  inject_msg(msg.get());
+  ASSERT_EQ(1, txdata_count());
+  pjsip_msg* out = current_txdata()->msg;
+  EXPECT_EQ(200, out->line.status.code);
+  free_txdata();
+
+  EXPECT_EQ(1, _counter._count);
+}
+
+// Check that other requests are passed on to the rest of the stack.
+TEST_F(OptionsFastPathTest, NotHandled)
+{
+  Message msg;
+  msg._method = "INVITE";
+  EXPECT_EQ(PJ_FALSE, inject_msg_direct(msg.get()));
+
+  msg._method = "OPTIONS";
+  msg._domain = "homedomain";
+  EXPECT_EQ(PJ_FALSE, inject_msg_direct(msg.get()));
+
+  msg._domain = "127.0.0.1";
+  msg._route = "Route: <sip:notthehomedomain;transport=UDP;lr>";
+  EXPECT_EQ(PJ_FALSE, inject_msg_direct(msg.get()));
+
+  EXPECT_EQ(0, _counter._count);
+}
@@ -0,0 +1,146 @@
+/**
+ * @file pjutils_test.cpp UT for PJUtils string and identity helpers.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <string>
+#include "gtest/gtest.h"
+
+#include "basetest.hpp"
+#include "pjsip.h"
+#include "pjutils.h"
+#include "stack.h"
+#include "pj_string_view.h"
+
+class PJUtilsTest : public BaseTest
+{
+public:
+  static pj_caching_pool caching_pool;
+  static pj_pool_t* pool;
+  static pjsip_endpoint* endpt;
+
+  static void SetUpTestCase()
+  {
+    pj_init();
+    pj_caching_pool_init(&caching_pool, &pj_pool_factory_default_policy, 0);
+    pjsip_endpt_create(&caching_pool.factory, NULL, &endpt);
+    pool = pj_pool_create(&caching_pool.factory, "pjutils-test", 4000, 4000, NULL);
+  }
+
+  PJUtilsTest()
+  {
+    stack_data.default_home_domain = pj_str((char*)"homedomain");
+  }
+
+  pjsip_uri* uri(const std::string& uri_str)
+  {
+    return (pjsip_uri*)pjsip_uri_get_uri(PJUtils::uri_from_string(uri_str, pool));
+  }
+};
+
+pj_pool_t* PJUtilsTest::pool;
+pj_caching_pool PJUtilsTest::caching_pool;
+pjsip_endpoint* PJUtilsTest::endpt;
+
+TEST_F(PJUtilsTest, StringView)
+{
+  pj_str_t pjstr = pj_str((char*)"Hello World");
+  PJStringView view = PJUtils::pj_str_view(&pjstr);
+
+  EXPECT_EQ(11u, view.size());
+  EXPECT_TRUE(view == "Hello World");
+  EXPECT_TRUE(view != "Hello");
+  EXPECT_TRUE(view.iequals("hello world"));
+  EXPECT_FALSE(view.iequals("hello"));
+  EXPECT_TRUE(view.starts_with("Hello"));
+  EXPECT_EQ(5u, view.find(' '));
+  EXPECT_EQ(std::string::npos, view.find('!'));
+  EXPECT_EQ("World", view.substr(6).str());
+  EXPECT_TRUE(PJStringView("abc") < PJStringView("abd"));
+  EXPECT_TRUE(PJStringView("ab") < PJStringView("abc"));
+  pj_str_t view_pjstr = view.pj_str();
+  EXPECT_EQ(0, pj_strcmp(&pjstr, &view_pjstr));
+
+  // NULL and empty pj_str_ts give empty views.
+  pj_str_t empty = {NULL, 0};
+  EXPECT_TRUE(PJUtils::pj_str_view(NULL).empty());
+  EXPECT_TRUE(PJUtils::pj_str_view(&empty) == "");
+}
+
+TEST_F(PJUtilsTest, PublicIdIntoBuffer)
+{
+  pjsip_uri* sip_uri = uri("sip:alice@homedomain:5060;transport=tcp;lr");
+  char buf[100];
+  int len = PJUtils::public_id_from_uri(sip_uri, buf, sizeof(buf));
+  EXPECT_EQ("sip:alice@homedomain", std::string(buf, len));
+  EXPECT_EQ("sip:alice@homedomain", PJUtils::public_id_from_uri(sip_uri));
+
+  pj_str_t public_id = PJUtils::public_id_from_uri(sip_uri, pool);
+  EXPECT_EQ("sip:alice@homedomain", PJUtils::pj_str_to_string(&public_id));
+
+  pjsip_uri* tel_uri = uri("tel:+1234;isub=5;phone-context=home");
+  len = PJUtils::public_id_from_uri(tel_uri, buf, sizeof(buf));
+  EXPECT_EQ("tel:+1234", std::string(buf, len));
+
+  // Buffer too small.
+  EXPECT_EQ(-1, PJUtils::public_id_from_uri(sip_uri, buf, 5));
+
+  // Unsupported scheme.
+  pjsip_uri* other_uri = (pjsip_uri*)PJUtils::uri_from_string("mailto:alice@homedomain", pool);
+  EXPECT_EQ(0, PJUtils::public_id_from_uri(other_uri, buf, sizeof(buf)));
+  EXPECT_EQ("", PJUtils::public_id_from_uri(other_uri));
+}
+
+TEST_F(PJUtilsTest, PrivateIdIntoBuffer)
+{
+  char buf[100];
+  int len = PJUtils::default_private_id_from_uri(uri("sip:alice@homedomain"), buf, sizeof(buf));
+  EXPECT_EQ("alice@homedomain", std::string(buf, len));
+
+  len = PJUtils::default_private_id_from_uri(uri("sip:homedomain"), buf, sizeof(buf));
+  EXPECT_EQ("homedomain", std::string(buf, len));
+
+  len = PJUtils::default_private_id_from_uri(uri("tel:+1234"), buf, sizeof(buf));
+  EXPECT_EQ("+1234@homedomain", std::string(buf, len));
+  EXPECT_EQ("+1234@homedomain", PJUtils::default_private_id_from_uri(uri("tel:+1234")));
+
+  // Buffer too small.
+  EXPECT_EQ(-1, PJUtils::default_private_id_from_uri(uri("sip:alice@homedomain"), buf, 8));
+}
+
+// Check that identities too long for the stack buffer are still returned in
+// full, rather than truncated or empty.
+TEST_F(PJUtilsTest, LongIdentities)
+{
+  std::string user(1000, 'a');
+  pjsip_uri* long_uri = uri("sip:" + user + "@homedomain;transport=tcp");
+
+  EXPECT_EQ("sip:" + user + "@homedomain", PJUtils::public_id_from_uri(long_uri));
+  pj_str_t public_id = PJUtils::public_id_from_uri(long_uri, pool);
+  EXPECT_EQ("sip:" + user + "@homedomain", PJUtils::pj_str_to_string(&public_id));
+
+  EXPECT_EQ(user + "@homedomain", PJUtils::default_private_id_from_uri(long_uri));
+  pj_str_t private_id = PJUtils::default_private_id_from_uri(long_uri, pool);
+  EXPECT_EQ(user + "@homedomain", PJUtils::pj_str_to_string(&private_id));
+}
+
+TEST_F(PJUtilsTest, HeaderValueIntoBuffer)
+{
+  pj_str_t name = pj_str((char*)"X-Test");
+  pj_str_t value = pj_str((char*)"some value");
+  pjsip_hdr* hdr = (pjsip_hdr*)pjsip_generic_string_hdr_create(pool, &name, &value);
+
+  char buf[100];
+  PJStringView view = PJUtils::get_header_value(hdr, buf, sizeof(buf));
+  EXPECT_TRUE(view == "some value");
+  EXPECT_EQ("some value", PJUtils::get_header_value(hdr));
+
+  // Buffer too small.
+  EXPECT_TRUE(PJUtils::get_header_value(hdr, buf, 5).empty());
+}
@@ -214,7 +214,8 @@ public:
   {
   }
 
-  RegistrarTest()
+  RegistrarTest(ExpiryJitter* expiry_jitter = NULL) :
+    _expiry_jitter(expiry_jitter)
   {
     _registrar_sproutlet = new RegistrarSproutlet("registrar",
                                                   5058,
@@ -225,7 +226,8 @@ public:
                                                   _sm,
                                                   _acr_factory,
                                                   300,
-                                                  &SNMP::FAKE_REGISTRATION_STATS_TABLES);
+                                                  &SNMP::FAKE_REGISTRATION_STATS_TABLES,
+                                                  _expiry_jitter);
 
     EXPECT_TRUE(_registrar_sproutlet->init());
 
@@ -282,6 +284,7 @@ public:
 
     delete _registrar_proxy; _registrar_proxy = NULL;
     delete _registrar_sproutlet; _registrar_sproutlet = NULL;
+    delete _expiry_jitter; _expiry_jitter = NULL;
   }
 
   void request_not_handled_by_registrar_sproutlet()
@@ -343,6 +346,7 @@ public:
 protected:
   static MockSubscriberManager* _sm;
   static ACRFactory* _acr_factory;
+  ExpiryJitter* _expiry_jitter;
   RegistrarSproutlet* _registrar_sproutlet;
   SproutletProxy* _registrar_proxy;
 };
@@ -350,6 +354,27 @@ protected:
 MockSubscriberManager* RegistrarTest::_sm;
 ACRFactory* RegistrarTest::_acr_factory;
 
+/// Fixture for registrar tests with expiry jitter enabled.
+class RegistrarJitterTest : public RegistrarTest
+{
+public:
+  RegistrarJitterTest() : RegistrarTest(new ExpiryJitter(300, 50)) {}
+
+  /// The number of granted expiries the jitter policy is tracking.
+  uint32_t tracked_expiries()
+  {
+    std::vector<uint32_t> density;
+    _expiry_jitter->get_density(time(NULL), density);
+
+    uint32_t total = 0;
+    for (uint32_t count : density)
+    {
+      total += count;
+    }
+    return total;
+  }
+};
+
 // This test registers a subscriber by adding a single binding. It checks in
 // detail the created binding object, the headers on the 200 OKs, and the call
 // to the registration sender.
@@ -565,6 +590,74 @@ TEST_F(RegistrarTest, ReRegisterSubscriber)
   delete expected_binding;
 }
 
+// Test that with expiry jitter enabled, the registrar grants a shortened
+// expiry, and that a refresh replaces the expiry it granted before rather than
+// adding another.
+TEST_F(RegistrarJitterTest, RegisterAndRefreshWithJitter)
+{
+  Message msg;
+
+  // Register the subscriber, and check the binding is stored with an expiry
+  // of between 150 and 300 seconds.
+  Bindings bindings;
+  HSSConnection::irs_info irs_info;
+  Bindings all_bindings;
+  set_up_single_returned_binding(all_bindings, msg._cid);
+
+  expectations_for_successful_get_subscriber_state(irs_info);
+  expectations_for_not_found_get_bindings();
+  EXPECT_CALL(*_sm, register_subscriber(_, _, _, _, _, _, _))
+    .WillOnce(DoAll(SaveBindingsRegister(&bindings),
+                    SetArgReferee<4>(all_bindings),
+                    Return(HTTP_OK)));
+  expectations_for_registration_sender();
+
+  int now = time(NULL);
+  inject_msg(msg.get());
+  EXPECT_EQ(200, current_txdata()->msg->line.status.code);
+  free_txdata();
+
+  ASSERT_FALSE(bindings[AoRTestUtils::BINDING_ID] == NULL);
+  int granted = bindings[AoRTestUtils::BINDING_ID]->_expires - now;
+  EXPECT_LE(150, granted);
+  EXPECT_GE(300, granted);
+  EXPECT_EQ(1u, tracked_expiries());
+
+  // Refresh the registration.  The store returns the binding just granted.
+  Bindings refreshed_bindings;
+  Bindings current_bindings = SubscriberDataUtils::copy_bindings(bindings);
+  HSSConnection::irs_info refresh_irs_info;
+  Bindings refresh_all_bindings;
+  set_up_single_returned_binding(refresh_all_bindings, msg._cid);
+
+  expectations_for_successful_get_subscriber_state(refresh_irs_info);
+  EXPECT_CALL(*_sm, get_bindings(_, _, _))
+    .WillOnce(DoAll(SetArgReferee<1>(current_bindings),
+                    Return(HTTP_OK)));
+  EXPECT_CALL(*_sm, reregister_subscriber(_, _, _, _, _, _, _, _))
+    .WillOnce(DoAll(SaveBindingsReRegister(&refreshed_bindings),
+                    SetArgReferee<5>(refresh_all_bindings),
+                    Return(HTTP_OK)));
+  expectations_for_registration_sender();
+
+  msg.inc_cseq();
+  inject_msg(msg.get());
+  EXPECT_EQ(200, current_txdata()->msg->line.status.code);
+  free_txdata();
+
+  ASSERT_FALSE(refreshed_bindings[AoRTestUtils::BINDING_ID] == NULL);
+  granted = refreshed_bindings[AoRTestUtils::BINDING_ID]->_expires - now;
+  EXPECT_LE(150, granted);
+  EXPECT_GE(300, granted);
+
+  // Only the refreshed expiry is still tracked.
+  EXPECT_EQ(1u, tracked_expiries());
+
+  // Tidy up.
+  SubscriberDataUtils::delete_bindings(bindings);
+  SubscriberDataUtils::delete_bindings(refreshed_bindings);
+}
+
 // Test a fetch request for an existing subscriber. This shouldn't pass in any
 // changes on the reregister request, or increment any stats, or require
 // outbound support.
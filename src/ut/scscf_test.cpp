@@ -202,6 +202,7 @@ public:
     URIClassifier::enforce_user_phone = false;
     URIClassifier::enforce_global = false;
     ((SNMP::FakeCounterTable*)_scscf_sproutlet->_routed_by_preloaded_route_tbl)->reset_count();
+    _scscf_sproutlet->set_in_dialog_fast_path(false);
 
     delete _sm; _sm = NULL;
     delete _hss_connection; _hss_connection = NULL;
@@ -9331,6 +9332,79 @@ TEST_F(SCSCFTest, TestSessionExpiresInDialogRouteHeaderEmpty)
 }
 
 
+// Check that with the in-dialog fast path enabled, an in-dialog request that
+// the S-CSCF isn't billing is forwarded without S-CSCF processing.
+TEST_F(SCSCFTest, TestInDialogFastPath)
+{
+  _scscf_sproutlet->set_in_dialog_fast_path(true);
+
+  SCSCFMessage msg;
+  msg._method = "BYE";
+  msg._in_dialog = true;
+  msg._requri = "sip:6505551234@10.114.61.213:5061;transport=tcp";
+  msg._route = "Route: <sip:homedomain;transport=tcp;lr;billing-role=charge-none>";
+  CapturingTestLogger log;
+
+  inject_msg(msg.get_request());
+  ASSERT_EQ(1, txdata_count());
+  pjsip_msg* out = current_txdata()->msg;
+  ReqMatcher req("BYE");
+  ASSERT_NO_FATAL_FAILURE(req.matches(out));
+  EXPECT_EQ("sip:6505551234@10.114.61.213:5061;transport=tcp", req.uri());
+  EXPECT_EQ("", get_headers(out, "Route"));
+
+  inject_msg(respond_to_current_txdata(200));
+  ASSERT_EQ(1, txdata_count());
+  RespMatcher(200).matches(current_txdata()->msg);
+  free_txdata();
+
+  EXPECT_TRUE(log.contains("Forwarding in-dialog request without S-CSCF processing"));
+  EXPECT_FALSE(log.contains("S-CSCF received in-dialog request"));
+}
+
+
+// Check that the in-dialog fast path doesn't apply to requests that the
+// S-CSCF is billing, or that need session timer processing.
+TEST_F(SCSCFTest, TestInDialogFastPathNotApplicable)
+{
+  _scscf_sproutlet->set_in_dialog_fast_path(true);
+
+  SCSCFMessage msg;
+  msg._method = "BYE";
+  msg._in_dialog = true;
+  msg._requri = "sip:6505551234@10.114.61.213:5061;transport=tcp";
+  msg._route = "Route: <sip:homedomain;transport=tcp;lr;billing-role=charge-term>";
+
+  {
+    CapturingTestLogger log;
+    inject_msg(msg.get_request());
+    ASSERT_EQ(1, txdata_count());
+    ASSERT_NO_FATAL_FAILURE(ReqMatcher("BYE").matches(current_txdata()->msg));
+    inject_msg(respond_to_current_txdata(200));
+    ASSERT_EQ(1, txdata_count());
+    free_txdata();
+    EXPECT_TRUE(log.contains("S-CSCF received in-dialog request"));
+  }
+
+  // An UPDATE always goes through the S-CSCF, so that it can apply session
+  // timers.
+  msg._method = "UPDATE";
+  msg._cseq++;
+  msg._route = "Route: <sip:homedomain;transport=tcp;lr;billing-role=charge-none>";
+
+  {
+    CapturingTestLogger log;
+    inject_msg(msg.get_request());
+    ASSERT_EQ(1, txdata_count());
+    ASSERT_NO_FATAL_FAILURE(ReqMatcher("UPDATE").matches(current_txdata()->msg));
+    inject_msg(respond_to_current_txdata(200));
+    ASSERT_EQ(1, txdata_count());
+    free_txdata();
+    EXPECT_TRUE(log.contains("S-CSCF received in-dialog request"));
+  }
+}
+
+
 TEST_F(SCSCFTest, TestSessionExpiresWhenNoRecordRoute)
 {
   SCOPED_TRACE("");
@@ -10750,3 +10824,210 @@ TEST_F(SCSCFTestWithRalf, ExpiredChain)
   delete ralf_request_4; ralf_request_4 = NULL;
 }
 
+
+class SCSCFAsLatencyTest : public SCSCFTestBase
+{
+  static void SetUpTestCase()
+  {
+    SCSCFTestBase::SetUpTestCase();
+
+    // Adaptive timeouts are twice an AS's 99th percentile response time, and
+    // an AS is bypassed after a single failure.  The tracker keeps its state
+    // across tests, so each test uses a different AS.
+    _as_latency_tracker = new AsLatencyTracker(2, 1);
+  }
+  static void TearDownTestCase()
+  {
+    delete _as_latency_tracker; _as_latency_tracker = NULL;
+    SCSCFTestBase::TearDownTestCase();
+  }
+
+  SCSCFAsLatencyTest() : SCSCFTestBase()
+  {
+    // Create the S-CSCF Sproutlet.
+    IFCConfiguration ifc_configuration(false, false, "sip:DUMMY_AS", NULL, NULL);
+    _scscf_sproutlet = new SCSCFSproutlet("scscf",
+                                          "scscf",
+                                          "sip:scscf.sprout.homedomain:5058;transport=TCP",
+                                          "sip:127.0.0.1:5058",
+                                          "sip:icscf.sprout.homedomain:5059;transport=TCP",
+                                          "sip:bgcf@homedomain:5058",
+                                          5058,
+                                          "sip:scscf.sprout.homedomain:5058;transport=TCP",
+                                          "scscf",
+                                          "",
+                                          _sm,
+                                          _enum_service,
+                                          _acr_factory,
+                                          &SNMP::FAKE_INCOMING_SIP_TRANSACTIONS_TABLE,
+                                          &SNMP::FAKE_OUTGOING_SIP_TRANSACTIONS_TABLE,
+                                          false,
+                                          _fifc_service,
+                                          ifc_configuration,
+                                          3000, // Session continue timeout - different from default
+                                          6000, // Session terminated timeout - different from default
+                                          _sess_term_comm_tracker,
+                                          _sess_cont_comm_tracker,
+                                          _as_latency_tracker
+                                          );
+    _scscf_sproutlet->init();
+
+    // Add common sproutlet to the list for Proxy use
+    std::list<Sproutlet*> sproutlets;
+    sproutlets.push_back(_scscf_sproutlet);
+    sproutlets.push_back(_bgcf_sproutlet);
+    sproutlets.push_back(_mmtel_sproutlet);
+
+    // Add additional home domain for Proxy use
+    std::unordered_set<std::string> additional_home_domains;
+    additional_home_domains.insert("sprout.homedomain");
+    additional_home_domains.insert("sprout-site2.homedomain");
+    additional_home_domains.insert("127.0.0.1");
+
+    _proxy = new SproutletProxy(stack_data.endpt,
+                                PJSIP_MOD_PRIORITY_UA_PROXY_LAYER+1,
+                                "homedomain",
+                                additional_home_domains,
+                                std::unordered_set<std::string>(),
+                                true,
+                                sproutlets,
+                                std::set<std::string>(),
+                                nullptr,
+                                nullptr);
+  }
+
+  ~SCSCFAsLatencyTest()
+  {
+  }
+
+  static AsLatencyTracker* _as_latency_tracker;
+};
+
+AsLatencyTracker* SCSCFAsLatencyTest::_as_latency_tracker;
+
+// Test that an AS with default handling of SESSION_CONTINUED is bypassed
+// without being sent the request once its circuit breaker has opened.
+TEST_F(SCSCFAsLatencyTest, CircuitBreakerBypassesAs)
+{
+  HSSConnection::irs_info irs_info;
+  Bindings bindings;
+  setup_callee_info(irs_info, bindings);
+  set_ifc(irs_info, "sip:6505551234@homedomain", 1, {"<Method>INVITE</Method>"}, "sip:1.2.3.4:56789;transport=tcp");
+  expect_get_callee_info(irs_info, bindings);
+
+  // The AS has already failed once, which opens its circuit breaker.
+  _as_latency_tracker->on_failure("sip:1.2.3.4:56789;transport=tcp");
+
+  // The AS isn't contacted, so there is no failure to track.
+  EXPECT_CALL(*_sess_cont_comm_tracker, on_failure(_, _)).Times(0);
+
+  TransportFlow tpCaller(TransportFlow::Protocol::TCP, stack_data.scscf_port, "10.99.88.11", 12345);
+  TransportFlow tpBono(TransportFlow::Protocol::TCP, stack_data.scscf_port, "10.6.6.200", 5060);
+
+  // Caller sends INVITE
+  SCSCFMessage msg;
+  msg._via = "10.99.88.11:12345;transport=TCP";
+  msg._route = "Route: <sip:sprout.homedomain>";
+  msg._requri = "sip:6505551234@homedomain";
+
+  msg._method = "INVITE";
+  inject_msg(msg.get_request(), &tpCaller);
+  poll();
+  ASSERT_EQ(2, txdata_count());
+
+  // 100 Trying goes back to caller
+  pjsip_msg* out = current_txdata()->msg;
+  RespMatcher(100).matches(out);
+  tpCaller.expect_target(current_txdata(), true);
+  free_txdata();
+
+  // INVITE goes straight to the callee, without a Route to the AS.
+  out = current_txdata()->msg;
+  ReqMatcher r1("INVITE");
+  ASSERT_NO_FATAL_FAILURE(r1.matches(out));
+  tpBono.expect_target(current_txdata(), true);
+  EXPECT_EQ("sip:wuntootreefower@10.114.61.213:5061;transport=tcp;ob", r1.uri());
+  EXPECT_THAT(get_headers(out, "Route"), Not(HasSubstr("1.2.3.4")));
+
+  inject_msg(respond_to_txdata(current_txdata(), 200, "", ""), &tpBono);
+  free_txdata();
+
+  // 200 OK received at caller.
+  poll();
+  ASSERT_EQ(1, txdata_count());
+  out = current_txdata()->msg;
+  RespMatcher(200).matches(out);
+  free_txdata();
+}
+
+// Test that the liveness timer for an AS with default handling of
+// SESSION_CONTINUED is scaled down to fit the AS's usual response time.
+TEST_F(SCSCFAsLatencyTest, AdaptiveTimeout)
+{
+  HSSConnection::irs_info irs_info;
+  Bindings bindings;
+  setup_callee_info(irs_info, bindings);
+  set_ifc(irs_info, "sip:6505551234@homedomain", 1, {"<Method>INVITE</Method>"}, "sip:1.2.3.5:56789;transport=tcp");
+  expect_get_callee_info(irs_info, bindings);
+
+  // The AS normally responds in 10ms, so its timeout is the minimum adaptive
+  // timeout rather than the configured 3s.
+  for (int ii = 0; ii < AsLatencyTracker::RECALC_INTERVAL; ++ii)
+  {
+    _as_latency_tracker->on_success("sip:1.2.3.5:56789;transport=tcp", 10);
+  }
+  ASSERT_EQ(AsLatencyTracker::MIN_ADAPTIVE_TIMEOUT_MS,
+            _as_latency_tracker->timeout_ms("sip:1.2.3.5:56789;transport=tcp", 3000));
+
+  EXPECT_CALL(*_sess_cont_comm_tracker, on_failure(_, HasSubstr("timeout")));
+
+  TransportFlow tpCaller(TransportFlow::Protocol::TCP, stack_data.scscf_port, "10.99.88.11", 12345);
+  TransportFlow tpBono(TransportFlow::Protocol::TCP, stack_data.scscf_port, "10.6.6.200", 5060);
+
+  // Caller sends INVITE
+  SCSCFMessage msg;
+  msg._via = "10.99.88.11:12345;transport=TCP";
+  msg._route = "Route: <sip:sprout.homedomain>";
+  msg._requri = "sip:6505551234@homedomain";
+
+  msg._method = "INVITE";
+  inject_msg(msg.get_request(), &tpCaller);
+  poll();
+  ASSERT_EQ(2, txdata_count());
+
+  // 100 Trying goes back to caller
+  pjsip_msg* out = current_txdata()->msg;
+  RespMatcher(100).matches(out);
+  free_txdata();
+
+  // INVITE passed on to AS
+  out = current_txdata()->msg;
+  ReqMatcher r1("INVITE");
+  ASSERT_NO_FATAL_FAILURE(r1.matches(out));
+  free_txdata();
+
+  // The AS doesn't respond.  Nothing happens before the adaptive timeout.
+  cwtest_advance_time_ms(AsLatencyTracker::MIN_ADAPTIVE_TIMEOUT_MS - 1);
+  poll();
+  ASSERT_EQ(0, txdata_count());
+
+  // Once it expires, the AS is bypassed and the INVITE is sent to the callee,
+  // well before the configured timeout.
+  cwtest_advance_time_ms(1);
+  poll();
+  ASSERT_EQ(1, txdata_count());
+  out = current_txdata()->msg;
+  ReqMatcher r2("INVITE");
+  ASSERT_NO_FATAL_FAILURE(r2.matches(out));
+  tpBono.expect_target(current_txdata(), true);
+
+  inject_msg(respond_to_txdata(current_txdata(), 200, "", ""), &tpBono);
+  free_txdata();
+
+  // 200 OK received at caller.
+  poll();
+  ASSERT_EQ(1, txdata_count());
+  out = current_txdata()->msg;
+  RespMatcher(200).matches(out);
+  free_txdata();
+}
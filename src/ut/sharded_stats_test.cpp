@@ -0,0 +1,91 @@
+/**
+ * @file sharded_stats_test.cpp UT for the sharded statistics.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "sharded_stats.h"
+#include "fakesnmp.hpp"
+
+class ShardedStatsTest : public ::testing::Test
+{
+};
+
+// Check that increments from several threads are only written to the
+// underlying table when the counter is flushed.
+TEST_F(ShardedStatsTest, Counter)
+{
+  ShardedStatsFlusher flusher;
+  SNMP::FakeCounterTable* table = new SNMP::FakeCounterTable();
+  ShardedCounter<SNMP::CounterTable> counter(table, &flusher);
+
+  std::vector<std::thread> threads;
+  for (int ii = 0; ii < 4; ++ii)
+  {
+    threads.push_back(std::thread([&counter]()
+    {
+      for (int jj = 0; jj < 100; ++jj)
+      {
+        counter.increment();
+      }
+    }));
+  }
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  EXPECT_EQ(0, table->_count);
+
+  flusher.flush_all();
+  EXPECT_EQ(400, table->_count);
+
+  // Flushing again doesn't count anything twice.
+  flusher.flush_all();
+  EXPECT_EQ(400, table->_count);
+}
+
+// Check that samples are buffered until the accumulator is flushed.
+TEST_F(ShardedStatsTest, Accumulator)
+{
+  ShardedStatsFlusher flusher;
+  SNMP::FakeEventAccumulatorTable* table = new SNMP::FakeEventAccumulatorTable();
+  ShardedAccumulator<SNMP::EventAccumulatorTable> accumulator(table, &flusher);
+
+  accumulator.accumulate(10);
+  accumulator.accumulate(20);
+  EXPECT_EQ(0, table->_count);
+
+  flusher.flush_all();
+  EXPECT_EQ(2, table->_count);
+}
+
+// Check that a thread writes its samples out itself if too many are
+// buffered.
+TEST_F(ShardedStatsTest, AccumulatorBufferFull)
+{
+  ShardedStatsFlusher flusher;
+  SNMP::FakeEventAccumulatorTable* table = new SNMP::FakeEventAccumulatorTable();
+  ShardedAccumulator<SNMP::EventAccumulatorTable> accumulator(table, &flusher);
+  const int max_samples =
+    (int)ShardedAccumulator<SNMP::EventAccumulatorTable>::MAX_BUFFERED_SAMPLES;
+
+  for (int ii = 0; ii < max_samples - 1; ++ii)
+  {
+    accumulator.accumulate(ii);
+  }
+  EXPECT_EQ(0, table->_count);
+
+  accumulator.accumulate(0);
+  EXPECT_EQ(max_samples, table->_count);
+}
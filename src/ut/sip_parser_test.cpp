@@ -17,6 +17,7 @@
 #include "pjutils.h"
 #include "stack.h"
 #include "custom_headers.h"
+#include "sip_scan.h"
 
 using namespace std;
 
@@ -1425,3 +1426,172 @@ TEST_F(SipParserTest, ResourcePriority)
 
   pj_pool_release(clone_pool);
 }
+
+// Messages used to check that the vectorised framing scanner gives the same
+// results as the PJSIP scanner.
+static const std::string FRAMING_MSGS[] = {
+  // Complete message with a body.
+  "INVITE sip:6505554321@homedomain SIP/2.0\r\n"
+  "Via: SIP/2.0/TCP 10.0.0.1:5060;rport;branch=z9hG4bKPjPtKqxhkZnvVKI2LUEWoZVFjFaqo.cOzf\r\n"
+  "Max-Forwards: 63\r\n"
+  "From: <sip:6505551234@homedomain>;tag=1234\r\n"
+  "To: <sip:6505554321@homedomain>\r\n"
+  "Record-Route: <sip:sprout.homedomain:5054;transport=TCP;lr;billing-role=charge-term>\r\n"
+  "Record-Route: <sip:sprout.homedomain:5054;transport=TCP;lr;billing-role=charge-orig>\r\n"
+  "Call-ID: 1-13919@10.151.20.48\r\n"
+  "CSeq: 1 INVITE\r\n"
+  "Content-Type: application/sdp\r\n"
+  "Content-Length: 10\r\n"
+  "\r\n"
+  "v=0\r\no=- 1",
+
+  // Two pipelined messages, the first of which uses the compact form.
+  "OPTIONS sip:homedomain SIP/2.0\r\n"
+  "Via: SIP/2.0/TCP 10.0.0.1:5060;branch=z9hG4bK1\r\n"
+  "l : 0\r\n"
+  "\r\n"
+  "OPTIONS sip:homedomain SIP/2.0\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n",
+
+  // Lower case header name, with extra whitespace.
+  "BYE sip:6505554321@homedomain SIP/2.0\r\n"
+  "Call-ID: 1-13919@10.151.20.48\r\n"
+  "content-length :\t 3\r\n"
+  "\r\n"
+  "abc",
+
+  // Body is incomplete.
+  "MESSAGE sip:6505554321@homedomain SIP/2.0\r\n"
+  "Content-Length: 100\r\n"
+  "\r\n"
+  "Short body",
+
+  // Headers are incomplete.
+  "MESSAGE sip:6505554321@homedomain SIP/2.0\r\n"
+  "Content-Length: 100\r\n",
+
+  // No Content-Length.
+  "REGISTER sip:homedomain SIP/2.0\r\n"
+  "Via: SIP/2.0/TCP 10.0.0.1:5060;branch=z9hG4bK1\r\n"
+  "Content-Type: text/plain\r\n"
+  "\r\n",
+
+  // Content-Length with no value, followed by a valid one.
+  "REGISTER sip:homedomain SIP/2.0\r\n"
+  "Content-Length: x\r\n"
+  "Content-Length: 2\r\n"
+  "\r\n"
+  "ab",
+
+  // Headers that only look like Content-Length.
+  "REGISTER sip:homedomain SIP/2.0\r\n"
+  "Link: <sip:homedomain>\r\n"
+  "Location: 4\r\n"
+  "\r\n",
+
+  // Header name that starts with Content-Length.
+  "REGISTER sip:homedomain SIP/2.0\r\n"
+  "Content-LengthX: 5\r\n"
+  "\r\n"
+  "abcde",
+
+  // Content-Length value with trailing characters.
+  "REGISTER sip:homedomain SIP/2.0\r\n"
+  "Content-Length: 5abc\r\n"
+  "\r\n"
+  "abcde",
+
+  // Content-Length value with trailing whitespace.
+  "REGISTER sip:homedomain SIP/2.0\r\n"
+  "Content-Length: 5 \r\n"
+  "\r\n"
+  "abcde"
+};
+
+// Check that the scanner frames messages identically to pjsip_find_msg, for
+// every prefix of each message and at every implementation level.
+TEST_F(SipParserTest, ScannerFindMsgMatchesPJSIP)
+{
+  SipScan::Level original = SipScan::level();
+
+  for (const std::string& msg : FRAMING_MSGS)
+  {
+    for (size_t len = 0; len <= msg.length(); ++len)
+    {
+      pj_size_t pj_size = 0;
+      pj_status_t pj_rc = pjsip_find_msg(msg.data(), len, PJ_FALSE, &pj_size);
+
+      for (int level = (int)SipScan::Level::SCALAR;
+           level <= (int)SipScan::Level::AVX2;
+           ++level)
+      {
+        SipScan::set_level((SipScan::Level)level);
+        pj_size_t scan_size = 0;
+        pj_status_t scan_rc = SipScan::find_msg(msg.data(), len, PJ_FALSE, &scan_size);
+
+        EXPECT_EQ(pj_rc, scan_rc) << SipScan::level_name(SipScan::level())
+                                  << " length " << len << ":\n" << msg;
+        EXPECT_EQ(pj_size, scan_size) << SipScan::level_name(SipScan::level())
+                                      << " length " << len << ":\n" << msg;
+      }
+    }
+  }
+
+  SipScan::set_level(original);
+}
+
+// Check that headers that aren't exactly Content-Length, and Content-Length
+// values that don't end at the end of the line, are ignored.
+TEST_F(SipParserTest, ScannerFindMsgInvalidContentLength)
+{
+  pj_size_t size = 0;
+  const std::string& bad_name = FRAMING_MSGS[8];
+  EXPECT_EQ(PJSIP_EMISSINGHDR,
+            SipScan::find_msg(bad_name.data(), bad_name.length(), PJ_FALSE, &size));
+
+  const std::string& bad_value = FRAMING_MSGS[9];
+  EXPECT_EQ(PJSIP_EMISSINGHDR,
+            SipScan::find_msg(bad_value.data(), bad_value.length(), PJ_FALSE, &size));
+
+  const std::string& trailing_ws = FRAMING_MSGS[10];
+  EXPECT_EQ(PJ_SUCCESS,
+            SipScan::find_msg(trailing_ws.data(), trailing_ws.length(), PJ_FALSE, &size));
+  EXPECT_EQ(trailing_ws.length(), size);
+}
+
+// Datagrams are always a single message.
+TEST_F(SipParserTest, ScannerFindMsgDatagram)
+{
+  const std::string& msg = FRAMING_MSGS[3];
+  pj_size_t size = 0;
+  EXPECT_EQ(PJ_SUCCESS, SipScan::find_msg(msg.data(), msg.length(), PJ_TRUE, &size));
+  EXPECT_EQ(msg.length(), size);
+}
+
+// Check the line and header boundary primitives agree across implementation
+// levels at every alignment.
+TEST_F(SipParserTest, ScannerPrimitives)
+{
+  SipScan::Level original = SipScan::level();
+  const std::string& msg = FRAMING_MSGS[0];
+
+  for (size_t start = 0; start < msg.length(); ++start)
+  {
+    const char* buf = msg.data() + start;
+    size_t len = msg.length() - start;
+    const char* expected_lf = (const char*)memchr(buf, '\n', len);
+    const char* expected_eoh = strstr(buf, "\n\r\n");
+
+    for (int level = (int)SipScan::Level::SCALAR;
+         level <= (int)SipScan::Level::AVX2;
+         ++level)
+    {
+      SipScan::set_level((SipScan::Level)level);
+      EXPECT_EQ(expected_lf, SipScan::find_line_end(buf, len));
+      EXPECT_EQ(expected_eoh, SipScan::find_end_of_headers(buf, len));
+    }
+  }
+
+  SipScan::set_level(original);
+}
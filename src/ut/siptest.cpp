@@ -114,6 +114,7 @@ void SipTest::SetUpTestCase()
   URIClassifier::home_domains.push_back(&scscf_domain);
   stack_data.cdf_domain = pj_str("cdfdomain");
   stack_data.name = {stack_data.local_host, stack_data.public_host, pj_str("sprout.homedomain")};
+  URIClassifier::update_host_sets();
   stack_data.record_route_on_initiation_of_originating = true;
   stack_data.record_route_on_completion_of_terminating = true;
   stack_data.default_session_expires = 60 * 10;
@@ -0,0 +1,265 @@
+/**
+ * @file slow_transactions_test.cpp UT for the slowest SIP message records.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <string>
+#include "gtest/gtest.h"
+
+#include "siptest.hpp"
+#include "test_interposer.hpp"
+#include "slow_transactions.h"
+#include "fast_clock.h"
+
+using namespace std;
+
+class SlowTransactionsTest : public SipTest
+{
+public:
+  static void SetUpTestCase()
+  {
+    SipTest::SetUpTestCase();
+  }
+
+  static void TearDownTestCase()
+  {
+    SipTest::TearDownTestCase();
+  }
+
+  void SetUp()
+  {
+    cwtest_completely_control_time();
+    SlowTransactions::configure(SlowTransactions::DEFAULT_COUNT,
+                                SlowTransactions::DEFAULT_WINDOW_S);
+    SlowTransactions::reset();
+  }
+
+  void TearDown()
+  {
+    SlowTransactions::configure(SlowTransactions::DEFAULT_COUNT,
+                                SlowTransactions::DEFAULT_WINDOW_S);
+    SlowTransactions::reset();
+    cwtest_reset_time();
+  }
+
+  pjsip_rx_data* request(const string& method)
+  {
+    string msg =
+      method + " sip:6505550001@homedomain SIP/2.0\r\n"
+      "Via: SIP/2.0/TCP 10.83.18.38:36530;rport;branch=z9hG4bKPjslowtsx\r\n"
+      "From: <sip:6505550000@homedomain>;tag=10.114.61.213+1+8c8b232a+5fb751cf\r\n"
+      "To: <sip:6505550001@homedomain>\r\n"
+      "Max-Forwards: 68\r\n"
+      "Call-ID: slowtsx@10.114.61.213\r\n"
+      "CSeq: 16567 " + method + "\r\n"
+      "Content-Length: 0\r\n\r\n";
+
+    pjsip_rx_data* rdata = build_rxdata(msg);
+    parse_rxdata(rdata);
+    return rdata;
+  }
+
+  pjsip_rx_data* response(const string& method)
+  {
+    string msg =
+      "SIP/2.0 200 OK\r\n"
+      "Via: SIP/2.0/TCP 10.83.18.38:36530;rport;branch=z9hG4bKPjslowtsx\r\n"
+      "From: <sip:6505550000@homedomain>;tag=10.114.61.213+1+8c8b232a+5fb751cf\r\n"
+      "To: <sip:6505550001@homedomain>;tag=1234\r\n"
+      "Call-ID: slowtsx@10.114.61.213\r\n"
+      "CSeq: 16567 " + method + "\r\n"
+      "Content-Length: 0\r\n\r\n";
+
+    pjsip_rx_data* rdata = build_rxdata(msg);
+    parse_rxdata(rdata);
+    return rdata;
+  }
+
+  // Records processing of the message that takes the given time.
+  void process(pjsip_rx_data* rdata, int duration_ms)
+  {
+    SlowTransactions::start(0);
+    cwtest_advance_time_ms(duration_ms);
+    SlowTransactions::finish(rdata, 0);
+  }
+};
+
+// Check that the time is split into the right stages.
+TEST_F(SlowTransactionsTest, StageBreakdown)
+{
+  pjsip_rx_data* rdata = request("INVITE");
+
+  SlowTransactions::start(2000);
+  EXPECT_TRUE(SlowTransactions::recording());
+  cwtest_advance_time_ms(1);
+
+  {
+    SlowTransactions::SproutletStage scscf("scscf");
+    cwtest_advance_time_ms(3);
+
+    SlowTransactions::io_started("HTTP");
+    cwtest_advance_time_ms(10);
+    SlowTransactions::io_completed("HTTP");
+
+    {
+      SlowTransactions::SproutletStage bgcf("bgcf");
+      cwtest_advance_time_ms(1);
+    }
+
+    SlowTransactions::set_served_user("sip:6505550000@homedomain");
+    SlowTransactions::response_sent(180);
+    SlowTransactions::response_sent(200);
+  }
+
+  SlowTransactions::finish(rdata, 1234);
+  EXPECT_FALSE(SlowTransactions::recording());
+
+  SlowTransactions::Report report;
+  SlowTransactions::get_slowest(report);
+  ASSERT_EQ(1u, report.size());
+  ASSERT_EQ(1u, report["INVITE"].size());
+
+  const SlowTransactions::Transaction& tsx = report["INVITE"][0];
+  EXPECT_EQ(17000u, tsx.latency_us);
+  EXPECT_EQ(1234u, tsx.trail);
+  EXPECT_EQ("INVITE", tsx.method);
+  EXPECT_TRUE(tsx.request);
+  EXPECT_EQ("slowtsx@10.114.61.213", tsx.call_id);
+  EXPECT_EQ("sip:6505550000@homedomain", tsx.served_user);
+  EXPECT_EQ(200, tsx.status_code);
+
+  ASSERT_EQ(2u, tsx.sproutlets.size());
+  EXPECT_EQ("scscf", tsx.sproutlets[0]);
+  EXPECT_EQ("bgcf", tsx.sproutlets[1]);
+
+  ASSERT_EQ(5u, tsx.stages.size());
+  EXPECT_EQ(SlowTransactions::Stage::QUEUE, tsx.stages[0].type);
+  EXPECT_EQ(2000u, tsx.stages[0].duration_us);
+  EXPECT_EQ(SlowTransactions::Stage::SPROUT, tsx.stages[1].type);
+  EXPECT_EQ(1000u, tsx.stages[1].duration_us);
+  EXPECT_EQ(SlowTransactions::Stage::SPROUTLET, tsx.stages[2].type);
+  EXPECT_EQ("scscf", tsx.stages[2].name);
+  EXPECT_EQ(3000u, tsx.stages[2].duration_us);
+  EXPECT_EQ(SlowTransactions::Stage::IO, tsx.stages[3].type);
+  EXPECT_EQ("HTTP", tsx.stages[3].name);
+  EXPECT_EQ(10000u, tsx.stages[3].duration_us);
+  EXPECT_EQ(SlowTransactions::Stage::SPROUTLET, tsx.stages[4].type);
+  EXPECT_EQ("bgcf", tsx.stages[4].name);
+  EXPECT_EQ(1000u, tsx.stages[4].duration_us);
+}
+
+// Check that only the slowest messages are kept for each method, and that
+// responses are kept under the method of their CSeq.
+TEST_F(SlowTransactionsTest, KeepsSlowestPerMethod)
+{
+  SlowTransactions::configure(2, 60);
+
+  process(request("INVITE"), 1);
+  process(request("INVITE"), 5);
+  process(request("INVITE"), 3);
+  process(request("INVITE"), 2);
+  process(response("BYE"), 4);
+  process(request("FOO"), 6);
+
+  SlowTransactions::Report report;
+  SlowTransactions::get_slowest(report);
+  ASSERT_EQ(3u, report.size());
+
+  ASSERT_EQ(2u, report["INVITE"].size());
+  EXPECT_EQ(5000u, report["INVITE"][0].latency_us);
+  EXPECT_EQ(3000u, report["INVITE"][1].latency_us);
+
+  ASSERT_EQ(1u, report["BYE"].size());
+  EXPECT_FALSE(report["BYE"][0].request);
+  EXPECT_EQ(0, report["BYE"][0].status_code);
+
+  ASSERT_EQ(1u, report["other"].size());
+  EXPECT_EQ("FOO", report["other"][0].method);
+
+  // Resetting discards all the messages.
+  SlowTransactions::reset();
+  report.clear();
+  SlowTransactions::get_slowest(report);
+  EXPECT_TRUE(report.empty());
+}
+
+// Check that messages are discarded once they leave the window, and that the
+// slowest of the messages still in the window are then reported, even if
+// they were faster than ones that have left.
+TEST_F(SlowTransactionsTest, Window)
+{
+  SlowTransactions::configure(1, 60);
+
+  process(request("INVITE"), 10);
+  cwtest_advance_time_ms(30000);
+  process(request("INVITE"), 1);
+
+  SlowTransactions::Report report;
+  SlowTransactions::get_slowest(report);
+  ASSERT_EQ(1u, report["INVITE"].size());
+  EXPECT_EQ(10000u, report["INVITE"][0].latency_us);
+
+  cwtest_advance_time_ms(31000);
+  report.clear();
+  SlowTransactions::get_slowest(report);
+  ASSERT_EQ(1u, report["INVITE"].size());
+  EXPECT_EQ(1000u, report["INVITE"][0].latency_us);
+
+  cwtest_advance_time_ms(30000);
+  report.clear();
+  SlowTransactions::get_slowest(report);
+  EXPECT_TRUE(report.empty());
+}
+
+// Check that faster messages are only dropped in favour of slower ones in
+// the same slice of the window.
+TEST_F(SlowTransactionsTest, WindowSlices)
+{
+  SlowTransactions::configure(1, 60);
+
+  // Move to the start of a 6s slice.
+  uint64_t slice_ns = 6000000000ull;
+  cwtest_advance_time_ms((slice_ns - FastClock::now_ns() % slice_ns + 999999) / 1000000);
+
+  // Two messages in the slice, of which only the slower is kept.
+  process(request("INVITE"), 10);
+  process(request("INVITE"), 5);
+
+  // A faster message in the next slice is kept too.
+  cwtest_advance_time_ms(6000);
+  process(request("INVITE"), 2);
+
+  SlowTransactions::Report report;
+  SlowTransactions::get_slowest(report);
+  ASSERT_EQ(1u, report["INVITE"].size());
+  EXPECT_EQ(10000u, report["INVITE"][0].latency_us);
+
+  // Once the first slice leaves the window, the message from the second
+  // slice is the slowest.
+  cwtest_advance_time_ms(54100);
+  report.clear();
+  SlowTransactions::get_slowest(report);
+  ASSERT_EQ(1u, report["INVITE"].size());
+  EXPECT_EQ(2000u, report["INVITE"][0].latency_us);
+}
+
+// Check that nothing is recorded when disabled.
+TEST_F(SlowTransactionsTest, Disabled)
+{
+  SlowTransactions::configure(0, 60);
+
+  SlowTransactions::start(0);
+  EXPECT_FALSE(SlowTransactions::recording());
+  cwtest_advance_time_ms(10);
+  SlowTransactions::finish(request("INVITE"), 0);
+
+  SlowTransactions::Report report;
+  SlowTransactions::get_slowest(report);
+  EXPECT_TRUE(report.empty());
+}
@@ -0,0 +1,77 @@
+/**
+ * @file sprout_probes_test.cpp UT for the USDT probe helpers.
+ *
+ * Copyright (C) Metaswitch Networks 2017
+ * If license terms are provided to you in a COPYING file in the root directory
+ * of the source code repository by which you are accessing this code, then
+ * the license outlined in that COPYING file applies to your use.
+ * Otherwise no rights are granted except for those provided to you by
+ * Metaswitch Networks in a separate written agreement.
+ */
+
+#include <string>
+#include "gtest/gtest.h"
+
+#include "pjsip.h"
+#include "sprout_probes.h"
+
+class SproutProbesTest : public ::testing::Test
+{
+public:
+  static pj_caching_pool caching_pool;
+  static pj_pool_t* pool;
+
+  static void SetUpTestCase()
+  {
+    pj_init();
+    pj_caching_pool_init(&caching_pool, &pj_pool_factory_default_policy, 0);
+    pool = pj_pool_create(&caching_pool.factory, "probes-test", 4000, 4000, NULL);
+  }
+
+  static void TearDownTestCase()
+  {
+    pj_pool_release(pool); pool = NULL;
+    pj_caching_pool_destroy(&caching_pool);
+    pj_shutdown();
+  }
+};
+
+pj_pool_t* SproutProbesTest::pool;
+pj_caching_pool SproutProbesTest::caching_pool;
+
+// Check that the method of a request is reported.
+TEST_F(SproutProbesTest, RequestMethod)
+{
+  pjsip_msg* msg = pjsip_msg_create(pool, PJSIP_REQUEST_MSG);
+  pjsip_method_set(&msg->line.req.method, PJSIP_INVITE_METHOD);
+
+  EXPECT_EQ(std::string("INVITE"), ProbeMethod(msg).c_str());
+  EXPECT_EQ(0, probe_status_code(msg));
+}
+
+// Check that the method of a response is taken from its CSeq.
+TEST_F(SproutProbesTest, ResponseMethod)
+{
+  pjsip_msg* msg = pjsip_msg_create(pool, PJSIP_RESPONSE_MSG);
+  msg->line.status.code = 180;
+  EXPECT_EQ(std::string(""), ProbeMethod(msg).c_str());
+
+  pjsip_cseq_hdr* cseq = pjsip_cseq_hdr_create(pool);
+  pjsip_method_set(&cseq->method, PJSIP_BYE_METHOD);
+  pjsip_msg_add_hdr(msg, (pjsip_hdr*)cseq);
+
+  EXPECT_EQ(std::string("BYE"), ProbeMethod(msg).c_str());
+  EXPECT_EQ(180, probe_status_code(msg));
+}
+
+// Check that there is no method without a message, and that long methods are
+// truncated.
+TEST_F(SproutProbesTest, NoMethodAndLongMethod)
+{
+  EXPECT_EQ(std::string(""), ProbeMethod((const pjsip_msg*)NULL).c_str());
+
+  pjsip_method method;
+  pj_str_t name = pj_str((char*)"AVERYVERYVERYLONGEXTENSIONMETHOD");
+  pjsip_method_init_np(&method, &name);
+  EXPECT_EQ(std::string("AVERYVERYVERYLONGEXTENS"), ProbeMethod(&method).c_str());
+}
@@ -1478,6 +1478,56 @@ TEST_F(SubscriberManagerTest, TestGetExpiredBindings)
   EXPECT_EQ(all_bindings.size(), 0);
 }
 
+// Tests that get bindings hands over the bindings from the AoR read from S4
+// rather than copying them.
+TEST_F(SubscriberManagerTest, TestGetBindingsNotCopied)
+{
+  AoR* get_aor = AoRTestUtils::create_simple_aor(DEFAULT_ID, true);
+  Binding* binding = get_aor->get_binding(AoRTestUtils::BINDING_ID);
+
+  EXPECT_CALL(*_s4, handle_get(DEFAULT_ID, _, _, _))
+    .WillOnce(DoAll(SetArgPointee<1>(get_aor),
+                    Return(HTTP_OK)));
+
+  Bindings all_bindings;
+  HTTPCode rc = _subscriber_manager->get_bindings(DEFAULT_ID,
+                                                  all_bindings,
+                                                  DUMMY_TRAIL_ID);
+  EXPECT_EQ(rc, HTTP_OK);
+
+  // The binding passed out is the one S4 returned, so it has survived the
+  // deletion of the AoR.
+  ASSERT_EQ(all_bindings.size(), 1);
+  EXPECT_EQ(all_bindings[AoRTestUtils::BINDING_ID], binding);
+  EXPECT_EQ(binding->_uri, AoRTestUtils::CONTACT_URI);
+
+  SubscriberDataUtils::delete_bindings(all_bindings);
+}
+
+// Tests that taking the active bindings leaves expired bindings behind.
+TEST_F(SubscriberManagerTest, TestTakeActiveBindings)
+{
+  int now = time(NULL);
+  Bindings bindings;
+  Binding* active = AoRTestUtils::build_binding(DEFAULT_ID, now);
+  Binding* expired = AoRTestUtils::build_binding(DEFAULT_ID, now);
+  expired->_expires = now - 10;
+  bindings.insert(std::make_pair("active", active));
+  bindings.insert(std::make_pair("expired", expired));
+
+  Bindings taken = SubscriberDataUtils::take_active_bindings(bindings,
+                                                             now,
+                                                             DUMMY_TRAIL_ID);
+
+  ASSERT_EQ(taken.size(), 1);
+  EXPECT_EQ(taken["active"], active);
+  ASSERT_EQ(bindings.size(), 1);
+  EXPECT_EQ(bindings["expired"], expired);
+
+  SubscriberDataUtils::delete_bindings(taken);
+  SubscriberDataUtils::delete_bindings(bindings);
+}
+
 // Tests when getting bindings from SM fails.
 TEST_F(SubscriberManagerTest, TestGetBindingsFail)
 {
@@ -217,6 +217,8 @@ public:
     add_host_mapping("sprout.example.com", "10.8.8.1");
   }
 
+  SubscriptionTest() : _expiry_jitter(NULL) {}
+
   void SetUp()
   {
     _sm = new MockSubscriberManager();
@@ -231,7 +233,8 @@ public:
                                                         "scscf-proxy",
                                                         _sm,
                                                         _acr_factory,
-                                                        300);
+                                                        300,
+                                                        _expiry_jitter);
     EXPECT_TRUE(_subscription_sproutlet->init());
 
     std::list<Sproutlet*> sproutlets;
@@ -291,6 +294,7 @@ public:
 
     delete _subscription_proxy; _subscription_proxy = NULL;
     delete _subscription_sproutlet; _subscription_sproutlet = NULL;
+    delete _expiry_jitter; _expiry_jitter = NULL;
   }
 
   // Handle the case where the request isn't absorbed by the subscription
@@ -318,10 +322,35 @@ public:
 protected:
   MockSubscriberManager* _sm;
   ACRFactory* _acr_factory;
+  ExpiryJitter* _expiry_jitter;
   SubscriptionSproutlet* _subscription_sproutlet;
   SproutletProxy* _subscription_proxy;
 };
 
+/// Fixture for subscription tests with expiry jitter enabled.
+class SubscriptionJitterTest : public SubscriptionTest
+{
+public:
+  SubscriptionJitterTest()
+  {
+    _expiry_jitter = new ExpiryJitter(300, 50);
+  }
+
+  /// The number of granted expiries the jitter policy is tracking.
+  uint32_t tracked_expiries()
+  {
+    std::vector<uint32_t> density;
+    _expiry_jitter->get_density(time(NULL), density);
+
+    uint32_t total = 0;
+    for (uint32_t count : density)
+    {
+      total += count;
+    }
+    return total;
+  }
+};
+
 // This test adds a subscription then expires it. It checks in detail the
 // created subscription object and the headers on the 200 OKs.
 TEST_F(SubscriptionTest, MainlineAddAndRemoveSubscription)
@@ -406,6 +435,74 @@ TEST_F(SubscriptionTest, MainlineAddAndRemoveSubscription)
   EXPECT_EQ("Expires: 0", get_headers(out, "Expires"));
 }
 
+// Test that with expiry jitter enabled, the subscription sproutlet grants a
+// shortened expiry, and that refreshes are granted without looking up the
+// existing subscription.
+TEST_F(SubscriptionJitterTest, AddAndRefreshWithJitter)
+{
+  std::string subscription_id;
+  Subscription subscription;
+  HSSConnection::irs_info irs_info;
+  irs_info._regstate = RegDataXMLUtils::STATE_REGISTERED;
+
+  EXPECT_CALL(*_sm, update_subscriptions("sip:6505550231@homedomain", _, _, _))
+    .WillOnce(DoAll(SaveSubscription(&subscription_id, &subscription),
+                    SetArgReferee<2>(irs_info),
+                    Return(HTTP_OK)));
+
+  SubscribeMessage msg;
+  int now = time(NULL);
+  inject_msg(msg.get());
+
+  // The granted expiry is between 150 and 300 seconds, and is returned on
+  // the 200 OK.
+  ASSERT_EQ(1, txdata_count());
+  pjsip_msg* out = pop_txdata()->msg;
+  EXPECT_EQ(200, out->line.status.code);
+  int granted = subscription._expires - now;
+  EXPECT_LE(150, granted);
+  EXPECT_GE(300, granted);
+  EXPECT_EQ("Expires: " + std::to_string(granted), get_headers(out, "Expires"));
+  EXPECT_EQ(1u, tracked_expiries());
+
+  // Refresh the subscription.  Only the update is made - the existing
+  // subscription isn't looked up.
+  EXPECT_CALL(*_sm, get_subscriptions(_, _, _)).Times(0);
+  EXPECT_CALL(*_sm, update_subscriptions("sip:6505550231@homedomain", _, _, _))
+    .WillOnce(DoAll(SaveSubscription(&subscription_id, &subscription),
+                    SetArgReferee<2>(irs_info),
+                    Return(HTTP_OK)));
+
+  msg._to_tag = subscription_id;
+  msg._unique += 1;
+  inject_msg(msg.get());
+
+  ASSERT_EQ(1, txdata_count());
+  out = pop_txdata()->msg;
+  EXPECT_EQ(200, out->line.status.code);
+  granted = subscription._expires - now;
+  EXPECT_LE(150, granted);
+  EXPECT_GE(300, granted);
+
+  // The replaced expiry stays in the histogram until it falls due.
+  EXPECT_EQ(2u, tracked_expiries());
+}
+
+// Test that an expiry isn't tracked if the subscription couldn't be stored.
+TEST_F(SubscriptionJitterTest, FailedUpdateNotTracked)
+{
+  EXPECT_CALL(*_sm, update_subscriptions("sip:6505550231@homedomain", _, _, _))
+    .WillOnce(Return(HTTP_GATEWAY_TIMEOUT));
+
+  SubscribeMessage msg;
+  inject_msg(msg.get());
+
+  ASSERT_EQ(1, txdata_count());
+  pjsip_msg* out = pop_txdata()->msg;
+  EXPECT_NE(200, out->line.status.code);
+  EXPECT_EQ(0u, tracked_expiries());
+}
+
 // Test that a request that isn't a subscribe isn't handled by the subscription
 // sproutlet.
 TEST_F(SubscriptionTest, NotSubscribe)
@@ -42,6 +42,7 @@ public:
     stack_data.home_domains.insert("homedomain");
     stack_data.default_home_domain = pj_str("homedomain");
     URIClassifier::home_domains.push_back(&stack_data.default_home_domain);
+    URIClassifier::update_host_sets();
   }
 
 
@@ -155,3 +156,80 @@ TEST_F(URIClassiferTest, NoUserSIPURI)
   EXPECT_EQ(URIClass::HOME_DOMAIN_SIP_URI,
             classify_uri_helper("sip:homedomain", false));
 }
+
+TEST_F(URIClassiferTest, HomeDomainCaseInsensitive)
+{
+  EXPECT_EQ(URIClass::HOME_DOMAIN_SIP_URI,
+            classify_uri_helper("sip:bob@HomeDomain"));
+}
+
+TEST_F(URIClassiferTest, LocalName)
+{
+  std::vector<pj_str_t> saved_names = stack_data.name;
+  stack_data.name.push_back(pj_str((char*)"sprout.local"));
+  URIClassifier::update_host_sets();
+
+  EXPECT_EQ(URIClass::NODE_LOCAL_SIP_URI,
+            classify_uri_helper("sip:bob@sprout.local"));
+  EXPECT_EQ(URIClass::NODE_LOCAL_SIP_URI,
+            classify_uri_helper("sip:bob@SPROUT.local"));
+  EXPECT_EQ(URIClass::OFFNET_SIP_URI,
+            classify_uri_helper("sip:bob@sprout.local.other"));
+
+  stack_data.name = saved_names;
+  URIClassifier::update_host_sets();
+}
+
+TEST_F(URIClassiferTest, ManyHomeDomains)
+{
+  // Add enough home domains that the set has to grow several times.
+  std::vector<std::string> domains;
+  for (int ii = 0; ii < 500; ++ii)
+  {
+    domains.push_back("tenant" + std::to_string(ii) + ".example.com");
+  }
+  std::vector<pj_str_t> domain_strs(domains.size());
+  for (size_t ii = 0; ii < domains.size(); ++ii)
+  {
+    domain_strs[ii] = pj_str((char*)domains[ii].c_str());
+    URIClassifier::home_domains.push_back(&domain_strs[ii]);
+  }
+  URIClassifier::update_host_sets();
+
+  EXPECT_EQ(URIClass::HOME_DOMAIN_SIP_URI,
+            classify_uri_helper("sip:bob@tenant0.example.com"));
+  EXPECT_EQ(URIClass::HOME_DOMAIN_SIP_URI,
+            classify_uri_helper("sip:bob@TENANT499.example.com"));
+  EXPECT_EQ(URIClass::HOME_DOMAIN_SIP_URI,
+            classify_uri_helper("sip:bob@homedomain"));
+  EXPECT_EQ(URIClass::OFFNET_SIP_URI,
+            classify_uri_helper("sip:bob@tenant500.example.com"));
+
+  URIClassifier::home_domains.resize(URIClassifier::home_domains.size() -
+                                     domain_strs.size());
+  URIClassifier::update_host_sets();
+}
+
+TEST_F(URIClassiferTest, NumberCharacters)
+{
+  URIClassifier::enforce_global = true;
+  URIClassifier::enforce_user_phone = false;
+
+  // Visual separators are allowed in both global and local numbers.
+  EXPECT_EQ(URIClass::GLOBAL_PHONE_NUMBER,
+            classify_uri_helper("sip:+1-(234),5@homedomain", false));
+  EXPECT_EQ(URIClass::LOCAL_PHONE_NUMBER,
+            classify_uri_helper("sip:*12AB-(3)@homedomain", false));
+
+  // User parameters are ignored.
+  EXPECT_EQ(URIClass::GLOBAL_PHONE_NUMBER,
+            classify_uri_helper("sip:+1234;isub=5@homedomain", false));
+
+  // Lower case hex digits and other characters aren't numbers.
+  EXPECT_EQ(URIClass::HOME_DOMAIN_SIP_URI,
+            classify_uri_helper("sip:12ab@homedomain", false));
+  EXPECT_EQ(URIClass::HOME_DOMAIN_SIP_URI,
+            classify_uri_helper("sip:+12.34@homedomain", false));
+
+  URIClassifier::enforce_global = false;
+}
@@ -25,6 +25,7 @@ extern "C" {
 #include "log.h"
 #include "pjutils.h"
 #include "websockets.h"
+#include "sip_scan.h"
 
 using websocketpp::server;
 
@@ -270,6 +271,23 @@ static pj_bool_t on_ws_data(ws_transport *ws,
     return PJ_FALSE;
   }
 
+  /* Each web socket message must carry exactly one SIP message.  RFC 7118
+   * doesn't require a Content-Length, but if there is one it must match the
+   * body, as otherwise the transport manager won't consume the whole packet.
+   */
+  const std::string& payload = msg->get_payload();
+  pj_size_t msg_size;
+  pj_status_t frame_status = SipScan::find_msg(payload.data(),
+                                               payload.length(),
+                                               PJ_FALSE,
+                                               &msg_size);
+  if ((frame_status == PJSIP_EPARTIALMSG) ||
+      ((frame_status == PJ_SUCCESS) && (msg_size != payload.length())))
+  {
+    TRC_ERROR("Dropping incoming websocket message that isn't a single complete SIP message");
+    return PJ_FALSE;
+  }
+
   /* Initialize rdata */
   pj_pool_t *pool;
   pj_sockaddr *rem_addr;
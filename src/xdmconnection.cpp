@@ -16,6 +16,7 @@
 #include <fstream>
 
 #include "utils.h"
+#include "fast_clock.h"
 #include "log.h"
 #include "sas.h"
 #include "sproutsasevent.h"
@@ -52,7 +53,7 @@ bool XDMConnection::get_simservs(const std::string& user,
                                  const std::string& password,
                                  SAS::TrailId trail)
 {
-  Utils::StopWatch stopWatch;
+  FastStopWatch stopWatch;
   stopWatch.start();
 
   std::string url = "/org.etsi.ngn.simservs/users/" + Utils::url_escape(user) + "/simservs.xml";